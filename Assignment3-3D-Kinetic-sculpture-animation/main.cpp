@@ -12,18 +12,78 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include <learnopengl/filesystem.h>
-#include <learnopengl/shader_m.h>
 #include <learnopengl/camera.h>
 
+#define ALLOC_TRACKER_IMPLEMENTATION
+#include "../common/alloc_tracker.h"
+#include "../common/fixed_timestep.h"
+#include "../common/frame_capture.h"
+#include "../common/packed_vertex.h"
+#include "../common/program_cache.h"
+#include "../common/render_queue.h"
+#include "nbody.h"
+#include "sphere_lod.h"
+#include "texture_manager.h"
+#include "virtual_texture.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <random>
 #include <vector>
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-unsigned int createSphereVAO(int sectorCount, int stackCount, unsigned int& vertexCount);
-unsigned int loadTexture(const char* path);
+unsigned int createSphereVAO(const SphereLodChain& lods);
+unsigned int createImpostorVAO();
+
+// material permutations of the body programs: a body whose specular map is its diffuse
+// map (the Sun, the Moon) draws with a variant that samples the texture once
+const int MATERIAL_SPECULAR_MAP = 0;
+const int MATERIAL_SHARED_SPECULAR = 1;
+const int MATERIAL_VARIANTS = 2;
+const int BODY_PROGRAMS = 2 * MATERIAL_VARIANTS; // mesh and impostor per material
+
+// --virtual-texture: the bodies whose diffuse maps are paged, each with its own map and program
+const int VT_SUN = 0;
+const int VT_EARTH = 1;
+const int VT_MOON = 2;
+const int VT_BODIES = 3;
+
+// the two ways a body is drawn: a level of the LOD mesh, or the ray-cast impostor quad,
+// each with one program per material variant
+struct SphereRenderer
+{
+    const SphereLodChain* lods;
+    unsigned int meshVAO;
+    unsigned int meshPrograms[MATERIAL_VARIANTS];
+    unsigned int impostorVAO;
+    unsigned int impostorPrograms[MATERIAL_VARIANTS];
+};
+
+std::vector<ProgramSource> bodyProgramSources(bool specialized);
+SphereRenderer makeSphereRenderer(const SphereLodChain& lods, unsigned int meshVAO, unsigned int impostorVAO,
+                                  const CachedShader* bodyShaders);
+
+int selectBodyLevel(const SphereLodChain& lods, glm::vec3 center, float scale);
+DrawPacket spherePacket(const SphereRenderer& renderer, int level, unsigned int diffuse, unsigned int specular,
+                        const glm::mat4& model, glm::vec3 center);
+void printBodyLevel(std::ostream& out, const SphereLodChain& lods, int level);
+void setLightingUniforms(const CachedShader& shader, glm::vec3 sunPos);
+void useVirtualTexture(VirtualTexture* texture, const CachedShader& virtualShader, const CachedShader& feedbackShader, int level,
+                       DrawPacket& packet);
+int runImpostorBenchmark(GLFWwindow* window, const SphereRenderer& renderer, const CachedShader* bodyShaders, RenderQueue& queue,
+                         TextureManager& textures, unsigned int diffuse, unsigned int specular, size_t maxBodies);
+int runVariantBenchmark(GLFWwindow* window, const SphereRenderer& generic, const SphereRenderer& specialized,
+                        const CachedShader* genericShaders, const CachedShader* specializedShaders, RenderQueue& queue,
+                        TextureManager& textures, unsigned int texture, size_t bodies);
+std::vector<glm::vec3> scatterBenchmarkBodies(size_t count, std::mt19937& generator);
+double timeBenchmarkFrames(GLFWwindow* window, const SphereRenderer& renderer, RenderQueue& queue, const std::vector<glm::vec3>& centers,
+                           unsigned int diffuse, unsigned int specular, unsigned long long& vertices);
 
 // settings
 const unsigned int SCR_WIDTH = 1024;
@@ -39,8 +99,92 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-int main()
+// sphere LOD statistics (reported once per second)
+float impostorMaxPixels = SPHERE_IMPOSTOR_MAX_PIXELS; // 0 with --no-impostors
+unsigned int trianglesThisFrame = 0;
+unsigned int verticesThisFrame = 0; // vertex shader inputs: indices for the mesh, 6 per impostor
+unsigned int impostorsThisFrame = 0;
+unsigned long long trianglesSinceReport = 0;
+unsigned long long verticesSinceReport = 0;
+unsigned long long impostorsSinceReport = 0;
+unsigned int framesSinceReport = 0;
+float lastReportTime = 0.0f;
+
+int main(int argc, char** argv)
 {
+    auto startTime = std::chrono::steady_clock::now();
+
+    // headless tools:
+    //   --bench-textures [repeat]  decode throughput
+    //   --bench-texcache           plain vs BC1 cache memory and load time (also writes the caches)
+    //   --no-texture-cache         run the demo on the plain decode path
+    //   --no-shader-cache          always compile shaders from source
+    //   --frame-time <ms>          pace frames to this time instead of vsync
+    //   --nbody [asteroids]        Sun, Earth, Moon and an asteroid belt under mutual gravity
+    //   --bench-nbody [maxBodies] [threads]  Barnes-Hut steps/s and energy drift, 10^3 .. 10^6 bodies
+    //   --no-impostors             draw every body with the LOD mesh
+    //   --bench-impostors [maxBodies]  vertex load and frame time, meshes vs impostors (opens a window;
+    //                              LIBGL_ALWAYS_SOFTWARE=1 measures Mesa's CPU vertex path)
+    //   --virtual-texture [image]  page the Sun's, Earth's and Moon's diffuse maps through tile files;
+    //                              image replaces the Earth's (default earth.jpg)
+    //   --bench-vtex [size]        page hit rate and memory for a size x size/2 map on a scripted flight
+    //   --bench-variants [bodies]  generic vs specialized body programs: active uniforms and frame time
+    //   --capture <path> [frames]  record the window to a .y4m file or a directory of PNGs; with a frame
+    //                              count the window is hidden and closes once that many are taken
+    std::vector<std::string> texturePaths = {
+        FileSystem::getPath("resources/textures/sun.jpg"),
+        FileSystem::getPath("resources/textures/earth.jpg"),
+        FileSystem::getPath("resources/textures/earth_specular.jpg"),
+        FileSystem::getPath("resources/textures/moon.jpg"),
+    };
+    bool useTextureCache = true;
+    bool useShaderCache = true;
+    double targetFrameTime = 0.0;
+    int nbodyAsteroids = -1; // -1: the hand-animated orbits
+    size_t impostorBenchBodies = 0;
+    size_t variantBenchBodies = 0;
+    std::string virtualTexturePath;
+    std::string capturePath;
+    int captureFrames = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--bench-vtex") == 0)
+            return runVirtualTextureBenchmark(texturePaths[1], i + 1 < argc ? atoi(argv[i + 1]) : 16384);
+        if (strcmp(argv[i], "--bench-nbody") == 0)
+            return runNBodyBenchmark(i + 1 < argc ? (size_t)atof(argv[i + 1]) : 1000000, i + 2 < argc ? atoi(argv[i + 2]) : 0);
+        if (strcmp(argv[i], "--bench-textures") == 0)
+        {
+            benchmarkTextureDecode(texturePaths, i + 1 < argc ? atoi(argv[i + 1]) : 4);
+            return 0;
+        }
+        if (strcmp(argv[i], "--bench-texcache") == 0)
+        {
+            benchmarkTextureCache(texturePaths);
+            return 0;
+        }
+        if (strcmp(argv[i], "--no-texture-cache") == 0)
+            useTextureCache = false;
+        if (strcmp(argv[i], "--no-shader-cache") == 0)
+            useShaderCache = false;
+        if (strcmp(argv[i], "--frame-time") == 0 && i + 1 < argc)
+            targetFrameTime = atof(argv[++i]) / 1000.0;
+        if (strcmp(argv[i], "--nbody") == 0)
+            nbodyAsteroids = i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i]) : 300;
+        if (strcmp(argv[i], "--no-impostors") == 0)
+            impostorMaxPixels = 0.0f;
+        if (strcmp(argv[i], "--bench-impostors") == 0)
+            impostorBenchBodies = i + 1 < argc && argv[i + 1][0] != '-' ? (size_t)atof(argv[++i]) : 10000;
+        if (strcmp(argv[i], "--bench-variants") == 0)
+            variantBenchBodies = i + 1 < argc && argv[i + 1][0] != '-' ? (size_t)atof(argv[++i]) : 1000;
+        if (strcmp(argv[i], "--virtual-texture") == 0)
+            virtualTexturePath = i + 1 < argc && argv[i + 1][0] != '-' ? argv[++i] : texturePaths[1];
+        if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+        {
+            capturePath = argv[++i];
+            captureFrames = i + 1 < argc && argv[i + 1][0] != '-' ? atoi(argv[++i]) : 0;
+        }
+    }
+
     // glfw: initialize
     glfwInit();
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
@@ -49,10 +193,15 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (captureFrames > 0)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     GLFWwindow* window = glfwCreateWindow(SCR_WIDTH, SCR_HEIGHT, "Sun-Earth-Moon (multiple lights)", NULL, NULL);
     if (!window) { std::cout << "Failed to create GLFW window\n"; glfwTerminate(); return -1; }
     glfwMakeContextCurrent(window);
+    FramePacer pacer(targetFrameTime);
+    if (pacer.enabled())
+        glfwSwapInterval(0);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -64,8 +213,33 @@ int main()
     }
     glEnable(GL_DEPTH_TEST);
 
-    // shaders (these are the updated shader sources below)
-    Shader lightingShader("6.multiple_lights.vs", "6.multiple_lights.fs");
+    // shaders (these are the updated shader sources below); the linked program is
+    // cached on disk and restored on later runs. The bodies use specialized permutations:
+    // normal matrix from the CPU, and a variant per material (bodyProgramSources).
+    ProgramCache programCache((GLADloadproc)glfwGetProcAddress, "shader_cache", useShaderCache);
+    std::vector<ProgramSource> programSources = bodyProgramSources(true);
+    bool virtualTexturing = !virtualTexturePath.empty();
+    if (virtualTexturing)
+    {
+        // one program per paged body, as each carries its own map's uniforms into the render queue
+        for (int body = 0; body < VT_BODIES; ++body)
+            programSources.push_back({ "6.multiple_lights.vs", "virtual_texture.fs",
+                                       { { "NORMAL_MATRIX", 1 }, { "HAS_SPECULAR_MAP", body == VT_EARTH ? 1 : 0 } } });
+        programSources.push_back({ "6.multiple_lights.vs", "vt_feedback.fs", { { "NORMAL_MATRIX", 1 } } });
+    }
+    if (variantBenchBodies > 0)
+    {
+        std::vector<ProgramSource> generic = bodyProgramSources(false);
+        programSources.insert(programSources.end(), generic.begin(), generic.end());
+    }
+    std::vector<CachedShader> shaders = programCache.loadAll(programSources);
+    // shaders[0 .. BODY_PROGRAMS): lighting and impostor (same lighting, ray-cast spheres on
+    // one quad each) per material variant
+    CachedShader virtualShaders[VT_BODIES]; // diffuse from the body's page cache
+    for (int body = 0; virtualTexturing && body < VT_BODIES; ++body)
+        virtualShaders[body] = shaders[BODY_PROGRAMS + body];
+    CachedShader feedbackShader = virtualTexturing ? shaders[BODY_PROGRAMS + VT_BODIES] : CachedShader(); // pages wanted, at 1/8 size
+    programCache.report(std::cout);
 
 
     // cube data (positions, normals, texcoords)
@@ -73,25 +247,110 @@ int main()
 
     // VBO + VAOs
 
-    // Load textures for Sun, Earth and Moon
-    unsigned int sunDiffuse = loadTexture(FileSystem::getPath("resources/textures/sun.jpg").c_str());
-    unsigned int sunSpecular = loadTexture(FileSystem::getPath("resources/textures/sun.jpg").c_str()); // Optional
+    // Load textures for Sun, Earth and Moon. Files are decoded on worker threads and
+    // streamed in over the first frames; the sun and moon reuse their diffuse map as
+    // the specular map, which the manager resolves to the same texture. After the first
+    // run they come from pre-mipmapped BC1 caches next to the JPEGs.
+    ThreadPool workers;
+    TextureManager textures(workers, (GLADloadproc)glfwGetProcAddress, useTextureCache);
+    unsigned int sunDiffuse = textures.request(FileSystem::getPath("resources/textures/sun.jpg"));
+    unsigned int sunSpecular = textures.request(FileSystem::getPath("resources/textures/sun.jpg")); // Optional
+
+    unsigned int earthDiffuse = textures.request(FileSystem::getPath("resources/textures/earth.jpg"));
+    unsigned int earthSpecular = textures.request(FileSystem::getPath("resources/textures/earth_specular.jpg")); // Optional
+
+    unsigned int moonDiffuse = textures.request(FileSystem::getPath("resources/textures/moon.jpg"));
+    unsigned int moonSpecular = textures.request(FileSystem::getPath("resources/textures/moon.jpg")); // Optional
+    bool firstFrameReported = false;
+    bool texturesReported = false;
+
+    // --virtual-texture: the Sun's, Earth's and Moon's diffuse maps are each paged in from
+    // their own tile file as the feedback pass asks for them; a body keeps its plain
+    // texture until its map's coarsest page is in
+    std::unique_ptr<VirtualTexture> bodyVirtual[VT_BODIES];
+    VirtualTextureStats lastVirtualStats[VT_BODIES];
+    if (virtualTexturing)
+    {
+        std::string virtualPaths[VT_BODIES] = { texturePaths[0], virtualTexturePath, texturePaths[3] };
+        for (int body = 0; body < VT_BODIES; ++body)
+        {
+            bodyVirtual[body].reset(new VirtualTexture(workers, VT_INDIRECTION_UNIT + body));
+            bodyVirtual[body]->load(virtualPaths[body]);
+        }
+    }
+
+    // shader config
+    for (const CachedShader& shader : shaders)
+    {
+        shader.use();
+        shader.setInt("material.diffuse", 0);
+        shader.setInt("material.specular", 1);
+        shader.setFloat("material.shininess", 32.0f);
+        shader.setFloat("overrideColor", 0.0f);
+    }
+
+    // 8x4 up to 128x64 sectors/stacks, picked per body from its size on screen; bodies
+    // under impostorMaxPixels use the impostor quad instead
+    SphereLodChain sphereLods = buildSphereLodChain(8, 128);
+    unsigned int sphereVAO = createSphereVAO(sphereLods);
+    SphereRenderer sphereRenderer = makeSphereRenderer(sphereLods, sphereVAO, createImpostorVAO(), shaders.data());
 
-    unsigned int earthDiffuse = loadTexture(FileSystem::getPath("resources/textures/earth.jpg").c_str());
-    unsigned int earthSpecular = loadTexture(FileSystem::getPath("resources/textures/earth_specular.jpg").c_str()); // Optional
+    // the orbits advance on a fixed 60 Hz clock; rendering uses the time interpolated
+    // between the last two ticks so motion does not depend on the frame rate
+    FixedTimestep simClock(1.0 / 60.0);
+    FrameTimeStats frameStats;
+    AllocationStats allocationStats; // operator new calls per frame
 
-    unsigned int moonDiffuse = loadTexture(FileSystem::getPath("resources/textures/moon.jpg").c_str());
-    unsigned int moonSpecular = loadTexture(FileSystem::getPath("resources/textures/moon.jpg").c_str()); // Optional
+    // the bodies are recorded as draw packets and submitted sorted by state once per frame
+    RenderQueue renderQueue;
 
-    // shader config
-    lightingShader.use();
-    lightingShader.setInt("material.diffuse", 0);
-    lightingShader.setInt("material.specular", 1);
-    lightingShader.setFloat("material.shininess", 32.0f);
+    if (impostorBenchBodies > 0)
+    {
+        int result = runImpostorBenchmark(window, sphereRenderer, shaders.data(), renderQueue, textures, moonDiffuse, moonSpecular,
+                                          impostorBenchBodies);
+        glfwTerminate();
+        return result;
+    }
+    if (variantBenchBodies > 0)
+    {
+        const CachedShader* genericShaders = &shaders[shaders.size() - BODY_PROGRAMS];
+        SphereRenderer genericRenderer = makeSphereRenderer(sphereLods, sphereVAO, sphereRenderer.impostorVAO, genericShaders);
+        int result = runVariantBenchmark(window, genericRenderer, sphereRenderer, genericShaders, shaders.data(), renderQueue, textures,
+                                         moonDiffuse, variantBenchBodies);
+        glfwTerminate();
+        return result;
+    }
+
+    // --nbody: bodies 0-2 are the Sun, Earth and Moon, stepped once per tick and drawn
+    // blended between their last two ticks
+    bool nbodyMode = nbodyAsteroids >= 0;
+    NBodySystem nbody;
+    std::vector<glm::dvec3> nbodyPrevious;
+    std::unique_ptr<ThreadPool> physicsWorkers;
+    double nbodyStartEnergy = 0.0;
+    if (nbodyMode)
+    {
+        nbody = makeSolarSystem(nbodyAsteroids);
+        nbodyPrevious = nbody.position;
+        physicsWorkers.reset(new ThreadPool());
+        nbodyStartEnergy = nbody.totalEnergy(physicsWorkers.get());
+    }
+    auto bodyPosition = [&](size_t i) { return glm::vec3(glm::mix(nbodyPrevious[i], nbody.position[i], (double)simClock.alpha())); };
 
-    unsigned int sphereVAO;
-    unsigned int sphereVertexCount;
-    sphereVAO = createSphereVAO(64, 32, sphereVertexCount); // 64 sectors, 32 stacks for smooth sphere
+    // --capture: frames are read back through a PBO ring and encoded on worker threads
+    std::unique_ptr<FrameCapture> capture;
+    if (!capturePath.empty())
+    {
+        int captureWidth, captureHeight;
+        glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+        capture.reset(new FrameCapture(capturePath, FrameCapture::formatFor(capturePath), captureWidth, captureHeight,
+                                       targetFrameTime > 0.0 ? (int)std::lround(1.0 / targetFrameTime) : 60));
+        if (!capture->open())
+        {
+            std::cout << "Failed to open capture output " << capturePath << std::endl;
+            capture.reset();
+        }
+    }
 
     // render loop
     while (!glfwWindowShouldClose(window))
@@ -99,197 +358,531 @@ int main()
         // time
         float currentFrame = (float)glfwGetTime();
         deltaTime = currentFrame - lastFrame;
+        if (lastFrame > 0.0f)
+            frameStats.add(deltaTime);
         lastFrame = currentFrame;
+        int simSteps = simClock.advance(currentFrame);
+        float simTime = (float)simClock.interpolatedTime();
+        for (int step = 0; nbodyMode && step < simSteps; ++step)
+        {
+            nbodyPrevious = nbody.position;
+            nbody.step(simClock.dt(), physicsWorkers.get());
+        }
 
         processInput(window);
+        textures.update();
+        for (int body = 0; virtualTexturing && body < VT_BODIES; ++body)
+            bodyVirtual[body]->update();
 
         // clear
         glClearColor(0.02f, 0.02f, 0.04f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        // --- lighting shader (applied to Sun, Earth, Moon objects)
-        lightingShader.use();
-        lightingShader.setVec3("viewPos", camera.Position);
-
-        // Remove or set to zero if you want only the Sun
-        lightingShader.setVec3("dirLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("dirLight.diffuse", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("dirLight.specular", 0.0f, 0.0f, 0.0f);
-
-        // Only one point light: the Sun
-        glm::vec3 sunPos = glm::vec3(0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("pointLights[0].position", sunPos);
-        lightingShader.setVec3("pointLights[0].ambient", 1.0f, 0.9f, 0.6f);   // brighter ambient
-        lightingShader.setVec3("pointLights[0].diffuse", 2.0f, 1.8f, 1.2f);   // very bright
-        lightingShader.setVec3("pointLights[0].specular", 3.0f, 2.7f, 1.8f);
-        lightingShader.setFloat("pointLights[0].constant", 1.0f);
-        lightingShader.setFloat("pointLights[0].linear", 0.022f);
-        lightingShader.setFloat("pointLights[0].quadratic", 0.0019f);
-
-        // spot light (flashlight from camera) - set to zero
-        lightingShader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
-        lightingShader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
-
-        // projection + view
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
-        glm::mat4 view = camera.GetViewMatrix();
-        lightingShader.setMat4("projection", projection);
-        lightingShader.setMat4("view", view);
+        // --- lighting (the same for the meshes and the impostors)
+        glm::vec3 sunPos = nbodyMode ? bodyPosition(0) : glm::vec3(0.0f, 0.0f, 0.0f);
+        for (int i = 0; i < BODY_PROGRAMS; ++i)
+            setLightingUniforms(shaders[i], sunPos);
+        if (virtualTexturing)
+        {
+            setLightingUniforms(feedbackShader, sunPos);
+            for (int body = 0; body < VT_BODIES; ++body)
+                if (bodyVirtual[body]->ready())
+                {
+                    setLightingUniforms(virtualShaders[body], sunPos);
+                    bodyVirtual[body]->setUniforms(virtualShaders[body]);
+                }
+        }
 
         // ---- Draw SUN
         glm::mat4 model = glm::mat4(1.0f);
         model = glm::translate(model, sunPos);
         model = glm::scale(model, glm::vec3(1.8f));
-        lightingShader.setMat4("model", model);
-        lightingShader.setFloat("overrideColor", 0.0f);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, sunDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, sunSpecular);
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES, sphereVertexCount, GL_UNSIGNED_INT, 0);
+        int sunLevel = selectBodyLevel(sphereLods, sunPos, 1.8f);
+        DrawPacket sunPacket = spherePacket(sphereRenderer, sunLevel, textures.get(sunDiffuse), textures.get(sunSpecular), model, sunPos);
+        useVirtualTexture(bodyVirtual[VT_SUN].get(), virtualShaders[VT_SUN], feedbackShader, sunLevel, sunPacket);
+        renderQueue.submit(sunPacket);
 
         // ---- Draw EARTH (orbits Sun)
         float earthOrbitRadius = 6.0f;
         float earthOrbitSpeed = 0.3f;
         glm::vec3 earthPos;
-        earthPos.x = sunPos.x + earthOrbitRadius * sin(currentFrame * earthOrbitSpeed);
-        earthPos.y = 0.0f;
-        earthPos.z = sunPos.z + earthOrbitRadius * cos(currentFrame * earthOrbitSpeed);
+        if (nbodyMode)
+            earthPos = bodyPosition(1);
+        else
+        {
+            earthPos.x = sunPos.x + earthOrbitRadius * sin(simTime * earthOrbitSpeed);
+            earthPos.y = 0.0f;
+            earthPos.z = sunPos.z + earthOrbitRadius * cos(simTime * earthOrbitSpeed);
+        }
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, earthPos);
         model = glm::rotate(model, glm::radians(23.5f), glm::vec3(0.0f, 0.0f, 1.0f));
-        model = glm::rotate(model, currentFrame * 1.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, simTime * 1.5f, glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.9f));
-        lightingShader.setMat4("model", model);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, earthDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, earthSpecular);
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES, sphereVertexCount, GL_UNSIGNED_INT, 0);
+        int earthLevel = selectBodyLevel(sphereLods, earthPos, 0.9f);
+        DrawPacket earthPacket = spherePacket(sphereRenderer, earthLevel, textures.get(earthDiffuse), textures.get(earthSpecular), model, earthPos);
+        useVirtualTexture(bodyVirtual[VT_EARTH].get(), virtualShaders[VT_EARTH], feedbackShader, earthLevel, earthPacket);
+        renderQueue.submit(earthPacket);
 
         // ---- Draw MOON (orbits Earth)
         float moonOrbitRadius = 1.8f;
         float moonOrbitSpeed = 1.0f;
         glm::vec3 moonPos;
-        moonPos.x = earthPos.x + moonOrbitRadius * sin(currentFrame * moonOrbitSpeed);
-        moonPos.y = earthPos.y + 0.15f * sin(currentFrame * 1.2f);
-        moonPos.z = earthPos.z + moonOrbitRadius * cos(currentFrame * moonOrbitSpeed);
+        if (nbodyMode)
+            moonPos = bodyPosition(2);
+        else
+        {
+            moonPos.x = earthPos.x + moonOrbitRadius * sin(simTime * moonOrbitSpeed);
+            moonPos.y = earthPos.y + 0.15f * sin(simTime * 1.2f);
+            moonPos.z = earthPos.z + moonOrbitRadius * cos(simTime * moonOrbitSpeed);
+        }
 
         model = glm::mat4(1.0f);
         model = glm::translate(model, moonPos);
-        model = glm::rotate(model, currentFrame * 3.0f, glm::vec3(0.0f, 1.0f, 0.0f));
+        model = glm::rotate(model, simTime * 3.0f, glm::vec3(0.0f, 1.0f, 0.0f));
         model = glm::scale(model, glm::vec3(0.35f));
-        lightingShader.setMat4("model", model);
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, moonDiffuse);
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, moonSpecular);
-        glBindVertexArray(sphereVAO);
-        glDrawElements(GL_TRIANGLES, sphereVertexCount, GL_UNSIGNED_INT, 0);
+        int moonLevel = selectBodyLevel(sphereLods, moonPos, 0.35f);
+        DrawPacket moonPacket = spherePacket(sphereRenderer, moonLevel, textures.get(moonDiffuse), textures.get(moonSpecular), model, moonPos);
+        useVirtualTexture(bodyVirtual[VT_MOON].get(), virtualShaders[VT_MOON], feedbackShader, moonLevel, moonPacket);
+        renderQueue.submit(moonPacket);
 
+        // ---- Draw ASTEROIDS (--nbody only), small moon-textured spheres
+        for (size_t i = 3; nbodyMode && i < nbody.size(); ++i)
+        {
+            glm::vec3 asteroidPos = bodyPosition(i);
+            model = glm::scale(glm::translate(glm::mat4(1.0f), asteroidPos), glm::vec3(0.08f));
+            int asteroidLevel = selectBodyLevel(sphereLods, asteroidPos, 0.08f);
+            renderQueue.submit(spherePacket(sphereRenderer, asteroidLevel, textures.get(moonDiffuse), textures.get(moonSpecular),
+                                            model, asteroidPos));
+        }
 
+        renderQueue.flush();
+
+        // LOD report
+        trianglesSinceReport += trianglesThisFrame;
+        verticesSinceReport += verticesThisFrame;
+        impostorsSinceReport += impostorsThisFrame;
+        trianglesThisFrame = 0;
+        verticesThisFrame = 0;
+        impostorsThisFrame = 0;
+        framesSinceReport++;
+        if (currentFrame - lastReportTime >= 1.0f)
+        {
+            std::cout << "Sphere LOD: " << trianglesSinceReport / framesSinceReport << " triangles/frame, "
+                      << verticesSinceReport / framesSinceReport << " vertices/frame, "
+                      << impostorsSinceReport / framesSinceReport << " impostors/frame (sun ";
+            printBodyLevel(std::cout, sphereLods, sunLevel);
+            std::cout << ", earth ";
+            printBodyLevel(std::cout, sphereLods, earthLevel);
+            std::cout << ", moon ";
+            printBodyLevel(std::cout, sphereLods, moonLevel);
+            std::cout << ")" << std::endl;
+            const RenderQueueStats& queueStats = renderQueue.accumulated();
+            std::cout << "Render queue: " << queueStats.packets / framesSinceReport << " packets/frame, "
+                      << (queueStats.programBinds + queueStats.vaoBinds + queueStats.textureBinds) / framesSinceReport
+                      << " binds/frame, " << queueStats.avoidedChanges / framesSinceReport << " state changes avoided/frame, sort "
+                      << queueStats.sortMicroseconds / framesSinceReport << " us/frame" << std::endl;
+            renderQueue.resetTotals();
+            static const char* virtualNames[VT_BODIES] = { "sun", "earth", "moon" };
+            for (int body = 0; virtualTexturing && body < VT_BODIES; ++body)
+            {
+                if (!bodyVirtual[body]->ready())
+                    continue;
+                const VirtualTextureStats& stats = bodyVirtual[body]->stats();
+                const VirtualTextureStats& last = lastVirtualStats[body];
+                unsigned long long frames = std::max(1ull, stats.frames - last.frames);
+                unsigned long long requested = stats.requested - last.requested;
+                std::cout << "Virtual texture (" << virtualNames[body] << "): " << requested / frames << " pages/frame, hit rate "
+                          << 100.0 * (stats.hits - last.hits) / std::max(1ull, requested) << "%, "
+                          << stats.loads - last.loads << " read, " << stats.evictions - last.evictions
+                          << " evicted, " << stats.residentPages << "/" << stats.slots << " slots; "
+                          << bodyVirtual[body]->residentBytes() / (1024.0 * 1024.0) << " MB resident for a "
+                          << bodyVirtual[body]->fullMapBytes() / (1024.0 * 1024.0) << " MB map" << std::endl;
+                lastVirtualStats[body] = stats;
+            }
+            if (nbodyMode)
+                std::cout << "N-body: " << nbody.size() << " bodies, " << nbody.tree().nodeCount() << " tree nodes, energy drift "
+                          << (nbody.totalEnergy() - nbodyStartEnergy) / std::fabs(nbodyStartEnergy) << std::endl;
+            trianglesSinceReport = 0;
+            verticesSinceReport = 0;
+            impostorsSinceReport = 0;
+            framesSinceReport = 0;
+            lastReportTime = currentFrame;
+        }
 
+        if (capture)
+        {
+            capture->capture();
+            if (captureFrames > 0 && capture->frames() >= (unsigned long long)captureFrames)
+                glfwSetWindowShouldClose(window, true);
+        }
         glfwSwapBuffers(window);
+        frameArena().reset();
+        allocationStats.endFrame();
         glfwPollEvents();
-    }
-
-    // cleanup
-
-
-    glfwTerminate();
-    return 0;
-}
-
-// Generates a sphere mesh (positions, normals, texcoords) and returns VAO, vertex count
-unsigned int createSphereVAO(int sectorCount, int stackCount, unsigned int& vertexCount)
-{
-    std::vector<float> vertices;
-    std::vector<unsigned int> indices;
-
-    float radius = 0.5f;
-    for (int i = 0; i <= stackCount; ++i)
-    {
-        float stackAngle = glm::pi<float>() / 2 - i * glm::pi<float>() / stackCount; // from pi/2 to -pi/2
-        float xy = radius * cosf(stackAngle);
-        float z = radius * sinf(stackAngle);
+        pacer.wait();
 
-        for (int j = 0; j <= sectorCount; ++j)
+        // startup report: first frame, then the moment every texture is resident
+        double sinceStart = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        if (!firstFrameReported)
+        {
+            std::cout << "Time to first frame: " << sinceStart << " ms" << std::endl;
+            firstFrameReported = true;
+        }
+        if (!texturesReported && textures.allReady())
         {
-            float sectorAngle = j * 2 * glm::pi<float>() / sectorCount; // 0 to 2pi
-
-            float x = xy * cosf(sectorAngle);
-            float y = xy * sinf(sectorAngle);
-
-            float nx = x / radius;
-            float ny = y / radius;
-            float nz = z / radius;
-            float s = (float)j / sectorCount;
-            float t = (float)i / stackCount;
-
-            vertices.push_back(x);
-            vertices.push_back(y);
-            vertices.push_back(z);
-            vertices.push_back(nx);
-            vertices.push_back(ny);
-            vertices.push_back(nz);
-            vertices.push_back(s);
-            vertices.push_back(t);
+            const TextureStats& stats = textures.stats();
+            double decodedMB = stats.decodedBytes / (1024.0 * 1024.0);
+            std::cout << "Textures ready: " << stats.unique << " files for " << stats.requests << " requests after "
+                      << sinceStart << " ms (" << stats.cacheHits << " from cache, " << stats.cacheWrites << " converted), "
+                      << "decoded " << decodedMB << " MB, worker time " << stats.decodeSeconds * 1000.0 << " ms, "
+                      << stats.uploadChunks << " upload chunks, "
+                      << stats.residentBytes / (1024.0 * 1024.0) << " MB resident" << std::endl;
+            texturesReported = true;
         }
     }
 
-    for (int i = 0; i < stackCount; ++i)
+    frameStats.report(std::cout, "Frame time");
+    allocationStats.report(std::cout, "Heap allocations");
+    if (capture)
     {
-        int k1 = i * (sectorCount + 1);
-        int k2 = k1 + sectorCount + 1;
-        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
-        {
-            if (i != 0)
-            {
-                indices.push_back(k1);
-                indices.push_back(k2);
-                indices.push_back(k1 + 1);
-            }
-            if (i != (stackCount - 1))
-            {
-                indices.push_back(k1 + 1);
-                indices.push_back(k2);
-                indices.push_back(k2 + 1);
-            }
-        }
+        capture->finish();
+        capture->report(std::cout);
     }
 
-    vertexCount = (unsigned int)indices.size();
+    // cleanup
+    glfwTerminate();
+    return 0;
+}
 
+// Uploads every level of the sphere LOD chain into one VBO/EBO and returns the VAO
+unsigned int createSphereVAO(const SphereLodChain& lods)
+{
     unsigned int VAO, VBO, EBO;
     glGenVertexArrays(1, &VAO);
     glGenBuffers(1, &VBO);
     glGenBuffers(1, &EBO);
 
+    // 16-byte packed vertices in place of the 8 floats; positions are stored divided
+    // by the radius, which spherePacket() puts back through the model matrix
+    VertexPackReport packReport;
+    std::vector<PackedStaticVertex> packed = packStaticVertices(lods.vertices.data(), lods.vertices.size() / SPHERE_FLOATS_PER_VERTEX,
+                                                                SPHERE_FLOATS_PER_VERTEX, SPHERE_RADIUS, packReport);
+    std::cout << "Sphere vertex format:" << std::endl;
+    reportVertexPack(std::cout, "sphere LOD chain", packReport);
+
     glBindVertexArray(VAO);
     glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedStaticVertex), packed.data(), GL_STATIC_DRAW);
 
     glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, lods.indices.size() * sizeof(uint16_t), lods.indices.data(), GL_STATIC_DRAW);
 
-    // position
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+    // position: snorm16
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(PackedStaticVertex), (void*)offsetof(PackedStaticVertex, position));
     glEnableVertexAttribArray(0);
-    // normal
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+    // normal: octahedral snorm16, decoded in the vertex shader
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(PackedStaticVertex), (void*)offsetof(PackedStaticVertex, normal));
     glEnableVertexAttribArray(1);
-    // texcoord
-    glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+    // texcoord: unorm16
+    glVertexAttribPointer(2, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(PackedStaticVertex), (void*)offsetof(PackedStaticVertex, texCoords));
     glEnableVertexAttribArray(2);
 
     glBindVertexArray(0);
     return VAO;
 }
 
+// The impostor quad: four corners in [-1, 1]; sphere_impostor.vs stretches them over
+// the body's silhouette
+unsigned int createImpostorVAO()
+{
+    const float corners[] = { -1.0f, -1.0f, 1.0f, -1.0f, 1.0f, 1.0f, -1.0f, 1.0f };
+    const uint16_t indices[] = { 0, 1, 2, 0, 2, 3 };
+    unsigned int VAO, VBO, EBO;
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glBindVertexArray(0);
+    return VAO;
+}
+
+// LOD level for a body of the given scale (the unit sphere has radius 0.5) seen from the
+// camera, or SPHERE_IMPOSTOR_LEVEL when it is small enough for the impostor
+int selectBodyLevel(const SphereLodChain& lods, glm::vec3 center, float scale)
+{
+    float distance = glm::length(center - camera.Position);
+    float screenRadius = projectedSphereRadius(SPHERE_RADIUS * scale, distance, glm::radians(camera.Zoom), (float)SCR_HEIGHT);
+    if (screenRadius <= impostorMaxPixels)
+        return SPHERE_IMPOSTOR_LEVEL;
+    return selectSphereLevel(lods, screenRadius);
+}
+
+// The body programs in SphereRenderer order: mesh and impostor with a specular map,
+// then both for a material whose specular map is its diffuse map. Generic is the
+// shader files as written, as the benchmark's baseline; specialized takes the normal
+// matrix from the render queue and drops the second texture where it is not needed.
+std::vector<ProgramSource> bodyProgramSources(bool specialized)
+{
+    std::vector<ProgramSource> sources;
+    for (int material = 0; material < MATERIAL_VARIANTS; ++material)
+    {
+        std::vector<ShaderDefine> defines;
+        if (specialized)
+            defines = { { "NORMAL_MATRIX", 1 }, { "HAS_SPECULAR_MAP", material == MATERIAL_SPECULAR_MAP ? 1 : 0 } };
+        sources.push_back({ "6.multiple_lights.vs", "6.multiple_lights.fs", defines });
+        sources.push_back({ "sphere_impostor.vs", "sphere_impostor.fs", defines });
+    }
+    return sources;
+}
+
+SphereRenderer makeSphereRenderer(const SphereLodChain& lods, unsigned int meshVAO, unsigned int impostorVAO,
+                                  const CachedShader* bodyShaders)
+{
+    SphereRenderer renderer = { &lods, meshVAO, {}, impostorVAO, {} };
+    for (int material = 0; material < MATERIAL_VARIANTS; ++material)
+    {
+        renderer.meshPrograms[material] = bodyShaders[2 * material].ID;
+        renderer.impostorPrograms[material] = bodyShaders[2 * material + 1].ID;
+    }
+    return renderer;
+}
+
+// draw packet for one level of the shared sphere mesh, or for the impostor quad, with the
+// program variant for its material
+DrawPacket spherePacket(const SphereRenderer& renderer, int level, unsigned int diffuse, unsigned int specular,
+                        const glm::mat4& model, glm::vec3 center)
+{
+    int material = diffuse == specular ? MATERIAL_SHARED_SPECULAR : MATERIAL_SPECULAR_MAP;
+    DrawPacket packet;
+    packet.textures[0] = diffuse;
+    packet.textures[1] = specular;
+    packet.indexType = GL_UNSIGNED_SHORT;
+    packet.depth = glm::length(center - camera.Position) / 200.0f; // far plane
+    // the mesh positions are packed divided by the radius; the impostor takes the same
+    // unit-radius model matrix and reads its centre and radius from it
+    packet.model = glm::scale(model, glm::vec3(SPHERE_RADIUS));
+    if (level == SPHERE_IMPOSTOR_LEVEL)
+    {
+        packet.program = renderer.impostorPrograms[material];
+        packet.vao = renderer.impostorVAO;
+        packet.indexCount = 6;
+        packet.firstIndexOffset = 0;
+        packet.baseVertex = 0;
+        trianglesThisFrame += 2;
+        verticesThisFrame += 6;
+        impostorsThisFrame++;
+        return packet;
+    }
+    const SphereLevel& lod = renderer.lods->levels[level];
+    packet.program = renderer.meshPrograms[material];
+    packet.vao = renderer.meshVAO;
+    packet.indexCount = (GLsizei)lod.indexCount;
+    packet.firstIndexOffset = lod.firstIndex * sizeof(uint16_t);
+    packet.baseVertex = (GLint)lod.baseVertex;
+    trianglesThisFrame += lod.indexCount / 3;
+    verticesThisFrame += lod.indexCount;
+    return packet;
+}
+
+void printBodyLevel(std::ostream& out, const SphereLodChain& lods, int level)
+{
+    if (level == SPHERE_IMPOSTOR_LEVEL)
+        out << "impostor";
+    else
+        out << lods.levels[level].sectorCount << "x" << lods.levels[level].stackCount;
+}
+
+// camera, the Sun's point light and the unused lights, for one of the body shaders
+// Once the map's coarsest page is in: draws the body's feedback pass straight into the
+// map's own small target and points the packet at the page cache for the main pass.
+// Bodies drawn as impostors keep the plain texture.
+void useVirtualTexture(VirtualTexture* texture, const CachedShader& virtualShader, const CachedShader& feedbackShader, int level,
+                       DrawPacket& packet)
+{
+    if (texture == nullptr || !texture->ready() || level == SPHERE_IMPOSTOR_LEVEL)
+        return;
+    texture->setUniforms(feedbackShader);
+    texture->beginFeedback(SCR_WIDTH, SCR_HEIGHT);
+    feedbackShader.use();
+    feedbackShader.setMat4("model", packet.model);
+    glBindVertexArray(packet.vao);
+    glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.indexType, (void*)packet.firstIndexOffset, packet.baseVertex);
+    texture->endFeedback();
+    packet.program = virtualShader.ID;
+    packet.textures[0] = texture->pageTexture();
+}
+
+void setLightingUniforms(const CachedShader& shader, glm::vec3 sunPos)
+{
+    shader.use();
+    shader.setVec3("viewPos", camera.Position);
+
+    // Remove or set to zero if you want only the Sun
+    shader.setVec3("dirLight.ambient", 0.0f, 0.0f, 0.0f);
+    shader.setVec3("dirLight.diffuse", 0.0f, 0.0f, 0.0f);
+    shader.setVec3("dirLight.specular", 0.0f, 0.0f, 0.0f);
+
+    // Only one point light: the Sun
+    shader.setVec3("pointLights[0].position", sunPos);
+    shader.setVec3("pointLights[0].ambient", 1.0f, 0.9f, 0.6f);   // brighter ambient
+    shader.setVec3("pointLights[0].diffuse", 2.0f, 1.8f, 1.2f);   // very bright
+    shader.setVec3("pointLights[0].specular", 3.0f, 2.7f, 1.8f);
+    shader.setFloat("pointLights[0].constant", 1.0f);
+    shader.setFloat("pointLights[0].linear", 0.022f);
+    shader.setFloat("pointLights[0].quadratic", 0.0019f);
+
+    // spot light (flashlight from camera) - set to zero
+    shader.setVec3("spotLight.ambient", 0.0f, 0.0f, 0.0f);
+    shader.setVec3("spotLight.diffuse", 0.0f, 0.0f, 0.0f);
+    shader.setVec3("spotLight.specular", 0.0f, 0.0f, 0.0f);
+
+    // projection + view
+    glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 200.0f);
+    glm::mat4 view = camera.GetViewMatrix();
+    shader.setMat4("projection", projection);
+    shader.setMat4("view", view);
+}
+
+// --bench-impostors: 10^2 .. maxBodies moon-sized bodies scattered 8 to 80 units in front
+// of the start camera, drawn with meshes only, with impostors below impostorMaxPixels,
+// and with impostors only. Reports the vertex load per frame against the frame time
+// (glFinish'd, vsync off). The GPU hides vertex cost well; under LIBGL_ALWAYS_SOFTWARE=1
+// (llvmpipe) the vertex stage runs on the CPU and the difference shows directly.
+int runImpostorBenchmark(GLFWwindow* window, const SphereRenderer& renderer, const CachedShader* bodyShaders, RenderQueue& queue,
+                         TextureManager& textures, unsigned int diffuse, unsigned int specular, size_t maxBodies)
+{
+    glfwSwapInterval(0);
+    while (!textures.allReady())
+        textures.update();
+    for (int i = 0; i < BODY_PROGRAMS; ++i)
+        setLightingUniforms(bodyShaders[i], glm::vec3(0.0f, 20.0f, 0.0f));
+    std::cout << "Impostor benchmark: " << (const char*)glGetString(GL_RENDERER) << ", impostors up to "
+              << SPHERE_IMPOSTOR_MAX_PIXELS << " px" << std::endl;
+
+    const float modeMaxPixels[3] = { 0.0f, SPHERE_IMPOSTOR_MAX_PIXELS, 1.0e9f };
+    const char* modeNames[3] = { "meshes", "mixed", "impostors" };
+    std::mt19937 generator(7);
+    for (size_t count = 100; count <= maxBodies; count *= 10)
+    {
+        std::vector<glm::vec3> centers = scatterBenchmarkBodies(count, generator);
+        std::cout << "  " << count << " bodies:";
+        for (int mode = 0; mode < 3; ++mode)
+        {
+            impostorMaxPixels = modeMaxPixels[mode];
+            unsigned long long vertices = 0;
+            double milliseconds = timeBenchmarkFrames(window, renderer, queue, centers, diffuse, specular, vertices);
+            std::cout << (mode > 0 ? "," : "") << " " << modeNames[mode] << " " << vertices << " vertices " << milliseconds << " ms";
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
+
+// --bench-variants: the generic body programs against the specialized ones on moon-sized
+// bodies with the Moon's material (its specular map is its diffuse map), drawn as meshes
+// only, where the per-vertex normal matrix shows, and as impostors only, where the second
+// texture sample does. Reports the uniform components each program keeps active and the
+// frame time (glFinish'd, vsync off); under LIBGL_ALWAYS_SOFTWARE=1 the shaders run on the
+// CPU and their ALU savings show up in the time directly.
+int runVariantBenchmark(GLFWwindow* window, const SphereRenderer& generic, const SphereRenderer& specialized,
+                        const CachedShader* genericShaders, const CachedShader* specializedShaders, RenderQueue& queue,
+                        TextureManager& textures, unsigned int texture, size_t bodies)
+{
+    glfwSwapInterval(0);
+    while (!textures.allReady())
+        textures.update();
+    for (int i = 0; i < BODY_PROGRAMS; ++i)
+    {
+        setLightingUniforms(genericShaders[i], glm::vec3(0.0f, 20.0f, 0.0f));
+        setLightingUniforms(specializedShaders[i], glm::vec3(0.0f, 20.0f, 0.0f));
+    }
+    unsigned int diffuse = textures.get(texture);
+    std::cout << "Shader variant benchmark: " << (const char*)glGetString(GL_RENDERER) << ", " << bodies << " bodies" << std::endl;
+    const char* programNames[2] = { "mesh", "impostor" };
+    for (int program = 0; program < 2; ++program)
+    {
+        int shared = 2 * MATERIAL_SHARED_SPECULAR + program;
+        std::cout << "  " << programNames[program] << " program: " << activeUniformComponents(genericShaders[shared].ID)
+                  << " active uniform components generic, " << activeUniformComponents(specializedShaders[shared].ID)
+                  << " specialized" << std::endl;
+    }
+
+    std::mt19937 generator(7);
+    std::vector<glm::vec3> centers = scatterBenchmarkBodies(bodies, generator);
+    const float modeMaxPixels[2] = { 0.0f, 1.0e9f };
+    const char* modeNames[2] = { "meshes", "impostors" };
+    for (int mode = 0; mode < 2; ++mode)
+    {
+        impostorMaxPixels = modeMaxPixels[mode];
+        unsigned long long vertices = 0;
+        double genericMs = timeBenchmarkFrames(window, generic, queue, centers, diffuse, diffuse, vertices);
+        double specializedMs = timeBenchmarkFrames(window, specialized, queue, centers, diffuse, diffuse, vertices);
+        const RenderQueueStats& stats = queue.lastFrame();
+        std::cout << "  " << modeNames[mode] << ": " << vertices << " vertices, generic " << genericMs << " ms, specialized "
+                  << specializedMs << " ms (" << stats.normalMatrixUploads << " normal matrices from the CPU per frame)" << std::endl;
+    }
+    impostorMaxPixels = SPHERE_IMPOSTOR_MAX_PIXELS;
+    return 0;
+}
+
+// moon-sized body centres scattered 8 to 80 units in front of the start camera
+std::vector<glm::vec3> scatterBenchmarkBodies(size_t count, std::mt19937& generator)
+{
+    std::uniform_real_distribution<float> unit(-1.0f, 1.0f), depth(8.0f, 80.0f);
+    glm::vec3 forward = camera.Front, right = camera.Right, up = camera.Up;
+    std::vector<glm::vec3> centers(count);
+    for (glm::vec3& center : centers)
+    {
+        float d = depth(generator);
+        center = camera.Position + forward * d + right * (unit(generator) * 0.5f * d) + up * (unit(generator) * 0.35f * d);
+    }
+    return centers;
+}
+
+// mean time of 20 frames drawing every centre through the queue, after two untimed
+// warm-up frames; `vertices` receives the vertex shader inputs per frame
+double timeBenchmarkFrames(GLFWwindow* window, const SphereRenderer& renderer, RenderQueue& queue, const std::vector<glm::vec3>& centers,
+                           unsigned int diffuse, unsigned int specular, unsigned long long& vertices)
+{
+    const float scale = 0.35f; // the Moon
+    const int frames = 20;
+    double seconds = 0.0;
+    vertices = 0;
+    for (int frame = -2; frame < frames; ++frame)
+    {
+        auto start = std::chrono::steady_clock::now();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        verticesThisFrame = 0;
+        for (const glm::vec3& center : centers)
+        {
+            glm::mat4 model = glm::scale(glm::translate(glm::mat4(1.0f), center), glm::vec3(scale));
+            int level = selectBodyLevel(*renderer.lods, center, scale);
+            queue.submit(spherePacket(renderer, level, diffuse, specular, model, center));
+        }
+        queue.flush();
+        glFinish();
+        if (frame >= 0)
+        {
+            seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            vertices += verticesThisFrame;
+        }
+        glfwSwapBuffers(window);
+        glfwPollEvents();
+    }
+    vertices /= frames;
+    return seconds / frames * 1000.0;
+}
+
 // input
 void processInput(GLFWwindow* window)
 {
@@ -320,30 +913,3 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
 {
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
-
-unsigned int loadTexture(char const* path)
-{
-    unsigned int textureID; glGenTextures(1, &textureID);
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(path, &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format = GL_RGB;
-        if (nrComponents == 1) format = GL_RED;
-        else if (nrComponents == 3) format = GL_RGB;
-        else if (nrComponents == 4) format = GL_RGBA;
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, (GLint)format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        stbi_image_free(data);
-    }
-    else {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
-    return textureID;
-}
\ No newline at end of file
@@ -1,4 +1,10 @@
 #version 330 core
+// permutations (program_cache.h), defaults are the generic program:
+//   HAS_SPECULAR_MAP 0: the material's specular map is its diffuse map, sampled once
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+
 struct Material {
     sampler2D diffuse;
     sampler2D specular;
@@ -28,21 +34,26 @@ uniform PointLight pointLights[1];
 void main()
 {
     vec3 norm = normalize(Normal);
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 diffuseTex = texture(material.diffuse, TexCoords).rgb;
+#if HAS_SPECULAR_MAP
+    vec3 specularTex = texture(material.specular, TexCoords).rgb;
+#else
+    vec3 specularTex = diffuseTex;
+#endif
+
     vec3 lightDir = normalize(pointLights[0].position - FragPos);
 
     // Diffuse shading
     float diff = max(dot(norm, lightDir), 0.0);
-    vec3 diffuseTex = texture(material.diffuse, TexCoords).rgb;
     vec3 diffuse = pointLights[0].diffuse * diff * diffuseTex;
 
     // Ambient
     vec3 ambient = pointLights[0].ambient * diffuseTex;
 
     // Specular
-    vec3 viewDir = normalize(viewPos - FragPos);
     vec3 reflectDir = reflect(-lightDir, norm);
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
-    vec3 specularTex = texture(material.specular, TexCoords).rgb;
     vec3 specular = pointLights[0].specular * spec * specularTex;
 
     // Attenuation
@@ -1,6 +1,13 @@
 #version 330 core
-layout (location = 0) in vec3 aPos;
-layout (location = 1) in vec3 aNormal;
+// permutation (program_cache.h): NORMAL_MATRIX 1 reads the normal matrix from a
+// uniform that render_queue.h computes once per draw, instead of inverting the model
+// matrix in every vertex
+#ifndef NORMAL_MATRIX
+#define NORMAL_MATRIX 0
+#endif
+
+layout (location = 0) in vec3 aPos;       // snorm16, pre-divided by the radius (model matrix scales it back)
+layout (location = 1) in vec2 aNormalOct; // octahedral snorm16
 layout (location = 2) in vec2 aTexCoords;
 
 out vec3 FragPos;
@@ -10,11 +17,27 @@ out vec2 TexCoords;
 uniform mat4 model;
 uniform mat4 view;
 uniform mat4 projection;
+#if NORMAL_MATRIX
+uniform mat3 normalMatrix;
+#endif
+
+vec3 octDecode(vec2 p)
+{
+    vec3 n = vec3(p, 1.0 - abs(p.x) - abs(p.y));
+    float t = max(-n.z, 0.0);
+    n.xy += mix(vec2(t), vec2(-t), greaterThanEqual(n.xy, vec2(0.0)));
+    return normalize(n);
+}
 
 void main()
 {
+    vec3 aNormal = octDecode(aNormalOct);
     FragPos = vec3(model * vec4(aPos, 1.0));
+#if NORMAL_MATRIX
+    Normal = normalMatrix * aNormal;
+#else
     Normal = mat3(transpose(inverse(model))) * aNormal;
+#endif
     TexCoords = aTexCoords;
     gl_Position = projection * view * model * vec4(aPos, 1.0);
 }
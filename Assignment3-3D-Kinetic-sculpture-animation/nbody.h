@@ -0,0 +1,576 @@
+// nbody.h
+// Gravity simulation for the --nbody mode: bodies under mutual gravity, advanced with
+// kick-drift-kick leapfrog (symplectic, so energy errors oscillate rather than grow)
+// and with forces from a Barnes-Hut octree rebuilt every step.
+//  - BarnesHutTree: bodies sorted along a Morton curve, so every node covers one
+//    contiguous range of them; the top levels are cut into up to 64 subtrees that
+//    are built on the thread pool and spliced together
+//  - NBodySystem: structure of arrays plus the integrator and energy bookkeeping
+//  - makeSolarSystem / makePlummerSphere: the demo's scene and the benchmark's cluster
+//  - runNBodyBenchmark: headless steps/s and energy drift from 10^3 to 10^6 bodies
+// No GL calls in here; main.cpp draws the bodies with the sphere LOD chain.
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "../common/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <utility>
+#include <vector>
+
+struct NBodySettings
+{
+    double gravity = 1.0;     // G
+    double softening = 0.01;  // Plummer softening length, keeps close encounters finite
+    double theta = 0.5;       // opening angle: a node is one point mass when size / distance < theta
+    int leafSize = 8;         // bodies per leaf
+};
+
+// Runs fn(begin, end) over [0, count) in one chunk per pool worker and waits for all
+// of them; without a pool (or for small counts) it runs inline.
+template <typename Function>
+void parallelRanges(ThreadPool* pool, size_t count, Function fn)
+{
+    if (pool == nullptr || pool->size() < 2 || count < 1024)
+    {
+        fn((size_t)0, count);
+        return;
+    }
+    size_t chunks = pool->size();
+    for (size_t chunk = 0; chunk < chunks; ++chunk)
+    {
+        size_t begin = count * chunk / chunks;
+        size_t end = count * (chunk + 1) / chunks;
+        pool->enqueue([&fn, begin, end] { fn(begin, end); });
+    }
+    pool->waitIdle();
+}
+
+// spreads the low 21 bits of v three apart, for 63-bit Morton codes
+inline uint64_t spreadBits(uint64_t v)
+{
+    v &= 0x1fffff;
+    v = (v | v << 32) & 0x1f00000000ffffull;
+    v = (v | v << 16) & 0x1f0000ff0000ffull;
+    v = (v | v << 8) & 0x100f00f00f00f00full;
+    v = (v | v << 4) & 0x10c30c30c30c30c3ull;
+    v = (v | v << 2) & 0x1249249249249249ull;
+    return v;
+}
+
+class BarnesHutTree
+{
+public:
+    static const int MORTON_LEVELS = 21;
+
+    void build(const std::vector<glm::dvec3>& positions, const std::vector<double>& masses, const NBodySettings& settings, ThreadPool* pool)
+    {
+        size_t count = positions.size();
+        leafSize = settings.leafSize;
+        nodes.clear();
+        if (count == 0)
+            return;
+
+        // bounding cube
+        glm::dvec3 low = positions[0], high = positions[0];
+        for (const glm::dvec3& p : positions)
+        {
+            low = glm::min(low, p);
+            high = glm::max(high, p);
+        }
+        double size = std::max(std::max(high.x - low.x, high.y - low.y), std::max(high.z - low.z, 1.0e-9)) * 1.0001;
+        glm::dvec3 rootCenter = low + glm::dvec3(size * 0.5);
+
+        // Morton codes, then sort the bodies along the curve
+        double scale = (double)(1 << MORTON_LEVELS) / size;
+        keyed.resize(count);
+        parallelRanges(pool, count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                glm::dvec3 cell = (positions[i] - low) * scale;
+                uint64_t code = spreadBits((uint64_t)cell.x) << 2 | spreadBits((uint64_t)cell.y) << 1 | spreadBits((uint64_t)cell.z);
+                keyed[i] = std::make_pair(code, (uint32_t)i);
+            }
+        });
+        sortKeys(pool);
+
+        sortedPosition.resize(count);
+        sortedMass.resize(count);
+        parallelRanges(pool, count, [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                sortedPosition[i] = positions[keyed[i].second];
+                sortedMass[i] = masses[keyed[i].second];
+            }
+        });
+
+        // top levels here, the subtrees below SPLIT_LEVEL on the pool; all the scratch
+        // vectors are members, so a warm tree rebuilds without allocating
+        bool parallel = pool != nullptr && pool->size() > 1 && count >= 1024;
+        tasks.clear();
+        nodes.push_back(Node());
+        topNodes.clear();
+        buildTopNode(0, 0, (uint32_t)count, 0, rootCenter, size * 0.5, tasks);
+        if (subtrees.size() < tasks.size())
+            subtrees.resize(tasks.size());
+        for (size_t t = 0; t < tasks.size(); ++t)
+        {
+            auto job = [this, t] {
+                const SubtreeTask& task = tasks[t];
+                subtrees[t].clear();
+                subtrees[t].push_back(Node());
+                buildNode(subtrees[t], 0, task.begin, task.end, task.level, task.center, task.halfSize);
+            };
+            if (parallel)
+                pool->enqueue(job);
+            else
+                job();
+        }
+        if (parallel)
+            pool->waitIdle();
+
+        // splice: subtree node k > 0 lands at base + k - 1, its root replaces the placeholder
+        for (size_t t = 0; t < tasks.size(); ++t)
+        {
+            std::vector<Node>& subtree = subtrees[t];
+            int base = (int)nodes.size() - 1;
+            for (size_t k = 0; k < subtree.size(); ++k)
+                if (subtree[k].childCount > 0)
+                    subtree[k].firstChild += base;
+            nodes[tasks[t].node] = subtree[0];
+            nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+        }
+        // the top nodes were created parents first, so summing them in reverse finishes children first
+        for (size_t i = topNodes.size(); i-- > 0;)
+            summarize(nodes, topNodes[i]);
+    }
+
+    // acceleration and potential at p, for a body that is part of the tree
+    // (the softened self term is not skipped but adds nothing: its offset is zero)
+    glm::dvec3 acceleration(glm::dvec3 p, const NBodySettings& settings, double& potential) const
+    {
+        double ax = 0.0, ay = 0.0, az = 0.0, phi = 0.0;
+        if (nodes.empty())
+        {
+            potential = 0.0;
+            return glm::dvec3(0.0);
+        }
+        double epsilon2 = settings.softening * settings.softening;
+        double theta2 = settings.theta * settings.theta;
+        int stack[64 * 8];
+        int depth = 0;
+        stack[depth++] = 0;
+        while (depth > 0)
+        {
+            const Node& node = nodes[stack[--depth]];
+            uint32_t begin = node.begin, end = node.end;
+            if (node.childCount != 0)
+            {
+                double dx = node.centerOfMass.x - p.x, dy = node.centerOfMass.y - p.y, dz = node.centerOfMass.z - p.z;
+                double width = node.halfSize * 2.0;
+                if (width * width >= theta2 * (dx * dx + dy * dy + dz * dz))
+                {
+                    for (int c = 0; c < node.childCount; ++c)
+                        stack[depth++] = node.firstChild + c;
+                    continue;
+                }
+                double inverse = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz + epsilon2);
+                double strength = node.mass * inverse * inverse * inverse;
+                ax += dx * strength;
+                ay += dy * strength;
+                az += dz * strength;
+                phi -= node.mass * inverse;
+                continue;
+            }
+            for (uint32_t j = begin; j < end; ++j)
+            {
+                double dx = sortedPosition[j].x - p.x, dy = sortedPosition[j].y - p.y, dz = sortedPosition[j].z - p.z;
+                double r2 = dx * dx + dy * dy + dz * dz;
+                double inverse = 1.0 / std::sqrt(r2 + epsilon2);
+                double strength = sortedMass[j] * inverse * inverse * inverse;
+                ax += dx * strength;
+                ay += dy * strength;
+                az += dz * strength;
+                phi -= r2 > 0.0 ? sortedMass[j] * inverse : 0.0; // not the body's own softened potential
+            }
+        }
+        potential = phi * settings.gravity;
+        return glm::dvec3(ax, ay, az) * settings.gravity;
+    }
+
+    // visits the bodies in tree order: sortedIndex -> original body index
+    uint32_t bodyAt(size_t sortedIndex) const { return keyed[sortedIndex].second; }
+    size_t nodeCount() const { return nodes.size(); }
+
+private:
+    static const int SPLIT_LEVEL = 2; // 8^2 = 64 subtrees at most
+
+    struct Node
+    {
+        glm::dvec3 centerOfMass = glm::dvec3(0.0);
+        double mass = 0.0;
+        glm::dvec3 center = glm::dvec3(0.0);
+        double halfSize = 0.0;
+        int firstChild = 0; // children are stored next to each other
+        int childCount = 0; // 0 for a leaf
+        uint32_t begin = 0, end = 0; // bodies in sorted order
+    };
+
+    struct SubtreeTask
+    {
+        int node;
+        uint32_t begin, end;
+        int level;
+        glm::dvec3 center;
+        double halfSize;
+    };
+
+    // chunk sorts on the pool, then pairwise merges of neighbouring chunks
+    void sortKeys(ThreadPool* pool)
+    {
+        size_t count = keyed.size();
+        size_t chunks = pool != nullptr && pool->size() > 1 && count >= 65536 ? pool->size() : 1;
+        bounds.resize(chunks + 1);
+        for (size_t c = 0; c <= chunks; ++c)
+            bounds[c] = count * c / chunks;
+        parallelRanges(chunks > 1 ? pool : nullptr, chunks, [&](size_t begin, size_t end) {
+            for (size_t c = begin; c < end; ++c)
+                std::sort(keyed.begin() + bounds[c], keyed.begin() + bounds[c + 1]);
+        });
+        for (size_t width = 1; width < chunks; width *= 2)
+        {
+            for (size_t c = 0; c + width < chunks; c += 2 * width)
+            {
+                size_t middle = bounds[c + width], last = bounds[std::min(chunks, c + 2 * width)];
+                auto merge = [this, c, middle, last] {
+                    std::inplace_merge(keyed.begin() + bounds[c], keyed.begin() + middle, keyed.begin() + last);
+                };
+                pool->enqueue(merge);
+            }
+            pool->waitIdle();
+        }
+    }
+
+    // splits [begin, end) into its (up to 8) children by the Morton digit of `level`
+    template <typename Visit>
+    void forEachChild(uint32_t begin, uint32_t end, int level, glm::dvec3 center, double halfSize, Visit visit) const
+    {
+        int shift = 3 * (MORTON_LEVELS - 1 - level);
+        uint32_t first = begin;
+        while (first < end)
+        {
+            int octant = (int)((keyed[first].first >> shift) & 7);
+            uint32_t last = (uint32_t)(std::upper_bound(keyed.begin() + first, keyed.begin() + end, octant,
+                                                        [shift](int value, const std::pair<uint64_t, uint32_t>& key) {
+                                                            return value < (int)((key.first >> shift) & 7);
+                                                        }) - keyed.begin());
+            double quarter = halfSize * 0.5;
+            glm::dvec3 childCenter = center + glm::dvec3((octant & 4) ? quarter : -quarter, (octant & 2) ? quarter : -quarter,
+                                                         (octant & 1) ? quarter : -quarter);
+            visit(first, last, childCenter, quarter);
+            first = last;
+        }
+    }
+
+    bool isLeaf(uint32_t begin, uint32_t end, int level) const
+    {
+        return (int)(end - begin) <= leafSize || level >= MORTON_LEVELS;
+    }
+
+    void buildTopNode(int index, uint32_t begin, uint32_t end, int level, glm::dvec3 center, double halfSize, std::vector<SubtreeTask>& tasks)
+    {
+        if (level == SPLIT_LEVEL && !isLeaf(begin, end, level))
+        {
+            tasks.push_back({ index, begin, end, level, center, halfSize });
+            return;
+        }
+        topNodes.push_back(index);
+        initNode(nodes[index], begin, end, center, halfSize);
+        if (isLeaf(begin, end, level))
+            return;
+        struct Child { uint32_t begin, end; glm::dvec3 center; double halfSize; };
+        Child children[8];
+        int childCount = 0;
+        forEachChild(begin, end, level, center, halfSize, [&](uint32_t first, uint32_t last, glm::dvec3 childCenter, double quarter) {
+            children[childCount++] = { first, last, childCenter, quarter };
+        });
+        int firstChild = (int)nodes.size();
+        nodes[index].firstChild = firstChild;
+        nodes[index].childCount = childCount;
+        nodes.resize(nodes.size() + childCount);
+        for (int c = 0; c < childCount; ++c)
+            buildTopNode(firstChild + c, children[c].begin, children[c].end, level + 1, children[c].center, children[c].halfSize, tasks);
+    }
+
+    void buildNode(std::vector<Node>& out, int index, uint32_t begin, uint32_t end, int level, glm::dvec3 center, double halfSize) const
+    {
+        initNode(out[index], begin, end, center, halfSize);
+        if (isLeaf(begin, end, level))
+        {
+            summarize(out, index);
+            return;
+        }
+        struct Child { uint32_t begin, end; glm::dvec3 center; double halfSize; };
+        Child children[8];
+        int childCount = 0;
+        forEachChild(begin, end, level, center, halfSize, [&](uint32_t first, uint32_t last, glm::dvec3 childCenter, double quarter) {
+            children[childCount++] = { first, last, childCenter, quarter };
+        });
+        int firstChild = (int)out.size();
+        out[index].firstChild = firstChild;
+        out[index].childCount = childCount;
+        out.resize(out.size() + childCount);
+        for (int c = 0; c < childCount; ++c)
+            buildNode(out, firstChild + c, children[c].begin, children[c].end, level + 1, children[c].center, children[c].halfSize);
+        summarize(out, index);
+    }
+
+    static void initNode(Node& node, uint32_t begin, uint32_t end, glm::dvec3 center, double halfSize)
+    {
+        node = Node();
+        node.begin = begin;
+        node.end = end;
+        node.center = center;
+        node.halfSize = halfSize;
+    }
+
+    // mass and centre of mass from the children, or from the bodies of a leaf
+    void summarize(std::vector<Node>& out, int index) const
+    {
+        Node& node = out[index];
+        glm::dvec3 weighted(0.0);
+        double mass = 0.0;
+        if (node.childCount == 0)
+        {
+            for (uint32_t j = node.begin; j < node.end; ++j)
+            {
+                weighted += sortedPosition[j] * sortedMass[j];
+                mass += sortedMass[j];
+            }
+        }
+        else
+        {
+            for (int c = 0; c < node.childCount; ++c)
+            {
+                const Node& child = out[node.firstChild + c];
+                weighted += child.centerOfMass * child.mass;
+                mass += child.mass;
+            }
+        }
+        node.mass = mass;
+        node.centerOfMass = mass > 0.0 ? weighted / mass : node.center;
+    }
+
+    std::vector<std::pair<uint64_t, uint32_t>> keyed; // Morton code, body index; sorted
+    std::vector<glm::dvec3> sortedPosition;
+    std::vector<double> sortedMass;
+    std::vector<Node> nodes;
+    std::vector<int> topNodes; // nodes built by buildTopNode, parents first
+    std::vector<SubtreeTask> tasks;
+    std::vector<std::vector<Node>> subtrees;
+    std::vector<size_t> bounds; // sortKeys' chunks
+    int leafSize = 8;
+};
+
+class NBodySystem
+{
+public:
+    std::vector<glm::dvec3> position;
+    std::vector<glm::dvec3> velocity;
+    std::vector<double> mass;
+    NBodySettings settings;
+
+    size_t size() const { return position.size(); }
+
+    void add(glm::dvec3 p, glm::dvec3 v, double m)
+    {
+        position.push_back(p);
+        velocity.push_back(v);
+        mass.push_back(m);
+        accelerationValid = false;
+    }
+
+    // one kick-drift-kick leapfrog step; the tree is rebuilt once per step
+    void step(double dt, ThreadPool* pool = nullptr)
+    {
+        if (!accelerationValid)
+            computeAccelerations(pool);
+        parallelRanges(pool, size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+            {
+                velocity[i] += acceleration[i] * (dt * 0.5);
+                position[i] += velocity[i] * dt;
+            }
+        });
+        computeAccelerations(pool);
+        parallelRanges(pool, size(), [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; ++i)
+                velocity[i] += acceleration[i] * (dt * 0.5);
+        });
+    }
+
+    // kinetic plus potential energy; the potential comes from the same tree walk as
+    // the forces (current as of the last step), or from all pairs when `exact`
+    double totalEnergy(ThreadPool* pool = nullptr, bool exact = false)
+    {
+        if (!accelerationValid)
+            computeAccelerations(pool);
+        double kinetic = 0.0, potentialSum = 0.0;
+        double epsilon2 = settings.softening * settings.softening;
+        for (size_t i = 0; i < size(); ++i)
+        {
+            kinetic += 0.5 * mass[i] * glm::dot(velocity[i], velocity[i]);
+            if (!exact)
+                potentialSum += 0.5 * mass[i] * potential[i];
+            else
+                for (size_t j = i + 1; j < size(); ++j)
+                {
+                    glm::dvec3 d = position[j] - position[i];
+                    potentialSum -= settings.gravity * mass[i] * mass[j] / std::sqrt(glm::dot(d, d) + epsilon2);
+                }
+        }
+        return kinetic + potentialSum;
+    }
+
+    // shifts velocities so the total momentum is zero and the barycentre stays put
+    void removeDrift()
+    {
+        glm::dvec3 momentum(0.0);
+        double total = 0.0;
+        for (size_t i = 0; i < size(); ++i)
+        {
+            momentum += velocity[i] * mass[i];
+            total += mass[i];
+        }
+        if (total > 0.0)
+            for (glm::dvec3& v : velocity)
+                v -= momentum / total;
+    }
+
+    const BarnesHutTree& tree() const { return barnesHut; }
+
+private:
+    void computeAccelerations(ThreadPool* pool)
+    {
+        acceleration.resize(size());
+        potential.resize(size());
+        barnesHut.build(position, mass, settings, pool);
+        // walk in tree order, so neighbouring bodies on a thread share most of their walk
+        parallelRanges(pool, size(), [&](size_t begin, size_t end) {
+            for (size_t s = begin; s < end; ++s)
+            {
+                uint32_t i = barnesHut.bodyAt(s);
+                acceleration[i] = barnesHut.acceleration(position[i], settings, potential[i]);
+            }
+        });
+        accelerationValid = true;
+    }
+
+    std::vector<glm::dvec3> acceleration;
+    std::vector<double> potential;
+    BarnesHutTree barnesHut;
+    bool accelerationValid = false;
+};
+
+// The demo's Sun, Earth and Moon (bodies 0, 1, 2) with G = 1, on the scene's scale:
+// the Earth keeps the hand-animated orbit (radius 6, 0.3 rad/s). The Moon's 1.8-unit
+// orbit would lie outside the Earth's Hill sphere at any sensible mass, so the Earth is
+// given 15% of the Sun's mass and the Moon orbits at 0.8, about a third of the Hill
+// radius. `asteroids` nearly massless bodies fill a belt between radius 9.5 and 12.
+inline NBodySystem makeSolarSystem(int asteroids, unsigned int seed = 1)
+{
+    NBodySystem system;
+    system.settings.softening = 0.05; // well inside the drawn Sun, so only bodies falling into it feel it
+    const double sunMass = 0.09 * 6.0 * 6.0 * 6.0; // circular speed 0.3 * 6 at radius 6
+    const double earthMass = 0.15 * sunMass;
+    const double moonMass = 0.01 * earthMass;
+    const double earthOrbit = 6.0, moonOrbit = 0.8;
+
+    glm::dvec3 earthPosition(0.0, 0.0, earthOrbit);
+    glm::dvec3 earthVelocity(std::sqrt((sunMass + earthMass) / earthOrbit), 0.0, 0.0);
+    system.add(glm::dvec3(0.0), glm::dvec3(0.0), sunMass);
+    system.add(earthPosition, earthVelocity, earthMass);
+    system.add(earthPosition + glm::dvec3(0.0, 0.0, moonOrbit),
+               earthVelocity + glm::dvec3(std::sqrt((earthMass + moonMass) / moonOrbit), 0.0, 0.0), moonMass);
+
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (int i = 0; i < asteroids; ++i)
+    {
+        double radius = 9.5 + 2.5 * unit(generator);
+        double angle = glm::two_pi<double>() * unit(generator);
+        double height = (unit(generator) - 0.5) * 0.4;
+        glm::dvec3 p(std::sin(angle) * radius, height, std::cos(angle) * radius);
+        double speed = std::sqrt(sunMass / radius);
+        system.add(p, glm::dvec3(std::cos(angle), 0.0, -std::sin(angle)) * speed, 1.0e-6);
+    }
+    system.removeDrift();
+    return system;
+}
+
+// Plummer sphere of total mass 1 and scale radius 1 in virial equilibrium (G = 1),
+// sampled as in Aarseth, Henon and Wielen (1974)
+inline NBodySystem makePlummerSphere(size_t count, unsigned int seed = 1)
+{
+    NBodySystem system;
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    auto isotropic = [&](double length) {
+        double z = 2.0 * unit(generator) - 1.0;
+        double angle = glm::two_pi<double>() * unit(generator);
+        double r = std::sqrt(1.0 - z * z);
+        return glm::dvec3(r * std::cos(angle), r * std::sin(angle), z) * length;
+    };
+    system.position.reserve(count);
+    system.velocity.reserve(count);
+    system.mass.reserve(count);
+    for (size_t i = 0; i < count; ++i)
+    {
+        double radius = 1.0 / std::sqrt(std::pow(std::max(unit(generator), 1.0e-10), -2.0 / 3.0) - 1.0);
+        radius = std::min(radius, 20.0);
+        // rejection sampling of q = v / v_escape from q^2 (1 - q^2)^3.5
+        double q, g;
+        do
+        {
+            q = unit(generator);
+            g = unit(generator) * 0.1;
+        } while (g > q * q * std::pow(1.0 - q * q, 3.5));
+        double escape = std::sqrt(2.0) * std::pow(1.0 + radius * radius, -0.25);
+        system.add(isotropic(radius), isotropic(q * escape), 1.0 / count);
+    }
+    system.removeDrift();
+    return system;
+}
+
+// Headless: Plummer spheres of 10^3 .. maxBodies bodies (200 steps for the smallest,
+// down to 3 for 10^6) at dt = 1/256. Reports steps/s and the relative energy drift
+// over the run (exact pair sum up to 10^4 bodies, the tree's potential above that).
+inline int runNBodyBenchmark(size_t maxBodies, unsigned int threads)
+{
+    ThreadPool pool(threads);
+    const double dt = 1.0 / 256.0;
+    std::cout << "N-body benchmark: Barnes-Hut, theta 0.5, leapfrog dt " << dt << ", " << pool.size() << " worker threads" << std::endl;
+    for (size_t count = 1000; count <= maxBodies; count *= 10)
+    {
+        NBodySystem system = makePlummerSphere(count);
+        bool exact = count <= 10000;
+        double before = system.totalEnergy(&pool, exact);
+        int steps = (int)std::min<size_t>(200, std::max<size_t>(3, 1000000 / count));
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < steps; ++i)
+            system.step(dt, &pool);
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double after = system.totalEnergy(&pool, exact);
+        std::cout << "  " << count << " bodies: " << steps / seconds << " steps/s (" << seconds / steps * 1000.0 << " ms/step, "
+                  << system.tree().nodeCount() << " nodes), energy drift " << std::fabs((after - before) / before)
+                  << " over " << steps << " steps" << (exact ? "" : " (tree potential)") << std::endl;
+    }
+    return 0;
+}
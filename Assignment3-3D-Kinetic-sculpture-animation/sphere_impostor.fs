@@ -0,0 +1,105 @@
+#version 330 core
+// permutation (program_cache.h): HAS_SPECULAR_MAP 0 reuses the diffuse sample as the
+// specular map, as in multiple_light.fs
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+struct PointLight {
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec3 RayTarget;
+
+out vec4 FragColor;
+
+uniform mat4 model;
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+uniform Material material;
+uniform PointLight pointLights[1];
+
+const float PI = 3.14159265358979;
+
+void main()
+{
+    // ray from the eye against the analytic sphere
+    vec3 center = model[3].xyz;
+    float radius = length(model[0].xyz);
+    vec3 rayDir = normalize(RayTarget - viewPos);
+    vec3 toCenter = center - viewPos;
+    float along = dot(rayDir, toCenter);
+    vec3 closest = toCenter - rayDir * along; // not d^2 - along^2, which cancels badly for far bodies
+    float missSquared = dot(closest, closest);
+    if (missSquared > radius * radius)
+        discard;
+    vec3 FragPos = viewPos + rayDir * (along - sqrt(radius * radius - missSquared));
+
+    // depth of the surface, not of the quad, so impostors intersect meshes correctly
+    vec4 clipPos = projection * view * vec4(FragPos, 1.0);
+    gl_FragDepth = clipPos.z / clipPos.w * 0.5 + 0.5;
+
+    vec3 Normal = (FragPos - center) / radius;
+
+    // texture coordinates of the UV sphere mesh, from the direction in the body's own
+    // frame (mat3(model) is a rotation times the radius)
+    vec3 local = transpose(mat3(model)) * Normal / radius;
+    vec2 TexCoords = vec2(atan(local.y, local.x) / (2.0 * PI), acos(clamp(local.z, -1.0, 1.0)) / PI);
+    // u jumps by 1 at the seam, which would drop a pixel quad straddling it to the
+    // smallest mip; take each derivative from whichever of u and fract(u) is continuous
+    // there, and sample with those (the texture repeats, so u needs no wrapping itself)
+    vec2 dx = dFdx(TexCoords);
+    vec2 dy = dFdy(TexCoords);
+    float seamX = dFdx(fract(TexCoords.x));
+    float seamY = dFdy(fract(TexCoords.x));
+    dx.x = abs(seamX) < abs(dx.x) ? seamX : dx.x;
+    dy.x = abs(seamY) < abs(dy.x) ? seamY : dy.x;
+
+    // lighting as in multiple_light.fs
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(pointLights[0].position - FragPos);
+
+    // Diffuse shading
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuseTex = textureGrad(material.diffuse, TexCoords, dx, dy).rgb;
+    vec3 diffuse = pointLights[0].diffuse * diff * diffuseTex;
+
+    // Ambient
+    vec3 ambient = pointLights[0].ambient * diffuseTex;
+
+    // Specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#if HAS_SPECULAR_MAP
+    vec3 specularTex = textureGrad(material.specular, TexCoords, dx, dy).rgb;
+#else
+    vec3 specularTex = diffuseTex;
+#endif
+    vec3 specular = pointLights[0].specular * spec * specularTex;
+
+    // Attenuation
+    float distance = length(pointLights[0].position - FragPos);
+    float attenuation = 1.0 / (pointLights[0].constant + pointLights[0].linear * distance +
+                               pointLights[0].quadratic * (distance * distance));
+
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    vec3 result = ambient + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
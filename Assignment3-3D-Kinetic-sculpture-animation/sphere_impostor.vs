@@ -0,0 +1,27 @@
+#version 330 core
+layout (location = 0) in vec2 aCorner; // -1..1
+
+out vec3 RayTarget; // world-space point on the quad; the fragment shader casts a ray through it
+
+uniform mat4 model; // same as the mesh: unit sphere to world, uniform scale
+uniform mat4 view;
+uniform mat4 projection;
+uniform vec3 viewPos;
+
+void main()
+{
+    vec3 center = model[3].xyz;
+    float radius = length(model[0].xyz);
+    vec3 toCenter = center - viewPos;
+    float distance = length(toCenter);
+    vec3 forward = toCenter / distance;
+    vec3 cameraUp = vec3(view[0][1], view[1][1], view[2][1]);
+    vec3 right = normalize(cross(forward, cameraUp));
+    vec3 up = cross(right, forward);
+
+    // square through the centre, facing the camera, that holds the cone of rays
+    // touching the sphere: half size = distance * tan(asin(radius / distance))
+    float halfSize = radius * distance / sqrt(max(distance * distance - radius * radius, 1e-6));
+    RayTarget = center + (aCorner.x * right + aCorner.y * up) * halfSize;
+    gl_Position = projection * view * vec4(RayTarget, 1.0);
+}
@@ -0,0 +1,171 @@
+// sphere_lod.h
+// CPU side of the sphere mesh: a chain of UV-sphere levels of detail packed
+// back to back into one vertex array and one index array, plus the screen-space
+// level selection. No GL calls in here; createSphereVAO() in main.cpp uploads it.
+// Small bodies skip the mesh entirely and use the impostor quad (createImpostorVAO()).
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <vector>
+
+// vertex layout: position (3), normal (3), texcoord (2)
+const int SPHERE_FLOATS_PER_VERTEX = 8;
+const float SPHERE_RADIUS = 0.5f;
+
+struct SphereLevel
+{
+    int sectorCount;
+    int stackCount;
+    unsigned int baseVertex;  // first vertex of this level in the shared vertex array
+    unsigned int firstIndex;  // first index of this level in the shared index array
+    unsigned int indexCount;
+};
+
+// Indices are 16-bit and relative to the level's baseVertex (drawn with
+// glDrawElementsBaseVertex), which holds for every level up to 255x127.
+struct SphereLodChain
+{
+    std::vector<SphereLevel> levels; // coarsest first
+    std::vector<float> vertices;
+    std::vector<uint16_t> indices;
+};
+
+inline unsigned int sphereVertexCount(int sectorCount, int stackCount)
+{
+    return (unsigned int)((sectorCount + 1) * (stackCount + 1));
+}
+
+// the first and last stack are fans (one triangle per sector), the rest are quads
+inline unsigned int sphereIndexCount(int sectorCount, int stackCount)
+{
+    return (unsigned int)(6 * sectorCount * (stackCount - 1));
+}
+
+// Fills one level into storage that was already sized for it. Same winding and
+// texture mapping as the original single-sphere createSphereVAO().
+inline void writeSphereLevel(const SphereLevel& level, float* vertices, uint16_t* indices)
+{
+    const int sectorCount = level.sectorCount;
+    const int stackCount = level.stackCount;
+
+    float* v = vertices;
+    for (int i = 0; i <= stackCount; ++i)
+    {
+        float stackAngle = glm::pi<float>() / 2 - i * glm::pi<float>() / stackCount; // from pi/2 to -pi/2
+        float xy = SPHERE_RADIUS * cosf(stackAngle);
+        float z = SPHERE_RADIUS * sinf(stackAngle);
+
+        for (int j = 0; j <= sectorCount; ++j)
+        {
+            float sectorAngle = j * 2 * glm::pi<float>() / sectorCount; // 0 to 2pi
+            float x = xy * cosf(sectorAngle);
+            float y = xy * sinf(sectorAngle);
+
+            *v++ = x;
+            *v++ = y;
+            *v++ = z;
+            *v++ = x / SPHERE_RADIUS;
+            *v++ = y / SPHERE_RADIUS;
+            *v++ = z / SPHERE_RADIUS;
+            *v++ = (float)j / sectorCount;
+            *v++ = (float)i / stackCount;
+        }
+    }
+
+    uint16_t* idx = indices;
+    for (int i = 0; i < stackCount; ++i)
+    {
+        int k1 = i * (sectorCount + 1);
+        int k2 = k1 + sectorCount + 1;
+        for (int j = 0; j < sectorCount; ++j, ++k1, ++k2)
+        {
+            if (i != 0)
+            {
+                *idx++ = (uint16_t)k1;
+                *idx++ = (uint16_t)k2;
+                *idx++ = (uint16_t)(k1 + 1);
+            }
+            if (i != (stackCount - 1))
+            {
+                *idx++ = (uint16_t)(k1 + 1);
+                *idx++ = (uint16_t)k2;
+                *idx++ = (uint16_t)(k2 + 1);
+            }
+        }
+    }
+}
+
+// Builds levels minSectors x minSectors/2 ... maxSectors x maxSectors/2, doubling
+// each step. All offsets are known up front, so the arrays are sized exactly once
+// and every level writes a disjoint range; with parallel set each level gets its
+// own thread.
+inline SphereLodChain buildSphereLodChain(int minSectors = 8, int maxSectors = 128, bool parallel = true)
+{
+    SphereLodChain chain;
+    unsigned int vertexTotal = 0;
+    unsigned int indexTotal = 0;
+    for (int sectors = minSectors; sectors <= maxSectors; sectors *= 2)
+    {
+        SphereLevel level;
+        level.sectorCount = sectors;
+        level.stackCount = sectors / 2;
+        level.baseVertex = vertexTotal;
+        level.firstIndex = indexTotal;
+        level.indexCount = sphereIndexCount(level.sectorCount, level.stackCount);
+        vertexTotal += sphereVertexCount(level.sectorCount, level.stackCount);
+        indexTotal += level.indexCount;
+        chain.levels.push_back(level);
+    }
+    chain.vertices.resize((size_t)vertexTotal * SPHERE_FLOATS_PER_VERTEX);
+    chain.indices.resize(indexTotal);
+
+    std::vector<std::thread> workers;
+    for (const SphereLevel& level : chain.levels)
+    {
+        float* v = chain.vertices.data() + (size_t)level.baseVertex * SPHERE_FLOATS_PER_VERTEX;
+        uint16_t* idx = chain.indices.data() + level.firstIndex;
+        if (parallel && &level != &chain.levels.back())
+            workers.emplace_back(writeSphereLevel, level, v, idx);
+        else
+            writeSphereLevel(level, v, idx); // the finest level runs on the calling thread
+    }
+    for (std::thread& worker : workers)
+        worker.join();
+    return chain;
+}
+
+// Radius in pixels of a sphere's silhouette. Uses the exact angular radius so it
+// stays correct when the camera is close to the body.
+inline float projectedSphereRadius(float worldRadius, float distance, float fovyRadians, float viewportHeight)
+{
+    if (distance <= worldRadius)
+        return viewportHeight; // camera is inside the body
+    float angularRadius = asinf(worldRadius / distance);
+    return tanf(angularRadius) / tanf(fovyRadians * 0.5f) * viewportHeight * 0.5f;
+}
+
+// Bodies at most this many pixels in radius on screen are drawn as impostors: one
+// quad that sphere_impostor.fs ray-casts against the exact sphere, in place of a mesh
+// level. Below this size even the mesh levels selectSphereLevel picks cost hundreds
+// of vertices for a few hundred pixels.
+const float SPHERE_IMPOSTOR_MAX_PIXELS = 32.0f;
+const int SPHERE_IMPOSTOR_LEVEL = -1;
+
+// Coarsest level whose silhouette stays within maxErrorPixels of the true circle.
+// An n-gon inscribed in a circle of radius r deviates from it by r * (1 - cos(pi / n));
+// stacks cover half the angle of sectors, so both directions give the same n.
+inline int selectSphereLevel(const SphereLodChain& chain, float screenRadius, float maxErrorPixels = 0.5f)
+{
+    for (int i = 0; i < (int)chain.levels.size(); ++i)
+    {
+        float error = screenRadius * (1.0f - cosf(glm::pi<float>() / chain.levels[i].sectorCount));
+        if (error <= maxErrorPixels)
+            return i;
+    }
+    return (int)chain.levels.size() - 1;
+}
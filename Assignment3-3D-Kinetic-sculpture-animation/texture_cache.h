@@ -0,0 +1,356 @@
+// texture_cache.h
+// Pre-mipmapped, block-compressed texture cache. A decoded RGB image is reduced
+// to a full mip chain, every level is encoded to BC1 (DXT1) in software and the
+// result is written as a standard .dds file next to the source. Later runs map
+// the .dds and hand the levels to glCompressedTexSubImage2D as they are.
+// Everything here is CPU-only; the software decoder is used for the quality
+// report and as a fallback on drivers without S3TC.
+#pragma once
+
+#include "../common/mapped_file.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+
+const int BC1_BLOCK_BYTES = 8;
+
+struct ImageLevel
+{
+    int width = 0;
+    int height = 0;
+    std::vector<unsigned char> pixels; // tightly packed, `components` bytes per pixel
+};
+
+// Next mip level of `src`: 2x2 box filter, odd edges repeat the last row/column
+inline ImageLevel halveImageLevel(const ImageLevel& src, int components)
+{
+    ImageLevel dst;
+    dst.width = std::max(1, src.width / 2);
+    dst.height = std::max(1, src.height / 2);
+    dst.pixels.resize((size_t)dst.width * dst.height * components);
+    for (int y = 0; y < dst.height; ++y)
+    {
+        int y0 = std::min(2 * y, src.height - 1), y1 = std::min(2 * y + 1, src.height - 1);
+        for (int x = 0; x < dst.width; ++x)
+        {
+            int x0 = std::min(2 * x, src.width - 1), x1 = std::min(2 * x + 1, src.width - 1);
+            for (int c = 0; c < components; ++c)
+            {
+                int sum = src.pixels[((size_t)y0 * src.width + x0) * components + c]
+                        + src.pixels[((size_t)y0 * src.width + x1) * components + c]
+                        + src.pixels[((size_t)y1 * src.width + x0) * components + c]
+                        + src.pixels[((size_t)y1 * src.width + x1) * components + c];
+                dst.pixels[((size_t)y * dst.width + x) * components + c] = (unsigned char)((sum + 2) / 4);
+            }
+        }
+    }
+    return dst;
+}
+
+// Box-filtered mip chain down to 1x1; level 0 is a copy of the source.
+inline std::vector<ImageLevel> buildMipChain(const unsigned char* pixels, int width, int height, int components)
+{
+    std::vector<ImageLevel> chain(1);
+    chain[0].width = width;
+    chain[0].height = height;
+    chain[0].pixels.assign(pixels, pixels + (size_t)width * height * components);
+
+    while (chain.back().width > 1 || chain.back().height > 1)
+        chain.push_back(halveImageLevel(chain.back(), components));
+    return chain;
+}
+
+inline size_t bc1LevelSize(int width, int height)
+{
+    return (size_t)((width + 3) / 4) * ((height + 3) / 4) * BC1_BLOCK_BYTES;
+}
+
+inline uint16_t packRGB565(float r, float g, float b)
+{
+    int R = std::clamp((int)std::lround(r * 31.0f / 255.0f), 0, 31);
+    int G = std::clamp((int)std::lround(g * 63.0f / 255.0f), 0, 63);
+    int B = std::clamp((int)std::lround(b * 31.0f / 255.0f), 0, 31);
+    return (uint16_t)((R << 11) | (G << 5) | B);
+}
+
+inline void unpackRGB565(uint16_t c, int rgb[3])
+{
+    int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+    rgb[0] = (r << 3) | (r >> 2);
+    rgb[1] = (g << 2) | (g >> 4);
+    rgb[2] = (b << 3) | (b >> 2);
+}
+
+// Four-colour palette of a block; 3-colour mode is only produced for flat blocks.
+inline void bc1Palette(uint16_t c0, uint16_t c1, int palette[4][3])
+{
+    unpackRGB565(c0, palette[0]);
+    unpackRGB565(c1, palette[1]);
+    for (int i = 0; i < 3; ++i)
+    {
+        if (c0 > c1)
+        {
+            palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+            palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+        }
+        else
+        {
+            palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+            palette[3][i] = 0;
+        }
+    }
+}
+
+// Range fit along the principal axis of the block's colours.
+inline void encodeBC1Block(const unsigned char rgb[16][3], unsigned char out[8])
+{
+    float mean[3] = { 0, 0, 0 };
+    for (int p = 0; p < 16; ++p)
+        for (int i = 0; i < 3; ++i)
+            mean[i] += rgb[p][i] / 16.0f;
+
+    float cov[6] = { 0, 0, 0, 0, 0, 0 }; // xx xy xz yy yz zz
+    for (int p = 0; p < 16; ++p)
+    {
+        float d[3] = { rgb[p][0] - mean[0], rgb[p][1] - mean[1], rgb[p][2] - mean[2] };
+        cov[0] += d[0] * d[0]; cov[1] += d[0] * d[1]; cov[2] += d[0] * d[2];
+        cov[3] += d[1] * d[1]; cov[4] += d[1] * d[2]; cov[5] += d[2] * d[2];
+    }
+    float axis[3] = { 1.0f, 1.0f, 1.0f };
+    for (int iteration = 0; iteration < 8; ++iteration)
+    {
+        float next[3] = {
+            cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2],
+            cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2],
+            cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2],
+        };
+        float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length < 1e-6f)
+            break; // flat block, keep the grey axis
+        for (int i = 0; i < 3; ++i)
+            axis[i] = next[i] / length;
+    }
+
+    float minProj = 1e30f, maxProj = -1e30f;
+    for (int p = 0; p < 16; ++p)
+    {
+        float proj = (rgb[p][0] - mean[0]) * axis[0] + (rgb[p][1] - mean[1]) * axis[1] + (rgb[p][2] - mean[2]) * axis[2];
+        minProj = std::min(minProj, proj);
+        maxProj = std::max(maxProj, proj);
+    }
+    uint16_t c0 = packRGB565(mean[0] + axis[0] * maxProj, mean[1] + axis[1] * maxProj, mean[2] + axis[2] * maxProj);
+    uint16_t c1 = packRGB565(mean[0] + axis[0] * minProj, mean[1] + axis[1] * minProj, mean[2] + axis[2] * minProj);
+    if (c0 < c1)
+        std::swap(c0, c1);
+
+    int palette[4][3];
+    bc1Palette(c0, c1, palette);
+    uint32_t indices = 0;
+    if (c0 != c1)
+    {
+        for (int p = 0; p < 16; ++p)
+        {
+            int best = 0, bestError = 1 << 30;
+            for (int k = 0; k < 4; ++k)
+            {
+                int dr = rgb[p][0] - palette[k][0], dg = rgb[p][1] - palette[k][1], db = rgb[p][2] - palette[k][2];
+                int error = dr * dr + dg * dg + db * db;
+                if (error < bestError) { bestError = error; best = k; }
+            }
+            indices |= (uint32_t)best << (2 * p);
+        }
+    }
+    out[0] = (unsigned char)(c0 & 0xFF); out[1] = (unsigned char)(c0 >> 8);
+    out[2] = (unsigned char)(c1 & 0xFF); out[3] = (unsigned char)(c1 >> 8);
+    for (int i = 0; i < 4; ++i)
+        out[4 + i] = (unsigned char)(indices >> (8 * i));
+}
+
+// Encodes one level (components 3 or 4; alpha is ignored). Edge blocks repeat the last row/column.
+inline std::vector<unsigned char> encodeBC1(const unsigned char* pixels, int width, int height, int components)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::vector<unsigned char> out((size_t)blocksX * blocksY * BC1_BLOCK_BYTES);
+    unsigned char block[16][3];
+    for (int by = 0; by < blocksY; ++by)
+    {
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            for (int p = 0; p < 16; ++p)
+            {
+                int x = std::min(bx * 4 + (p & 3), width - 1);
+                int y = std::min(by * 4 + (p >> 2), height - 1);
+                const unsigned char* src = pixels + ((size_t)y * width + x) * components;
+                block[p][0] = src[0]; block[p][1] = src[1]; block[p][2] = src[2];
+            }
+            encodeBC1Block(block, &out[((size_t)by * blocksX + bx) * BC1_BLOCK_BYTES]);
+        }
+    }
+    return out;
+}
+
+// Software decoder: BC1 level to tightly packed RGB8
+inline std::vector<unsigned char> decodeBC1(const unsigned char* blocks, int width, int height)
+{
+    int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+    std::vector<unsigned char> rgb((size_t)width * height * 3);
+    for (int by = 0; by < blocksY; ++by)
+    {
+        for (int bx = 0; bx < blocksX; ++bx)
+        {
+            const unsigned char* b = blocks + ((size_t)by * blocksX + bx) * BC1_BLOCK_BYTES;
+            uint16_t c0 = (uint16_t)(b[0] | (b[1] << 8)), c1 = (uint16_t)(b[2] | (b[3] << 8));
+            uint32_t indices = (uint32_t)b[4] | ((uint32_t)b[5] << 8) | ((uint32_t)b[6] << 16) | ((uint32_t)b[7] << 24);
+            int palette[4][3];
+            bc1Palette(c0, c1, palette);
+            for (int p = 0; p < 16; ++p)
+            {
+                int x = bx * 4 + (p & 3), y = by * 4 + (p >> 2);
+                if (x >= width || y >= height)
+                    continue;
+                const int* color = palette[(indices >> (2 * p)) & 3];
+                unsigned char* dst = &rgb[((size_t)y * width + x) * 3];
+                dst[0] = (unsigned char)color[0]; dst[1] = (unsigned char)color[1]; dst[2] = (unsigned char)color[2];
+            }
+        }
+    }
+    return rgb;
+}
+
+// --- .dds container (DX9 header, FourCC DXT1, full mip chain) ---
+
+struct CompressedLevel
+{
+    int width;
+    int height;
+    const unsigned char* data;
+    size_t size;
+};
+
+struct CompressedImage
+{
+    int width = 0;
+    int height = 0;
+    std::vector<CompressedLevel> levels; // point into the mapped file
+};
+
+inline void putU32(unsigned char* p, uint32_t v)
+{
+    p[0] = (unsigned char)v; p[1] = (unsigned char)(v >> 8); p[2] = (unsigned char)(v >> 16); p[3] = (unsigned char)(v >> 24);
+}
+
+inline uint32_t getU32(const unsigned char* p)
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+const size_t DDS_HEADER_BYTES = 128; // magic + DDS_HEADER
+
+inline bool writeBC1DDS(const std::string& path, int width, int height, const std::vector<std::vector<unsigned char>>& levels)
+{
+    unsigned char header[DDS_HEADER_BYTES] = {};
+    memcpy(header, "DDS ", 4);
+    putU32(header + 4, 124);                                   // dwSize
+    putU32(header + 8, 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000); // caps, height, width, pixelformat, mipmapcount, linearsize
+    putU32(header + 12, (uint32_t)height);
+    putU32(header + 16, (uint32_t)width);
+    putU32(header + 20, (uint32_t)levels[0].size());           // dwPitchOrLinearSize
+    putU32(header + 28, (uint32_t)levels.size());              // dwMipMapCount
+    putU32(header + 76, 32);                                   // ddspf.dwSize
+    putU32(header + 80, 0x4);                                  // DDPF_FOURCC
+    memcpy(header + 84, "DXT1", 4);
+    putU32(header + 108, 0x1000 | 0x400000 | 0x8);             // texture, mipmap, complex
+
+    // write to a temporary name first so a crash never leaves a truncated cache behind
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write((const char*)header, sizeof(header));
+        for (const std::vector<unsigned char>& level : levels)
+            file.write((const char*)level.data(), (std::streamsize)level.size());
+        if (!file)
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+inline bool parseBC1DDS(const unsigned char* data, size_t size, CompressedImage& image)
+{
+    if (size < DDS_HEADER_BYTES || memcmp(data, "DDS ", 4) != 0 || memcmp(data + 84, "DXT1", 4) != 0)
+        return false;
+    image.height = (int)getU32(data + 12);
+    image.width = (int)getU32(data + 16);
+    uint32_t mipCount = std::max<uint32_t>(1, getU32(data + 28));
+    image.levels.clear();
+
+    size_t offset = DDS_HEADER_BYTES;
+    int width = image.width, height = image.height;
+    for (uint32_t level = 0; level < mipCount; ++level)
+    {
+        size_t levelSize = bc1LevelSize(width, height);
+        if (offset + levelSize > size)
+            return false;
+        image.levels.push_back(CompressedLevel{ width, height, data + offset, levelSize });
+        offset += levelSize;
+        width = std::max(1, width / 2);
+        height = std::max(1, height / 2);
+    }
+    return true;
+}
+
+inline std::string textureCachePath(const std::string& sourcePath)
+{
+    return sourcePath + ".dds";
+}
+
+// true when the cache exists and is not older than the source image
+inline bool textureCacheIsFresh(const std::string& sourcePath, const std::string& cachePath)
+{
+    std::error_code error;
+    auto cacheTime = std::filesystem::last_write_time(cachePath, error);
+    if (error)
+        return false;
+    auto sourceTime = std::filesystem::last_write_time(sourcePath, error);
+    return error || cacheTime >= sourceTime; // a missing source keeps using the cache
+}
+
+// Mip chain + BC1 encode + .dds write for a decoded RGB image. BC1 as written here
+// has no alpha, so other layouts are refused and stay uncompressed.
+inline bool writeTextureCache(const unsigned char* pixels, int width, int height, int components, const std::string& cachePath)
+{
+    if (components != 3)
+        return false;
+    std::vector<ImageLevel> chain = buildMipChain(pixels, width, height, components);
+    std::vector<std::vector<unsigned char>> encoded;
+    encoded.reserve(chain.size());
+    for (const ImageLevel& level : chain)
+        encoded.push_back(encodeBC1(level.pixels.data(), level.width, level.height, components));
+    return writeBC1DDS(cachePath, width, height, encoded);
+}
+
+inline double imagePSNR(const unsigned char* a, const unsigned char* b, size_t count, int strideA, int strideB)
+{
+    double squared = 0.0;
+    for (size_t i = 0; i < count; ++i)
+        for (int c = 0; c < 3; ++c)
+        {
+            double d = (double)a[i * strideA + c] - (double)b[i * strideB + c];
+            squared += d * d;
+        }
+    double mse = squared / (count * 3.0);
+    return mse > 0.0 ? 10.0 * std::log10(255.0 * 255.0 / mse) : 99.0;
+}
@@ -0,0 +1,578 @@
+// texture_manager.h
+// Asynchronous texture loading: files are decoded with stb_image on a worker
+// pool and uploaded on the GL thread through a small ring of pixel buffer
+// objects, a bounded number of bytes per frame. Until a texture is complete
+// get() hands out a 1x1 placeholder, so the first frame never waits on disk.
+// Requests are deduplicated by path. With the cache enabled the worker converts
+// a source image to a BC1 .dds (see texture_cache.h) once, and every later run
+// maps that file and uploads its precomputed mip levels without decoding.
+#pragma once
+
+#include <glad/glad.h>
+#include <stb_image.h>
+
+#include "../common/thread_pool.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT 0x0040
+#endif
+#ifndef GL_MAP_COHERENT_BIT
+#define GL_MAP_COHERENT_BIT 0x0080
+#endif
+
+struct DecodedImage
+{
+    unsigned char* pixels = nullptr;
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    double decodeSeconds = 0.0;
+
+    size_t byteSize() const { return (size_t)width * height * components; }
+};
+
+inline DecodedImage decodeImage(const std::string& path)
+{
+    DecodedImage image;
+    auto start = std::chrono::steady_clock::now();
+    image.pixels = stbi_load(path.c_str(), &image.width, &image.height, &image.components, 0);
+    image.decodeSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return image;
+}
+
+inline GLenum imageFormat(int components)
+{
+    if (components == 1) return GL_RED;
+    if (components == 4) return GL_RGBA;
+    return GL_RGB;
+}
+
+struct TextureStats
+{
+    unsigned int requests = 0;       // calls to request(), including duplicates
+    unsigned int unique = 0;         // distinct files
+    unsigned int ready = 0;
+    unsigned int cacheHits = 0;      // served from an existing .dds
+    unsigned int cacheWrites = 0;    // converted on this run
+    size_t decodedBytes = 0;         // source pixels decoded from JPEG/PNG
+    double decodeSeconds = 0.0;      // worker time (decode, convert or map), summed over workers
+    size_t residentBytes = 0;        // GPU memory of all finished textures, mips included
+    size_t uploadedBytes = 0;
+    unsigned int uploadChunks = 0;
+    unsigned int stalledFrames = 0;  // frames where every pixel buffer was still in flight
+};
+
+class TextureManager
+{
+public:
+    // loader is used to look up glBufferStorage; on a context older than 4.4 the
+    // pixel buffers are mapped per chunk instead of persistently
+    TextureManager(ThreadPool& pool, GLADloadproc loader, bool useCache = true,
+                   size_t uploadBudgetBytes = 8u << 20, int pixelBufferCount = 3)
+        : pool(pool), useCache(useCache), uploadBudget(uploadBudgetBytes), pixelBuffers(pixelBufferCount)
+    {
+        unsigned char grey[3] = { 128, 128, 128 };
+        glGenTextures(1, &placeholder);
+        glBindTexture(GL_TEXTURE_2D, placeholder);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, 1, 1, 0, GL_RGB, GL_UNSIGNED_BYTE, grey);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+        typedef void (APIENTRYP BufferStorageProc)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+        GLint major = 0, minor = 0;
+        glGetIntegerv(GL_MAJOR_VERSION, &major);
+        glGetIntegerv(GL_MINOR_VERSION, &minor);
+        BufferStorageProc bufferStorage = nullptr;
+        if (major > 4 || (major == 4 && minor >= 4))
+            bufferStorage = (BufferStorageProc)loader("glBufferStorage");
+        persistent = bufferStorage != nullptr;
+
+        // without S3TC the cache is still used, but its levels are expanded to RGB on the worker
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; ++i)
+            if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_EXT_texture_compression_s3tc") == 0)
+                s3tcSupported = true;
+
+        for (PixelBuffer& buffer : pixelBuffers)
+        {
+            glGenBuffers(1, &buffer.pbo);
+            glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+            if (persistent)
+            {
+                GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+                bufferStorage(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)uploadBudget, nullptr, flags);
+                buffer.mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)uploadBudget, flags);
+            }
+            else
+            {
+                glBufferData(GL_PIXEL_UNPACK_BUFFER, (GLsizeiptr)uploadBudget, nullptr, GL_STREAM_DRAW);
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    }
+
+    // GL objects are left to the context teardown; only wait for our jobs here
+    ~TextureManager()
+    {
+        pool.waitIdle();
+        for (Entry& entry : entries)
+            stbi_image_free(entry.image.pixels);
+        for (Loaded& done : finished)
+            stbi_image_free(done.image.pixels);
+    }
+
+    // returns a handle for the file, queueing a decode the first time it is seen
+    unsigned int request(const std::string& path)
+    {
+        textureStats.requests++;
+        auto found = handles.find(path);
+        if (found != handles.end())
+            return found->second;
+
+        unsigned int handle = (unsigned int)entries.size();
+        entries.push_back(Entry());
+        entries.back().path = path;
+        handles[path] = handle;
+        textureStats.unique++;
+
+        pool.enqueue([this, handle, path]() {
+            Loaded done = load(path);
+            done.handle = handle;
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            finished.push_back(std::move(done));
+        });
+        return handle;
+    }
+
+    // texture to bind for this handle: the placeholder until the upload completes
+    GLuint get(unsigned int handle) const
+    {
+        return entries[handle].ready ? entries[handle].texture : placeholder;
+    }
+
+    bool allReady() const { return textureStats.ready + failedCount == textureStats.unique; }
+    const TextureStats& stats() const { return textureStats; }
+
+    // call once per frame on the GL thread: picks up decoded images and uploads
+    // at most uploadBudget bytes of them
+    void update()
+    {
+        {
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            for (Loaded& done : finished)
+                prepareUpload(done);
+            finished.clear();
+        }
+
+        size_t budget = uploadBudget;
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        while (budget > 0 && !uploadQueue.empty())
+        {
+            PixelBuffer& buffer = pixelBuffers[nextBuffer];
+            if (buffer.fence)
+            {
+                // never block: if the GPU has not consumed this buffer yet, try again next frame
+                if (glClientWaitSync(buffer.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                {
+                    textureStats.stalledFrames++;
+                    break;
+                }
+                glDeleteSync(buffer.fence);
+                buffer.fence = 0;
+            }
+
+            Entry& entry = entries[uploadQueue.front()];
+            if (entry.texture == 0)
+                allocate(entry);
+
+            const UploadLevel& level = entry.levels[entry.level];
+            int rows = (int)std::max<size_t>(1, std::min(budget, uploadBudget) / level.rowBytes);
+            rows = std::min(rows, level.rowCount - entry.rowsUploaded);
+            size_t bytes = rows * level.rowBytes;
+            const unsigned char* source = level.data + entry.rowsUploaded * level.rowBytes;
+
+            glBindTexture(GL_TEXTURE_2D, entry.texture);
+            if (bytes > uploadBudget)
+            {
+                // a single row wider than a pixel buffer: upload it straight from client memory
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+                uploadRows(entry, level, rows, bytes, source);
+            }
+            else
+            {
+                glBindBuffer(GL_PIXEL_UNPACK_BUFFER, buffer.pbo);
+                if (persistent)
+                {
+                    memcpy(buffer.mapped, source, bytes);
+                }
+                else
+                {
+                    void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, (GLsizeiptr)bytes,
+                                                    GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+                    memcpy(mapped, source, bytes);
+                    glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+                }
+                uploadRows(entry, level, rows, bytes, (void*)0);
+                buffer.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+                nextBuffer = (nextBuffer + 1) % pixelBuffers.size();
+            }
+
+            entry.rowsUploaded += rows;
+            textureStats.uploadedBytes += bytes;
+            textureStats.uploadChunks++;
+            budget -= std::min(budget, bytes);
+
+            if (entry.rowsUploaded == level.rowCount)
+            {
+                entry.level++;
+                entry.rowsUploaded = 0;
+            }
+            if (entry.level == entry.levels.size())
+            {
+                if (entry.generateMipmaps)
+                    glGenerateMipmap(GL_TEXTURE_2D);
+                // the GL copy is complete; drop the CPU side
+                stbi_image_free(entry.image.pixels);
+                entry.image.pixels = nullptr;
+                entry.mapping.reset();
+                entry.expanded.clear();
+                entry.levels.clear();
+                entry.ready = true;
+                textureStats.ready++;
+                textureStats.residentBytes += entry.residentBytes;
+                uploadQueue.pop_front();
+            }
+        }
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+private:
+    // one mip level; a row is a row of pixels, or a row of 4x4 blocks when compressed
+    struct UploadLevel
+    {
+        const unsigned char* data;
+        int width;
+        int height;
+        size_t rowBytes;
+        int rowCount;
+    };
+    struct Entry
+    {
+        std::string path;
+        GLuint texture = 0;
+        GLenum format = GL_RGB;
+        bool compressed = false;
+        bool generateMipmaps = false;
+        std::vector<UploadLevel> levels;
+        size_t level = 0;  // level being uploaded
+        int rowsUploaded = 0;
+        size_t residentBytes = 0;
+        bool ready = false;
+
+        // whichever of these backs `levels` until the upload is done
+        DecodedImage image;
+        std::unique_ptr<MappedFile> mapping;
+        std::vector<std::vector<unsigned char>> expanded;
+    };
+    // result of a worker job
+    struct Loaded
+    {
+        unsigned int handle = 0;
+        DecodedImage image;                      // plain path: source pixels, mips generated on the GPU
+        std::unique_ptr<MappedFile> mapping;     // cached path: the mapped .dds
+        CompressedImage cached;                  // level layout of the .dds
+        std::vector<std::vector<unsigned char>> expanded; // cached path without S3TC: RGB levels
+        bool converted = false;
+        double seconds = 0.0;
+    };
+    struct PixelBuffer
+    {
+        GLuint pbo = 0;
+        void* mapped = nullptr; // only when persistently mapped
+        GLsync fence = 0;
+    };
+
+    // worker side: cache lookup, first-run conversion, or a plain decode
+    Loaded load(const std::string& path) const
+    {
+        Loaded done;
+        auto start = std::chrono::steady_clock::now();
+        if (useCache)
+        {
+            std::string cachePath = textureCachePath(path);
+            if (!textureCacheIsFresh(path, cachePath))
+            {
+                done.image = decodeImage(path);
+                if (done.image.pixels && writeTextureCache(done.image.pixels, done.image.width, done.image.height,
+                                                           done.image.components, cachePath))
+                {
+                    done.converted = true;
+                    stbi_image_free(done.image.pixels);
+                    done.image.pixels = nullptr;
+                }
+            }
+            if (!done.image.pixels)
+            {
+                std::unique_ptr<MappedFile> mapping(new MappedFile());
+                if (mapping->open(cachePath) && parseBC1DDS(mapping->data(), mapping->size(), done.cached))
+                {
+                    if (s3tcSupported)
+                    {
+                        done.mapping = std::move(mapping);
+                    }
+                    else
+                    {
+                        for (const CompressedLevel& level : done.cached.levels)
+                            done.expanded.push_back(decodeBC1(level.data, level.width, level.height));
+                    }
+                }
+            }
+        }
+        if (!done.mapping && done.expanded.empty() && !done.image.pixels)
+            done.image = decodeImage(path);
+        done.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        return done;
+    }
+
+    // GL thread: turns a finished job into the list of levels to upload
+    void prepareUpload(Loaded& done)
+    {
+        Entry& entry = entries[done.handle];
+        textureStats.decodeSeconds += done.seconds;
+        if (done.converted)
+            textureStats.cacheWrites++;
+        if (done.mapping)
+        {
+            entry.mapping = std::move(done.mapping);
+            entry.compressed = true;
+            entry.format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            for (const CompressedLevel& level : done.cached.levels)
+            {
+                entry.levels.push_back(UploadLevel{ level.data, level.width, level.height,
+                                                    (size_t)((level.width + 3) / 4) * BC1_BLOCK_BYTES, (level.height + 3) / 4 });
+                entry.residentBytes += level.size;
+            }
+            if (!done.converted)
+                textureStats.cacheHits++;
+        }
+        else if (!done.expanded.empty())
+        {
+            entry.expanded = std::move(done.expanded);
+            entry.format = GL_RGB;
+            for (size_t i = 0; i < entry.expanded.size(); ++i)
+            {
+                const CompressedLevel& level = done.cached.levels[i];
+                entry.levels.push_back(UploadLevel{ entry.expanded[i].data(), level.width, level.height,
+                                                    (size_t)level.width * 3, level.height });
+                entry.residentBytes += (size_t)level.width * level.height * 4; // drivers pad RGB8 to RGBA8
+            }
+            if (!done.converted)
+                textureStats.cacheHits++;
+        }
+        else if (done.image.pixels)
+        {
+            entry.image = done.image;
+            done.image.pixels = nullptr;
+            entry.format = imageFormat(entry.image.components);
+            entry.generateMipmaps = true;
+            entry.levels.push_back(UploadLevel{ entry.image.pixels, entry.image.width, entry.image.height,
+                                                (size_t)entry.image.width * entry.image.components, entry.image.height });
+            textureStats.decodedBytes += entry.image.byteSize();
+            entry.residentBytes = (size_t)entry.image.width * entry.image.height * 4 * 4 / 3;
+        }
+        else
+        {
+            std::cout << "Texture failed to load at path: " << entry.path << std::endl;
+            failedCount++;
+            return;
+        }
+        uploadQueue.push_back(done.handle);
+    }
+
+    // creates storage for every level; contents arrive chunk by chunk in update()
+    void allocate(Entry& entry)
+    {
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0); // a bound unpack buffer would turn nullptr into an offset
+        glGenTextures(1, &entry.texture);
+        glBindTexture(GL_TEXTURE_2D, entry.texture);
+        for (size_t i = 0; i < entry.levels.size(); ++i)
+        {
+            const UploadLevel& level = entry.levels[i];
+            if (entry.compressed)
+                glCompressedTexImage2D(GL_TEXTURE_2D, (GLint)i, entry.format, level.width, level.height, 0,
+                                       (GLsizei)(level.rowBytes * level.rowCount), nullptr);
+            else
+                glTexImage2D(GL_TEXTURE_2D, (GLint)i, (GLint)entry.format, level.width, level.height, 0,
+                             entry.format, GL_UNSIGNED_BYTE, nullptr);
+        }
+        if (!entry.generateMipmaps)
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (GLint)entry.levels.size() - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    // pixels is a client pointer, or an offset into the bound pixel buffer
+    void uploadRows(const Entry& entry, const UploadLevel& level, int rows, size_t bytes, const void* pixels)
+    {
+        if (entry.compressed)
+        {
+            int y = entry.rowsUploaded * 4;
+            int height = std::min(rows * 4, level.height - y);
+            glCompressedTexSubImage2D(GL_TEXTURE_2D, (GLint)entry.level, 0, y, level.width, height,
+                                      entry.format, (GLsizei)bytes, pixels);
+        }
+        else
+        {
+            glTexSubImage2D(GL_TEXTURE_2D, (GLint)entry.level, 0, entry.rowsUploaded, level.width, rows,
+                            entry.format, GL_UNSIGNED_BYTE, pixels);
+        }
+    }
+
+    ThreadPool& pool;
+    bool useCache;
+    bool s3tcSupported = false;
+    size_t uploadBudget;
+    bool persistent = false;
+    GLuint placeholder = 0;
+
+    std::vector<Entry> entries;
+    std::unordered_map<std::string, unsigned int> handles;
+    std::deque<unsigned int> uploadQueue;
+    std::vector<PixelBuffer> pixelBuffers;
+    size_t nextBuffer = 0;
+    unsigned int failedCount = 0;
+    TextureStats textureStats;
+
+    std::mutex finishedMutex;
+    std::vector<Loaded> finished; // written by workers, drained in update()
+};
+
+// Headless decode throughput: decodes every file `repeat` times with 1, 2, 4, ...
+// worker threads and prints MB/s. Needs no GL context.
+inline void benchmarkTextureDecode(const std::vector<std::string>& paths, int repeat)
+{
+    unsigned int hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned int> threadCounts;
+    for (unsigned int threads = 1; threads < hardware; threads *= 2)
+        threadCounts.push_back(threads);
+    threadCounts.push_back(hardware);
+
+    std::cout << "threads,images,decoded_mb,seconds,mb_per_s,images_per_s" << std::endl;
+    for (unsigned int threads : threadCounts)
+    {
+        ThreadPool pool(threads);
+        std::mutex statsMutex;
+        size_t bytes = 0;
+        unsigned int images = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int r = 0; r < repeat; ++r)
+        {
+            for (const std::string& path : paths)
+            {
+                pool.enqueue([&, path]() {
+                    DecodedImage image = decodeImage(path);
+                    std::lock_guard<std::mutex> lock(statsMutex);
+                    if (image.pixels)
+                    {
+                        bytes += image.byteSize();
+                        images++;
+                    }
+                    else
+                    {
+                        std::cout << "Texture failed to load at path: " << path << std::endl;
+                    }
+                    stbi_image_free(image.pixels);
+                });
+            }
+        }
+        pool.waitIdle();
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double mb = bytes / (1024.0 * 1024.0);
+        std::cout << threads << "," << images << "," << mb << "," << seconds << ","
+                  << mb / seconds << "," << images / seconds << std::endl;
+    }
+}
+
+// Headless memory/load-time comparison of the plain path (JPEG decode, full RGB8
+// chain) against the BC1 cache. Writes the .dds caches as a side effect, so it
+// doubles as the offline converter. Uses only the software encoder/decoder.
+inline void benchmarkTextureCache(const std::vector<std::string>& paths)
+{
+    typedef std::chrono::steady_clock Clock;
+    auto ms = [](Clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    };
+    const double MB = 1024.0 * 1024.0;
+
+    std::cout << "texture,width,height,jpeg_decode_ms,rgb8_chain_mb,rgba8_resident_mb,convert_ms,"
+                 "bc1_chain_mb,cached_load_ms,bc1_psnr_db" << std::endl;
+    for (const std::string& path : paths)
+    {
+        auto start = Clock::now();
+        DecodedImage image = decodeImage(path);
+        double decodeMs = ms(start);
+        if (!image.pixels || image.components < 3)
+        {
+            std::cout << "Texture failed to load at path: " << path << std::endl;
+            stbi_image_free(image.pixels);
+            continue;
+        }
+        if (image.components != 3)
+        {
+            std::cout << "Texture has alpha and is not cached: " << path << std::endl;
+            stbi_image_free(image.pixels);
+            continue;
+        }
+        // a full chain is ~4/3 of the top level
+        double rgbChain = image.width * (double)image.height * image.components * 4.0 / 3.0 / MB;
+        double rgbaChain = image.width * (double)image.height * 4.0 * 4.0 / 3.0 / MB;
+
+        std::string cachePath = textureCachePath(path);
+        start = Clock::now();
+        bool written = writeTextureCache(image.pixels, image.width, image.height, image.components, cachePath);
+        double convertMs = ms(start);
+
+        start = Clock::now();
+        MappedFile mapping;
+        CompressedImage cached;
+        bool mapped = written && mapping.open(cachePath) && parseBC1DDS(mapping.data(), mapping.size(), cached);
+        size_t bc1Bytes = 0;
+        volatile unsigned int touched = 0;
+        for (const CompressedLevel& level : cached.levels)
+        {
+            bc1Bytes += level.size;
+            for (size_t offset = 0; offset < level.size; offset += 4096)
+                touched = touched + level.data[offset]; // fault every page in, as an upload would
+        }
+        double loadMs = ms(start);
+
+        double psnr = 0.0;
+        if (mapped)
+        {
+            std::vector<unsigned char> decoded = decodeBC1(cached.levels[0].data, cached.width, cached.height);
+            psnr = imagePSNR(image.pixels, decoded.data(), (size_t)image.width * image.height, image.components, 3);
+        }
+        std::cout << path << "," << image.width << "," << image.height << "," << decodeMs << ","
+                  << rgbChain << "," << rgbaChain << "," << convertMs << "," << bc1Bytes / MB << ","
+                  << loadMs << "," << psnr << std::endl;
+        stbi_image_free(image.pixels);
+    }
+}
@@ -0,0 +1,548 @@
+// tile_file.h
+// Sparse virtual texturing, CPU side. A large map is cut into fixed-size BC1 pages
+// for every mip level down to a single page and stored in one tile file (.vtex)
+// next to the source; VirtualTexturePager keeps only the pages a frame actually
+// samples in a fixed pool of physical slots.
+//  - a page is VT_PAGE_SIZE texels plus VT_PAGE_BORDER texels on every side copied
+//    from its neighbours (u wraps, v clamps), so bilinear filtering never reads
+//    across into another slot
+//  - pages are stored level by level, finest first, row by row, all the same size,
+//    so a page's offset is computed rather than looked up
+//  - VirtualTexturePager: page reads on the worker pool, LRU over the slots, and the
+//    indirection table: for every page of every level, the slot holding it or the
+//    one holding its nearest resident ancestor
+// Everything here is CPU-only; virtual_texture.h does the GL side.
+#pragma once
+
+#include "../common/thread_pool.h"
+#include "texture_cache.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+const int VT_PAGE_SIZE = 128;
+const int VT_PAGE_BORDER = 4;                               // a whole BC1 block, so slots stay block aligned
+const int VT_SLOT_SIZE = VT_PAGE_SIZE + 2 * VT_PAGE_BORDER; // 136 texels
+const size_t VT_PAGE_BYTES = (VT_SLOT_SIZE / 4) * (VT_SLOT_SIZE / 4) * BC1_BLOCK_BYTES;
+const size_t VT_HEADER_BYTES = 64;
+const int VT_MAX_PAGES_PER_SIDE = 256; // feedback stores page coordinates in 8 bits: maps up to 32768 texels wide
+
+inline bool isPowerOfTwo(int value)
+{
+    return value > 0 && (value & (value - 1)) == 0;
+}
+
+// Page grid of a map whose sides are powers of two. A level's pages are counted from
+// its size in texels, at least one per side, so the last level holds the whole map
+// in a single (possibly partly filled) page.
+struct TileFileLayout
+{
+    int width = 0;
+    int height = 0;
+    int levels = 0;
+    std::vector<int> pagesX;           // per level
+    std::vector<int> pagesY;
+    std::vector<uint32_t> firstPage;   // per level, index of its first page
+    uint32_t pageCount = 0;
+
+    bool build(int mapWidth, int mapHeight)
+    {
+        if (!isPowerOfTwo(mapWidth) || !isPowerOfTwo(mapHeight)
+            || mapWidth / VT_PAGE_SIZE > VT_MAX_PAGES_PER_SIDE || mapHeight / VT_PAGE_SIZE > VT_MAX_PAGES_PER_SIDE)
+            return false;
+        width = mapWidth;
+        height = mapHeight;
+        pagesX.clear();
+        pagesY.clear();
+        firstPage.clear();
+        pageCount = 0;
+        for (int level = 0;; ++level)
+        {
+            int x = std::max(1, (width >> level) / VT_PAGE_SIZE);
+            int y = std::max(1, (height >> level) / VT_PAGE_SIZE);
+            pagesX.push_back(x);
+            pagesY.push_back(y);
+            firstPage.push_back(pageCount);
+            pageCount += (uint32_t)(x * y);
+            if (x == 1 && y == 1)
+                break;
+        }
+        levels = (int)pagesX.size();
+        return true;
+    }
+
+    uint32_t pageIndex(int level, int x, int y) const { return firstPage[level] + (uint32_t)(y * pagesX[level] + x); }
+    size_t pageOffset(uint32_t page) const { return VT_HEADER_BYTES + page * VT_PAGE_BYTES; }
+    size_t fileSize() const { return pageOffset(pageCount); }
+};
+
+// Bilinear resample of an RGB(A) image, for sources whose sides are not powers of two
+// and for blowing a small map up into a large test map.
+inline std::vector<unsigned char> resampleImage(const unsigned char* pixels, int width, int height, int components,
+                                                int newWidth, int newHeight)
+{
+    std::vector<unsigned char> out((size_t)newWidth * newHeight * components);
+    for (int y = 0; y < newHeight; ++y)
+    {
+        float sy = std::max(0.0f, (y + 0.5f) * height / newHeight - 0.5f);
+        int y0 = std::min((int)sy, height - 1), y1 = std::min(y0 + 1, height - 1);
+        float fy = sy - y0;
+        for (int x = 0; x < newWidth; ++x)
+        {
+            float sx = std::max(0.0f, (x + 0.5f) * width / newWidth - 0.5f);
+            int x0 = std::min((int)sx, width - 1), x1 = (x0 + 1) % width; // u wraps around the planet
+            float fx = sx - x0;
+            for (int c = 0; c < components; ++c)
+            {
+                float top = pixels[((size_t)y0 * width + x0) * components + c] * (1.0f - fx) + pixels[((size_t)y0 * width + x1) * components + c] * fx;
+                float bottom = pixels[((size_t)y1 * width + x0) * components + c] * (1.0f - fx) + pixels[((size_t)y1 * width + x1) * components + c] * fx;
+                out[((size_t)y * newWidth + x) * components + c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+            }
+        }
+    }
+    return out;
+}
+
+inline int nextPowerOfTwo(int value)
+{
+    int power = 1;
+    while (power < value)
+        power *= 2;
+    return power;
+}
+
+// one page of one level, border included, as RGB8
+inline void extractPage(const ImageLevel& level, int components, int pageX, int pageY, unsigned char* rgb)
+{
+    for (int ty = 0; ty < VT_SLOT_SIZE; ++ty)
+    {
+        int sy = std::clamp(pageY * VT_PAGE_SIZE + ty - VT_PAGE_BORDER, 0, level.height - 1);
+        for (int tx = 0; tx < VT_SLOT_SIZE; ++tx)
+        {
+            int sx = ((pageX * VT_PAGE_SIZE + tx - VT_PAGE_BORDER) % level.width + level.width) % level.width;
+            const unsigned char* src = &level.pixels[((size_t)sy * level.width + sx) * components];
+            unsigned char* dst = rgb + ((size_t)ty * VT_SLOT_SIZE + tx) * 3;
+            dst[0] = src[0];
+            dst[1] = src[1];
+            dst[2] = src[2];
+        }
+    }
+}
+
+// Writes the tile file of an RGB(A) image whose sides are powers of two. The image is
+// taken by value (move it in): each level is box-filtered from the previous one in its
+// place, so at most two levels are ever in memory. A level's page rows are encoded on
+// the pool when one is given.
+inline bool writeTileFile(const std::string& path, ImageLevel level, int components, ThreadPool* pool = nullptr)
+{
+    TileFileLayout layout;
+    if (components < 3 || !layout.build(level.width, level.height))
+        return false;
+
+    unsigned char header[VT_HEADER_BYTES] = {};
+    memcpy(header, "VTEX", 4);
+    putU32(header + 4, 1); // version
+    putU32(header + 8, (uint32_t)level.width);
+    putU32(header + 12, (uint32_t)level.height);
+    putU32(header + 16, (uint32_t)VT_PAGE_SIZE);
+    putU32(header + 20, (uint32_t)VT_PAGE_BORDER);
+    putU32(header + 24, (uint32_t)layout.levels);
+
+    // write to a temporary name first so a crash never leaves a truncated file behind
+    std::string temporary = path + ".tmp";
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+            return false;
+        file.write((const char*)header, sizeof(header));
+
+        for (int l = 0; l < layout.levels; ++l)
+        {
+            if (l > 0)
+                level = halveImageLevel(level, components);
+            int pagesX = layout.pagesX[l], pagesY = layout.pagesY[l];
+            std::vector<unsigned char> encoded((size_t)pagesX * pagesY * VT_PAGE_BYTES);
+            auto encodeRow = [&, pagesX](int pageY) {
+                std::vector<unsigned char> rgb((size_t)VT_SLOT_SIZE * VT_SLOT_SIZE * 3);
+                for (int pageX = 0; pageX < pagesX; ++pageX)
+                {
+                    extractPage(level, components, pageX, pageY, rgb.data());
+                    std::vector<unsigned char> blocks = encodeBC1(rgb.data(), VT_SLOT_SIZE, VT_SLOT_SIZE, 3);
+                    memcpy(&encoded[((size_t)pageY * pagesX + pageX) * VT_PAGE_BYTES], blocks.data(), VT_PAGE_BYTES);
+                }
+            };
+            if (pool != nullptr && pool->size() > 1 && pagesY > 1)
+            {
+                for (int pageY = 0; pageY < pagesY; ++pageY)
+                    pool->enqueue([&encodeRow, pageY] { encodeRow(pageY); });
+                pool->waitIdle();
+            }
+            else
+            {
+                for (int pageY = 0; pageY < pagesY; ++pageY)
+                    encodeRow(pageY);
+            }
+            file.write((const char*)encoded.data(), (std::streamsize)encoded.size());
+        }
+        if (!file)
+            return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
+
+inline std::string tileFilePath(const std::string& sourcePath)
+{
+    return sourcePath + ".vtex";
+}
+
+// Mapped tile file. Reading a page copies it out of the mapping, which is where the
+// disk read actually happens, so the pager does that on a worker.
+class TileFile
+{
+public:
+    bool open(const std::string& path)
+    {
+        if (!file.open(path) || file.size() < VT_HEADER_BYTES || memcmp(file.data(), "VTEX", 4) != 0
+            || getU32(file.data() + 4) != 1 || getU32(file.data() + 16) != (uint32_t)VT_PAGE_SIZE
+            || getU32(file.data() + 20) != (uint32_t)VT_PAGE_BORDER)
+            return false;
+        if (!layout.build((int)getU32(file.data() + 8), (int)getU32(file.data() + 12)) || file.size() < layout.fileSize())
+            return false;
+        return true;
+    }
+
+    const TileFileLayout& info() const { return layout; }
+
+    void readPage(uint32_t page, unsigned char* out) const
+    {
+        memcpy(out, file.data() + layout.pageOffset(page), VT_PAGE_BYTES);
+    }
+
+private:
+    MappedFile file;
+    TileFileLayout layout;
+};
+
+struct VirtualTextureStats
+{
+    unsigned long long frames = 0;
+    unsigned long long requested = 0;  // distinct pages the feedback asked for, summed over frames
+    unsigned long long hits = 0;       // of those, already resident
+    unsigned long long misses = 0;     // drawn from a coarser ancestor that frame
+    unsigned long long loads = 0;      // pages read from the tile file
+    unsigned long long dropped = 0;    // read but not placed: every slot was in use this frame
+    unsigned long long evictions = 0;
+    unsigned long long bytesRead = 0;
+    double readSeconds = 0.0;          // worker time, summed
+    unsigned int residentPages = 0;
+    unsigned int slots = 0;
+
+    double hitRate() const { return requested > 0 ? (double)hits / requested : 1.0; }
+};
+
+class VirtualTexturePager
+{
+public:
+    // slotsX * slotsY physical pages. With decodeToRGB the workers expand BC1 pages to
+    // RGB8 for drivers without S3TC.
+    VirtualTexturePager(ThreadPool& pool, int slotsX, int slotsY, bool decodeToRGB = false,
+                        int maxReadsInFlight = 32, int maxUploadsPerFrame = 16)
+        : pool(pool), slotsX(slotsX), slotsY(slotsY), decodeToRGB(decodeToRGB),
+          maxReadsInFlight(maxReadsInFlight), maxUploadsPerFrame(maxUploadsPerFrame)
+    {
+        slots.resize((size_t)slotsX * slotsY);
+        pageBytes = decodeToRGB ? (size_t)VT_SLOT_SIZE * VT_SLOT_SIZE * 3 : VT_PAGE_BYTES;
+        buffers.resize((size_t)maxReadsInFlight);
+        for (ReadBuffer& buffer : buffers)
+            buffer.data.resize(std::max(pageBytes, VT_PAGE_BYTES));
+        arrived.reserve(buffers.size());
+        finished.reserve(buffers.size());
+        pageStats.slots = (unsigned int)slots.size();
+    }
+
+    ~VirtualTexturePager() { pool.waitIdle(); }
+
+    VirtualTexturePager(const VirtualTexturePager&) = delete;
+    VirtualTexturePager& operator=(const VirtualTexturePager&) = delete;
+
+    bool open(const std::string& path)
+    {
+        if (!file.open(path))
+            return false;
+        const TileFileLayout& layout = file.info();
+        pageSlot.assign(layout.pageCount, -1);
+        pageUsed.assign(layout.pageCount, 0);
+        pageRequested.assign(layout.pageCount, 0);
+        pageQueued.assign(layout.pageCount, 0);
+        indirectionLevels.resize(layout.levels);
+        for (int level = 0; level < layout.levels; ++level)
+            indirectionLevels[level].assign((size_t)layout.pagesX[level] * layout.pagesY[level] * 4, 0);
+        wanted.reserve(layout.pageCount);
+        // the single page of the last level is always wanted, so every lookup has a fallback
+        rootPage = layout.pageCount - 1;
+        opened = true;
+        return true;
+    }
+
+    bool isOpen() const { return opened; }
+    // the coarsest page is resident, so every lookup resolves to real texels
+    bool ready() const { return opened && pageSlot[rootPage] >= 0; }
+    const TileFileLayout& layout() const { return file.info(); }
+    int slotColumns() const { return slotsX; }
+    int slotRows() const { return slotsY; }
+    size_t slotBytes() const { return pageBytes; }
+    const VirtualTextureStats& stats() const { return pageStats; }
+
+    void beginFrame()
+    {
+        frame++;
+        pageStats.frames++;
+        touch(rootPage);
+    }
+
+    // a page the frame samples (from the feedback pass); repeats within a frame are ignored
+    void requestPage(int level, int x, int y)
+    {
+        const TileFileLayout& layout = file.info();
+        if (level < 0 || level >= layout.levels || x < 0 || y < 0 || x >= layout.pagesX[level] || y >= layout.pagesY[level])
+            return;
+        uint32_t page = layout.pageIndex(level, x, y);
+        if (pageRequested[page] == frame)
+            return;
+        pageRequested[page] = frame;
+        pageStats.requested++;
+        if (pageSlot[page] >= 0)
+            pageStats.hits++;
+        else
+            pageStats.misses++;
+        if (pageUsed[page] == frame)
+            return; // already touched as another page's ancestor, and so were its own
+        touch(page);
+        // the ancestors are what a miss falls back to: keep them from being evicted and
+        // load them too, coarse first
+        for (level++, x /= 2, y /= 2; level < layout.levels; level++, x /= 2, y /= 2)
+        {
+            uint32_t ancestor = layout.pageIndex(level, std::min(x, layout.pagesX[level] - 1), std::min(y, layout.pagesY[level] - 1));
+            if (pageUsed[ancestor] == frame)
+                break;
+            touch(ancestor);
+        }
+    }
+
+    // GL thread, once per frame after the requests: places at most maxUploadsPerFrame
+    // finished pages, handing each to upload(slotX, slotY, data) in texels of the slot
+    // grid, and starts reads for the missing pages, coarsest first.
+    template <typename Upload>
+    void update(Upload&& upload)
+    {
+        if (!opened)
+            return;
+        {
+            std::lock_guard<std::mutex> lock(finishedMutex);
+            arrived.insert(arrived.end(), finished.begin(), finished.end());
+            finished.clear();
+        }
+        int uploads = 0;
+        size_t kept = 0;
+        for (size_t i = 0; i < arrived.size(); ++i)
+        {
+            int buffer = arrived[i];
+            if (uploads == maxUploadsPerFrame)
+            {
+                arrived[kept++] = buffer;
+                continue;
+            }
+            ReadBuffer& read = buffers[buffer];
+            int slot = takeSlot();
+            pageQueued[read.page] = 0;
+            if (slot < 0)
+            {
+                pageStats.dropped++;
+            }
+            else
+            {
+                slots[slot].page = read.page;
+                slots[slot].lastUsed = pageUsed[read.page];
+                pageSlot[read.page] = slot;
+                upload((slot % slotsX) * VT_SLOT_SIZE, (slot / slotsX) * VT_SLOT_SIZE, read.data.data());
+                pageStats.residentPages++;
+                indirectionDirty = true;
+                uploads++;
+            }
+            pageStats.loads++;
+            pageStats.bytesRead += VT_PAGE_BYTES;
+            pageStats.readSeconds += read.seconds;
+            read.busy = false;
+        }
+        arrived.resize(kept);
+
+        // reads for this frame's misses, coarse levels first since finer pages fall back to them
+        std::sort(wanted.begin(), wanted.end(), [](uint32_t a, uint32_t b) { return a > b; });
+        for (uint32_t page : wanted)
+        {
+            if (pageSlot[page] >= 0 || pageQueued[page])
+                continue;
+            int buffer = freeBuffer();
+            if (buffer < 0)
+                break; // the rest are asked for again by next frame's feedback
+            pageQueued[page] = 1;
+            buffers[buffer].busy = true;
+            buffers[buffer].page = page;
+            pool.enqueue([this, buffer] { read(buffer); });
+        }
+        wanted.clear();
+
+        if (indirectionDirty)
+            rebuildIndirection();
+    }
+
+    // Per level, RGBA8 per page: slot column, slot row, level actually resident, 255.
+    // changed() is true when the table was rebuilt since the last call.
+    const std::vector<std::vector<unsigned char>>& indirection() const { return indirectionLevels; }
+    bool takeIndirectionChange()
+    {
+        bool changed = indirectionChanged;
+        indirectionChanged = false;
+        return changed;
+    }
+
+private:
+    struct Slot
+    {
+        int64_t page = -1;
+        uint64_t lastUsed = 0;
+    };
+    struct ReadBuffer
+    {
+        std::vector<unsigned char> data;
+        uint32_t page = 0;
+        double seconds = 0.0;
+        bool busy = false;
+    };
+
+    void touch(uint32_t page)
+    {
+        pageUsed[page] = frame;
+        if (pageSlot[page] >= 0)
+            slots[pageSlot[page]].lastUsed = frame;
+        else if (!pageQueued[page])
+            wanted.push_back(page);
+    }
+
+    // a free slot, else the least recently used one not needed this frame; never the root
+    int takeSlot()
+    {
+        int best = -1;
+        for (int i = 0; i < (int)slots.size(); ++i)
+        {
+            if (slots[i].page < 0)
+                return i;
+            if (slots[i].page == (int64_t)rootPage || slots[i].lastUsed >= frame)
+                continue;
+            if (best < 0 || slots[i].lastUsed < slots[best].lastUsed)
+                best = i;
+        }
+        if (best >= 0)
+        {
+            pageSlot[slots[best].page] = -1;
+            pageStats.evictions++;
+            pageStats.residentPages--;
+        }
+        return best;
+    }
+
+    int freeBuffer() const
+    {
+        for (int i = 0; i < (int)buffers.size(); ++i)
+            if (!buffers[i].busy)
+                return i;
+        return -1;
+    }
+
+    // worker: the disk read (a copy out of the mapping), then the RGB expansion if needed
+    void read(int buffer)
+    {
+        auto start = std::chrono::steady_clock::now();
+        ReadBuffer& target = buffers[buffer];
+        file.readPage(target.page, target.data.data());
+        if (decodeToRGB)
+        {
+            std::vector<unsigned char> rgb = decodeBC1(target.data.data(), VT_SLOT_SIZE, VT_SLOT_SIZE);
+            memcpy(target.data.data(), rgb.data(), rgb.size());
+        }
+        target.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(finishedMutex);
+        finished.push_back(buffer);
+    }
+
+    // coarse to fine: a page's entry is its own slot, or its parent's entry
+    void rebuildIndirection()
+    {
+        const TileFileLayout& layout = file.info();
+        for (int level = layout.levels - 1; level >= 0; --level)
+        {
+            std::vector<unsigned char>& entries = indirectionLevels[level];
+            for (int y = 0; y < layout.pagesY[level]; ++y)
+            {
+                for (int x = 0; x < layout.pagesX[level]; ++x)
+                {
+                    unsigned char* entry = &entries[((size_t)y * layout.pagesX[level] + x) * 4];
+                    int slot = pageSlot[layout.pageIndex(level, x, y)];
+                    if (slot >= 0)
+                    {
+                        entry[0] = (unsigned char)(slot % slotsX);
+                        entry[1] = (unsigned char)(slot / slotsX);
+                        entry[2] = (unsigned char)level;
+                        entry[3] = 255;
+                    }
+                    else if (level + 1 < layout.levels)
+                    {
+                        int parentX = std::min(x / 2, layout.pagesX[level + 1] - 1);
+                        int parentY = std::min(y / 2, layout.pagesY[level + 1] - 1);
+                        memcpy(entry, &indirectionLevels[level + 1][((size_t)parentY * layout.pagesX[level + 1] + parentX) * 4], 4);
+                    }
+                }
+            }
+        }
+        indirectionDirty = false;
+        indirectionChanged = true;
+    }
+
+    ThreadPool& pool;
+    int slotsX;
+    int slotsY;
+    bool decodeToRGB;
+    int maxReadsInFlight;
+    int maxUploadsPerFrame;
+    size_t pageBytes = VT_PAGE_BYTES;
+
+    TileFile file;
+    bool opened = false;
+    uint32_t rootPage = 0;
+    uint64_t frame = 0;
+    std::vector<Slot> slots;
+    std::vector<int32_t> pageSlot;       // per page: its slot, or -1
+    std::vector<uint64_t> pageUsed;      // per page: last frame it or a descendant was requested
+    std::vector<uint64_t> pageRequested; // per page: last frame the feedback asked for it, for the hit rate
+    std::vector<unsigned char> pageQueued; // per page: a read is in flight or waiting for a slot
+    std::vector<uint32_t> wanted;        // this frame's missing pages
+    std::vector<ReadBuffer> buffers;     // one per read in flight; reused, so paging does not allocate
+    std::vector<int> arrived;            // finished reads waiting for an upload
+    std::vector<std::vector<unsigned char>> indirectionLevels;
+    bool indirectionDirty = true;
+    bool indirectionChanged = false;
+    VirtualTextureStats pageStats;
+
+    std::mutex finishedMutex;
+    std::vector<int> finished; // written by workers, drained in update()
+};
@@ -0,0 +1,94 @@
+#version 330 core
+// permutations (program_cache.h), defaults are the generic program:
+//   HAS_SPECULAR_MAP 0: the specular map is the paged diffuse map itself (sun, moon)
+#ifndef HAS_SPECULAR_MAP
+#define HAS_SPECULAR_MAP 1
+#endif
+
+struct Material {
+    sampler2D diffuse;
+    sampler2D specular;
+    float shininess;
+};
+
+struct PointLight {
+    vec3 position;
+    vec3 ambient;
+    vec3 diffuse;
+    vec3 specular;
+    float constant;
+    float linear;
+    float quadratic;
+};
+
+in vec3 FragPos;
+in vec3 Normal;
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform vec3 viewPos;
+uniform Material material;         // diffuse is the page cache (virtual_texture.h)
+uniform PointLight pointLights[1];
+
+uniform sampler2D vtIndirection;   // per page and level: slot column, slot row, level resident there
+uniform vec2 vtVirtualSize;        // level 0 of the map, in texels
+uniform float vtMaxLevel;
+uniform vec2 vtPhysicalSize;       // page cache, in texels
+
+const float VT_PAGE_SIZE = 128.0;
+const float VT_PAGE_BORDER = 4.0;
+const float VT_SLOT_SIZE = 136.0;
+
+// Bilinear sample of the virtual map at the nearest mip level. The indirection entry
+// names the slot of the page, or of its nearest resident ancestor, and which level
+// that is; the texel is then found inside that page.
+vec3 sampleVirtual(vec2 uv)
+{
+    vec2 texels = uv * vtVirtualSize;
+    float lod = log2(max(length(dFdx(texels)), length(dFdy(texels))));
+    float level = clamp(floor(lod + 0.5), 0.0, vtMaxLevel);
+    uv = vec2(fract(uv.x), clamp(uv.y, 0.0, 0.99999));
+    vec3 entry = textureLod(vtIndirection, uv, level).xyz * 255.0;
+    vec2 pages = vtVirtualSize / (VT_PAGE_SIZE * exp2(entry.z)); // pages across the map at the resident level
+    vec2 inPage = fract(uv * pages);
+    vec2 physical = (entry.xy * VT_SLOT_SIZE + VT_PAGE_BORDER + inPage * VT_PAGE_SIZE) / vtPhysicalSize;
+    return textureLod(material.diffuse, physical, 0.0).rgb;
+}
+
+void main()
+{
+    vec3 norm = normalize(Normal);
+    vec3 lightDir = normalize(pointLights[0].position - FragPos);
+
+    // Diffuse shading
+    float diff = max(dot(norm, lightDir), 0.0);
+    vec3 diffuseTex = sampleVirtual(TexCoords);
+    vec3 diffuse = pointLights[0].diffuse * diff * diffuseTex;
+
+    // Ambient
+    vec3 ambient = pointLights[0].ambient * diffuseTex;
+
+    // Specular
+    vec3 viewDir = normalize(viewPos - FragPos);
+    vec3 reflectDir = reflect(-lightDir, norm);
+    float spec = pow(max(dot(viewDir, reflectDir), 0.0), material.shininess);
+#if HAS_SPECULAR_MAP
+    vec3 specularTex = texture(material.specular, TexCoords).rgb;
+#else
+    vec3 specularTex = diffuseTex;
+#endif
+    vec3 specular = pointLights[0].specular * spec * specularTex;
+
+    // Attenuation
+    float distance = length(pointLights[0].position - FragPos);
+    float attenuation = 1.0 / (pointLights[0].constant + pointLights[0].linear * distance +
+                               pointLights[0].quadratic * (distance * distance));
+
+    ambient *= attenuation;
+    diffuse *= attenuation;
+    specular *= attenuation;
+
+    vec3 result = ambient + diffuse + specular;
+    FragColor = vec4(result, 1.0);
+}
@@ -0,0 +1,496 @@
+// virtual_texture.h
+// Sparse virtual texturing, GL side; the tile file and the paging are in tile_file.h.
+//  - page cache: one texture holding a grid of slot-sized pages, BC1 when the driver
+//    has S3TC
+//  - indirection texture: RGBA8, one texel per page and one mip per page level,
+//    sampled at the level a fragment wants; it names the slot to read and the level
+//    that slot really holds (virtual_texture.fs)
+//  - feedback pass: the virtually textured bodies are drawn again at 1/feedbackDivisor
+//    of the screen with vt_feedback.fs, which writes the page each pixel wants; the
+//    image comes back through pixel buffers a frame or two later and becomes page
+//    requests, so the GL thread never waits on the GPU or on the disk
+// A tile file that is missing or older than its source is built on the worker pool
+// first. Until the coarsest page is resident ready() is false and the body keeps its
+// plain texture.
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "../common/program_cache.h"
+#include "tile_file.h"
+#include "texture_manager.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+const int VT_INDIRECTION_UNIT = 2; // the render queue only binds units 0 and 1; each paged map takes one unit from here
+
+// decode, round the sides up to powers of two, write the tile file
+inline bool buildTileFile(const std::string& sourcePath, const std::string& tilePath, ThreadPool* pool = nullptr)
+{
+    DecodedImage image = decodeImage(sourcePath);
+    if (!image.pixels || image.components < 3)
+    {
+        stbi_image_free(image.pixels);
+        return false;
+    }
+    ImageLevel level;
+    level.width = nextPowerOfTwo(image.width);
+    level.height = nextPowerOfTwo(image.height);
+    if (level.width == image.width && level.height == image.height)
+        level.pixels.assign(image.pixels, image.pixels + image.byteSize());
+    else
+        level.pixels = resampleImage(image.pixels, image.width, image.height, image.components, level.width, level.height);
+    int components = image.components;
+    stbi_image_free(image.pixels);
+    return writeTileFile(tilePath, std::move(level), components, pool);
+}
+
+class VirtualTexture
+{
+public:
+    // maps drawn in the same frame need their own indirectionUnit: the render queue draws
+    // them later, each with the indirection texture bound when it was submitted
+    VirtualTexture(ThreadPool& pool, int indirectionUnit = VT_INDIRECTION_UNIT, int slotsPerSide = 16, int feedbackDivisor = 8)
+        : pool(pool), indirectionUnit(indirectionUnit), slotsPerSide(slotsPerSide), feedbackDivisor(feedbackDivisor)
+    {
+        GLint extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for (GLint i = 0; i < extensionCount; ++i)
+            if (strcmp((const char*)glGetStringi(GL_EXTENSIONS, (GLuint)i), "GL_EXT_texture_compression_s3tc") == 0)
+                s3tcSupported = true;
+    }
+
+    // the build job and the page reads point at this object; GL objects are left to the context teardown
+    ~VirtualTexture() { pool.waitIdle(); }
+
+    VirtualTexture(const VirtualTexture&) = delete;
+    VirtualTexture& operator=(const VirtualTexture&) = delete;
+
+    // starts using the map at sourcePath, building its tile file on the pool if needed
+    void load(const std::string& sourcePath)
+    {
+        tilePath = tileFilePath(sourcePath);
+        if (textureCacheIsFresh(sourcePath, tilePath))
+        {
+            buildState = BUILT;
+            return;
+        }
+        buildState = BUILDING;
+        pool.enqueue([this, sourcePath] {
+            auto start = std::chrono::steady_clock::now();
+            bool built = buildTileFile(sourcePath, tilePath);
+            buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            buildState = built ? BUILT : FAILED;
+        });
+    }
+
+    bool ready() const { return pager && pager->ready(); }
+    GLuint pageTexture() const { return pages; }
+    const VirtualTextureStats& stats() const { return pager ? pager->stats() : emptyStats; }
+
+    // call once per frame on the GL thread before drawing: opens the tile file once it
+    // exists, turns returned feedback into requests and places arrived pages
+    void update()
+    {
+        if (!pager)
+        {
+            if (buildState == BUILT)
+                open();
+            else if (buildState == FAILED)
+            {
+                std::cout << "Virtual texture: could not build " << tilePath << std::endl;
+                buildState = REPORTED;
+            }
+            if (!pager)
+                return;
+        }
+        pager->beginFrame();
+        readFeedback();
+
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glBindTexture(GL_TEXTURE_2D, pages);
+        pager->update([this](int x, int y, const unsigned char* data) {
+            if (s3tcSupported)
+                glCompressedTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VT_SLOT_SIZE, VT_SLOT_SIZE, GL_COMPRESSED_RGB_S3TC_DXT1_EXT,
+                                          (GLsizei)VT_PAGE_BYTES, data);
+            else
+                glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, VT_SLOT_SIZE, VT_SLOT_SIZE, GL_RGB, GL_UNSIGNED_BYTE, data);
+        });
+        if (pager->takeIndirectionChange())
+        {
+            glBindTexture(GL_TEXTURE_2D, indirection);
+            const TileFileLayout& layout = pager->layout();
+            for (int level = 0; level < layout.levels; ++level)
+                glTexSubImage2D(GL_TEXTURE_2D, level, 0, 0, layout.pagesX[level], layout.pagesY[level], GL_RGBA, GL_UNSIGNED_BYTE,
+                                pager->indirection()[level].data());
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    }
+
+    // Redirects drawing into the feedback target (cleared: alpha 0 = no request) for a
+    // screen of the given size; draw the virtually textured bodies with vt_feedback.fs,
+    // then call endFeedback().
+    void beginFeedback(int screenWidth, int screenHeight)
+    {
+        glGetIntegerv(GL_VIEWPORT, savedViewport);
+        int width = std::max(1, screenWidth / feedbackDivisor), height = std::max(1, screenHeight / feedbackDivisor);
+        if (width != feedbackWidth || height != feedbackHeight)
+            createFeedbackTarget(width, height);
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+        glViewport(0, 0, feedbackWidth, feedbackHeight);
+        glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // queues the asynchronous read of the feedback image and restores the screen
+    void endFeedback()
+    {
+        Readback& readback = readbacks[nextReadback];
+        if (readback.pending)
+        {
+            skippedFeedback++; // both buffers still in flight; this frame's requests are skipped
+        }
+        else
+        {
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            glReadPixels(0, 0, feedbackWidth, feedbackHeight, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            readback.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            readback.pending = true;
+            nextReadback = (nextReadback + 1) % 2;
+        }
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+    }
+
+    // uniforms of virtual_texture.fs and vt_feedback.fs; the indirection texture is bound here too
+    void setUniforms(const CachedShader& shader) const
+    {
+        if (!pager)
+            return;
+        const TileFileLayout& layout = pager->layout();
+        shader.use();
+        shader.setVec2("vtVirtualSize", (float)layout.width, (float)layout.height);
+        shader.setFloat("vtMaxLevel", (float)(layout.levels - 1));
+        shader.setVec2("vtPhysicalSize", (float)(slotsPerSide * VT_SLOT_SIZE), (float)(slotsPerSide * VT_SLOT_SIZE));
+        shader.setFloat("vtFeedbackBias", std::log2((float)feedbackDivisor));
+        shader.setInt("vtIndirection", indirectionUnit);
+        glActiveTexture(GL_TEXTURE0 + indirectionUnit);
+        glBindTexture(GL_TEXTURE_2D, indirection);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    // GPU memory of the page cache and indirection, against the whole map resident
+    size_t residentBytes() const { return physicalBytes + indirectionBytes; }
+    size_t fullMapBytes() const { return pager ? pager->layout().fileSize() - VT_HEADER_BYTES : 0; }
+    unsigned long long skippedFeedbackFrames() const { return skippedFeedback; }
+    double tileBuildSeconds() const { return buildSeconds; }
+
+private:
+    enum BuildState { NONE, BUILDING, BUILT, FAILED, REPORTED };
+
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+        bool pending = false;
+    };
+
+    void open()
+    {
+        std::unique_ptr<VirtualTexturePager> opened(new VirtualTexturePager(pool, slotsPerSide, slotsPerSide, !s3tcSupported));
+        if (!opened->open(tilePath))
+        {
+            std::cout << "Virtual texture: could not open " << tilePath << std::endl;
+            buildState = REPORTED;
+            return;
+        }
+        pager = std::move(opened);
+        const TileFileLayout& layout = pager->layout();
+
+        int physicalSize = slotsPerSide * VT_SLOT_SIZE;
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+        glGenTextures(1, &pages);
+        glBindTexture(GL_TEXTURE_2D, pages);
+        if (s3tcSupported)
+        {
+            physicalBytes = bc1LevelSize(physicalSize, physicalSize);
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, GL_COMPRESSED_RGB_S3TC_DXT1_EXT, physicalSize, physicalSize, 0,
+                                   (GLsizei)physicalBytes, nullptr);
+        }
+        else
+        {
+            physicalBytes = (size_t)physicalSize * physicalSize * 4; // drivers pad RGB8 to RGBA8
+            glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, physicalSize, physicalSize, 0, GL_RGB, GL_UNSIGNED_BYTE, nullptr);
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        // the page grid halves per level exactly like a mip chain, so each page level is a mip
+        glGenTextures(1, &indirection);
+        glBindTexture(GL_TEXTURE_2D, indirection);
+        for (int level = 0; level < layout.levels; ++level)
+        {
+            glTexImage2D(GL_TEXTURE_2D, level, GL_RGBA8, layout.pagesX[level], layout.pagesY[level], 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+            indirectionBytes += (size_t)layout.pagesX[level] * layout.pagesY[level] * 4;
+        }
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, layout.levels - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::cout << "Virtual texture: " << tilePath << ", " << layout.width << "x" << layout.height << ", " << layout.levels
+                  << " levels, " << layout.pageCount << " pages (" << fullMapBytes() / (1024.0 * 1024.0) << " MB), page cache "
+                  << slotsPerSide * slotsPerSide << " slots (" << residentBytes() / (1024.0 * 1024.0) << " MB)" << std::endl;
+    }
+
+    void createFeedbackTarget(int width, int height)
+    {
+        if (feedbackFramebuffer == 0)
+        {
+            glGenFramebuffers(1, &feedbackFramebuffer);
+            glGenRenderbuffers(1, &feedbackColor);
+            glGenRenderbuffers(1, &feedbackDepth);
+            for (Readback& readback : readbacks)
+                glGenBuffers(1, &readback.buffer);
+        }
+        feedbackWidth = width;
+        feedbackHeight = height;
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackColor);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, feedbackDepth);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+        glBindRenderbuffer(GL_RENDERBUFFER, 0);
+        glBindFramebuffer(GL_FRAMEBUFFER, feedbackFramebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, feedbackColor);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, feedbackDepth);
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        for (Readback& readback : readbacks)
+        {
+            if (readback.fence)
+                glDeleteSync(readback.fence);
+            readback.fence = 0;
+            readback.pending = false;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)width * height * 4, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    }
+
+    // oldest first; never blocks: a readback the GPU has not finished waits for next frame
+    void readFeedback()
+    {
+        for (int i = 0; i < 2; ++i)
+        {
+            Readback& readback = readbacks[(nextReadback + i) % 2];
+            if (!readback.pending)
+                continue;
+            if (glClientWaitSync(readback.fence, 0, 0) == GL_TIMEOUT_EXPIRED)
+                break;
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+            readback.pending = false;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            size_t bytes = (size_t)feedbackWidth * feedbackHeight * 4;
+            const unsigned char* texels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)bytes, GL_MAP_READ_BIT);
+            if (texels != nullptr)
+            {
+                // r, g: page column and row; b: level; a: 255 where a body was drawn
+                for (size_t t = 0; t < bytes; t += 4)
+                    if (texels[t + 3] != 0)
+                        pager->requestPage(texels[t + 2], texels[t], texels[t + 1]);
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        }
+    }
+
+    ThreadPool& pool;
+    int indirectionUnit;
+    int slotsPerSide;
+    int feedbackDivisor;
+    bool s3tcSupported = false;
+    std::string tilePath;
+    std::atomic<int> buildState { NONE };
+    std::atomic<double> buildSeconds { 0.0 };
+    std::unique_ptr<VirtualTexturePager> pager;
+    VirtualTextureStats emptyStats;
+
+    GLuint pages = 0;
+    GLuint indirection = 0;
+    size_t physicalBytes = 0;
+    size_t indirectionBytes = 0;
+
+    GLuint feedbackFramebuffer = 0;
+    GLuint feedbackColor = 0;
+    GLuint feedbackDepth = 0;
+    int feedbackWidth = 0;
+    int feedbackHeight = 0;
+    GLint savedViewport[4] = {};
+    Readback readbacks[2];
+    int nextReadback = 0;
+    unsigned long long skippedFeedback = 0;
+};
+
+// CPU stand-in for vt_feedback.fs, for the benchmark: ray-casts a planet of the given
+// radius at the origin, with the UV sphere's mapping in its rotated frame, from `eye`
+// looking at it, and requests the page every feedback pixel would.
+inline void emulateFeedback(VirtualTexturePager& pager, glm::vec3 eye, const glm::mat3& planetRotation, float planetRadius,
+                            int screenWidth, int screenHeight, float fovyRadians, int feedbackDivisor)
+{
+    const TileFileLayout& layout = pager.layout();
+    glm::vec3 forward = glm::normalize(-eye);
+    glm::vec3 right = glm::normalize(glm::cross(forward, glm::vec3(0.0f, 1.0f, 0.0f)));
+    glm::vec3 up = glm::cross(right, forward);
+    float pixelScale = 2.0f * std::tan(fovyRadians * 0.5f) / screenHeight; // view-plane units per screen pixel
+    glm::mat3 toLocal = glm::transpose(planetRotation);
+
+    // uv of the surface under a screen position, false when the ray misses
+    auto surfaceUV = [&](float px, float py, glm::vec2& uv) {
+        glm::vec3 dir = glm::normalize(forward + right * ((px - screenWidth * 0.5f) * pixelScale) + up * ((py - screenHeight * 0.5f) * pixelScale));
+        float along = glm::dot(dir, -eye);
+        glm::vec3 closest = -eye - dir * along;
+        float missSquared = glm::dot(closest, closest);
+        if (missSquared > planetRadius * planetRadius)
+            return false;
+        glm::vec3 local = toLocal * ((eye + dir * (along - std::sqrt(planetRadius * planetRadius - missSquared))) / planetRadius);
+        uv.x = std::atan2(local.y, local.x) / glm::two_pi<float>();
+        uv.x -= std::floor(uv.x);
+        uv.y = std::acos(std::clamp(local.z, -1.0f, 1.0f)) / glm::pi<float>();
+        return true;
+    };
+    auto wrappedDelta = [](glm::vec2 d) {
+        d.x -= std::round(d.x);
+        return d;
+    };
+
+    glm::vec2 size((float)layout.width, (float)layout.height);
+    for (int y = 0; y < screenHeight / feedbackDivisor; ++y)
+    {
+        for (int x = 0; x < screenWidth / feedbackDivisor; ++x)
+        {
+            float px = (x + 0.5f) * feedbackDivisor, py = (y + 0.5f) * feedbackDivisor;
+            glm::vec2 uv, uvX, uvY;
+            if (!surfaceUV(px, py, uv))
+                continue;
+            // screen-pixel derivatives, as dFdx/dFdy at full resolution would give
+            glm::vec2 dx = surfaceUV(px + 1.0f, py, uvX) ? wrappedDelta(uvX - uv) : glm::vec2(0.0f);
+            glm::vec2 dy = surfaceUV(px, py + 1.0f, uvY) ? wrappedDelta(uvY - uv) : glm::vec2(0.0f);
+            float lod = std::log2(std::max(std::max(glm::length(dx * size), glm::length(dy * size)), 1e-6f));
+            int level = std::clamp((int)std::floor(lod + 0.5f), 0, layout.levels - 1);
+            float pageTexels = (float)(VT_PAGE_SIZE << level);
+            int pageX = std::min((int)(uv.x * size.x / pageTexels), layout.pagesX[level] - 1);
+            int pageY = std::min((int)(std::min(uv.y, 0.99999f) * size.y / pageTexels), layout.pagesY[level] - 1);
+            pager.requestPage(level, pageX, pageY);
+        }
+    }
+}
+
+// Headless: blows the source map up to size x size/2 (with some noise, so pages differ),
+// writes its tile file to the temp directory and flies a camera from far away down to
+// just above the spinning planet at 60 frames per second, paging with the CPU feedback.
+// Reports page hit rate, reads and resident memory against the whole map.
+inline int runVirtualTextureBenchmark(const std::string& sourcePath, int size, int slotsPerSide = 16)
+{
+    typedef std::chrono::steady_clock Clock;
+    const double MB = 1024.0 * 1024.0;
+    size = nextPowerOfTwo(std::max(size, 2 * VT_PAGE_SIZE));
+    DecodedImage source = decodeImage(sourcePath);
+    if (!source.pixels || source.components < 3)
+    {
+        std::cout << "Texture failed to load at path: " << sourcePath << std::endl;
+        stbi_image_free(source.pixels);
+        return 1;
+    }
+    ThreadPool pool;
+    auto start = Clock::now();
+    ImageLevel map;
+    map.width = size;
+    map.height = size / 2;
+    map.pixels = resampleImage(source.pixels, source.width, source.height, source.components, map.width, map.height);
+    int components = source.components;
+    stbi_image_free(source.pixels);
+    std::mt19937 generator(11);
+    std::uniform_int_distribution<int> noise(-8, 8);
+    for (unsigned char& value : map.pixels)
+        value = (unsigned char)std::clamp(value + noise(generator), 0, 255);
+    double synthesizeSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::string tilePath = (std::filesystem::temp_directory_path() / "vt_benchmark.vtex").string();
+    start = Clock::now();
+    bool written = writeTileFile(tilePath, std::move(map), components, &pool);
+    double buildSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+    VirtualTexturePager pager(pool, slotsPerSide, slotsPerSide);
+    if (!written || !pager.open(tilePath))
+    {
+        std::cout << "Virtual texture: could not write " << tilePath << std::endl;
+        return 1;
+    }
+    const TileFileLayout& layout = pager.layout();
+    size_t slotBytes = bc1LevelSize(slotsPerSide * VT_SLOT_SIZE, slotsPerSide * VT_SLOT_SIZE);
+    std::cout << "Virtual texture benchmark: " << layout.width << "x" << layout.height << " map, " << layout.levels << " levels, "
+              << layout.pageCount << " pages; synthesized in " << synthesizeSeconds << " s, tile file written in " << buildSeconds
+              << " s (" << layout.fileSize() / MB << " MB BC1; " << layout.width * (double)layout.height * 4.0 * 4.0 / 3.0 / MB
+              << " MB as RGBA8 with mips)" << std::endl;
+    std::cout << "  page cache " << slotsPerSide * slotsPerSide << " slots, " << slotBytes / MB << " MB; feedback 128x90 of 1024x720, "
+              << pool.size() << " read threads" << std::endl;
+
+    const int frames = 600;
+    const double frameSeconds = 1.0 / 60.0;
+    const float fovy = glm::radians(45.0f);
+    VirtualTextureStats last;
+    auto next = Clock::now();
+    for (int frame = 0; frame < frames; ++frame)
+    {
+        // approach from 12 radii to 1.15 over the first half, then skim the surface
+        float t = (float)frame / frames;
+        float distance = t < 0.5f ? 12.0f * std::pow(1.15f / 12.0f, t * 2.0f) : 1.15f;
+        float orbit = t * 2.0f;
+        glm::vec3 eye(distance * std::sin(orbit), 0.3f * distance * std::sin(t * 5.0f), distance * std::cos(orbit));
+        float spin = frame * (float)frameSeconds * 0.3f;
+        glm::mat3 rotation = glm::mat3(glm::rotate(glm::rotate(glm::mat4(1.0f), glm::radians(23.5f), glm::vec3(0.0f, 0.0f, 1.0f)),
+                                                   spin, glm::vec3(0.0f, 1.0f, 0.0f)));
+
+        pager.beginFrame();
+        emulateFeedback(pager, eye, rotation, 1.0f, 1024, 720, fovy, 8);
+        pager.update([](int, int, const unsigned char*) {});
+
+        if ((frame + 1) % 60 == 0)
+        {
+            const VirtualTextureStats& stats = pager.stats();
+            unsigned long long requested = stats.requested - last.requested;
+            std::cout << "  t=" << (frame + 1) / 60 << "s distance " << distance << ": " << requested / 60 << " pages/frame, hit rate "
+                      << 100.0 * (stats.hits - last.hits) / std::max(1ull, requested) << "%, " << stats.loads - last.loads
+                      << " read, " << stats.evictions - last.evictions << " evicted, " << stats.residentPages << "/" << stats.slots
+                      << " slots" << std::endl;
+            last = stats;
+        }
+        next += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(frameSeconds));
+        std::this_thread::sleep_until(next);
+    }
+    const VirtualTextureStats& stats = pager.stats();
+    std::cout << "  total: hit rate " << 100.0 * stats.hitRate() << "%, " << stats.loads << " pages read ("
+              << stats.bytesRead / MB << " MB of " << layout.fileSize() / MB << "), " << stats.evictions << " evicted, "
+              << stats.dropped << " dropped, read time " << stats.readSeconds * 1000.0 / std::max(1ull, stats.loads)
+              << " ms/page" << std::endl;
+    std::error_code error;
+    std::filesystem::remove(tilePath, error);
+    return 0;
+}
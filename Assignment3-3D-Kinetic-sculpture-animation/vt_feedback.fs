@@ -0,0 +1,24 @@
+#version 330 core
+// Feedback pass of the virtual texture: writes the page every pixel of the body would
+// sample, for virtual_texture.h to read back. Drawn at 1/feedbackDivisor of the screen,
+// so the level is biased back to what the full-size pixel wants.
+in vec2 TexCoords;
+
+out vec4 FragColor;
+
+uniform vec2 vtVirtualSize;
+uniform float vtMaxLevel;
+uniform float vtFeedbackBias; // log2 of the feedback divisor
+
+const float VT_PAGE_SIZE = 128.0;
+
+void main()
+{
+    vec2 texels = TexCoords * vtVirtualSize;
+    float lod = log2(max(length(dFdx(texels)), length(dFdy(texels)))) - vtFeedbackBias;
+    float level = clamp(floor(lod + 0.5), 0.0, vtMaxLevel);
+    vec2 uv = vec2(fract(TexCoords.x), clamp(TexCoords.y, 0.0, 0.99999));
+    vec2 page = floor(uv * vtVirtualSize / (VT_PAGE_SIZE * exp2(level)));
+    // r, g: page column and row (up to 255); b: level; a: 255 marks a request
+    FragColor = vec4(page, level, 255.0) / 255.0;
+}
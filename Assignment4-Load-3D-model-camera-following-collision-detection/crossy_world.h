@@ -0,0 +1,494 @@
+// crossy_world.h
+// Game state and rules of the crossing game, without any GL or GLFW: the
+// player, cars, trees, endless rows and the follow camera. Everything is
+// advanced by tick() on the simulation thread; the renderer only ever sees
+// copies of it (see game_pipeline.h). Every road row is one lane of the
+// car-following model (traffic_model.h); tick() steps the lanes up to the spawn
+// horizon by the road time that passed (RoadClock) and sweeps the player's lane
+// for hits, so a fast car cannot jump over the duck between two ticks.
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include "../common/object_pool.h"
+#include "traffic_model.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Game constants
+const float MOVE_DISTANCE = 2.0f;
+const float CAR_SPEED = 10.0f;
+const int GRID_WIDTH = 11;
+const int VISIBLE_ROWS = 15;
+// Rows this far behind the camera can never be seen or reached again (the player is
+// kept in front of the camera), so their cars and trees go back to the pools
+const float RECYCLE_DISTANCE = 12.0f;
+const size_t MAX_CARS = 512;
+const size_t MAX_TREES = 256;
+const float ROAD_HALF_LENGTH = GRID_WIDTH * MOVE_DISTANCE + 20; // cars wrap around at +-this x
+const float COLLISION_DISTANCE = 1.0f; // a car this close to the duck's centre hits it
+const int MAX_ROAD_LANES = 4;          // a road is 1-4 adjacent rows, one lane each
+
+// Input actions, as a bit mask of keys pressed since the last tick
+const uint8_t INPUT_FORWARD = 1 << 0;
+const uint8_t INPUT_BACK = 1 << 1;
+const uint8_t INPUT_LEFT = 1 << 2;
+const uint8_t INPUT_RIGHT = 1 << 3;
+const uint8_t INPUT_RESET = 1 << 4;
+
+// A car's place in the world; where it is on the road is its row's traffic lane's business
+struct Car {
+    float z;
+    int lane;
+    bool movingRight;
+    int rowIndex; // Track which row this car belongs to
+    int slot;     // index into its row's TrafficLane
+};
+
+// x of ring position `at` of a lane: cars enter at one road end and wrap at the other
+inline float laneX(bool movingRight, float at) {
+    return movingRight ? at - ROAD_HALF_LENGTH : ROAD_HALF_LENGTH - at;
+}
+
+// Road time: simulation time scaled by gameSpeed. The speed only changes on the ticks
+// where it is set, so road time is piecewise linear in the tick number and every tick's
+// value is computed directly rather than summed up tick by tick. Only the current and
+// the previous segment are kept, enough for the current and the previous tick.
+class RoadClock {
+public:
+    void reset(long long tick, float speed) {
+        segmentCount = 1;
+        segments[0] = { tick, 0.0, speed };
+    }
+
+    // the fixed tick length; set before the first query
+    void setStep(double seconds) { step = seconds; }
+
+    // gameSpeed from `tick` on
+    void setSpeed(long long tick, float speed) {
+        Segment& last = segments[segmentCount - 1];
+        if (last.speed == speed)
+            return;
+        Segment next = { tick, at(tick), speed };
+        if (last.tick == tick)
+            last = next;
+        else if (segmentCount < 2)
+            segments[segmentCount++] = next;
+        else {
+            segments[0] = last;
+            segments[1] = next;
+        }
+    }
+
+    // road time at the end of `tick`; ticks before the previous segment extrapolate it
+    double at(long long tick) const {
+        const Segment& segment = segmentCount == 2 && tick < segments[1].tick ? segments[0] : segments[segmentCount - 1];
+        return segment.time + segment.speed * (double)(tick - segment.tick) * step;
+    }
+
+private:
+    struct Segment {
+        long long tick;
+        double time;
+        float speed;
+    };
+
+    Segment segments[2] = {};
+    int segmentCount = 1;
+    double step = 1.0 / 60.0;
+};
+
+struct Tree {
+    glm::vec3 position;
+};
+
+// Follow camera pose; turned into a learnopengl Camera at render time
+struct FollowCamera {
+    glm::vec3 position;
+    float yaw;
+    float pitch;
+};
+
+class CrossyWorld {
+public:
+    glm::vec3 playerPosition = glm::vec3(0.0f, 0.0f, -10.0f);
+    float playerRotation = 0.0f; // Duck rotation angle - start facing forward (0 degrees)
+    ObjectPool<Car> cars = ObjectPool<Car>(MAX_CARS); // sorted by rowIndex, then slot
+    ObjectPool<Tree> trees = ObjectPool<Tree>(MAX_TREES);
+    std::vector<int> roadRows; // stores which rows are roads (1) vs grass/safe (0), from firstRoadRow on
+    int firstRoadRow = 0;      // rows before this one have been recycled
+    int playerScore = 0;
+    bool gameOver = false;
+    float gameSpeed = 1.0f;
+    RoadClock roadClock;
+    int furthestRow = 0;
+    int roadLanesLeft = 0;   // rows still to come of the road being spawned
+    int roadLaneCount = 0;
+    bool roadFlowsRight = false;
+    TrafficSettings traffic;
+    TrafficModel lanes = TrafficModel(traffic); // one per road row, in row order
+    std::vector<int> laneRows;                  // the row of each lane
+    std::default_random_engine generator;
+    std::uniform_real_distribution<float> distribution = std::uniform_real_distribution<float>(0.0f, 1.0f);
+
+    FollowCamera camera;
+    FollowCamera previousCamera; // camera at the previous tick, for interpolated rendering
+    long long ticks = 0;
+    int64_t lastInputMicros = 0; // time stamp of the newest key press applied
+
+    CrossyWorld() {
+        reset();
+    }
+
+    void reset() {
+        playerPosition = glm::vec3(0.0f, 0.0f, -10.0f);
+        playerRotation = 0.0f; // Reset duck rotation to face forward (0 degrees)
+        cars.clear();
+        trees.clear();
+        roadRows.clear();
+        lanes.clear();
+        laneRows.clear();
+        firstRoadRow = 0;
+        playerScore = 0;
+        gameOver = false;
+        gameSpeed = 1.0f;
+        roadClock.reset(ticks, gameSpeed);
+        furthestRow = 0;
+        roadLanesLeft = 0;
+
+        // Reset camera position to match the new player position
+        camera.position = glm::vec3(playerPosition.x, playerPosition.y + 10.0f, playerPosition.z - 6.0f);
+        camera.yaw = 90.0f;   // Face forward
+        camera.pitch = -30.0f; // Look down at the duck
+        previousCamera = camera;
+
+        // Initialize the game world with more rows for endless gameplay
+        for (int row = 0; row < VISIBLE_ROWS * 2; ++row) {
+            spawnNewRow();
+        }
+
+        std::cout << "Crossy Road Started! Use WASD to move, R to restart" << std::endl;
+    }
+
+    // Apply the keys pressed since the last tick; one move per key press
+    void applyInput(uint8_t pressed, int64_t pressMicros) {
+        if (pressed == 0)
+            return;
+        lastInputMicros = pressMicros;
+
+        if (!gameOver) {
+            if (pressed & INPUT_FORWARD) {
+                // Allow forward, but keep the player ahead of the camera (never behind)
+                float minZ = camera.position.z + 2.0f;
+                float nextZ = playerPosition.z + MOVE_DISTANCE;
+                glm::vec3 newPos = glm::vec3(playerPosition.x, playerPosition.y, nextZ);
+                if (nextZ >= minZ && canMoveTo(newPos)) {
+                    playerPosition.z = nextZ; // Move forward
+                    playerRotation = 0.0f; // Face forward (0 degrees)
+                }
+            }
+
+            if (pressed & INPUT_BACK) {
+                // Constrain moving backward: do not allow player to go behind camera's forward edge
+                float minZ = camera.position.z + 2.0f; // small margin in front of camera
+                glm::vec3 newPos = glm::vec3(playerPosition.x, playerPosition.y, playerPosition.z - MOVE_DISTANCE);
+                if (playerPosition.z - MOVE_DISTANCE >= minZ && canMoveTo(newPos)) {
+                    playerPosition.z -= MOVE_DISTANCE; // Move backward within camera bounds
+                    playerRotation = 180.0f; // Face backward (180 degrees)
+                }
+            }
+
+            if (pressed & INPUT_LEFT) {
+                // Constrain left movement: keep player inside camera horizontal frustum
+                float halfViewWidth = 8.0f; // tune to your FOV and distance
+                float minX = camera.position.x - halfViewWidth;
+                glm::vec3 newPos = glm::vec3(playerPosition.x - MOVE_DISTANCE, playerPosition.y, playerPosition.z);
+                if (playerPosition.x - MOVE_DISTANCE >= minX && playerPosition.x > -GRID_WIDTH * MOVE_DISTANCE && canMoveTo(newPos)) {
+                    playerPosition.x += MOVE_DISTANCE; // Move left
+                    playerRotation = 90.0f; // Face left (-90 degrees)
+                }
+            }
+
+            if (pressed & INPUT_RIGHT) {
+                // Constrain right movement: keep player inside camera horizontal frustum
+                float halfViewWidth = 8.0f; // tune to your FOV and distance
+                float maxX = camera.position.x + halfViewWidth;
+                glm::vec3 newPos = glm::vec3(playerPosition.x + MOVE_DISTANCE, playerPosition.y, playerPosition.z);
+                if (playerPosition.x + MOVE_DISTANCE <= maxX && playerPosition.x < GRID_WIDTH * MOVE_DISTANCE && canMoveTo(newPos)) {
+                    playerPosition.x -= MOVE_DISTANCE; // Move right
+                    playerRotation = -90.0f; // Face right (90 degrees)
+                }
+            }
+        }
+
+        // Reset game
+        if (pressed & INPUT_RESET) {
+            reset();
+        }
+    }
+
+    // One fixed simulation step
+    void tick(float deltaTime) {
+        roadClock.setStep(deltaTime);
+        stepTraffic();
+        if (!gameOver) {
+            checkCollisions();
+            if (gameOver)
+                roadClock.setSpeed(ticks + 1, 0.0f); // traffic stops where it hit
+
+            // Check if player moved forward
+            int currentRow = (int)((playerPosition.z + 10.0f) / MOVE_DISTANCE);
+            if (currentRow > furthestRow) {
+                furthestRow = currentRow;
+                playerScore = furthestRow;
+                gameSpeed += 0.01f; // Gradually increase difficulty
+                roadClock.setSpeed(ticks + 1, gameSpeed);
+            }
+
+            // Continuously spawn new rows to create endless gameplay
+            while (currentRow + VISIBLE_ROWS >= rowCount()) {
+                spawnNewRow();
+            }
+        }
+
+        updateCamera(deltaTime);
+        recycleRowsBehind(camera.position.z - RECYCLE_DISTANCE);
+        ticks++;
+    }
+
+    // rows spawned so far, recycled ones included
+    int rowCount() const {
+        return firstRoadRow + (int)roadRows.size();
+    }
+
+    bool isRoadRow(int row) const {
+        int i = row - firstRoadRow;
+        return i >= 0 && i < (int)roadRows.size() && roadRows[i] == 1;
+    }
+
+    // index into lanes of a road row's lane, -1 if the row has none
+    int laneIndex(int row) const {
+        auto lane = std::lower_bound(laneRows.begin(), laneRows.end(), row);
+        return lane != laneRows.end() && *lane == row ? (int)(lane - laneRows.begin()) : -1;
+    }
+
+    // where a car is after the last tick, and after the one before
+    glm::vec3 carPosition(const Car& car) const {
+        const TrafficLane& lane = lanes.lane(laneIndex(car.rowIndex));
+        return glm::vec3(laneX(car.movingRight, lane.wrapped(car.slot)), 0.0f, car.z);
+    }
+
+    glm::vec3 previousCarPosition(const Car& car) const {
+        const TrafficLane& lane = lanes.lane(laneIndex(car.rowIndex));
+        return glm::vec3(laneX(car.movingRight, lane.wrap(lane.previousPosition[car.slot])), 0.0f, car.z);
+    }
+
+    // the cars of rows firstRow..lastRow, a contiguous run of the sorted pool
+    void carsInRows(int firstRow, int lastRow, const Car*& first, const Car*& last) const {
+        first = std::lower_bound(cars.begin(), cars.end(), firstRow, [](const Car& car, int row) { return car.rowIndex < row; });
+        last = std::upper_bound(first, cars.end(), lastRow, [](int row, const Car& car) { return row < car.rowIndex; });
+    }
+
+    // appends rows beyond the ones tick() keeps around the player (benchmarks)
+    void spawnRows(int count) {
+        for (int i = 0; i < count; ++i)
+            spawnNewRow();
+    }
+
+    // Function to check if player can move to a position (tree collision)
+    bool canMoveTo(glm::vec3 newPosition) const {
+        const float TREE_COLLISION_DISTANCE = 1.5f; // Trees have larger collision radius
+
+        for (const auto& tree : trees) {
+            float distance = glm::length(glm::vec2(newPosition.x - tree.position.x, newPosition.z - tree.position.z));
+            if (distance < TREE_COLLISION_DISTANCE) {
+                return false; // Cannot move, tree is blocking
+            }
+        }
+        return true; // Can move, no trees blocking
+    }
+
+private:
+    // Smoothly follow the duck
+    void updateCamera(float deltaTime) {
+        previousCamera = camera;
+
+        // Target camera position behind and above the duck
+        glm::vec3 targetCameraPos = glm::vec3(
+            playerPosition.x,
+            playerPosition.y + 10.0f, // 10 units above
+            playerPosition.z - 6.0f   // 6 units behind
+        );
+        // Prevent the camera from moving backwards (only allow non-decreasing Z)
+        if (targetCameraPos.z < camera.position.z) {
+            targetCameraPos.z = camera.position.z;
+        }
+
+        // Smooth camera following with interpolation
+        float cameraFollowSpeed = 2.5f * deltaTime; // Smoother follow speed
+        camera.position = glm::mix(camera.position, targetCameraPos, cameraFollowSpeed);
+
+        // Target look direction - where camera should look
+        glm::vec3 targetLookAt = playerPosition;
+        glm::vec3 direction = glm::normalize(targetLookAt - camera.position);
+
+        // Calculate target yaw and pitch
+        float targetYaw = glm::degrees(atan2(direction.z, direction.x));
+        float targetPitch = glm::degrees(asin(direction.y));
+
+        // Clamp target pitch
+        targetPitch = glm::clamp(targetPitch, -89.0f, 89.0f);
+
+        // Smooth camera rotation interpolation
+        float cameraRotationSpeed = 3.0f * deltaTime;
+
+        // Handle yaw wrapping (shortest rotation path)
+        float yawDiff = targetYaw - camera.yaw;
+        if (yawDiff > 180.0f) yawDiff -= 360.0f;
+        if (yawDiff < -180.0f) yawDiff += 360.0f;
+
+        camera.yaw += yawDiff * cameraRotationSpeed;
+        camera.pitch = glm::clamp(glm::mix(camera.pitch, targetPitch, cameraRotationSpeed), -89.0f, 89.0f);
+    }
+
+    // Advances the lanes of the rows up to the spawn horizon by this tick's road time.
+    // tick() keeps no rows beyond it, so in the game that is every lane; the rows a
+    // benchmark spawns further ahead wait until the player comes near. A game's
+    // handful of short lanes is stepped on this thread.
+    void stepTraffic() {
+        auto horizon = std::upper_bound(laneRows.begin(), laneRows.end(), playerRowIndex() + VISIBLE_ROWS);
+        lanes.step(0, horizon - laneRows.begin(), (float)(roadClock.at(ticks + 1) - roadClock.at(ticks)));
+    }
+
+    // Ends the game if a car of the player's row swept through the duck's cell during
+    // this tick's step. The player moves at the start of a tick, so this is its cell for
+    // the whole step, and the sweep catches a car that jumped over it between two ticks,
+    // whatever the tick rate.
+    void checkCollisions() {
+        int lane = laneIndex(playerRowIndex());
+        if (lane < 0)
+            return;
+        const Car& car = *std::lower_bound(cars.begin(), cars.end(), laneRows[lane], [](const Car& car, int row) { return car.rowIndex < row; });
+        float at = car.movingRight ? playerPosition.x + ROAD_HALF_LENGTH : ROAD_HALF_LENGTH - playerPosition.x;
+        if (lanes.lane(lane).sweptWithin(at, COLLISION_DISTANCE)) {
+            gameOver = true;
+            std::cout << "Game Over! Score: " << playerScore << " - Press R to restart" << std::endl;
+        }
+    }
+
+    int playerRowIndex() const {
+        return (int)std::lround((playerPosition.z + 10.0f) / MOVE_DISTANCE);
+    }
+
+    // Hands the cars, lanes and trees of every row before minZ back to their pools and
+    // drops the rows' road flags. erase() from the front keeps roadRows' storage, so once
+    // the pools are warm nothing here or in spawnNewRow allocates.
+    void recycleRowsBehind(float minZ) {
+        int keepFrom = (int)std::floor((minZ + 10.0f) / MOVE_DISTANCE);
+        if (keepFrom <= firstRoadRow)
+            return;
+        keepFrom = std::min(keepFrom, rowCount());
+        const Car* first;
+        const Car* last;
+        carsInRows(firstRoadRow, keepFrom - 1, first, last);
+        cars.releaseFront(last - cars.begin()); // keeps the pool sorted by row
+        size_t lanesBehind = std::lower_bound(laneRows.begin(), laneRows.end(), keepFrom) - laneRows.begin();
+        lanes.releaseFront(lanesBehind);
+        laneRows.erase(laneRows.begin(), laneRows.begin() + lanesBehind);
+        float keepZ = keepFrom * MOVE_DISTANCE - 10.0f - MOVE_DISTANCE * 0.5f;
+        trees.releaseIf([keepZ](const Tree& tree) { return tree.position.z < keepZ; });
+        roadRows.erase(roadRows.begin(), roadRows.begin() + (keepFrom - firstRoadRow));
+        firstRoadRow = keepFrom;
+    }
+
+    void spawnNewRow() {
+        int rowIndex = rowCount();
+        float rowZ = (rowIndex * MOVE_DISTANCE) - 10.0f;
+
+        // Initially mark as no road (0)
+        bool hasRoad = false;
+
+        // Decide whether to start a road of several lanes (and thus car rows)
+        if (roadLanesLeft == 0 && distribution(generator) < 0.5f) { // 50% chance to spawn a road
+            roadLaneCount = 1 + (int)(distribution(generator) * MAX_ROAD_LANES);
+            roadLanesLeft = roadLaneCount;
+            roadFlowsRight = distribution(generator) < 0.5f;
+        }
+
+        if (roadLanesLeft > 0) {
+            hasRoad = true; // This row will have a road because it has cars
+            int laneIndex = roadLaneCount - roadLanesLeft--;
+
+            // the first half of the lanes drives one way, the rest the other way
+            bool movingRight = (laneIndex < (roadLaneCount + 1) / 2) == roadFlowsRight;
+
+            // Traffic starts out at one speed per lane with at least the equilibrium gap
+            // (minimum gap plus the time headway at that speed) between cars, all the way
+            // around the wrap. Each car then wants its own speed around the lane's, so the
+            // car-following model bunches faster cars up behind slower ones.
+            float speed = CAR_SPEED * (0.7f + distribution(generator) * 0.6f); // Speed variation, per lane
+            float wrapLength = 2.0f * ROAD_HALF_LENGTH;
+            float minimumSpacing = traffic.carLength + traffic.minimumGap + speed * traffic.timeHeadway;
+            int maxCarsPerLane = glm::clamp((int)(wrapLength / minimumSpacing), 1, 16);
+            int numCarsPerLane = 2 + (int)(distribution(generator) * (maxCarsPerLane - 1)); // 2 up to a full lane
+            numCarsPerLane = std::min(numCarsPerLane, maxCarsPerLane);
+
+            // the slack beyond the minimum spacing is shared out at random
+            float slack = wrapLength - numCarsPerLane * minimumSpacing;
+            float weights[16];
+            float weightSum = 0.0f;
+            for (int i = 0; i < numCarsPerLane; ++i) {
+                weights[i] = distribution(generator);
+                weightSum += weights[i];
+            }
+            float offset = 0.0f;
+            TrafficLane& lane = lanes.addLane(wrapLength);
+            laneRows.push_back(rowIndex);
+
+            for (int i = 0; i < numCarsPerLane; ++i) {
+                Car car;
+                car.rowIndex = rowIndex; // Track which row this car belongs to
+
+                car.z = rowZ; // Cars stay in the center of the road row, on the road surface
+
+                car.movingRight = movingRight;
+                car.lane = rowIndex * 10 + laneIndex; // Unique lane identifier
+                car.slot = i;
+
+                // The first car enters at its road end (off screen), each later one its
+                // spacing ahead of the one before
+                float desired = speed * (1.0f + traffic.speedVariation * (2.0f * distribution(generator) - 1.0f));
+                lane.addCar(offset, speed, desired);
+                offset += minimumSpacing + (weightSum > 0.0f ? slack * weights[i] / weightSum : 0.0f);
+
+                cars.acquire() = car;
+            }
+        } else {
+            // This is a safe lane (no cars), potentially spawn trees as obstacles
+            if (distribution(generator) < 0.4f) { // 40% chance to spawn trees on safe lanes
+                int numTrees = 1 + static_cast<int>(distribution(generator) * 3); // 1-3 trees per safe lane
+
+                for (int i = 0; i < numTrees; ++i) {
+                    Tree tree;
+                    tree.position.y = -0.5f; // Position trees at ground level
+                    tree.position.z = rowZ; // Same Z as the row
+
+                    // Random X position within the lane, but not too close to edges
+                    float minX = -GRID_WIDTH * MOVE_DISTANCE * 0.8f;
+                    float maxX = GRID_WIDTH * MOVE_DISTANCE * 0.8f;
+                    tree.position.x = minX + distribution(generator) * (maxX - minX);
+
+                    trees.acquire() = tree;
+                }
+            }
+        }
+
+        // Add to roadRows: 1 if has road (with cars), 0 if no road (safe area)
+        roadRows.push_back(hasRoad ? 1 : 0);
+    }
+};
@@ -0,0 +1,201 @@
+// game_pipeline.h
+// Runs CrossyWorld on its own thread so simulation and drawing overlap:
+//  - InputMailbox: the main thread latches key presses, the simulation takes them each tick
+//  - GameSnapshot: immutable copy of what the renderer needs, published every tick
+//    through a TripleBuffer so neither side ever blocks on the other
+//  - SimulationThread: fixed-tick loop that applies input, ticks and publishes,
+//    optionally recording the input of every tick for replay
+#pragma once
+
+#include "crossy_world.h"
+#include "../common/fixed_timestep.h"
+#include "../common/input_log.h"
+#include "../common/triple_buffer.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+// shared time base for input stamps, tick stamps and latency measurements
+inline int64_t pipelineMicros()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+class InputMailbox
+{
+public:
+    // main thread: a key went down
+    void press(uint8_t keys, int64_t micros)
+    {
+        pressMicros.store(micros, std::memory_order_relaxed);
+        pressed.fetch_or(keys, std::memory_order_release);
+    }
+
+    // simulation thread: every key pressed since the last call (taps shorter than a tick are not lost)
+    uint8_t take(int64_t& micros)
+    {
+        uint8_t keys = pressed.exchange(0, std::memory_order_acquire);
+        micros = pressMicros.load(std::memory_order_relaxed);
+        return keys;
+    }
+
+private:
+    std::atomic<uint8_t> pressed { 0 };
+    std::atomic<int64_t> pressMicros { 0 };
+};
+
+// a car as drawn: its position at the snapshot's tick and at the tick before
+struct CarPose
+{
+    glm::vec3 position;
+    glm::vec3 previousPosition;
+    bool movingRight;
+};
+
+struct GameSnapshot
+{
+    glm::vec3 playerPosition;
+    float playerRotation = 0.0f;
+    bool gameOver = false;
+    int playerScore = 0;
+    std::vector<CarPose> cars;  // only the cars of the rows below
+    std::vector<Tree> trees;
+    int firstRow = 0;           // road flags for rows firstRow .. firstRow + rows.size() - 1
+    std::vector<int> rows;
+    FollowCamera camera;
+    FollowCamera previousCamera;
+    long long tick = 0;
+    int64_t publishMicros = 0;  // when this tick finished; the renderer interpolates from here
+    int64_t lastInputMicros = 0;
+
+    bool isRoad(int row) const
+    {
+        int i = row - firstRow;
+        return i >= 0 && i < (int)rows.size() && rows[i] == 1;
+    }
+};
+
+// Copies what the renderer draws: every tree, and the road flags and car positions of
+// the rows around the player, so the car work per tick follows what is on screen rather
+// than the size of the world. Storage is reused, so this stops allocating once warm.
+inline void captureSnapshot(const CrossyWorld& world, GameSnapshot& snapshot)
+{
+    snapshot.playerPosition = world.playerPosition;
+    snapshot.playerRotation = world.playerRotation;
+    snapshot.gameOver = world.gameOver;
+    snapshot.playerScore = world.playerScore;
+    snapshot.trees.assign(world.trees.begin(), world.trees.end());
+
+    int playerRow = (int)((world.playerPosition.z + 10.0f) / MOVE_DISTANCE);
+    int startRow = std::max(0, playerRow - 5);
+    int endRow = std::min(world.rowCount() - 1, playerRow + VISIBLE_ROWS);
+    snapshot.firstRow = startRow;
+    snapshot.rows.clear();
+    for (int row = startRow; row <= endRow; ++row)
+        snapshot.rows.push_back(world.isRoadRow(row) ? 1 : 0);
+
+    const Car* firstCar;
+    const Car* lastCar;
+    world.carsInRows(startRow, endRow, firstCar, lastCar);
+    snapshot.cars.clear();
+    for (const Car* car = firstCar; car != lastCar; ++car)
+    {
+        CarPose pose;
+        pose.position = world.carPosition(*car);
+        pose.previousPosition = world.previousCarPosition(*car);
+        pose.movingRight = car->movingRight;
+        if ((pose.previousPosition.x > pose.position.x) == car->movingRight)
+            pose.previousPosition = pose.position; // don't interpolate across the wrap
+        snapshot.cars.push_back(pose);
+    }
+
+    snapshot.camera = world.camera;
+    snapshot.previousCamera = world.previousCamera;
+    snapshot.tick = world.ticks;
+    snapshot.lastInputMicros = world.lastInputMicros;
+}
+
+class SimulationThread
+{
+public:
+    // extraTickMicros busy-waits inside every tick, to model a heavier simulation in benchmarks
+    SimulationThread(CrossyWorld& world, InputMailbox& input, TripleBuffer<GameSnapshot>& snapshots,
+                     double step = 1.0 / 60.0, int64_t extraTickMicros = 0)
+        : world(world), input(input), snapshots(snapshots), clock(step), extraTickMicros(extraTickMicros)
+    {
+    }
+
+    ~SimulationThread() { stop(); }
+
+    void start()
+    {
+        running = true;
+        thread = std::thread(&SimulationThread::run, this);
+    }
+
+    void stop()
+    {
+        running = false;
+        if (thread.joinable())
+            thread.join();
+    }
+
+    long long ticks() const { return tickCount.load(std::memory_order_relaxed); }
+
+    // set before start(); closed by the owner once the thread has stopped
+    void setRecorder(InputRecorder* inputRecorder) { recorder = inputRecorder; }
+
+private:
+    void run()
+    {
+        int64_t startMicros = pipelineMicros();
+        publish();
+        while (running)
+        {
+            int steps = clock.advance((pipelineMicros() - startMicros) * 1.0e-6);
+            for (int step = 0; step < steps; ++step)
+            {
+                int64_t pressMicros = 0;
+                uint8_t pressed = input.take(pressMicros);
+                if (recorder != nullptr)
+                    recorder->record(world.ticks, pressed);
+                world.applyInput(pressed, pressMicros);
+                world.tick(clock.dt());
+                if (extraTickMicros > 0)
+                {
+                    int64_t until = pipelineMicros() + extraTickMicros;
+                    while (pipelineMicros() < until)
+                        ;
+                }
+                tickCount.fetch_add(1, std::memory_order_relaxed);
+            }
+            if (steps > 0)
+                publish();
+
+            // sleep until the next tick is due
+            double untilNextTick = (1.0 - clock.alpha()) * clock.dt();
+            std::this_thread::sleep_for(std::chrono::duration<double>(untilNextTick));
+        }
+    }
+
+    void publish()
+    {
+        GameSnapshot& snapshot = snapshots.writeBuffer();
+        captureSnapshot(world, snapshot);
+        snapshot.publishMicros = pipelineMicros();
+        snapshots.publish();
+    }
+
+    CrossyWorld& world;
+    InputMailbox& input;
+    TripleBuffer<GameSnapshot>& snapshots;
+    FixedTimestep clock;
+    int64_t extraTickMicros;
+    InputRecorder* recorder = nullptr;
+    std::atomic<bool> running { false };
+    std::atomic<long long> tickCount { 0 };
+    std::thread thread;
+};
@@ -10,7 +10,21 @@
 #include <learnopengl/camera.h>
 #include <learnopengl/model.h>
 
+#define ALLOC_TRACKER_IMPLEMENTATION
+#include "../common/alloc_tracker.h"
+#include "../common/fixed_timestep.h"
+#include "../common/frame_capture.h"
+#include "../common/model_optimizer.h"
+#include "../common/program_cache.h"
+#include "../common/render_queue.h"
+#include "game_pipeline.h"
+#include "road_batches.h"
+#include "world_snapshot.h"
+
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <random>
 #include <cmath>
@@ -20,24 +34,18 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void mouse_callback(GLFWwindow* window, double xpos, double ypos);
 void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
 void processInput(GLFWwindow* window);
-void updateCars(float deltaTime);
-void checkCollisions();
-void resetGame();
-bool checkGameOver();
-void spawnNewRow();
+Camera snapshotCamera(const GameSnapshot& snapshot, float alpha); // Camera blended between the snapshot's last two ticks
 void renderCube(); // Function to render a simple cube for road markings
-bool canMoveTo(glm::vec3 newPosition); // Function to check tree collisions
+int runPipelineBenchmark(double seconds, double simMs, double renderMs); // Headless serial vs pipelined comparison
+int runCarMotionBenchmark(double minutes); // Headless car cost per tick, and lane gaps over a long run
+int runCollisionBenchmark(float gameSpeed); // Headless polled vs swept collisions at several tick rates
+int replayInputLog(const std::string& path, bool maxSpeed, const std::string& baselinePath, const std::string& saveBaselinePath); // Headless replay of a recorded session
+void queueModel(RenderQueue& queue, Model& model, const std::vector<GLenum>& indexTypes, unsigned int program, const glm::mat4& transform, glm::vec3 position, glm::vec3 eye); // Record one draw packet per mesh
 
 // settings
 const unsigned int SCR_WIDTH = 1200;
 const unsigned int SCR_HEIGHT = 800;
 
-// Game constants
-const float MOVE_DISTANCE = 2.0f;
-const float CAR_SPEED = 10.0f;
-const int GRID_WIDTH = 11;
-const int VISIBLE_ROWS = 15;
-
 // camera - positioned for crossy road perspective
 Camera camera(glm::vec3(0.0f, 8.0f, 8.0f));
 float lastX = SCR_WIDTH / 2.0f;
@@ -48,34 +56,110 @@ bool firstMouse = true;
 float deltaTime = 0.0f;
 float lastFrame = 0.0f;
 
-// Game state
-struct Car {
-    glm::vec3 position;
-    float speed;
-    int lane;
-    bool movingRight;
-    int rowIndex; // Track which row this car belongs to
-};
-
-struct Tree {
-    glm::vec3 position;
-};
-
-// Game variables
-glm::vec3 playerPosition(0.0f, 0.0f, -10.0f);
-float playerRotation = 0.0f; // Duck rotation angle - start facing forward (0 degrees)
-std::vector<Car> cars;
-std::vector<Tree> trees;
-std::vector<int> roadRows; // stores which rows are roads (1) vs grass/safe (0)
-int playerScore = 0;
-bool gameOver = false;
-float gameSpeed = 1.0f;
-int furthestRow = 0;
-std::default_random_engine generator;
-std::uniform_real_distribution<float> distribution(0.0f, 1.0f);
-
-int main()
+// key presses handed from the main thread to the simulation thread
+InputMailbox inputMailbox;
+
+int main(int argc, char** argv)
 {
+    // --frame-time <ms>: pace frames to this time instead of vsync
+    // --no-shader-cache: always compile shaders from source
+    // --record <file>: write the input of every tick to an input log
+    // --replay <file> [--max-speed] [--baseline <file>] [--save-baseline <file>]:
+    //   re-run a recorded session without a window and report tick timings
+    // --capture <path> [frames]: record the window to a .y4m file or a directory of PNGs;
+    //   with a frame count the window is hidden and closes once that many are taken
+    // --resume <file>: start from a saved world instead of a new one (not with --record:
+    //   a replay always starts from a new world)
+    // --save <file>: save the world on exit
+    double targetFrameTime = 0.0;
+    std::string recordPath, replayPath, baselinePath, saveBaselinePath;
+    bool maxSpeed = false;
+    bool useShaderCache = true;
+    std::string capturePath, resumePath, savePath;
+    int captureFrames = 0;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--frame-time") == 0 && i + 1 < argc)
+            targetFrameTime = atof(argv[++i]) / 1000.0;
+        else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+            recordPath = argv[++i];
+        else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+            replayPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc)
+            saveBaselinePath = argv[++i];
+        else if (strcmp(argv[i], "--max-speed") == 0)
+            maxSpeed = true;
+        else if (strcmp(argv[i], "--no-shader-cache") == 0)
+            useShaderCache = false;
+        else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capturePath = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-')
+                captureFrames = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--resume") == 0 && i + 1 < argc)
+            resumePath = argv[++i];
+        else if (strcmp(argv[i], "--save") == 0 && i + 1 < argc)
+            savePath = argv[++i];
+    }
+    if (!resumePath.empty() && !recordPath.empty()) {
+        std::cout << "--record cannot be combined with --resume: a replay starts from a new world" << std::endl;
+        return -1;
+    }
+    if (!replayPath.empty())
+        return replayInputLog(replayPath, maxSpeed, baselinePath, saveBaselinePath);
+
+    // headless tool:
+    //   --bench-pipeline [seconds] [simMs] [renderMs]  input latency and throughput,
+    //   serial vs simulation thread, with busy-waits standing in for sim and draw cost
+    //   --bench-meshopt [files...]  vertex cache optimizer report (ACMR / ATVR before and after)
+    //   for the given model files, or for the game's models
+    //   --bench-shaders [threads]  cold, threaded-cold and warm program builds of the three
+    //   assignments' shaders through the program binary cache (run from this directory)
+    //   --bench-cars [minutes]  car cost per tick, stepping every lane vs tick() and the
+    //   snapshot, for growing worlds; and the smallest gap between cars after `minutes`
+    //   --bench-collisions [gameSpeed]  hits found by polling every tick vs by sweeping
+    //   the lanes, and their cost, at 60 down to 5 ticks per second
+    //   --bench-traffic [maxCars] [threads]  car-following traffic from 10^3 cars up to
+    //   maxCars (10^6), on one thread and split by lane across a thread pool
+    //   --bench-snapshot [maxRows]  world save and resume times from 10^3 rows up to maxRows (10^6)
+    if (argc > 1 && strcmp(argv[1], "--bench-pipeline") == 0)
+    {
+        double seconds = argc > 2 ? atof(argv[2]) : 5.0;
+        double simMs = argc > 3 ? atof(argv[3]) : 2.0;
+        double renderMs = argc > 4 ? atof(argv[4]) : 6.0;
+        return runPipelineBenchmark(seconds, simMs, renderMs);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-cars") == 0)
+        return runCarMotionBenchmark(argc > 2 ? atof(argv[2]) : 60.0);
+    if (argc > 1 && strcmp(argv[1], "--bench-collisions") == 0)
+        return runCollisionBenchmark(argc > 2 ? (float)atof(argv[2]) : 3.0f);
+    if (argc > 1 && strcmp(argv[1], "--bench-traffic") == 0)
+        return runTrafficBenchmark(argc > 2 ? (size_t)atof(argv[2]) : 1000000, argc > 3 ? atoi(argv[3]) : 0);
+    if (argc > 1 && strcmp(argv[1], "--bench-snapshot") == 0)
+        return runSnapshotBenchmark(argc > 2 ? (int)atof(argv[2]) : 1000000);
+    if (argc > 1 && strcmp(argv[1], "--bench-meshopt") == 0)
+    {
+        std::vector<std::string> paths(argv + 2, argv + argc);
+        if (paths.empty()) {
+            paths.push_back(FileSystem::getPath("resources/objects/mallard-crossy-road/source/Mallard_crossy_road.obj"));
+            paths.push_back(FileSystem::getPath("resources/objects/pixel-car-city/source/model.obj"));
+            paths.push_back(FileSystem::getPath("resources/objects/elm-tree-low-poly/source/tree-elm-low-poly.obj"));
+            paths.push_back(FileSystem::getPath("resources/objects/road/road.obj"));
+        }
+        return runMeshOptimizerBenchmark(paths);
+    }
+    if (argc > 1 && strcmp(argv[1], "--bench-shaders") == 0)
+    {
+        int threads = argc > 2 ? atoi(argv[2]) : 3;
+        std::vector<ProgramSource> sources = {
+            { "model_loading.vs", "model_loading.fs" },
+            { "../Assignment3-3D-Kinetic-sculpture-animation/multiple_light.vs", "../Assignment3-3D-Kinetic-sculpture-animation/multiple_light.fs" },
+            { "../Assignment5-Character-animation-control/anim_model.vs", "../Assignment5-Character-animation-control/anim_model.fs" },
+        };
+        return runProgramCacheBenchmark(sources, threads);
+    }
+
     // glfw: initialize and configure
     // ------------------------------
     glfwInit();
@@ -86,6 +170,8 @@ int main()
 #ifdef __APPLE__
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+    if (captureFrames > 0)
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
     // glfw window creation
     // --------------------
@@ -97,6 +183,9 @@ int main()
         return -1;
     }
     glfwMakeContextCurrent(window);
+    FramePacer pacer(targetFrameTime);
+    if (pacer.enabled())
+        glfwSwapInterval(0);
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetCursorPosCallback(window, mouse_callback);
     glfwSetScrollCallback(window, scroll_callback);
@@ -121,7 +210,11 @@ int main()
 
     // build and compile shaders
     // -------------------------
-    Shader ourShader("1.model_loading.vs", "1.model_loading.fs");
+    ProgramCache programCache((GLADloadproc)glfwGetProcAddress, "shader_cache", useShaderCache);
+    CachedShader ourShader = programCache.load("1.model_loading.vs", "1.model_loading.fs");
+    programCache.report(std::cout);
+    ourShader.use();
+    ourShader.setInt("texture_diffuse1", 0);
 
     // load models
     // -----------
@@ -130,14 +223,54 @@ int main()
     Model treeModel(FileSystem::getPath("resources/objects/elm-tree-low-poly/source/tree-elm-low-poly.obj"));
     Model roadModel(FileSystem::getPath("resources/objects/road/road.obj")); // Load road model
 
-    // Initialize game
-    resetGame();
-
-    // Set up initial camera position with smooth following setup
-    camera.Position = glm::vec3(playerPosition.x, playerPosition.y + 10.0f, playerPosition.z - 6.0f);
-    camera.Yaw = 90.0f;   // Face forward
-    camera.Pitch = -30.0f; // Look down at the duck
-    camera.ProcessMouseMovement(0, 0);
+    // optimize for the vertex cache, overdraw and fetch order; queueModel draws with
+    // the returned index types (16-bit wherever a mesh fits)
+    std::vector<GLenum> duckIndexTypes = optimizeModel(duckModel, "duck", true, false);
+    std::vector<GLenum> carIndexTypes = optimizeModel(carModel, "car", true, false);
+    std::vector<GLenum> treeIndexTypes = optimizeModel(treeModel, "tree", true, false);
+    optimizeModel(roadModel, "road", true, false); // only its CPU copy is drawn, through the road batches
+    RoadBatcher roadBatches(roadModel);
+
+    // The game runs on its own thread at a fixed 60 Hz tick and publishes a snapshot
+    // after every tick; this thread only samples input and draws the newest snapshot,
+    // blended between its last two ticks, so update and draw overlap.
+    CrossyWorld world;
+    if (!resumePath.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (loadWorldSnapshot(world, resumePath))
+            std::cout << "Resumed " << resumePath << " at score " << world.playerScore << " in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    }
+    TripleBuffer<GameSnapshot> snapshots;
+    SimulationThread simulation(world, inputMailbox, snapshots);
+    const double simStep = 1.0 / 60.0;
+    InputRecorder recorder;
+    if (!recordPath.empty() && recorder.open(recordPath, simStep))
+        simulation.setRecorder(&recorder);
+    simulation.start();
+    while (!snapshots.update())
+        std::this_thread::yield();
+    FrameTimeStats frameStats;
+    AllocationStats allocationStats; // operator new calls per frame, both threads
+    FrameTimeStats inputLatency;
+    int64_t lastMeasuredInput = 0;
+
+    // Every mesh of every object becomes a draw packet; the queue sorts them by
+    // program/texture/VAO so each car or tree model binds its state once per frame
+    RenderQueue renderQueue;
+
+    // --capture: frames are read back through a PBO ring and encoded on worker threads
+    std::unique_ptr<FrameCapture> capture;
+    if (!capturePath.empty()) {
+        int captureWidth, captureHeight;
+        glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+        capture.reset(new FrameCapture(capturePath, FrameCapture::formatFor(capturePath), captureWidth, captureHeight,
+                                       targetFrameTime > 0.0 ? (int)std::lround(1.0 / targetFrameTime) : 60));
+        if (!capture->open()) {
+            std::cout << "Failed to open capture output " << capturePath << std::endl;
+            capture.reset();
+        }
+    }
 
     // render loop
     // -----------
@@ -147,71 +280,25 @@ int main()
         // --------------------
         float currentFrame = static_cast<float>(glfwGetTime());
         deltaTime = currentFrame - lastFrame;
+        if (lastFrame > 0.0f)
+            frameStats.add(deltaTime);
         lastFrame = currentFrame;
 
         // input
         // -----
         processInput(window);
 
-        // Update game state
-        if (!gameOver) {
-            updateCars(deltaTime);
-            checkCollisions();
-            
-            // Check if player moved forward
-            int currentRow = (int)((playerPosition.z + 10.0f) / MOVE_DISTANCE);
-            if (currentRow > furthestRow) {
-                furthestRow = currentRow;
-                playerScore = furthestRow;
-                gameSpeed += 0.01f; // Gradually increase difficulty
-            }
-            
-            // Continuously spawn new rows to create endless gameplay
-            while (currentRow + VISIBLE_ROWS >= roadRows.size()) {
-                spawnNewRow();
-            }
-        }
-
-        // Update camera to follow the duck - smoother approach
-        // Target camera position behind and above the duck
-        glm::vec3 targetCameraPos = glm::vec3(
-            playerPosition.x,
-            playerPosition.y + 10.0f, // 10 units above
-            playerPosition.z - 6.0f   // 6 units behind
-        );
-        // Prevent the camera from moving backwards (only allow non-decreasing Z)
-        if (targetCameraPos.z < camera.Position.z) {
-            targetCameraPos.z = camera.Position.z;
-        }
-        
-        // Smooth camera following with interpolation
-        float cameraFollowSpeed = 2.5f * deltaTime; // Smoother follow speed
-        camera.Position = glm::mix(camera.Position, targetCameraPos, cameraFollowSpeed);
-        
-        // Target look direction - where camera should look
-        glm::vec3 targetLookAt = playerPosition;
-        glm::vec3 direction = glm::normalize(targetLookAt - camera.Position);
-        
-        // Calculate target yaw and pitch
-        float targetYaw = glm::degrees(atan2(direction.z, direction.x));
-        float targetPitch = glm::degrees(asin(direction.y));
-        
-        // Clamp target pitch
-        targetPitch = glm::clamp(targetPitch, -89.0f, 89.0f);
-        
-        // Smooth camera rotation interpolation
-        float cameraRotationSpeed = 3.0f * deltaTime;
-        
-        // Handle yaw wrapping (shortest rotation path)
-        float yawDiff = targetYaw - camera.Yaw;
-        if (yawDiff > 180.0f) yawDiff -= 360.0f;
-        if (yawDiff < -180.0f) yawDiff += 360.0f;
-        
-        camera.Yaw += yawDiff * cameraRotationSpeed;
-        camera.Pitch = glm::mix(camera.Pitch, targetPitch, cameraRotationSpeed);
-        
-        // Update camera vectors
-        camera.ProcessMouseMovement(0, 0);
+        // newest game state
+        // -----------------
+        snapshots.update();
+        const GameSnapshot& snapshot = snapshots.readBuffer();
+        float alpha = glm::clamp((float)((pipelineMicros() - snapshot.publishMicros) * 1.0e-6 / simStep), 0.0f, 1.0f);
+        Camera renderCamera = snapshotCamera(snapshot, alpha);
+        const glm::vec3& playerPosition = snapshot.playerPosition;
+        float playerRotation = snapshot.playerRotation;
+        bool gameOver = snapshot.gameOver;
+        const std::vector<CarPose>& cars = snapshot.cars;
+        const std::vector<Tree>& trees = snapshot.trees;
 
         // render
         // ------
@@ -222,8 +309,8 @@ int main()
         ourShader.use();
 
         // view/projection transformations
-        glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-        glm::mat4 view = camera.GetViewMatrix();
+        glm::mat4 projection = glm::perspective(glm::radians(renderCamera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+        glm::mat4 view = renderCamera.GetViewMatrix();
         ourShader.setMat4("projection", projection);
         ourShader.setMat4("view", view);
 
@@ -236,26 +323,34 @@ int main()
         if (gameOver) {
             model = glm::scale(model, glm::vec3(1.2f, 0.3f, 1.2f));
         }
-        ourShader.setMat4("model", model);
         
         // Debug output with camera info
         static int frameCounter = 0;
         if (frameCounter % 60 == 0) {
             std::cout << "Duck Position: (" << playerPosition.x << ", " << playerPosition.y << ", " << playerPosition.z << ")" << std::endl;
             std::cout << "Duck Rotation: " << playerRotation << " degrees" << std::endl;
-            std::cout << "Camera Position: (" << camera.Position.x << ", " << camera.Position.y << ", " << camera.Position.z << ")" << std::endl;
-            std::cout << "Camera Yaw: " << camera.Yaw << ", Pitch: " << camera.Pitch << std::endl;
-            std::cout << "Distance to duck: " << glm::length(camera.Position - playerPosition) << std::endl;
+            std::cout << "Camera Position: (" << snapshot.camera.position.x << ", " << snapshot.camera.position.y << ", " << snapshot.camera.position.z << ")" << std::endl;
+            std::cout << "Camera Yaw: " << snapshot.camera.yaw << ", Pitch: " << snapshot.camera.pitch << std::endl;
+            std::cout << "Distance to duck: " << glm::length(snapshot.camera.position - playerPosition) << std::endl;
+            const RenderQueueStats& queueStats = renderQueue.lastFrame();
+            std::cout << "Render queue: " << queueStats.packets << " packets, " << queueStats.programBinds << " program / "
+                      << queueStats.vaoBinds << " VAO / " << queueStats.textureBinds << " texture binds, "
+                      << queueStats.avoidedChanges << " state changes avoided" << std::endl;
+            const RoadBatchStats& roadStats = roadBatches.statistics();
+            std::cout << "Road batches: " << roadStats.chunks << " chunks, " << roadStats.draws << " draws, "
+                      << roadStats.rebuilds << " rebuilds ("
+                      << (roadStats.rebuilds > 0 ? roadStats.rebuildMicros / roadStats.rebuilds : 0.0) << " us per chunk)" << std::endl;
+            roadBatches.resetStats();
             std::cout << "---" << std::endl;
         }
         frameCounter++;
         
-        duckModel.Draw(ourShader);
+        queueModel(renderQueue, duckModel, duckIndexTypes, ourShader.ID, model, duckCarPosition, renderCamera.Position);
 
         // Draw cars - properly sized and positioned on road surface
         for (const auto& car : cars) {
             model = glm::mat4(1.0f);
-            model = glm::translate(model, car.position);
+            model = glm::translate(model, glm::mix(car.previousPosition, car.position, alpha));
             // Rotate car to face forward/backward along the road (0 degrees = forward)
             if (car.movingRight) {
                 model = glm::rotate(model, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // Face forward (right direction)
@@ -263,8 +358,7 @@ int main()
                 model = glm::rotate(model, glm::radians(-90.0f), glm::vec3(0.0f, 1.0f, 0.0f)); // Face backward (left direction)
             }
             model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f)); // Make cars larger and more visible
-            ourShader.setMat4("model", model);
-            carModel.Draw(ourShader);
+            queueModel(renderQueue, carModel, carIndexTypes, ourShader.ID, model, car.position, renderCamera.Position);
         }
 
         // Draw trees as obstacles on safe lanes
@@ -273,38 +367,53 @@ int main()
             glm::vec3 treeGroundPosition = glm::vec3(tree.position.x, -0.5f, tree.position.z); // Ensure trees are at ground level
             model = glm::translate(model, treeGroundPosition);
             model = glm::scale(model, glm::vec3(0.003f, 0.003f, 0.003f)); // Same size as duck (30% scale)
-            ourShader.setMat4("model", model);
-            treeModel.Draw(ourShader);
+            queueModel(renderQueue, treeModel, treeIndexTypes, ourShader.ID, model, treeGroundPosition, renderCamera.Position);
         }
 
-        // Draw road models for all rows that have been designated as car lanes (endless roads)
-        int playerRow = (int)((playerPosition.z + 10.0f ) / MOVE_DISTANCE);
-
-        // ?????????? ??????? (???????????????????)
-        int startRow = std::max(0, playerRow - 5);
-        int endRow = std::min((int)roadRows.size() - 1, playerRow + VISIBLE_ROWS);
-
-        for (int row = startRow; row <= endRow; ++row) {
-            if (roadRows[row] == 1) {
-                glm::mat4 model = glm::mat4(1.0f);
-
- 
-                float rowZ = (row - playerRow) * MOVE_DISTANCE + playerPosition.z;
-                glm::vec3 roadPos(0.0f, -1.2f, rowZ); // Same level as trees
+        // Draw road models for all rows that have been designated as car lanes (endless roads):
+        // the visible rows are pre-merged into static chunk buffers, a few draws in total
+        roadBatches.update(snapshot);
+        roadBatches.queue(renderQueue, ourShader.ID, renderCamera.Position);
 
-                model = glm::translate(model, roadPos);
-                float roadWidthX = (GRID_WIDTH * MOVE_DISTANCE) + 10.0f;
-                float roadLengthZ = 0.5f; // decreased road length (depth)
-                model = glm::scale(model, glm::vec3(roadWidthX, 1.0f, roadLengthZ));
-                ourShader.setMat4("model", model);
-                roadModel.Draw(ourShader);
-            }
-        }
+        renderQueue.flush();
 
         // glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
         // -------------------------------------------------------------------------------
+        if (capture) {
+            capture->capture();
+            if (captureFrames > 0 && capture->frames() >= (unsigned long long)captureFrames)
+                glfwSetWindowShouldClose(window, true);
+        }
         glfwSwapBuffers(window);
+        frameArena().reset();
+        allocationStats.endFrame();
         glfwPollEvents();
+        pacer.wait();
+
+        // input-to-photon: a key press is on screen once a frame showing its tick was presented
+        if (snapshot.lastInputMicros > lastMeasuredInput) {
+            inputLatency.add((pipelineMicros() - snapshot.lastInputMicros) * 1.0e-6);
+            lastMeasuredInput = snapshot.lastInputMicros;
+        }
+    }
+
+    simulation.stop();
+    if (!savePath.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        if (saveWorldSnapshot(world, savePath))
+            std::cout << "Saved the world to " << savePath << " in "
+                      << std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() << " ms" << std::endl;
+    }
+    if (recorder.isOpen()) {
+        recorder.close(world.ticks);
+        std::cout << "Recorded " << world.ticks << " ticks to " << recordPath << std::endl;
+    }
+    frameStats.report(std::cout, "Frame time");
+    allocationStats.report(std::cout, "Heap allocations");
+    inputLatency.report(std::cout, "Input latency");
+    if (capture) {
+        capture->finish();
+        capture->report(std::cout);
     }
 
     // glfw: terminate, clearing all previously allocated GLFW resources.
@@ -320,86 +429,24 @@ void processInput(GLFWwindow* window)
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
         glfwSetWindowShouldClose(window, true);
 
-    // Game controls
-    static bool wPressed = false;
-    static bool aPressed = false;
-    static bool sPressed = false;
-    static bool dPressed = false;
-    static bool rPressed = false;
-
-    if (!gameOver) {
-        // Player movement - only allow one move per key press
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS && !wPressed) {
-            // Allow forward, but keep the player ahead of the camera (never behind)
-            float minZ = camera.Position.z + 2.0f;
-            float nextZ = playerPosition.z + MOVE_DISTANCE;
-            glm::vec3 newPos = glm::vec3(playerPosition.x, playerPosition.y, nextZ);
-            if (nextZ >= minZ && canMoveTo(newPos)) {
-                playerPosition.z = nextZ; // Move forward
-                playerRotation = 0.0f; // Face forward (0 degrees)
-            }
-            wPressed = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_W) == GLFW_RELEASE) {
-            wPressed = false;
-        }
-
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_PRESS && !sPressed) {
-            // Constrain moving backward: do not allow player to go behind camera's forward edge
-            float minZ = camera.Position.z + 2.0f; // small margin in front of camera
-            glm::vec3 newPos = glm::vec3(playerPosition.x, playerPosition.y, playerPosition.z - MOVE_DISTANCE);
-            if (playerPosition.z - MOVE_DISTANCE >= minZ && canMoveTo(newPos)) {
-                playerPosition.z -= MOVE_DISTANCE; // Move backward within camera bounds
-                playerRotation = 180.0f; // Face backward (180 degrees)
-            }
-            sPressed = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_S) == GLFW_RELEASE) {
-            sPressed = false;
-        }
-
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS && !aPressed) {
-            // Constrain left movement: keep player inside camera horizontal frustum
-            float halfViewWidth = 8.0f; // tune to your FOV and distance
-            float minX = camera.Position.x - halfViewWidth;
-            glm::vec3 newPos = glm::vec3(playerPosition.x - MOVE_DISTANCE, playerPosition.y, playerPosition.z);
-            if (playerPosition.x - MOVE_DISTANCE >= minX && playerPosition.x > -GRID_WIDTH * MOVE_DISTANCE && canMoveTo(newPos)) {
-                playerPosition.x += MOVE_DISTANCE; // Move left
-                playerRotation = 90.0f; // Face left (-90 degrees)
-            }
-            aPressed = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_A) == GLFW_RELEASE) {
-            aPressed = false;
-        }
-
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_PRESS && !dPressed) {
-            // Constrain right movement: keep player inside camera horizontal frustum
-            float halfViewWidth = 8.0f; // tune to your FOV and distance
-            float maxX = camera.Position.x + halfViewWidth;
-            glm::vec3 newPos = glm::vec3(playerPosition.x + MOVE_DISTANCE, playerPosition.y, playerPosition.z);
-            if (playerPosition.x + MOVE_DISTANCE <= maxX && playerPosition.x < GRID_WIDTH * MOVE_DISTANCE && canMoveTo(newPos)) {
-                playerPosition.x -= MOVE_DISTANCE; // Move right
-                playerRotation = -90.0f; // Face right (90 degrees)
-            }
-            dPressed = true;
-        }
-        if (glfwGetKey(window, GLFW_KEY_D) == GLFW_RELEASE) {
-            dPressed = false;
-        }
-    }
-
-    // Reset game
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_PRESS && !rPressed) {
-        resetGame();
-        rPressed = true;
-    }
-    if (glfwGetKey(window, GLFW_KEY_R) == GLFW_RELEASE) {
-        rPressed = false;
+    // Game controls: each key press is handed to the simulation thread once,
+    // which applies the move on its next tick (see CrossyWorld::applyInput)
+    static const int keys[] = { GLFW_KEY_W, GLFW_KEY_S, GLFW_KEY_A, GLFW_KEY_D, GLFW_KEY_R };
+    static const uint8_t actions[] = { INPUT_FORWARD, INPUT_BACK, INPUT_LEFT, INPUT_RIGHT, INPUT_RESET };
+    static bool wasPressed[5] = { false, false, false, false, false };
+
+    uint8_t pressed = 0;
+    for (int i = 0; i < 5; ++i) {
+        bool down = glfwGetKey(window, keys[i]) == GLFW_PRESS;
+        if (down && !wasPressed[i])
+            pressed |= actions[i];
+        wasPressed[i] = down;
     }
+    if (pressed != 0)
+        inputMailbox.press(pressed, pipelineMicros());
 
     // Disable manual camera movement to keep constraints consistent
-    // (Camera is fully driven by follow logic above)
+    // (Camera is fully driven by follow logic in CrossyWorld)
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
@@ -441,125 +488,14 @@ void scroll_callback(GLFWwindow* window, double xoffset, double yoffset)
     camera.ProcessMouseScroll(static_cast<float>(yoffset));
 }
 
-// Game logic functions
-// ---------------------
-void updateCars(float deltaTime) {
-    for (auto& car : cars) {
-        if (car.movingRight) {
-            car.position.x += car.speed * gameSpeed * deltaTime;
-            if (car.position.x > GRID_WIDTH * MOVE_DISTANCE + 20) {
-                car.position.x = -GRID_WIDTH * MOVE_DISTANCE - 20;
-            }
-        } else {
-            car.position.x -= car.speed * gameSpeed * deltaTime;
-            if (car.position.x < -GRID_WIDTH * MOVE_DISTANCE - 20) {
-                car.position.x = GRID_WIDTH * MOVE_DISTANCE + 20;
-            }
-        }
-    }
-}
-
-void checkCollisions() {
-    const float COLLISION_DISTANCE = 1.0f;
-    
-    for (const auto& car : cars) {
-        float distance = glm::length(playerPosition - car.position);
-        if (distance < COLLISION_DISTANCE) {
-            gameOver = true;
-            std::cout << "Game Over! Score: " << playerScore << " - Press R to restart" << std::endl;
-            return;
-        }
-    }
-    
-    // Check tree collisions if needed
-    // Currently no trees, but could be added to grass areas
-}
-
-void resetGame() {
-    playerPosition = glm::vec3(0.0f, 0.0f, -10.0f);
-    playerRotation = 0.0f; // Reset duck rotation to face forward (0 degrees)
-    cars.clear();
-    trees.clear();
-    roadRows.clear();
-    playerScore = 0;
-    gameOver = false;
-    gameSpeed = 1.0f;
-    furthestRow = 0;
-    
-    // Reset camera position to match the new player position
-    camera.Position = glm::vec3(playerPosition.x, playerPosition.y + 10.0f, playerPosition.z - 6.0f);
-    camera.Yaw = 90.0f;   // Face forward
-    camera.Pitch = -30.0f; // Look down at the duck
-    camera.ProcessMouseMovement(0, 0); // Update camera vectors
-    
-    // Initialize the game world with more rows for endless gameplay
-    for (int row = 0; row < VISIBLE_ROWS * 2; ++row) {
-        spawnNewRow();
-    }
-    
-    std::cout << "Crossy Road Started! Use WASD to move, R to restart" << std::endl;
-}
-
-void spawnNewRow() {
-    int rowIndex = roadRows.size();
-    float rowZ = (rowIndex * MOVE_DISTANCE) - 10.0f;
-    
-    // Initially mark as no road (0)
-    bool hasRoad = false;
-    
-    // Decide whether to spawn cars (and thus create a road)
-    if (distribution(generator) < 0.5f) { // 50% chance to spawn car lanes
-        hasRoad = true; // This row will have a road because it has cars
-        
-        int numLanes = 1; // Single lane to match car width
-        bool movingRight = distribution(generator) < 0.5f; // Random direction
-        
-        int numCarsPerLane = 1 + (distribution(generator) * 2); // 1-3 cars per lane
-        
-        for (int i = 0; i < numCarsPerLane; ++i) {
-            Car car;
-            car.position.y = 0.0f; // Position cars on road surface
-            car.rowIndex = rowIndex; // Track which row this car belongs to
-            
-            car.position.z = rowZ; // Cars stay in the center of the road row
-            
-            car.speed = CAR_SPEED * (0.7f + distribution(generator) * 0.6f); // Speed variation
-            car.movingRight = movingRight;
-            car.lane = rowIndex * 10; // Unique lane identifier
-            
-            // Space cars out along the road with proper gaps
-            float carSpacing = 6.0f + distribution(generator) * 8.0f; // 6-14 units apart
-            
-            if (movingRight) {
-                car.position.x = -GRID_WIDTH * MOVE_DISTANCE - 20 - (i * carSpacing); // Start off-screen left
-            } else {
-                car.position.x = GRID_WIDTH * MOVE_DISTANCE + 20 + (i * carSpacing); // Start off-screen right
-            }
-            
-            cars.push_back(car);
-        }
-    } else {
-        // This is a safe lane (no cars), potentially spawn trees as obstacles
-        if (distribution(generator) < 0.4f) { // 40% chance to spawn trees on safe lanes
-            int numTrees = 1 + static_cast<int>(distribution(generator) * 3); // 1-3 trees per safe lane
-            
-            for (int i = 0; i < numTrees; ++i) {
-                Tree tree;
-                tree.position.y = -0.5f; // Position trees at ground level
-                tree.position.z = rowZ; // Same Z as the row
-                
-                // Random X position within the lane, but not too close to edges
-                float minX = -GRID_WIDTH * MOVE_DISTANCE * 0.8f;
-                float maxX = GRID_WIDTH * MOVE_DISTANCE * 0.8f;
-                tree.position.x = minX + distribution(generator) * (maxX - minX);
-                
-                trees.push_back(tree);
-            }
-        }
-    }
-    
-    // Add to roadRows: 1 if has road (with cars), 0 if no road (safe area)
-    roadRows.push_back(hasRoad ? 1 : 0);
+// Camera to render with: blended between the snapshot's previous and current tick
+Camera snapshotCamera(const GameSnapshot& snapshot, float alpha) {
+    Camera renderCamera = camera; // keeps the scroll zoom
+    renderCamera.Position = glm::mix(snapshot.previousCamera.position, snapshot.camera.position, alpha);
+    renderCamera.Yaw = glm::mix(snapshot.previousCamera.yaw, snapshot.camera.yaw, alpha);
+    renderCamera.Pitch = glm::mix(snapshot.previousCamera.pitch, snapshot.camera.pitch, alpha);
+    renderCamera.ProcessMouseMovement(0, 0); // Update camera vectors
+    return renderCamera;
 }
 
 // renderCube() renders a 1x1 3D cube for road markings
@@ -631,16 +567,282 @@ void renderCube()
     glBindVertexArray(0);
 }
 
-// Function to check if player can move to a position (tree collision)
-bool canMoveTo(glm::vec3 newPosition) {
-    const float TREE_COLLISION_DISTANCE = 1.5f; // Trees have larger collision radius
-    
-    for (const auto& tree : trees) {
-        float distance = glm::length(glm::vec2(newPosition.x - tree.position.x, newPosition.z - tree.position.z));
-        if (distance < TREE_COLLISION_DISTANCE) {
-            return false; // Cannot move, tree is blocking
+// Record one draw packet per mesh of a loaded model, in place of Model::Draw.
+// The model shader only samples texture_diffuse1, so only the first diffuse map is bound.
+void queueModel(RenderQueue& queue, Model& model, const std::vector<GLenum>& indexTypes, unsigned int program, const glm::mat4& transform, glm::vec3 position, glm::vec3 eye) {
+    DrawPacket packet;
+    packet.program = program;
+    packet.textures[1] = 0;
+    packet.firstIndexOffset = 0;
+    packet.baseVertex = 0;
+    packet.depth = glm::length(position - eye) / 100.0f; // far plane
+    packet.model = transform;
+    for (size_t m = 0; m < model.meshes.size(); ++m) {
+        Mesh& mesh = model.meshes[m];
+        packet.vao = mesh.VAO;
+        packet.indexType = indexTypes[m];
+        packet.indexCount = (GLsizei)mesh.indices.size();
+        packet.textures[0] = 0;
+        for (const Texture& texture : mesh.textures) {
+            if (texture.type == "texture_diffuse") {
+                packet.textures[0] = texture.id;
+                break;
+            }
+        }
+        queue.submit(packet);
+    }
+}
+
+// Headless stand-in for the draw side: builds every model matrix a real frame would
+// and busy-waits the rest of renderMicros in place of GL submission and the swap.
+float renderStandIn(const GameSnapshot& snapshot, float alpha, int64_t renderMicros) {
+    int64_t until = pipelineMicros() + renderMicros;
+    glm::mat4 sum(0.0f);
+    for (const auto& car : snapshot.cars) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::mix(car.previousPosition, car.position, alpha));
+        model = glm::rotate(model, glm::radians(car.movingRight ? 90.0f : -90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        sum += glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
+    }
+    for (const auto& tree : snapshot.trees) {
+        glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(tree.position.x, -0.5f, tree.position.z));
+        sum += glm::scale(model, glm::vec3(0.003f, 0.003f, 0.003f));
+    }
+    while (pipelineMicros() < until)
+        ;
+    return sum[3][0];
+}
+
+// Same game, same synthetic key presses (one every 173 ms), run twice: serially like
+// the original loop (input, ticks, draw on one thread) and pipelined through
+// SimulationThread. Latency is press -> end of the first frame that shows its tick.
+int runPipelineBenchmark(double seconds, double simMs, double renderMs) {
+    const double step = 1.0 / 60.0;
+    const int64_t pressInterval = 173000; // not a multiple of the tick, so presses land at every phase
+    const uint8_t presses[] = { INPUT_FORWARD, INPUT_LEFT, INPUT_FORWARD, INPUT_RIGHT };
+    int64_t simMicros = (int64_t)(simMs * 1000.0);
+    int64_t renderMicros = (int64_t)(renderMs * 1000.0);
+    int64_t duration = (int64_t)(seconds * 1.0e6);
+    volatile float sink = 0.0f;
+
+    std::cout << "Pipeline benchmark: " << seconds << " s per mode, " << simMs << " ms per tick, "
+              << renderMs << " ms per frame" << std::endl;
+
+    for (int pipelined = 0; pipelined <= 1; ++pipelined) {
+        CrossyWorld world;
+        InputMailbox input;
+        TripleBuffer<GameSnapshot> snapshots;
+        SimulationThread simulation(world, input, snapshots, step, simMicros);
+        FixedTimestep clock(step); // serial mode only
+        GameSnapshot serialSnapshot;
+        FrameTimeStats frameTimes;
+        FrameTimeStats latency;
+        long long frames = 0;
+        long long serialTicks = 0;
+        int64_t lastMeasuredInput = 0;
+        int pressIndex = 0;
+        uint8_t pendingPress = 0; // serial mode: presses waiting for the next tick
+        int64_t pendingMicros = 0;
+
+        if (pipelined) {
+            simulation.start();
+            while (!snapshots.update())
+                std::this_thread::yield();
+        }
+        int64_t start = pipelineMicros();
+        int64_t nextPress = start + pressInterval;
+        int64_t frameStart = start;
+        while (frameStart - start < duration) {
+            // input, sampled at the start of the frame like processInput()
+            uint8_t pressed = 0;
+            if (frameStart >= nextPress) {
+                const GameSnapshot& last = pipelined ? snapshots.readBuffer() : serialSnapshot;
+                pressed = last.gameOver ? INPUT_RESET : presses[pressIndex++ % 4];
+                nextPress += pressInterval;
+            }
+
+            const GameSnapshot* snapshot;
+            float alpha;
+            if (pipelined) {
+                if (pressed != 0)
+                    input.press(pressed, frameStart);
+                snapshots.update();
+                snapshot = &snapshots.readBuffer();
+                alpha = glm::clamp((float)((frameStart - snapshot->publishMicros) * 1.0e-6 / step), 0.0f, 1.0f);
+            } else {
+                if (pressed != 0) {
+                    pendingPress |= pressed;
+                    pendingMicros = frameStart;
+                }
+                int steps = clock.advance((frameStart - start) * 1.0e-6);
+                for (int i = 0; i < steps; ++i) {
+                    world.applyInput(pendingPress, pendingMicros);
+                    pendingPress = 0;
+                    world.tick(clock.dt());
+                    int64_t until = pipelineMicros() + simMicros;
+                    while (pipelineMicros() < until)
+                        ;
+                    serialTicks++;
+                }
+                captureSnapshot(world, serialSnapshot);
+                serialSnapshot.publishMicros = pipelineMicros();
+                snapshot = &serialSnapshot;
+                alpha = clock.alpha();
+            }
+
+            sink = sink + renderStandIn(*snapshot, alpha, renderMicros);
+
+            int64_t frameEnd = pipelineMicros();
+            if (snapshot->lastInputMicros > lastMeasuredInput) {
+                latency.add((frameEnd - snapshot->lastInputMicros) * 1.0e-6);
+                lastMeasuredInput = snapshot->lastInputMicros;
+            }
+            frameTimes.add((frameEnd - frameStart) * 1.0e-6);
+            frameStart = frameEnd;
+            frames++;
+        }
+        simulation.stop();
+
+        double elapsed = (frameStart - start) * 1.0e-6;
+        long long ticks = pipelined ? simulation.ticks() : serialTicks;
+        const char* mode = pipelined ? "Pipelined" : "Serial";
+        std::cout << mode << ": " << frames / elapsed << " frames/s, " << ticks / elapsed << " ticks/s" << std::endl;
+        frameTimes.report(std::cout, pipelined ? "Pipelined frame time" : "Serial frame time");
+        latency.report(std::cout, pipelined ? "Pipelined input latency" : "Serial input latency");
+    }
+    return 0;
+}
+
+// Car work per tick for worlds of 32 to 16384 rows: stepping every lane of the world
+// against what tick() and captureSnapshot() do (step the lanes up to the spawn horizon,
+// copy out the visible rows). Then the smallest bumper-to-bumper gap and the mean speed
+// of a fresh world's lanes after `minutes` at 60 Hz; a negative gap means cars overlap.
+int runCarMotionBenchmark(double minutes) {
+    const int sizes[] = { 32, 256, 2048, 16384 };
+    const int benchTicks = 600;
+    const float dt = 1.0f / 60.0f;
+
+    std::cout << "Car motion benchmark: " << benchTicks << " ticks per world" << std::endl;
+    for (int rows : sizes) {
+        CrossyWorld world;
+        world.spawnRows(rows - world.rowCount());
+        size_t carCount = world.cars.size();
+        TrafficModel everyLane = world.lanes;
+
+        auto start = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < benchTicks; ++tick)
+            everyLane.step(dt);
+        double everySeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        GameSnapshot snapshot;
+        size_t drawn = 0;
+        start = std::chrono::steady_clock::now();
+        for (int tick = 0; tick < benchTicks; ++tick) {
+            world.tick(dt);
+            captureSnapshot(world, snapshot);
+            drawn += snapshot.cars.size();
         }
+        double gameSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "  " << rows << " rows, " << carCount << " cars: step every lane "
+                  << everySeconds / benchTicks * 1.0e6 << " us/tick, tick and snapshot "
+                  << gameSeconds / benchTicks * 1.0e6 << " us/tick (" << drawn / benchTicks << " visible cars)" << std::endl;
     }
-    return true; // Can move, no trees blocking
+
+    CrossyWorld world;
+    long long runTicks = (long long)(minutes * 60.0 * 60.0);
+    for (long long tick = 0; tick < runTicks; ++tick)
+        world.lanes.step(dt);
+    std::cout << "After " << minutes << " min: smallest gap " << world.lanes.minimumGap() << ", mean speed "
+              << world.lanes.meanSpeed() << std::endl;
+    return 0;
 }
 
+// A duck standing at x = 0 in every road row of a 2048-row world while the traffic
+// drives until even the slowest car has made a full lap. Polling checks every car's
+// distance at the end of each tick, as checkCollisions() once did; the sweep asks each
+// lane once per tick whether a car passed through the cell during the step. Fast cars
+// at low tick rates jump over the duck between two polls; the sweep has no such gap.
+int runCollisionBenchmark(float gameSpeed) {
+    const double rates[] = { 60.0, 20.0, 10.0, 5.0 };
+    CrossyWorld world;
+    world.spawnRows(2048 - world.rowCount());
+    size_t laneCount = world.lanes.laneCount();
+    float slowest = CAR_SPEED * 0.7f * (1.0f - world.traffic.speedVariation);
+
+    std::cout << "Collision benchmark: " << world.cars.size() << " cars in " << laneCount << " lanes, gameSpeed " << gameSpeed
+              << std::endl;
+    for (double rate : rates) {
+        float roadStep = (float)(gameSpeed / rate); // road time per tick
+        long long ticks = (long long)std::ceil(2.0f * ROAD_HALF_LENGTH / slowest / roadStep);
+        TrafficModel traffic = world.lanes;
+        std::vector<char> polled(laneCount, 0), swept(laneCount, 0);
+        double pollSeconds = 0.0, sweepSeconds = 0.0;
+        for (long long tick = 0; tick < ticks; ++tick) {
+            traffic.step(roadStep);
+            auto start = std::chrono::steady_clock::now();
+            for (size_t l = 0; l < laneCount; ++l) {
+                const TrafficLane& lane = traffic.lane(l);
+                for (size_t i = 0; i < lane.size() && !polled[l]; ++i)
+                    if (std::fabs(lane.wrapped(i) - ROAD_HALF_LENGTH) < COLLISION_DISTANCE)
+                        polled[l] = 1;
+            }
+            auto middle = std::chrono::steady_clock::now();
+            for (size_t l = 0; l < laneCount; ++l)
+                if (!swept[l] && traffic.lane(l).sweptWithin(ROAD_HALF_LENGTH, COLLISION_DISTANCE))
+                    swept[l] = 1;
+            auto end = std::chrono::steady_clock::now();
+            pollSeconds += std::chrono::duration<double>(middle - start).count();
+            sweepSeconds += std::chrono::duration<double>(end - middle).count();
+        }
+        long long polledHits = std::count(polled.begin(), polled.end(), 1);
+        long long sweptHits = std::count(swept.begin(), swept.end(), 1);
+        double laneTicks = (double)ticks * laneCount;
+        std::cout << "  " << rate << " ticks/s: polling hit " << polledHits << " lanes (" << sweptHits - polledHits
+                  << " tunnelled through), sweep " << sweptHits << "; " << pollSeconds / laneTicks * 1.0e9 << " vs "
+                  << sweepSeconds / laneTicks * 1.0e9 << " ns per lane and tick" << std::endl;
+    }
+    return 0;
+}
+
+// Final state of a replay, hashed to check that it reproduced the recorded session
+uint64_t worldStateHash(const CrossyWorld& world) {
+    uint64_t hash = HASH_SEED;
+    hash = hashBytes(hash, &world.playerPosition, sizeof(world.playerPosition));
+    hash = hashBytes(hash, &world.playerScore, sizeof(world.playerScore));
+    hash = hashBytes(hash, &world.gameOver, sizeof(world.gameOver));
+    hash = hashBytes(hash, &world.ticks, sizeof(world.ticks));
+    for (const auto& car : world.cars) {
+        glm::vec3 position = world.carPosition(car);
+        hash = hashBytes(hash, &position, sizeof(position));
+    }
+    for (const auto& tree : world.trees)
+        hash = hashBytes(hash, &tree.position, sizeof(tree.position));
+    hash = hashBytes(hash, &world.camera, sizeof(world.camera));
+    return hash;
+}
+
+// Replays a recorded input log through a fresh world on this thread, no window or GL.
+// Returns non-zero if a baseline was given and the replay diverged or got slower.
+int replayInputLog(const std::string& path, bool maxSpeed, const std::string& baselinePath, const std::string& saveBaselinePath) {
+    InputReplay replay;
+    if (!replay.load(path))
+        return -1;
+    std::cout << "Replaying " << path << ": " << replay.ticks() << " ticks, " << replay.records() << " input changes"
+              << (maxSpeed ? ", max speed" : ", recorded rate") << std::endl;
+
+    CrossyWorld world;
+    float dt = (float)replay.step();
+    ReplayResult result = runReplay(replay, maxSpeed, [&](uint64_t, uint32_t keys) {
+        world.applyInput((uint8_t)keys, 0);
+        world.tick(dt);
+    });
+    result.stateHash = worldStateHash(world);
+    reportReplay(result, std::cout);
+    std::cout << "Final score: " << world.playerScore << (world.gameOver ? " (game over)" : "") << std::endl;
+
+    if (!saveBaselinePath.empty() && saveReplayBaseline(result, saveBaselinePath))
+        std::cout << "Saved baseline to " << saveBaselinePath << std::endl;
+    if (!baselinePath.empty() && !compareReplayBaseline(result, baselinePath))
+        return 1;
+    return 0;
+}
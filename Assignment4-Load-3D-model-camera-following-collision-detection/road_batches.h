@@ -0,0 +1,281 @@
+// road_batches.h
+// Static batching of the road rows. Road rows never move once spawned (row r sits
+// at z = r * MOVE_DISTANCE - 10), so instead of one Model::Draw per row the road
+// mesh is pre-transformed into per-chunk vertex buffers, CHUNK_ROWS rows each.
+// A chunk is rebuilt only when the set of visible road rows inside it changes,
+// i.e. when a row streams in at the far edge or drops out behind the player.
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <learnopengl/model.h>
+
+#include "../common/render_queue.h"
+#include "game_pipeline.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <vector>
+
+const int CHUNK_ROWS = 8;
+
+// Placement of one road row, as the per-row draw used to compute it
+inline glm::mat4 roadRowTransform(int row)
+{
+    float rowZ = row * MOVE_DISTANCE - 10.0f;
+    float roadWidthX = (GRID_WIDTH * MOVE_DISTANCE) + 10.0f;
+    float roadLengthZ = 0.5f; // decreased road length (depth)
+    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, -1.2f, rowZ)); // Same level as trees
+    return glm::scale(model, glm::vec3(roadWidthX, 1.0f, roadLengthZ));
+}
+
+struct RoadBatchStats
+{
+    unsigned int chunks = 0;      // chunks currently resident
+    unsigned int draws = 0;       // packets queued last frame
+    unsigned int rebuilds = 0;    // chunk rebuilds since the last resetStats()
+    double rebuildMicros = 0.0;   // time spent in those rebuilds
+    double lastRebuildMicros = 0.0;
+};
+
+class RoadBatcher
+{
+public:
+    // keeps a CPU copy of the road model's meshes; the model must outlive the batcher
+    explicit RoadBatcher(Model& roadModel)
+    {
+        for (Mesh& mesh : roadModel.meshes)
+        {
+            SourceMesh source;
+            source.mesh = &mesh;
+            source.texture = 0;
+            for (const Texture& texture : mesh.textures)
+            {
+                if (texture.type == "texture_diffuse")
+                {
+                    source.texture = texture.id;
+                    break;
+                }
+            }
+            sources.push_back(source);
+        }
+    }
+
+    ~RoadBatcher()
+    {
+        for (Chunk& chunk : chunks)
+            releaseBuffers(chunk);
+        for (Chunk& chunk : freeChunks)
+            releaseBuffers(chunk);
+    }
+
+    RoadBatcher(const RoadBatcher&) = delete;
+    RoadBatcher& operator=(const RoadBatcher&) = delete;
+
+    // brings the chunks in line with the rows visible in this snapshot
+    void update(const GameSnapshot& snapshot)
+    {
+        int firstRow = snapshot.firstRow;
+        int lastRow = snapshot.firstRow + (int)snapshot.rows.size() - 1;
+        int firstChunk = firstRow / CHUNK_ROWS;
+        int lastChunk = lastRow >= firstRow ? lastRow / CHUNK_ROWS : firstChunk - 1;
+
+        // chunks that left the visible range go back to the free list, buffers and all
+        for (size_t i = 0; i < chunks.size();)
+        {
+            if (chunks[i].index < firstChunk || chunks[i].index > lastChunk)
+            {
+                freeChunks.push_back(chunks[i]);
+                chunks[i] = chunks.back();
+                chunks.pop_back();
+            }
+            else
+                ++i;
+        }
+
+        for (int index = firstChunk; index <= lastChunk; ++index)
+        {
+            uint32_t mask = 0;
+            for (int r = 0; r < CHUNK_ROWS; ++r)
+            {
+                int row = index * CHUNK_ROWS + r;
+                if (row >= firstRow && row <= lastRow && snapshot.isRoad(row))
+                    mask |= 1u << r;
+            }
+            Chunk* chunk = findChunk(index);
+            if (chunk == nullptr)
+            {
+                chunks.push_back(takeFreeChunk());
+                chunk = &chunks.back();
+                chunk->index = index;
+                chunk->rowMask = ~0u; // force a build
+            }
+            if (chunk->rowMask != mask)
+                rebuild(*chunk, mask);
+        }
+        stats.chunks = (unsigned int)chunks.size();
+    }
+
+    // one packet per non-empty (chunk, road mesh) pair; the geometry is already in world space
+    void queue(RenderQueue& queue, GLuint program, glm::vec3 eye)
+    {
+        stats.draws = 0;
+        DrawPacket packet;
+        packet.program = program;
+        packet.textures[1] = 0;
+        packet.indexType = GL_UNSIGNED_INT;
+        packet.firstIndexOffset = 0;
+        packet.baseVertex = 0;
+        packet.model = glm::mat4(1.0f);
+        for (const Chunk& chunk : chunks)
+        {
+            float chunkZ = (chunk.index * CHUNK_ROWS + CHUNK_ROWS * 0.5f) * MOVE_DISTANCE - 10.0f;
+            packet.depth = std::abs(chunkZ - eye.z) / 100.0f; // far plane
+            for (size_t m = 0; m < chunk.parts.size(); ++m)
+            {
+                if (chunk.parts[m].indexCount == 0)
+                    continue;
+                packet.vao = chunk.parts[m].vao;
+                packet.textures[0] = sources[m].texture;
+                packet.indexCount = chunk.parts[m].indexCount;
+                queue.submit(packet);
+                stats.draws++;
+            }
+        }
+    }
+
+    const RoadBatchStats& statistics() const { return stats; }
+    void resetStats()
+    {
+        stats.rebuilds = 0;
+        stats.rebuildMicros = 0.0;
+    }
+
+private:
+    struct SourceMesh
+    {
+        Mesh* mesh;
+        GLuint texture;
+    };
+
+    struct ChunkPart // one road mesh's share of a chunk
+    {
+        GLuint vao = 0;
+        GLuint vbo = 0;
+        GLuint ebo = 0;
+        GLsizei indexCount = 0;
+    };
+
+    struct Chunk
+    {
+        int index = 0;
+        uint32_t rowMask = 0; // bit r set = row index * CHUNK_ROWS + r is a visible road
+        std::vector<ChunkPart> parts;
+    };
+
+    Chunk* findChunk(int index)
+    {
+        for (Chunk& chunk : chunks)
+            if (chunk.index == index)
+                return &chunk;
+        return nullptr;
+    }
+
+    Chunk takeFreeChunk()
+    {
+        if (freeChunks.empty())
+            return Chunk();
+        Chunk chunk = freeChunks.back();
+        freeChunks.pop_back();
+        return chunk;
+    }
+
+    void rebuild(Chunk& chunk, uint32_t mask)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (chunk.parts.size() != sources.size())
+            chunk.parts.resize(sources.size());
+
+        for (size_t m = 0; m < sources.size(); ++m)
+        {
+            const Mesh& mesh = *sources[m].mesh;
+            ChunkPart& part = chunk.parts[m];
+            vertices.clear();
+            indices.clear();
+            for (int r = 0; r < CHUNK_ROWS; ++r)
+            {
+                if ((mask & (1u << r)) == 0)
+                    continue;
+                glm::mat4 model = roadRowTransform(chunk.index * CHUNK_ROWS + r);
+                glm::mat3 normalMatrix = glm::transpose(glm::inverse(glm::mat3(model)));
+                unsigned int base = (unsigned int)(vertices.size() / 8);
+                for (const Vertex& vertex : mesh.vertices)
+                {
+                    glm::vec3 position = glm::vec3(model * glm::vec4(vertex.Position, 1.0f));
+                    glm::vec3 normal = glm::normalize(normalMatrix * vertex.Normal);
+                    float packed[8] = { position.x, position.y, position.z, normal.x, normal.y, normal.z,
+                                        vertex.TexCoords.x, vertex.TexCoords.y };
+                    vertices.insert(vertices.end(), packed, packed + 8);
+                }
+                for (unsigned int index : mesh.indices)
+                    indices.push_back(base + index);
+            }
+
+            part.indexCount = (GLsizei)indices.size();
+            if (part.indexCount == 0)
+                continue;
+            if (part.vao == 0)
+            {
+                glGenVertexArrays(1, &part.vao);
+                glGenBuffers(1, &part.vbo);
+                glGenBuffers(1, &part.ebo);
+                glBindVertexArray(part.vao);
+                glBindBuffer(GL_ARRAY_BUFFER, part.vbo);
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, part.ebo);
+                // same attribute locations as the model shader: position, normal, texcoords
+                glEnableVertexAttribArray(0);
+                glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)0);
+                glEnableVertexAttribArray(1);
+                glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(3 * sizeof(float)));
+                glEnableVertexAttribArray(2);
+                glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, 8 * sizeof(float), (void*)(6 * sizeof(float)));
+            }
+            else
+            {
+                glBindVertexArray(part.vao);
+                glBindBuffer(GL_ARRAY_BUFFER, part.vbo);
+            }
+            glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), vertices.data(), GL_STATIC_DRAW);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int), indices.data(), GL_STATIC_DRAW);
+            glBindVertexArray(0);
+        }
+        chunk.rowMask = mask;
+
+        double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+        stats.rebuilds++;
+        stats.rebuildMicros += micros;
+        stats.lastRebuildMicros = micros;
+    }
+
+    static void releaseBuffers(Chunk& chunk)
+    {
+        for (ChunkPart& part : chunk.parts)
+        {
+            if (part.vao == 0)
+                continue;
+            glDeleteVertexArrays(1, &part.vao);
+            glDeleteBuffers(1, &part.vbo);
+            glDeleteBuffers(1, &part.ebo);
+        }
+    }
+
+    std::vector<SourceMesh> sources;
+    std::vector<Chunk> chunks;
+    std::vector<Chunk> freeChunks;
+    std::vector<float> vertices; // scratch, reused across rebuilds
+    std::vector<unsigned int> indices;
+    RoadBatchStats stats;
+};
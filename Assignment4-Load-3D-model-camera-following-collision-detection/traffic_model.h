@@ -0,0 +1,290 @@
+// traffic_model.h
+// Lane traffic with interacting cars: every car follows the one ahead of it with the
+// Intelligent Driver Model, which keeps a speed-dependent gap and matches the leader's
+// speed.
+//  - TrafficLane: a ring road of one lane. Positions are kept unwrapped and sorted
+//    (IDM cars never overtake), so a car's leader is simply the next element, and the
+//    last car follows the first one a lap ahead: neighbour lookups are O(1)
+//  - TrafficModel: many independent lanes; step() splits them across a ThreadPool.
+//    The game keeps one lane per road row in one (see CrossyWorld), adding lanes as
+//    rows are spawned and releasing them from the front as rows are recycled
+//  - runTrafficBenchmark: headless throughput from 10^3 to 10^6 cars
+#pragma once
+
+#include "../common/thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <random>
+#include <vector>
+
+struct TrafficSettings
+{
+    float desiredSpeed = 10.0f;     // mean free-road speed, CAR_SPEED
+    float speedVariation = 0.3f;    // each car's free-road speed is desiredSpeed * (1 +- this)
+    float timeHeadway = 1.2f;       // seconds of gap kept to the leader
+    float minimumGap = 1.5f;        // bumper to bumper, when stopped
+    float maxAcceleration = 2.0f;
+    float comfortableDeceleration = 3.0f;
+    float carLength = 3.0f;
+};
+
+struct TrafficLane
+{
+    float length = 0.0f;
+    // structure of arrays, sorted by position; position[0] <= ... < position[0] + length
+    std::vector<float> position;
+    std::vector<float> velocity;
+    std::vector<float> desiredSpeed;
+    std::vector<float> acceleration; // scratch, so a step reads only the old state
+    std::vector<float> previousPosition; // before the last step, for interpolation and swept hit tests
+
+    size_t size() const { return position.size(); }
+
+    // appends a car ahead of all the others, at most a lap ahead of the first
+    void addCar(float at, float speed, float desired)
+    {
+        position.push_back(at);
+        velocity.push_back(speed);
+        desiredSpeed.push_back(desired);
+        acceleration.push_back(0.0f);
+        previousPosition.push_back(at);
+    }
+
+    // an unwrapped position on the ring, in [0, length)
+    float wrap(float x) const
+    {
+        x = std::fmod(x, length);
+        return x < 0.0f ? x + length : x;
+    }
+
+    // position of car i on the ring, in [0, length)
+    float wrapped(size_t i) const { return wrap(position[i]); }
+
+    // Whether a car swept over (at - reach, at + reach) in the last step, ring position
+    // `at` in [0, length). Positions and previous positions are both sorted, so on each
+    // lap of the ring only the first car past the near edge can have reached the far one
+    // from behind it; it is found by binary search.
+    bool sweptWithin(float at, float reach) const
+    {
+        for (int lap = -1; lap <= 1; ++lap)
+        {
+            float nearEdge = at + lap * length - reach;
+            size_t i = std::upper_bound(position.begin(), position.end(), nearEdge) - position.begin();
+            if (i < size() && previousPosition[i] < nearEdge + 2.0f * reach)
+                return true;
+        }
+        return false;
+    }
+
+    // bumper-to-bumper distance to the car ahead, and that car's speed
+    float gapAhead(size_t i, float carLength, float& leaderSpeed) const
+    {
+        size_t leader = i + 1 < size() ? i + 1 : 0;
+        leaderSpeed = velocity[leader];
+        float ahead = leader > i ? position[leader] : position[leader] + length;
+        return ahead - position[i] - carLength;
+    }
+};
+
+class TrafficModel
+{
+public:
+    // no lanes yet; see addLane
+    explicit TrafficModel(const TrafficSettings& settings = TrafficSettings()) : settings(settings) {}
+
+    // `lanes` rings of `laneLength`, each with `carsPerLane` cars spaced evenly at rest
+    TrafficModel(int lanes, int carsPerLane, float laneLength, const TrafficSettings& settings = TrafficSettings(), unsigned int seed = 1)
+        : settings(settings), lanes(lanes)
+    {
+        std::mt19937 generator(seed);
+        std::uniform_real_distribution<float> variation(-settings.speedVariation, settings.speedVariation);
+        float spacing = laneLength / std::max(1, carsPerLane);
+        for (TrafficLane& lane : this->lanes)
+        {
+            lane.length = laneLength;
+            lane.position.resize(carsPerLane);
+            lane.velocity.assign(carsPerLane, 0.0f);
+            lane.desiredSpeed.resize(carsPerLane);
+            lane.acceleration.assign(carsPerLane, 0.0f);
+            lane.previousPosition.resize(carsPerLane);
+            for (int i = 0; i < carsPerLane; ++i)
+            {
+                lane.position[i] = lane.previousPosition[i] = i * spacing;
+                lane.desiredSpeed[i] = settings.desiredSpeed * (1.0f + variation(generator));
+            }
+        }
+    }
+
+    // Advances every lane by dt. With a pool, lanes are cut into one chunk per worker;
+    // each lane is only ever touched by one thread, so no locking is needed.
+    void step(float dt, ThreadPool* pool = nullptr) { step(0, lanes.size(), dt, pool); }
+
+    // advances lanes [begin, end) only
+    void step(size_t begin, size_t end, float dt, ThreadPool* pool = nullptr)
+    {
+        size_t count = end - begin;
+        if (pool == nullptr || pool->size() < 2 || count < 2)
+        {
+            stepLanes(begin, end, dt);
+            return;
+        }
+        size_t chunks = std::min<size_t>(pool->size(), count);
+        for (size_t chunk = 0; chunk < chunks; ++chunk)
+        {
+            size_t first = begin + count * chunk / chunks;
+            size_t last = begin + count * (chunk + 1) / chunks;
+            pool->enqueue([this, first, last, dt] { stepLanes(first, last, dt); });
+        }
+        pool->waitIdle();
+    }
+
+    // An empty lane at the back. The storage of released lanes is reused, so once as many
+    // lanes as ever live at once have been added this no longer allocates.
+    TrafficLane& addLane(float length)
+    {
+        if (spare.empty())
+            lanes.emplace_back();
+        else
+        {
+            lanes.push_back(std::move(spare.back()));
+            spare.pop_back();
+        }
+        TrafficLane& lane = lanes.back();
+        lane.length = length;
+        lane.position.clear();
+        lane.velocity.clear();
+        lane.desiredSpeed.clear();
+        lane.acceleration.clear();
+        lane.previousPosition.clear();
+        return lane;
+    }
+
+    // drops the first `count` lanes and keeps the order of the rest
+    void releaseFront(size_t count)
+    {
+        count = std::min(count, lanes.size());
+        for (size_t l = 0; l < count; ++l)
+            spare.push_back(std::move(lanes[l]));
+        lanes.erase(lanes.begin(), lanes.begin() + count);
+    }
+
+    void clear() { releaseFront(lanes.size()); }
+
+    size_t laneCount() const { return lanes.size(); }
+    TrafficLane& lane(size_t index) { return lanes[index]; }
+    const TrafficLane& lane(size_t index) const { return lanes[index]; }
+    const std::vector<TrafficLane>& laneData() const { return lanes; }
+
+    size_t carCount() const
+    {
+        size_t count = 0;
+        for (const TrafficLane& lane : lanes)
+            count += lane.size();
+        return count;
+    }
+
+    // smallest bumper-to-bumper gap anywhere; negative means two cars overlap
+    float minimumGap() const
+    {
+        float smallest = INFINITY;
+        float leaderSpeed;
+        for (const TrafficLane& lane : lanes)
+            for (size_t i = 0; i < lane.size(); ++i)
+                smallest = std::min(smallest, lane.gapAhead(i, settings.carLength, leaderSpeed));
+        return smallest;
+    }
+
+    float meanSpeed() const
+    {
+        double sum = 0.0;
+        size_t count = 0;
+        for (const TrafficLane& lane : lanes)
+        {
+            for (float speed : lane.velocity)
+                sum += speed;
+            count += lane.size();
+        }
+        return count > 0 ? (float)(sum / count) : 0.0f;
+    }
+
+private:
+    void stepLanes(size_t first, size_t last, float dt)
+    {
+        for (size_t l = first; l < last; ++l)
+            stepLane(lanes[l], dt);
+    }
+
+    void stepLane(TrafficLane& lane, float dt) const
+    {
+        const float brakingTerm = 1.0f / (2.0f * std::sqrt(settings.maxAcceleration * settings.comfortableDeceleration));
+        size_t count = lane.size();
+        for (size_t i = 0; i < count; ++i)
+        {
+            float speed = lane.velocity[i];
+            float leaderSpeed;
+            float gap = std::max(lane.gapAhead(i, settings.carLength, leaderSpeed), 0.01f);
+            float desiredGap = settings.minimumGap + std::max(0.0f, speed * settings.timeHeadway + speed * (speed - leaderSpeed) * brakingTerm);
+            float freeRoad = speed / lane.desiredSpeed[i];
+            freeRoad *= freeRoad;
+            float interaction = desiredGap / gap;
+            lane.acceleration[i] = settings.maxAcceleration * (1.0f - freeRoad * freeRoad - interaction * interaction);
+        }
+        // ballistic update; speeds never go negative, so cars never reverse into the one behind
+        for (size_t i = 0; i < count; ++i)
+        {
+            lane.previousPosition[i] = lane.position[i];
+            float speed = lane.velocity[i];
+            float nextSpeed = std::max(0.0f, speed + lane.acceleration[i] * dt);
+            lane.position[i] += nextSpeed > 0.0f ? 0.5f * (speed + nextSpeed) * dt : 0.0f;
+            lane.velocity[i] = nextSpeed;
+        }
+        // keep the unwrapped positions small so float precision holds over long runs
+        if (count > 0 && lane.position[0] >= lane.length)
+            for (size_t i = 0; i < count; ++i)
+            {
+                lane.position[i] -= lane.length;
+                lane.previousPosition[i] -= lane.length;
+            }
+    }
+
+    TrafficSettings settings;
+    std::vector<TrafficLane> lanes;
+    std::vector<TrafficLane> spare; // released lanes, kept for their storage
+};
+
+// Headless: 10^3 .. maxCars cars on ring lanes of 25 units per car, 1000 cars per lane at
+// most, stepped at 60 Hz with 1 thread and with `threads` workers. Reports car updates
+// per second and checks the model kept every gap open.
+inline int runTrafficBenchmark(size_t maxCars, unsigned int threads)
+{
+    const float dt = 1.0f / 60.0f;
+    const float spacing = 25.0f; // lane length per car
+    ThreadPool pool(threads);
+    std::cout << "Traffic benchmark: IDM car following, " << pool.size() << " worker threads" << std::endl;
+    for (size_t cars = 1000; cars <= maxCars; cars *= 10)
+    {
+        int carsPerLane = (int)std::min<size_t>(cars, 1000);
+        int lanes = (int)(cars / carsPerLane);
+        TrafficModel model(lanes, carsPerLane, carsPerLane * spacing);
+        // warm up out of the standing start, then time enough steps for ~0.5 s per mode
+        for (int i = 0; i < 60; ++i)
+            model.step(dt, &pool);
+        int steps = (int)std::max<size_t>(10, 20000000 / cars);
+        double secondsPerMode[2];
+        for (int parallel = 0; parallel <= 1; ++parallel)
+        {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < steps; ++i)
+                model.step(dt, parallel ? &pool : nullptr);
+            secondsPerMode[parallel] = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        std::cout << "  " << cars << " cars in " << lanes << " lanes: " << cars * steps / secondsPerMode[0] / 1.0e6
+                  << " M car updates/s on 1 thread, " << cars * steps / secondsPerMode[1] / 1.0e6 << " M on "
+                  << pool.size() << " (" << secondsPerMode[0] / steps * 1000.0 << " -> " << secondsPerMode[1] / steps * 1000.0
+                  << " ms per step); mean speed " << model.meanSpeed() << ", smallest gap " << model.minimumGap() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,299 @@
+// world_snapshot.h
+// Save and resume of a whole CrossyWorld, for long runs. The file is the world's
+// state as flat arrays of its own POD types, so saving is one gathering write
+// straight from the pools (only the traffic lanes' state is gathered into one array
+// first) and resuming maps the file and copies each array in one go; nothing is
+// parsed per object.
+//
+// File format (native byte order and type layout):
+//   SnapshotHeader   "CRSN", version, the sizes of the stored types, then the count
+//                    and offset of each section and the file size
+//   WorldScalars     player, camera, score, gameSpeed, road clock, road spawner and
+//                    random generator state
+//   Car[cars]  Tree[trees]  int32 roadRows[rows]  LaneCarState[cars], each on a
+//                    16-byte boundary; the lane states are in the cars' order
+// A file written by another compiler or standard library (different type sizes) is
+// refused rather than misread. The lanes themselves are rebuilt from the cars' rows.
+//  - saveWorldSnapshot / loadWorldSnapshot
+//  - runSnapshotBenchmark: save and load times for worlds of 10^3 to 10^6 rows
+#pragma once
+
+#include "../common/mapped_file.h"
+#include "crossy_world.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+const uint16_t WORLD_SNAPSHOT_VERSION = 2;
+const size_t WORLD_SNAPSHOT_ALIGNMENT = 16;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t scalarsSize; // sizeof(WorldScalars), sizeof(Car), sizeof(Tree), sizeof(LaneCarState)
+    uint32_t carSize;
+    uint32_t treeSize;
+    uint32_t laneCarSize;
+    uint64_t carCount;
+    uint64_t treeCount;
+    uint64_t rowCount;
+    uint64_t scalarsOffset;
+    uint64_t carOffset;
+    uint64_t treeOffset;
+    uint64_t rowOffset;
+    uint64_t laneCarOffset;
+    uint64_t fileSize;
+};
+
+// One car's slot of its TrafficLane
+struct LaneCarState {
+    float position;
+    float previousPosition;
+    float velocity;
+    float desiredSpeed;
+};
+
+// Everything of CrossyWorld that is not an array
+struct WorldScalars {
+    glm::vec3 playerPosition;
+    float playerRotation;
+    int32_t firstRoadRow;
+    int32_t playerScore;
+    int32_t furthestRow;
+    int32_t roadLanesLeft;
+    int32_t roadLaneCount;
+    uint8_t gameOver;
+    uint8_t roadFlowsRight;
+    float gameSpeed;
+    RoadClock roadClock;
+    TrafficSettings traffic;
+    std::default_random_engine generator;
+    std::uniform_real_distribution<float> distribution;
+    FollowCamera camera;
+    FollowCamera previousCamera;
+    int64_t ticks;
+};
+
+static_assert(std::is_trivially_copyable<WorldScalars>::value, "WorldScalars is stored as raw bytes");
+static_assert(std::is_trivially_copyable<Car>::value, "Car is stored as raw bytes");
+static_assert(std::is_trivially_copyable<Tree>::value, "Tree is stored as raw bytes");
+static_assert(std::is_trivially_copyable<LaneCarState>::value, "LaneCarState is stored as raw bytes");
+static_assert(sizeof(int) == sizeof(int32_t), "roadRows is stored as int32");
+
+inline uint64_t alignSnapshotOffset(uint64_t offset) {
+    return (offset + WORLD_SNAPSHOT_ALIGNMENT - 1) / WORLD_SNAPSHOT_ALIGNMENT * WORLD_SNAPSHOT_ALIGNMENT;
+}
+
+// Call while nothing else is ticking the world (before the simulation thread starts or after it stops)
+inline bool saveWorldSnapshot(const CrossyWorld& world, const std::string& path) {
+    WorldScalars scalars;
+    std::memset((void*)&scalars, 0, sizeof(scalars)); // the padding goes to disk too
+    scalars.playerPosition = world.playerPosition;
+    scalars.playerRotation = world.playerRotation;
+    scalars.firstRoadRow = world.firstRoadRow;
+    scalars.playerScore = world.playerScore;
+    scalars.furthestRow = world.furthestRow;
+    scalars.roadLanesLeft = world.roadLanesLeft;
+    scalars.roadLaneCount = world.roadLaneCount;
+    scalars.gameOver = world.gameOver;
+    scalars.roadFlowsRight = world.roadFlowsRight;
+    scalars.gameSpeed = world.gameSpeed;
+    scalars.roadClock = world.roadClock;
+    scalars.traffic = world.traffic;
+    scalars.generator = world.generator;
+    scalars.distribution = world.distribution;
+    scalars.camera = world.camera;
+    scalars.previousCamera = world.previousCamera;
+    scalars.ticks = world.ticks;
+
+    // the lanes hold their cars in the pool's order: by row, then slot
+    std::vector<LaneCarState> laneCars;
+    laneCars.reserve(world.cars.size());
+    for (const TrafficLane& lane : world.lanes.laneData())
+        for (size_t i = 0; i < lane.size(); ++i)
+            laneCars.push_back({ lane.position[i], lane.previousPosition[i], lane.velocity[i], lane.desiredSpeed[i] });
+
+    SnapshotHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, "CRSN", 4);
+    header.version = WORLD_SNAPSHOT_VERSION;
+    header.scalarsSize = sizeof(WorldScalars);
+    header.carSize = sizeof(Car);
+    header.treeSize = sizeof(Tree);
+    header.laneCarSize = sizeof(LaneCarState);
+    header.carCount = world.cars.size();
+    header.treeCount = world.trees.size();
+    header.rowCount = world.roadRows.size();
+    header.scalarsOffset = alignSnapshotOffset(sizeof(SnapshotHeader));
+    header.carOffset = alignSnapshotOffset(header.scalarsOffset + sizeof(WorldScalars));
+    header.treeOffset = alignSnapshotOffset(header.carOffset + header.carCount * sizeof(Car));
+    header.rowOffset = alignSnapshotOffset(header.treeOffset + header.treeCount * sizeof(Tree));
+    header.laneCarOffset = alignSnapshotOffset(header.rowOffset + header.rowCount * sizeof(int32_t));
+    header.fileSize = header.laneCarOffset + laneCars.size() * sizeof(LaneCarState);
+
+    // the gaps between sections are taken from a block of zeros
+    static const unsigned char zeros[WORLD_SNAPSHOT_ALIGNMENT] = {};
+    auto gap = [](uint64_t from, uint64_t to) { return FileSection { zeros, (size_t)(to - from) }; };
+    FileSection sections[] = {
+        { &header, sizeof(header) },
+        gap(sizeof(header), header.scalarsOffset),
+        { &scalars, sizeof(scalars) },
+        gap(header.scalarsOffset + sizeof(scalars), header.carOffset),
+        { world.cars.begin(), (size_t)header.carCount * sizeof(Car) },
+        gap(header.carOffset + header.carCount * sizeof(Car), header.treeOffset),
+        { world.trees.begin(), (size_t)header.treeCount * sizeof(Tree) },
+        gap(header.treeOffset + header.treeCount * sizeof(Tree), header.rowOffset),
+        { world.roadRows.data(), (size_t)header.rowCount * sizeof(int32_t) },
+        gap(header.rowOffset + header.rowCount * sizeof(int32_t), header.laneCarOffset),
+        { laneCars.data(), laneCars.size() * sizeof(LaneCarState) },
+    };
+    if (!writeFileSections(path, sections, sizeof(sections) / sizeof(sections[0]))) {
+        std::cout << "Failed to write world snapshot: " << path << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// Replaces the world with the one saved in `path`; the world is left untouched if the
+// file is missing, truncated or from an incompatible build
+inline bool loadWorldSnapshot(CrossyWorld& world, const std::string& path) {
+    MappedFile file;
+    if (!file.open(path)) {
+        std::cout << "Failed to open world snapshot: " << path << std::endl;
+        return false;
+    }
+    const unsigned char* bytes = file.data();
+    SnapshotHeader header;
+    if (file.size() < sizeof(header)) {
+        std::cout << "World snapshot is truncated: " << path << std::endl;
+        return false;
+    }
+    std::memcpy(&header, bytes, sizeof(header));
+    if (std::memcmp(header.magic, "CRSN", 4) != 0 || header.version != WORLD_SNAPSHOT_VERSION ||
+        header.scalarsSize != sizeof(WorldScalars) || header.carSize != sizeof(Car) || header.treeSize != sizeof(Tree) ||
+        header.laneCarSize != sizeof(LaneCarState)) {
+        std::cout << "World snapshot is from another version or build: " << path << std::endl;
+        return false;
+    }
+    uint64_t size = file.size();
+    auto fits = [size](uint64_t offset, uint64_t count, uint64_t itemSize) {
+        return offset % WORLD_SNAPSHOT_ALIGNMENT == 0 && offset <= size && count <= (size - offset) / itemSize;
+    };
+    if (header.fileSize != size || !fits(header.scalarsOffset, 1, sizeof(WorldScalars)) ||
+        !fits(header.carOffset, header.carCount, sizeof(Car)) || !fits(header.treeOffset, header.treeCount, sizeof(Tree)) ||
+        !fits(header.rowOffset, header.rowCount, sizeof(int32_t)) || !fits(header.laneCarOffset, header.carCount, sizeof(LaneCarState))) {
+        std::cout << "World snapshot is truncated: " << path << std::endl;
+        return false;
+    }
+
+    // the mapping is page aligned and every section 16-byte aligned, so each array is read
+    // where it lies and copied in one go
+    const WorldScalars& scalars = *(const WorldScalars*)(bytes + header.scalarsOffset);
+    const int32_t* rows = (const int32_t*)(bytes + header.rowOffset);
+    world.cars.assign((const Car*)(bytes + header.carOffset), (size_t)header.carCount);
+    world.trees.assign((const Tree*)(bytes + header.treeOffset), (size_t)header.treeCount);
+    world.roadRows.assign(rows, rows + header.rowCount);
+
+    // a new lane wherever the cars' row changes
+    const LaneCarState* laneCars = (const LaneCarState*)(bytes + header.laneCarOffset);
+    world.lanes = TrafficModel(scalars.traffic);
+    world.laneRows.clear();
+    TrafficLane* lane = nullptr;
+    for (size_t i = 0; i < world.cars.size(); ++i) {
+        const Car& car = world.cars[i];
+        if (world.laneRows.empty() || world.laneRows.back() != car.rowIndex) {
+            lane = &world.lanes.addLane(2.0f * ROAD_HALF_LENGTH);
+            world.laneRows.push_back(car.rowIndex);
+        }
+        lane->addCar(laneCars[i].position, laneCars[i].velocity, laneCars[i].desiredSpeed);
+        lane->previousPosition.back() = laneCars[i].previousPosition;
+    }
+
+    world.playerPosition = scalars.playerPosition;
+    world.playerRotation = scalars.playerRotation;
+    world.firstRoadRow = scalars.firstRoadRow;
+    world.playerScore = scalars.playerScore;
+    world.furthestRow = scalars.furthestRow;
+    world.roadLanesLeft = scalars.roadLanesLeft;
+    world.roadLaneCount = scalars.roadLaneCount;
+    world.gameOver = scalars.gameOver != 0;
+    world.roadFlowsRight = scalars.roadFlowsRight != 0;
+    world.gameSpeed = scalars.gameSpeed;
+    world.roadClock = scalars.roadClock;
+    world.traffic = scalars.traffic;
+    world.generator = scalars.generator;
+    world.distribution = scalars.distribution;
+    world.camera = scalars.camera;
+    world.previousCamera = scalars.previousCamera;
+    world.ticks = scalars.ticks;
+    world.lastInputMicros = 0;
+    return true;
+}
+
+// Save and resume of worlds of 10^3 to maxRows rows, against building the same world
+// again row by row. The saved file is written to the page cache (no fsync) and read
+// back while it is still there, so this is the cost of the format, not of the disk.
+// Each resumed world is checked against the original by spawning more rows on both
+// and driving their traffic on for a second.
+inline int runSnapshotBenchmark(int maxRows) {
+    const char* path = "world_snapshot_bench.bin";
+    const int repeats = 3;
+    std::cout << "World snapshot benchmark (best of " << repeats << ")" << std::endl;
+    for (int rows = 1000; rows <= maxRows; rows *= 10) {
+        auto start = std::chrono::steady_clock::now();
+        CrossyWorld world;
+        world.spawnRows(rows - world.rowCount());
+        double buildSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        double saveSeconds = 1.0e30, loadSeconds = 1.0e30;
+        CrossyWorld resumed;
+        for (int repeat = 0; repeat < repeats; ++repeat) {
+            start = std::chrono::steady_clock::now();
+            if (!saveWorldSnapshot(world, path))
+                return 1;
+            auto middle = std::chrono::steady_clock::now();
+            if (!loadWorldSnapshot(resumed, path))
+                return 1;
+            auto end = std::chrono::steady_clock::now();
+            saveSeconds = std::min(saveSeconds, std::chrono::duration<double>(middle - start).count());
+            loadSeconds = std::min(loadSeconds, std::chrono::duration<double>(end - middle).count());
+        }
+
+        size_t carCount = world.cars.size(), treeCount = world.trees.size();
+        world.spawnRows(100);
+        resumed.spawnRows(100);
+        for (int tick = 0; tick < 60; ++tick) {
+            world.tick(1.0f / 60.0f);
+            resumed.tick(1.0f / 60.0f);
+        }
+        bool sameTraffic = world.laneRows == resumed.laneRows;
+        for (size_t l = 0; sameTraffic && l < world.lanes.laneCount(); ++l)
+            sameTraffic = world.lanes.lane(l).position == resumed.lanes.lane(l).position &&
+                world.lanes.lane(l).velocity == resumed.lanes.lane(l).velocity;
+        bool same = sameTraffic && world.cars.size() == resumed.cars.size() && world.trees.size() == resumed.trees.size() &&
+            world.roadRows == resumed.roadRows && world.generator == resumed.generator &&
+            std::memcmp(world.cars.begin(), resumed.cars.begin(), world.cars.size() * sizeof(Car)) == 0 &&
+            std::memcmp(world.trees.begin(), resumed.trees.begin(), world.trees.size() * sizeof(Tree)) == 0;
+
+        double megabytes = 0.0;
+        if (FILE* file = std::fopen(path, "rb")) {
+            std::fseek(file, 0, SEEK_END);
+            megabytes = std::ftell(file) / (1024.0 * 1024.0);
+            std::fclose(file);
+        }
+        std::cout << "  " << rows << " rows, " << carCount << " cars, " << treeCount << " trees: "
+                  << megabytes << " MB, save " << saveSeconds * 1000.0 << " ms, load " << loadSeconds * 1000.0
+                  << " ms (" << megabytes / 1024.0 / loadSeconds << " GB/s), rebuild " << buildSeconds * 1000.0 << " ms"
+                  << (same ? "" : "  MISMATCH after resume") << std::endl;
+    }
+    std::remove(path);
+    return 0;
+}
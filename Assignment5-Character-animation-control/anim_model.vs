@@ -1,35 +1,67 @@
 #version 330 core
+// permutations (program_cache.h), defaults are the generic program:
+//   MAX_BONES n:        palette size, the rig's bone count instead of 100
+//   BONE_INFLUENCES n:  influences per vertex fixed for one skeleton LOD, replacing the
+//                       boneInfluences uniform and its per-influence test
+//   BONE_IDS_CHECKED 1: every id was checked on the CPU to fit the palette, so the
+//                       per-influence range test goes
+#ifndef MAX_BONES
+#define MAX_BONES 100
+#endif
+#ifndef BONE_IDS_CHECKED
+#define BONE_IDS_CHECKED 0
+#endif
 
+// packed vertices (packed_vertex.h): half position, tangent frame quaternion,
+// half texcoords, uint8 bone ids (255 = unused), unorm8 weights
 layout(location = 0) in vec3 pos;
-layout(location = 1) in vec3 norm;
+layout(location = 1) in vec4 tangentFrame;
 layout(location = 2) in vec2 tex;
-layout(location = 3) in vec3 tangent;
-layout(location = 4) in vec3 bitangent;
-layout(location = 5) in ivec4 boneIds; 
+layout(location = 5) in uvec4 boneIds;
 layout(location = 6) in vec4 weights;
 
 uniform mat4 projection;
 uniform mat4 view;
 uniform mat4 model;
 
-const int MAX_BONES = 100;
 const int MAX_BONE_INFLUENCE = 4;
 uniform mat4 finalBonesMatrices[MAX_BONES];
+#ifndef BONE_INFLUENCES
+// 4, 2 or 1: reduced skeleton LODs keep only the strongest influences (skeleton_lod.h)
+uniform int boneInfluences;
+#endif
 
 out vec2 TexCoords;
 
+// normal out of the tangent frame: third column of the rotation
+vec3 frameNormal(vec4 q)
+{
+    q = normalize(q);
+    return vec3(2.0 * (q.x * q.z + q.w * q.y), 2.0 * (q.y * q.z - q.w * q.x), 1.0 - 2.0 * (q.x * q.x + q.y * q.y));
+}
+
 void main()
 {
+    vec3 norm = frameNormal(tangentFrame);
     vec4 totalPosition = vec4(0.0f);
+#ifdef BONE_INFLUENCES
+    for(int i = 0 ; i < BONE_INFLUENCES ; i++)
+    {
+#else
     for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
     {
-        if(boneIds[i] == -1) 
+        if(i >= boneInfluences)
+            break;
+#endif
+        if(boneIds[i] == 255u) 
             continue;
-        if(boneIds[i] >=MAX_BONES) 
+#if !BONE_IDS_CHECKED
+        if(boneIds[i] >= uint(MAX_BONES)) 
         {
             totalPosition = vec4(pos,1.0f);
             break;
         }
+#endif
         vec4 localPosition = finalBonesMatrices[boneIds[i]] * vec4(pos,1.0f);
         totalPosition += localPosition * weights[i];
         vec3 localNormal = mat3(finalBonesMatrices[boneIds[i]]) * norm;
@@ -0,0 +1,61 @@
+#version 330 core
+
+// instanced crowd (crowd_vat.h): same packed vertices as anim_model.vs, but the bone
+// matrices come from the baked clip texture at each instance's clip and time
+layout(location = 0) in vec3 pos;
+layout(location = 1) in vec4 tangentFrame;
+layout(location = 2) in vec2 tex;
+layout(location = 5) in uvec4 boneIds;
+layout(location = 6) in vec4 weights;
+layout(location = 7) in vec4 instancePlacement; // xyz position, w yaw
+layout(location = 8) in vec4 instanceClip;      // first row, frame count, frames per second, phase
+
+uniform mat4 projection;
+uniform mat4 view;
+uniform mat4 model;
+
+// one row per baked frame, three texels (matrix rows) per bone
+uniform sampler2D boneTexture;
+uniform float time;
+
+const int MAX_BONE_INFLUENCE = 4;
+
+out vec2 TexCoords;
+
+mat4 bakedBone(int row, int bone)
+{
+    vec4 r0 = texelFetch(boneTexture, ivec2(bone * 3, row), 0);
+    vec4 r1 = texelFetch(boneTexture, ivec2(bone * 3 + 1, row), 0);
+    vec4 r2 = texelFetch(boneTexture, ivec2(bone * 3 + 2, row), 0);
+    return mat4(vec4(r0.x, r1.x, r2.x, 0.0), vec4(r0.y, r1.y, r2.y, 0.0),
+                vec4(r0.z, r1.z, r2.z, 0.0), vec4(r0.w, r1.w, r2.w, 1.0));
+}
+
+void main()
+{
+    // frame position within the clip, wrapping the last frame back onto the first
+    float frames = instanceClip.y;
+    float frame = mod((time + instanceClip.w) * instanceClip.z, frames);
+    int frame0 = int(floor(frame));
+    int frame1 = frame0 + 1 >= int(frames) ? 0 : frame0 + 1;
+    float blend = fract(frame);
+    int row0 = int(instanceClip.x) + frame0;
+    int row1 = int(instanceClip.x) + frame1;
+
+    vec4 totalPosition = vec4(0.0f);
+    for(int i = 0 ; i < MAX_BONE_INFLUENCE ; i++)
+    {
+        if(boneIds[i] == 255u)
+            continue;
+        int bone = int(boneIds[i]);
+        mat4 boneMatrix = bakedBone(row0, bone) * (1.0 - blend) + bakedBone(row1, bone) * blend;
+        totalPosition += boneMatrix * vec4(pos,1.0f) * weights[i];
+    }
+
+    float s = sin(instancePlacement.w);
+    float c = cos(instancePlacement.w);
+    mat4 instance = mat4(vec4(c, 0.0, -s, 0.0), vec4(0.0, 1.0, 0.0, 0.0),
+                         vec4(s, 0.0, c, 0.0), vec4(instancePlacement.xyz, 1.0));
+    gl_Position = projection * view * instance * model * totalPosition;
+    TexCoords = tex;
+}
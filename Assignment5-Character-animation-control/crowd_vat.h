@@ -0,0 +1,255 @@
+// crowd_vat.h
+// Crowds without per-character CPU animation: every clip is sampled once at load
+// into a bone matrix texture ("vertex animation texture" with bones rather than
+// vertex positions, so one texture serves the whole mesh), and instanced characters
+// pick their pose in crowd_model.vs from a per-instance clip and phase.
+//  - sampleClip: bakes one Animation through an Animator at a fixed frame rate
+//  - BoneAnimationTexture: all baked clips in one RGBA32F texture, one row per frame,
+//    three texels (the rows of the 3x4 bone matrix) per bone
+//  - CrowdRenderer: per-mesh instanced VAOs over the character's packed vertex
+//    buffers plus a per-instance buffer; drawing costs one draw per mesh and one
+//    uniform per frame, whatever the crowd size
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+
+#include <learnopengl/animator.h>
+#include <learnopengl/model_animation.h>
+
+#include "../common/model_optimizer.h"
+#include "../common/program_cache.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+// one clip sampled at a fixed rate; matrices are frame-major, `bones` per frame
+struct BakedClipFrames
+{
+    std::vector<glm::mat4> matrices;
+    int frames = 0;
+    int bones = 0;
+    float seconds = 0.0f;
+};
+
+// Steps a fresh Animator through the clip. The frame count is rounded so the frames
+// divide the clip evenly; the last frame blends back into the first, as the Animator
+// wraps its time.
+inline BakedClipFrames sampleClip(Animation& clip, float framesPerSecond)
+{
+    BakedClipFrames baked;
+    baked.seconds = clip.GetDuration() / clip.GetTicksPerSecond();
+    baked.frames = std::max(1, (int)std::round(baked.seconds * framesPerSecond));
+    float step = baked.seconds / baked.frames;
+    Animator animator(&clip);
+    for (int frame = 0; frame < baked.frames; ++frame)
+    {
+        animator.UpdateAnimation(frame == 0 ? 0.0f : step);
+        std::vector<glm::mat4> bones = animator.GetFinalBoneMatrices();
+        if (frame == 0)
+            baked.bones = (int)bones.size();
+        baked.matrices.insert(baked.matrices.end(), bones.begin(), bones.begin() + baked.bones);
+    }
+    return baked;
+}
+
+struct BakedClip
+{
+    int firstRow = 0;
+    int frames = 0;
+    float framesPerSecond = 0.0f; // frames / seconds, so the loop period is the clip length
+};
+
+class BoneAnimationTexture
+{
+public:
+    BoneAnimationTexture() {}
+    ~BoneAnimationTexture()
+    {
+        if (texture != 0)
+            glDeleteTextures(1, &texture);
+    }
+    BoneAnimationTexture(const BoneAnimationTexture&) = delete;
+    BoneAnimationTexture& operator=(const BoneAnimationTexture&) = delete;
+
+    // stacks the clips' frames into one texture; all clips must have the same bone count
+    void upload(const std::vector<BakedClipFrames>& baked)
+    {
+        clips.clear();
+        bones = baked.empty() ? 0 : baked[0].bones;
+        rows = 0;
+        for (const BakedClipFrames& clip : baked)
+        {
+            BakedClip entry;
+            entry.firstRow = rows;
+            entry.frames = clip.frames;
+            entry.framesPerSecond = clip.seconds > 0.0f ? clip.frames / clip.seconds : 1.0f;
+            clips.push_back(entry);
+            rows += clip.frames;
+        }
+
+        int width = bones * 3;
+        std::vector<glm::vec4> texels((size_t)width * rows);
+        for (size_t c = 0; c < baked.size(); ++c)
+        {
+            for (int frame = 0; frame < baked[c].frames; ++frame)
+            {
+                glm::vec4* row = &texels[(size_t)(clips[c].firstRow + frame) * width];
+                for (int bone = 0; bone < bones; ++bone)
+                {
+                    const glm::mat4& m = baked[c].matrices[(size_t)frame * baked[c].bones + bone];
+                    for (int r = 0; r < 3; ++r)
+                        row[bone * 3 + r] = glm::vec4(m[0][r], m[1][r], m[2][r], m[3][r]);
+                }
+            }
+        }
+
+        if (texture == 0)
+            glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA32F, width, rows, 0, GL_RGBA, GL_FLOAT, texels.data());
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        bytes = texels.size() * sizeof(glm::vec4);
+    }
+
+    GLuint id() const { return texture; }
+    const std::vector<BakedClip>& clipTable() const { return clips; }
+    int boneCount() const { return bones; }
+    int frameCount() const { return rows; }
+    size_t byteSize() const { return bytes; }
+
+private:
+    GLuint texture = 0;
+    std::vector<BakedClip> clips;
+    int bones = 0;
+    int rows = 0;
+    size_t bytes = 0;
+};
+
+// per-instance attributes of crowd_model.vs
+struct CrowdInstance
+{
+    glm::vec4 placement; // xyz position, w yaw in radians
+    glm::vec4 clip;      // first row, frame count, frames per second, phase in seconds
+};
+
+// `count` characters on a square grid `spacing` apart around `center`, each with a
+// random clip, phase and heading
+inline std::vector<CrowdInstance> scatterCrowd(int count, const BoneAnimationTexture& poses, glm::vec3 center, float spacing, unsigned int seed = 1)
+{
+    std::vector<CrowdInstance> instances(count);
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    const std::vector<BakedClip>& clips = poses.clipTable();
+    int side = std::max(1, (int)std::ceil(std::sqrt((float)count)));
+    for (int i = 0; i < count; ++i)
+    {
+        const BakedClip& clip = clips[generator() % clips.size()];
+        float x = (i % side - (side - 1) * 0.5f) * spacing;
+        float z = (i / side - (side - 1) * 0.5f) * spacing;
+        instances[i].placement = glm::vec4(center + glm::vec3(x, 0.0f, z), unit(generator) * 6.2831853f);
+        instances[i].clip = glm::vec4((float)clip.firstRow, (float)clip.frames, clip.framesPerSecond,
+                                      unit(generator) * clip.frames / clip.framesPerSecond);
+    }
+    return instances;
+}
+
+class CrowdRenderer
+{
+public:
+    // the model's meshes must already be in the packed layout (packSkinnedModel)
+    explicit CrowdRenderer(Model& model)
+    {
+        glGenBuffers(1, &instanceBuffer);
+        for (Mesh& mesh : model.meshes)
+        {
+            Part part;
+            part.indexCount = (GLsizei)mesh.indices.size();
+            for (const Texture& texture : mesh.textures)
+            {
+                if (texture.type == "texture_diffuse")
+                {
+                    part.diffuse = texture.id;
+                    break;
+                }
+            }
+
+            // reuse the mesh's buffers, found through its VAO
+            GLint vbo = 0, ebo = 0;
+            glBindVertexArray(mesh.VAO);
+            glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vbo);
+            glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &ebo);
+
+            glGenVertexArrays(1, &part.vao);
+            glBindVertexArray(part.vao);
+            glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vbo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)ebo);
+            setPackedSkinnedAttributes();
+            glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+            glEnableVertexAttribArray(7);
+            glVertexAttribPointer(7, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), (void*)offsetof(CrowdInstance, placement));
+            glVertexAttribDivisor(7, 1);
+            glEnableVertexAttribArray(8);
+            glVertexAttribPointer(8, 4, GL_FLOAT, GL_FALSE, sizeof(CrowdInstance), (void*)offsetof(CrowdInstance, clip));
+            glVertexAttribDivisor(8, 1);
+            glBindVertexArray(0);
+            parts.push_back(part);
+        }
+    }
+
+    ~CrowdRenderer()
+    {
+        for (Part& part : parts)
+            glDeleteVertexArrays(1, &part.vao);
+        glDeleteBuffers(1, &instanceBuffer);
+    }
+    CrowdRenderer(const CrowdRenderer&) = delete;
+    CrowdRenderer& operator=(const CrowdRenderer&) = delete;
+
+    void setInstances(const std::vector<CrowdInstance>& instances)
+    {
+        glBindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+        glBufferData(GL_ARRAY_BUFFER, instances.size() * sizeof(CrowdInstance), instances.data(), GL_STATIC_DRAW);
+        instanceCount = (GLsizei)instances.size();
+    }
+
+    GLsizei size() const { return instanceCount; }
+
+    // shader is crowd_model.vs; projection, view and the shared "model" transform are set by the caller
+    void draw(const CachedShader& shader, const BoneAnimationTexture& poses, float seconds) const
+    {
+        if (instanceCount == 0)
+            return;
+        shader.setFloat("time", seconds);
+        shader.setInt("texture_diffuse1", 0);
+        shader.setInt("boneTexture", 1);
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, poses.id());
+        glActiveTexture(GL_TEXTURE0);
+        for (const Part& part : parts)
+        {
+            glBindTexture(GL_TEXTURE_2D, part.diffuse);
+            glBindVertexArray(part.vao);
+            glDrawElementsInstanced(GL_TRIANGLES, part.indexCount, GL_UNSIGNED_INT, 0, instanceCount);
+        }
+        glBindVertexArray(0);
+    }
+
+private:
+    struct Part
+    {
+        GLuint vao = 0;
+        GLuint diffuse = 0;
+        GLsizei indexCount = 0;
+    };
+
+    std::vector<Part> parts;
+    GLuint instanceBuffer = 0;
+    GLsizei instanceCount = 0;
+};
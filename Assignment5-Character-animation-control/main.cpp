@@ -11,9 +11,23 @@
 #include <learnopengl/animator.h>
 #include <learnopengl/model_animation.h>
 
+#define ALLOC_TRACKER_IMPLEMENTATION
+#include "../common/alloc_tracker.h"
+#include "../common/clip_import.h"
+#include "../common/fixed_timestep.h"
+#include "../common/frame_capture.h"
+#include "../common/input_log.h"
+#include "../common/linear_allocator.h"
+#include "../common/model_optimizer.h"
+#include "../common/program_cache.h"
+#include "crowd_vat.h"
+#include "skeleton_lod.h"
 
-
+#include <chrono>
+#include <cstring>
 #include <iostream>
+#include <memory>
+#include <string>
 
 
 void framebuffer_size_callback(GLFWwindow* window, int width, int height);
@@ -53,8 +67,122 @@ enum AnimState {
 	WALK
 };
 
-int main()
+struct CharacterClips {
+	Animation* idle;
+	Animation* walk;
+	Animation* run;
+	Animation* punch;
+	Animation* kick;
+	Animation* talk;
+};
+
+// animation state machine
+enum AnimState charState = IDLE;
+float blendAmount = 0.0f;
+float blendRate = 0.055f; // per simulation tick
+bool quietStates = false; // replays skip the per-tick state printout
+
+// Keys the character reacts to, as a bit mask sampled once per tick. The state
+// machine only sees this mask, so a recorded session replays exactly.
+const uint32_t INPUT_UP = 1 << 0;
+const uint32_t INPUT_DOWN = 1 << 1;
+const uint32_t INPUT_LEFT = 1 << 2;
+const uint32_t INPUT_RIGHT = 1 << 3;
+const uint32_t INPUT_PUNCH = 1 << 4;  // J
+const uint32_t INPUT_KICK = 1 << 5;   // K
+const uint32_t INPUT_TALK = 1 << 6;   // T
+const uint32_t INPUT_CLIP_1 = 1 << 7; // 1-5 play a clip directly
+const uint32_t INPUT_CLIP_2 = 1 << 8;
+const uint32_t INPUT_CLIP_3 = 1 << 9;
+const uint32_t INPUT_CLIP_4 = 1 << 10;
+const uint32_t INPUT_CLIP_5 = 1 << 11;
+
+uint32_t sampleCharacterInput(GLFWwindow* window);
+void updateCharacter(uint32_t keys, SkeletonLodAnimator& animator, const CharacterClips& clips, float deltaTime);
+uint64_t characterStateHash(const std::vector<glm::mat4>& bones);
+void logState(const char* state);
+void drawModel(Model& model, const CachedShader& shader, const SkeletonLod* lods = NULL, int lod = 0);
+int runSkeletonLodBenchmark(GLFWwindow* window, Model& model, const CharacterClips& clips, const std::vector<CompressedClip>& compressed,
+	CachedShader& shader, const std::vector<CachedShader>& variants, const SkeletonLod& lods, double seconds);
+int runCrowdBenchmark(GLFWwindow* window, Model& model, const CharacterClips& clips, CachedShader& skeletalShader,
+	CachedShader& crowdShader, CrowdRenderer& crowd, const BoneAnimationTexture& poses, double seconds);
+
+int main(int argc, char** argv)
 {
+	// --frame-time <ms>: pace frames to this time instead of vsync
+	// --no-shader-cache: always compile shaders from source
+	// --record <file>: write the keys of every tick to an input log
+	// --replay <file> [--max-speed] [--baseline <file>] [--save-baseline <file>]:
+	//   re-run a recorded session in a hidden window (nothing is drawn) and report tick timings
+	// --crowd <n>: draw n instanced characters from the baked clips around the player
+	// --bench-crowd [seconds]: time skeletal vs baked crowds of 10, 1k and 10k characters
+	// --bench-lod [seconds]: animation and skinning cost of 1k characters at each skeleton LOD,
+	//   with the generic and the specialized anim_model.vs
+	// --bench-clips [seconds]: size, error and sampling speed of the compressed clips (no window)
+	// --capture <path> [frames]: record the window to a .y4m file or a directory of PNGs;
+	//   with a frame count the window is hidden and closes once that many are taken
+	double targetFrameTime = 0.0;
+	std::string recordPath, replayPath, baselinePath, saveBaselinePath;
+	bool maxSpeed = false;
+	bool useShaderCache = true;
+	int crowdSize = 0;
+	double crowdBenchSeconds = 0.0;
+	double clipBenchSeconds = 0.0;
+	double lodBenchSeconds = 0.0;
+	std::string capturePath;
+	int captureFrames = 0;
+	for (int i = 1; i < argc; ++i)
+	{
+		if (strcmp(argv[i], "--frame-time") == 0 && i + 1 < argc)
+			targetFrameTime = atof(argv[++i]) / 1000.0;
+		else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc)
+			recordPath = argv[++i];
+		else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc)
+			replayPath = argv[++i];
+		else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+			baselinePath = argv[++i];
+		else if (strcmp(argv[i], "--save-baseline") == 0 && i + 1 < argc)
+			saveBaselinePath = argv[++i];
+		else if (strcmp(argv[i], "--max-speed") == 0)
+			maxSpeed = true;
+		else if (strcmp(argv[i], "--no-shader-cache") == 0)
+			useShaderCache = false;
+		else if (strcmp(argv[i], "--crowd") == 0 && i + 1 < argc)
+			crowdSize = atoi(argv[++i]);
+		else if (strcmp(argv[i], "--bench-crowd") == 0)
+		{
+			crowdBenchSeconds = 2.0;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				crowdBenchSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-lod") == 0)
+		{
+			lodBenchSeconds = 2.0;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				lodBenchSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--bench-clips") == 0)
+		{
+			clipBenchSeconds = 0.5;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				clipBenchSeconds = atof(argv[++i]);
+		}
+		else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc)
+		{
+			capturePath = argv[++i];
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				captureFrames = atoi(argv[++i]);
+		}
+	}
+	bool replaying = !replayPath.empty();
+	bool benchmarking = crowdBenchSeconds > 0.0 || lodBenchSeconds > 0.0;
+	// the character's clips, in CharacterClips order
+	std::vector<std::string> clipPaths;
+	for (const char* clip : { "Idle", "Walking", "Fast Run", "Quad Punch", "Mma Kick", "Talking" })
+		clipPaths.push_back(FileSystem::getPath(std::string("resources/objects/pleasant_girl/") + clip + ".dae"));
+	if (clipBenchSeconds > 0.0)
+		return runClipCompressionBenchmark(clipPaths, clipBenchSeconds);
+
 	// glfw: initialize and configure
 	// ------------------------------
 	glfwInit();
@@ -65,6 +193,9 @@ int main()
 #ifdef __APPLE__
 	glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
 #endif
+	// a replay or benchmark still needs a context to load the model, but never shows the window
+	if (replaying || benchmarking || captureFrames > 0)
+		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 
 	// glfw window creation
 	// --------------------
@@ -76,6 +207,9 @@ int main()
 		return -1;
 	}
 	glfwMakeContextCurrent(window);
+	FramePacer pacer(targetFrameTime);
+	if (pacer.enabled())
+		glfwSwapInterval(0);
 	glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
 	glfwSetCursorPosCallback(window, mouse_callback);
 	glfwSetScrollCallback(window, scroll_callback);
@@ -100,23 +234,150 @@ int main()
 
 	// build and compile shaders
 	// -------------------------
-	Shader ourShader("anim_model.vs", "anim_model.fs");
+	ProgramCache programCache((GLADloadproc)glfwGetProcAddress, "shader_cache", useShaderCache);
+	CachedShader ourShader = programCache.load("anim_model.vs", "anim_model.fs");
 
 
 	// load models
 	// -----------
 	// idle 3.3, walk 2.06, run 0.83, punch 1.03, kick 1.6
 	Model ourModel(FileSystem::getPath("resources/objects/pleasant_girl/Peasant Girl.dae"));
-	Animation idleAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Idle.dae"), &ourModel);
-	Animation walkAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Walking.dae"), &ourModel);
-	Animation runAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Fast Run.dae"), &ourModel);
-	Animation punchAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Quad Punch.dae"), &ourModel);
-	Animation kickAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Mma Kick.dae"), &ourModel);
-	Animation talkAnimation(FileSystem::getPath("resources/objects/pleasant_girl/Talking.dae"), &ourModel);
-	Animator animator(&idleAnimation);
-	enum AnimState charState = IDLE;
-	float blendAmount = 0.0f;
-	float blendRate = 0.055f;
+	// Mesh::Draw always draws 32-bit indices, so only the ordering passes apply here
+	optimizeModel(ourModel, "character", false, true);
+	// 28-byte packed vertices; anim_model.vs, crowd_model.vs and the skeleton LOD buffers
+	// all read this layout, so a rig that does not fit it cannot be drawn
+	if (!packSkinnedModel(ourModel, "character"))
+	{
+		std::cout << "Character mesh does not fit the packed vertex format" << std::endl;
+		glfwTerminate();
+		return -1;
+	}
+	// learnopengl's Animations remain the clip handles, the rig for the skeleton LODs and
+	// the source of the crowd bake and the Animator benchmark rows
+	Animation idleAnimation(clipPaths[0], &ourModel);
+	Animation walkAnimation(clipPaths[1], &ourModel);
+	Animation runAnimation(clipPaths[2], &ourModel);
+	Animation punchAnimation(clipPaths[3], &ourModel);
+	Animation kickAnimation(clipPaths[4], &ourModel);
+	Animation talkAnimation(clipPaths[5], &ourModel);
+	CharacterClips clips = { &idleAnimation, &walkAnimation, &runAnimation, &punchAnimation, &kickAnimation, &talkAnimation };
+	// the player's poses come from compressed copies of the clips; each raw clip is freed
+	// as soon as it is compressed
+	std::vector<CompressedClip> compressedClips;
+	for (const std::string& path : clipPaths)
+	{
+		RawClip raw;
+		if (!loadRawClip(path, raw))
+		{
+			std::cout << "Failed to load clip " << path << std::endl;
+			glfwTerminate();
+			return -1;
+		}
+		compressedClips.push_back(compressClip(raw));
+	}
+	SkeletonLod skeletonLods(ourModel, idleAnimation);
+	// the player is posed at the skeleton LOD it was last drawn at
+	SkeletonLodAnimator animator(skeletonLods, { clips.idle, clips.walk, clips.run, clips.punch, clips.kick, clips.talk }, compressedClips,
+		clips.idle);
+	int playerLod = 0;
+
+	// one anim_model.vs permutation per skeleton LOD, specialized to this rig; the generic
+	// ourShader stays as the benchmarks' baseline
+	std::vector<ProgramSource> skinnedSources;
+	for (int lod = 0; lod < SKELETON_LOD_COUNT; ++lod)
+		skinnedSources.push_back({ "anim_model.vs", "anim_model.fs", skeletonLods.shaderDefines(lod) });
+	std::vector<CachedShader> skinnedShaders = programCache.loadAll(skinnedSources);
+	programCache.report(std::cout);
+
+	// every clip baked into one bone matrix texture for the instanced crowd
+	auto bakeStart = std::chrono::steady_clock::now();
+	std::vector<BakedClipFrames> bakedClips;
+	for (Animation* clip : { clips.idle, clips.walk, clips.run, clips.punch, clips.kick, clips.talk })
+		bakedClips.push_back(sampleClip(*clip, 30.0f));
+	BoneAnimationTexture crowdPoses;
+	crowdPoses.upload(bakedClips);
+	std::cout << "Baked " << crowdPoses.frameCount() << " frames x " << crowdPoses.boneCount() << " bones ("
+		<< crowdPoses.byteSize() / 1024 << " KB) in "
+		<< std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - bakeStart).count() << " ms" << std::endl;
+	CachedShader crowdShader = programCache.load("crowd_model.vs", "anim_model.fs");
+	CrowdRenderer crowd(ourModel);
+	if (crowdSize > 0)
+		crowd.setInstances(scatterCrowd(crowdSize, crowdPoses, glm::vec3(0.0f, -0.4f, -4.0f), 1.0f));
+
+	if (benchmarking)
+	{
+		int status = 0;
+		if (crowdBenchSeconds > 0.0)
+			status = runCrowdBenchmark(window, ourModel, clips, ourShader, crowdShader, crowd, crowdPoses, crowdBenchSeconds);
+		if (lodBenchSeconds > 0.0 && status == 0)
+			status = runSkeletonLodBenchmark(window, ourModel, clips, compressedClips, ourShader, skinnedShaders, skeletonLods, lodBenchSeconds);
+		glfwTerminate();
+		return status;
+	}
+
+	// fixed 60 Hz simulation; the pose and position drawn are blended between the last two ticks
+	FixedTimestep simClock(1.0 / 60.0);
+	FrameTimeStats frameStats;
+	AllocationStats allocationStats; // operator new calls per frame
+	// palettes of the last two ticks at the levels they were evaluated at; reserved for the
+	// full rig so no level change reallocates them
+	std::vector<glm::mat4> currentBones, previousBones, renderBones;
+	currentBones.reserve(skeletonLods.paletteSize(0));
+	previousBones.reserve(skeletonLods.paletteSize(0));
+	renderBones.reserve(skeletonLods.paletteSize(0));
+	animator.evaluate(playerLod, currentBones);
+	previousBones = currentBones;
+	int currentLod = playerLod, previousLod = playerLod;
+	glm::vec3 previousCharacterPosition = characterPosition;
+
+	if (replaying)
+	{
+		InputReplay replay;
+		if (!replay.load(replayPath))
+		{
+			glfwTerminate();
+			return -1;
+		}
+		std::cout << "Replaying " << replayPath << ": " << replay.ticks() << " ticks, " << replay.records() << " input changes"
+			<< (maxSpeed ? ", max speed" : ", recorded rate") << std::endl;
+		quietStates = true;
+		float dt = (float)replay.step();
+		ReplayResult result = runReplay(replay, maxSpeed, [&](uint64_t, uint32_t keys) {
+			updateCharacter(keys, animator, clips, dt);
+			animator.UpdateAnimation(dt);
+			animator.evaluate(0, currentBones);
+		});
+		result.stateHash = characterStateHash(currentBones);
+		reportReplay(result, std::cout);
+
+		int status = 0;
+		if (!saveBaselinePath.empty() && saveReplayBaseline(result, saveBaselinePath))
+			std::cout << "Saved baseline to " << saveBaselinePath << std::endl;
+		if (!baselinePath.empty() && !compareReplayBaseline(result, baselinePath))
+			status = 1;
+		glfwTerminate();
+		return status;
+	}
+
+	InputRecorder recorder;
+	if (!recordPath.empty())
+		recorder.open(recordPath, simClock.dt());
+	uint64_t tickIndex = 0;
+
+	// --capture: frames are read back through a PBO ring and encoded on worker threads
+	std::unique_ptr<FrameCapture> capture;
+	if (!capturePath.empty())
+	{
+		int captureWidth, captureHeight;
+		glfwGetFramebufferSize(window, &captureWidth, &captureHeight);
+		capture.reset(new FrameCapture(capturePath, FrameCapture::formatFor(capturePath), captureWidth, captureHeight,
+			targetFrameTime > 0.0 ? (int)std::lround(1.0 / targetFrameTime) : 60));
+		if (!capture->open())
+		{
+			std::cout << "Failed to open capture output " << capturePath << std::endl;
+			capture.reset();
+		}
+	}
 
 	// draw in wireframe
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
@@ -129,302 +390,656 @@ int main()
 		// --------------------
 		float currentFrame = glfwGetTime();
 		deltaTime = currentFrame - lastFrame;
+		if (lastFrame > 0.0f)
+			frameStats.add(deltaTime);
 		lastFrame = currentFrame;
 
 		// input
 		// -----
 		processInput(window);
-		if (glfwGetKey(window, GLFW_KEY_1) == GLFW_PRESS)
-			animator.PlayAnimation(&idleAnimation, NULL, 0.0f, 0.0f, 0.0f);
-		if (glfwGetKey(window, GLFW_KEY_2) == GLFW_PRESS)
-			animator.PlayAnimation(&walkAnimation, NULL, 0.0f, 0.0f, 0.0f);
-		if (glfwGetKey(window, GLFW_KEY_3) == GLFW_PRESS)
-			animator.PlayAnimation(&punchAnimation, NULL, 0.0f, 0.0f, 0.0f);
-		if (glfwGetKey(window, GLFW_KEY_4) == GLFW_PRESS)
-			animator.PlayAnimation(&kickAnimation, NULL, 0.0f, 0.0f, 0.0f);
-		if (glfwGetKey(window, GLFW_KEY_5) == GLFW_PRESS)
-			animator.PlayAnimation(&talkAnimation, NULL, 0.0f, 0.0f, 0.0f);
-
-
-		switch (charState) {
-		case IDLE:
-			// Check for any movement input to trigger walk
-			if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS || 
-				glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS ||
-				glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS ||
-				glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &walkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				bool isMoving = false;
-				glm::vec3 moveDirection(0.0f);
-
-				// Check for movement input and set rotation
-				if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) { // Forward
-					moveDirection.z = 1.0f;
-					characterRotation = 180.0f;
-					isMoving = true;
-				}
-				if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) { // Backward
-					moveDirection.z = -1.0f;
-					characterRotation = 0.0f;
-					isMoving = true;
-				}
-				if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) { // Left
-					moveDirection.x = 1.0f;
-					characterRotation = -90.0f;
-					isMoving = true;
-				}
-				if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) { // Right
-					moveDirection.x = -1.0f;
-					characterRotation = 90.0f;
-					isMoving = true;
-				}
+		uint32_t keys = sampleCharacterInput(window);
 
-				// Move character if input detected
-				if (isMoving && glm::length(moveDirection) > 0.0f) {
-					moveDirection = glm::normalize(moveDirection);
-					characterPosition += moveDirection * moveSpeed * deltaTime;
-				}
+		// simulation ticks: the state machine, blending and movement advance in fixed
+		// steps, so blendRate is per tick rather than per rendered frame
+		int steps = simClock.advance(currentFrame);
+		for (int step = 0; step < steps; ++step)
+		{
+			std::swap(previousBones, currentBones);
+			previousLod = currentLod;
+			previousCharacterPosition = characterPosition;
+			recorder.record(tickIndex++, keys);
+			updateCharacter(keys, animator, clips, simClock.dt());
+			animator.UpdateAnimation(simClock.dt());
+			animator.evaluate(playerLod, currentBones);
+			currentLod = playerLod;
+		}
+		float alpha = simClock.alpha();
 
-				// Exit walk state when no movement keys are pressed
-				if (!isMoving) {
-					blendAmount = 0.0f;
-					charState = WALK_IDLE;
-				}
-				charState = IDLE_WALK;
-			}
-			else if (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &punchAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_PUNCH;
-			}
-			else if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &kickAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_KICK;
-			}
-			else if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
-				blendAmount = 0.0f;
-				animator.PlayAnimation(&idleAnimation, &talkAnimation, animator.m_CurrentTime, 0.0f, blendAmount);
-				charState = IDLE_TALK;
-			}
-			printf("idle \n");
-			break;
-		case IDLE_WALK:
-			blendAmount += blendRate;
-			blendAmount = fmod(blendAmount, 1.0f);
-			animator.PlayAnimation(&idleAnimation, &walkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			if (blendAmount > 0.9f) {
-				blendAmount = 0.0f;
-				float startTime = animator.m_CurrentTime2;
-				animator.PlayAnimation(&walkAnimation, NULL, startTime, 0.0f, blendAmount);
-				charState = WALK;
-			}
-			printf("idle_walk \n");
-			break;
-		case WALK: {
-			animator.PlayAnimation(&walkAnimation, NULL, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			
-			// Character movement during walk state
+		// render
+		// ------
+		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+		// view/projection transformations
+		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
+		glm::mat4 view = camera.GetViewMatrix();
+
+		// the palettes blend only when both ticks posed the same level; on a level change
+		// the latest pose is drawn as it is
+		renderBones.resize(currentBones.size());
+		for (size_t i = 0; i < currentBones.size(); ++i)
+			renderBones[i] = previousLod == currentLod ? previousBones[i] * (1.0f - alpha) + currentBones[i] * alpha : currentBones[i];
+
+		// skeleton LOD from the character's size on screen, for the next ticks' pose; the
+		// pose drawn now is uploaded to the shader variant of the level it was evaluated at
+		glm::vec3 drawPosition = glm::mix(previousCharacterPosition, characterPosition, alpha);
+		playerLod = skeletonLods.select(projection, view, drawPosition + glm::vec3(0.0f, -0.4f, 0.0f), skeletonLods.boundingRadius() * 0.5f);
+		int lod = currentLod;
+		const CachedShader& characterShader = skinnedShaders[lod];
+		characterShader.use();
+		characterShader.setMat4("projection", projection);
+		characterShader.setMat4("view", view);
+		skeletonLods.apply(characterShader, lod, renderBones);
+
+		// render the loaded model
+		glm::mat4 model = glm::mat4(1.0f);
+		model = glm::translate(model, drawPosition); // Use character position
+		model = glm::rotate(model, glm::radians(characterRotation), glm::vec3(0.0f, 1.0f, 0.0f)); // Apply character rotation
+		model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
+		model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
+		characterShader.setMat4("model", model);
+		drawModel(ourModel, characterShader, &skeletonLods, lod);
+
+		if (crowd.size() > 0)
+		{
+			crowdShader.use();
+			crowdShader.setMat4("projection", projection);
+			crowdShader.setMat4("view", view);
+			crowdShader.setMat4("model", glm::scale(glm::mat4(1.0f), glm::vec3(.5f, .5f, .5f)));
+			crowd.draw(crowdShader, crowdPoses, currentFrame);
+		}
+
+
+		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
+		// -------------------------------------------------------------------------------
+		if (capture)
+		{
+			capture->capture();
+			if (captureFrames > 0 && capture->frames() >= (unsigned long long)captureFrames)
+				glfwSetWindowShouldClose(window, true);
+		}
+		glfwSwapBuffers(window);
+		frameArena().reset();
+		allocationStats.endFrame();
+		glfwPollEvents();
+		pacer.wait();
+	}
+
+	if (recorder.isOpen())
+	{
+		recorder.close(tickIndex);
+		std::cout << "Recorded " << tickIndex << " ticks to " << recordPath << std::endl;
+	}
+	frameStats.report(std::cout, "Frame time");
+	allocationStats.report(std::cout, "Heap allocations");
+	if (capture)
+	{
+		capture->finish();
+		capture->report(std::cout);
+	}
+
+	// glfw: terminate, clearing all previously allocated GLFW resources.
+	// ------------------------------------------------------------------
+	glfwTerminate();
+	return 0;
+}
+
+// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
+// ---------------------------------------------------------------------------------------------------------
+void processInput(GLFWwindow* window)
+{
+	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
+		glfwSetWindowShouldClose(window, true);
+
+	// Camera controls disabled to prevent interference with character movement
+	// Character movement controls (Arrow Keys):
+	// UP = Forward, DOWN = Backward, LEFT = Left, RIGHT = Right
+	// Movement automatically triggers walk animation with blending
+}
+
+// Character state machine: picks and blends animations from the keys held and
+// moves the character. Called once per simulation tick.
+// ---------------------------------------------------------------------------
+void updateCharacter(uint32_t keys, SkeletonLodAnimator& animator, const CharacterClips& clips, float deltaTime)
+{
+	if (keys & INPUT_CLIP_1)
+		animator.PlayAnimation(clips.idle, NULL, 0.0f, 0.0f, 0.0f);
+	if (keys & INPUT_CLIP_2)
+		animator.PlayAnimation(clips.walk, NULL, 0.0f, 0.0f, 0.0f);
+	if (keys & INPUT_CLIP_3)
+		animator.PlayAnimation(clips.punch, NULL, 0.0f, 0.0f, 0.0f);
+	if (keys & INPUT_CLIP_4)
+		animator.PlayAnimation(clips.kick, NULL, 0.0f, 0.0f, 0.0f);
+	if (keys & INPUT_CLIP_5)
+		animator.PlayAnimation(clips.talk, NULL, 0.0f, 0.0f, 0.0f);
+
+	switch (charState) {
+	case IDLE:
+		// Check for any movement input to trigger walk
+		if ((keys & INPUT_UP) || 
+			(keys & INPUT_DOWN) ||
+			(keys & INPUT_LEFT) ||
+			(keys & INPUT_RIGHT)) {
+			blendAmount = 0.0f;
+			animator.PlayAnimation(clips.idle, clips.walk, animator.m_CurrentTime, 0.0f, blendAmount);
 			bool isMoving = false;
 			glm::vec3 moveDirection(0.0f);
-			
+
 			// Check for movement input and set rotation
-			if (glfwGetKey(window, GLFW_KEY_UP) == GLFW_PRESS) { // Forward
-				moveDirection.z = 0.0f;
+			if ((keys & INPUT_UP)) { // Forward
+				moveDirection.z = 1.0f;
 				characterRotation = 180.0f;
 				isMoving = true;
 			}
-			if (glfwGetKey(window, GLFW_KEY_DOWN) == GLFW_PRESS) { // Backward
-				moveDirection.z = 0.0f;
+			if ((keys & INPUT_DOWN)) { // Backward
+				moveDirection.z = -1.0f;
 				characterRotation = 0.0f;
 				isMoving = true;
 			}
-			if (glfwGetKey(window, GLFW_KEY_LEFT) == GLFW_PRESS) { // Left
-				moveDirection.x = 0.0f;
+			if ((keys & INPUT_LEFT)) { // Left
+				moveDirection.x = 1.0f;
 				characterRotation = -90.0f;
 				isMoving = true;
 			}
-			if (glfwGetKey(window, GLFW_KEY_RIGHT) == GLFW_PRESS) { // Right
-				moveDirection.x = 0.0f;
+			if ((keys & INPUT_RIGHT)) { // Right
+				moveDirection.x = -1.0f;
 				characterRotation = 90.0f;
 				isMoving = true;
 			}
-			
+
 			// Move character if input detected
 			if (isMoving && glm::length(moveDirection) > 0.0f) {
 				moveDirection = glm::normalize(moveDirection);
 				characterPosition += moveDirection * moveSpeed * deltaTime;
 			}
-			
+
 			// Exit walk state when no movement keys are pressed
 			if (!isMoving) {
 				blendAmount = 0.0f;
 				charState = WALK_IDLE;
 			}
-			printf("walking\n");
-			break;
+			charState = IDLE_WALK;
+		}
+		else if ((keys & INPUT_PUNCH)) {
+			blendAmount = 0.0f;
+			animator.PlayAnimation(clips.idle, clips.punch, animator.m_CurrentTime, 0.0f, blendAmount);
+			charState = IDLE_PUNCH;
+		}
+		else if ((keys & INPUT_KICK)) {
+			blendAmount = 0.0f;
+			animator.PlayAnimation(clips.idle, clips.kick, animator.m_CurrentTime, 0.0f, blendAmount);
+			charState = IDLE_KICK;
+		}
+		else if ((keys & INPUT_TALK)) {
+			blendAmount = 0.0f;
+			animator.PlayAnimation(clips.idle, clips.talk, animator.m_CurrentTime, 0.0f, blendAmount);
+			charState = IDLE_TALK;
+		}
+		logState("idle \n");
+		break;
+	case IDLE_WALK:
+		blendAmount += blendRate;
+		blendAmount = fmod(blendAmount, 1.0f);
+		animator.PlayAnimation(clips.idle, clips.walk, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		if (blendAmount > 0.9f) {
+			blendAmount = 0.0f;
+			float startTime = animator.m_CurrentTime2;
+			animator.PlayAnimation(clips.walk, NULL, startTime, 0.0f, blendAmount);
+			charState = WALK;
+		}
+		logState("idle_walk \n");
+		break;
+	case WALK: {
+		animator.PlayAnimation(clips.walk, NULL, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		
+		// Character movement during walk state
+		bool isMoving = false;
+		glm::vec3 moveDirection(0.0f);
+		
+		// Check for movement input and set rotation
+		if ((keys & INPUT_UP)) { // Forward
+			moveDirection.z = 0.0f;
+			characterRotation = 180.0f;
+			isMoving = true;
+		}
+		if ((keys & INPUT_DOWN)) { // Backward
+			moveDirection.z = 0.0f;
+			characterRotation = 0.0f;
+			isMoving = true;
+		}
+		if ((keys & INPUT_LEFT)) { // Left
+			moveDirection.x = 0.0f;
+			characterRotation = -90.0f;
+			isMoving = true;
+		}
+		if ((keys & INPUT_RIGHT)) { // Right
+			moveDirection.x = 0.0f;
+			characterRotation = 90.0f;
+			isMoving = true;
+		}
+		
+		// Move character if input detected
+		if (isMoving && glm::length(moveDirection) > 0.0f) {
+			moveDirection = glm::normalize(moveDirection);
+			characterPosition += moveDirection * moveSpeed * deltaTime;
+		}
+		
+		// Exit walk state when no movement keys are pressed
+		if (!isMoving) {
+			blendAmount = 0.0f;
+			charState = WALK_IDLE;
+		}
+		logState("walking\n");
+		break;
+	}
+	case WALK_IDLE:
+		blendAmount += blendRate;
+		blendAmount = fmod(blendAmount, 1.0f);
+		animator.PlayAnimation(clips.walk, clips.idle, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		if (blendAmount > 0.9f) {
+			blendAmount = 0.0f;
+			float startTime = animator.m_CurrentTime2;
+			animator.PlayAnimation(clips.idle, NULL, startTime, 0.0f, blendAmount);
+			charState = IDLE;
+		}
+		logState("walk_idle \n");
+		break;
+	case IDLE_PUNCH:
+		blendAmount += blendRate;
+		blendAmount = fmod(blendAmount, 1.0f);
+		animator.PlayAnimation(clips.idle, clips.punch, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		if (blendAmount > 0.9f) {
+			blendAmount = 0.0f;
+			float startTime = animator.m_CurrentTime2;
+			animator.PlayAnimation(clips.punch, NULL, startTime, 0.0f, blendAmount);
+			charState = PUNCH_IDLE;
 		}
-		case WALK_IDLE:
+		logState("idle_punch\n");
+		break;
+	case PUNCH_IDLE:
+		if (animator.m_CurrentTime > 0.7f) {
 			blendAmount += blendRate;
 			blendAmount = fmod(blendAmount, 1.0f);
-			animator.PlayAnimation(&walkAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+			animator.PlayAnimation(clips.punch, clips.idle, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
 			if (blendAmount > 0.9f) {
 				blendAmount = 0.0f;
 				float startTime = animator.m_CurrentTime2;
-				animator.PlayAnimation(&idleAnimation, NULL, startTime, 0.0f, blendAmount);
+				animator.PlayAnimation(clips.idle, NULL, startTime, 0.0f, blendAmount);
 				charState = IDLE;
 			}
-			printf("walk_idle \n");
-			break;
-		case IDLE_PUNCH:
-			blendAmount += blendRate;
-			blendAmount = fmod(blendAmount, 1.0f);
-			animator.PlayAnimation(&idleAnimation, &punchAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-			if (blendAmount > 0.9f) {
-				blendAmount = 0.0f;
-				float startTime = animator.m_CurrentTime2;
-				animator.PlayAnimation(&punchAnimation, NULL, startTime, 0.0f, blendAmount);
-				charState = PUNCH_IDLE;
-			}
-			printf("idle_punch\n");
-			break;
-		case PUNCH_IDLE:
-			if (animator.m_CurrentTime > 0.7f) {
-				blendAmount += blendRate;
-				blendAmount = fmod(blendAmount, 1.0f);
-				animator.PlayAnimation(&punchAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				if (blendAmount > 0.9f) {
-					blendAmount = 0.0f;
-					float startTime = animator.m_CurrentTime2;
-					animator.PlayAnimation(&idleAnimation, NULL, startTime, 0.0f, blendAmount);
-					charState = IDLE;
-				}
-				printf("punch_idle \n");
-			}
-			else {
-				// punching
-				printf("punching \n");
-			}
-			break;
-		case IDLE_KICK:
+			logState("punch_idle \n");
+		}
+		else {
+			// punching
+			logState("punching \n");
+		}
+		break;
+	case IDLE_KICK:
+		blendAmount += blendRate;
+		blendAmount = fmod(blendAmount, 1.0f);
+		animator.PlayAnimation(clips.idle, clips.kick, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		if (blendAmount > 0.9f) {
+			blendAmount = 0.0f;
+			float startTime = animator.m_CurrentTime2;
+			animator.PlayAnimation(clips.kick, NULL, startTime, 0.0f, blendAmount);
+			charState = KICK_IDLE;
+		}
+		logState("idle_kick\n");
+		break;
+	case KICK_IDLE:
+		if (animator.m_CurrentTime > 1.0f) {
 			blendAmount += blendRate;
 			blendAmount = fmod(blendAmount, 1.0f);
-			animator.PlayAnimation(&idleAnimation, &kickAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+			animator.PlayAnimation(clips.kick, clips.idle, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
 			if (blendAmount > 0.9f) {
 				blendAmount = 0.0f;
 				float startTime = animator.m_CurrentTime2;
-				animator.PlayAnimation(&kickAnimation, NULL, startTime, 0.0f, blendAmount);
-				charState = KICK_IDLE;
-			}
-			printf("idle_kick\n");
-			break;
-		case KICK_IDLE:
-			if (animator.m_CurrentTime > 1.0f) {
-				blendAmount += blendRate;
-				blendAmount = fmod(blendAmount, 1.0f);
-				animator.PlayAnimation(&kickAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				if (blendAmount > 0.9f) {
-					blendAmount = 0.0f;
-					float startTime = animator.m_CurrentTime2;
-					animator.PlayAnimation(&idleAnimation, NULL, startTime, 0.0f, blendAmount);
-					charState = IDLE;
-				}
-				printf("kick_idle \n");
-			}
-			else {
-				// punching
-				printf("kicking \n");
+				animator.PlayAnimation(clips.idle, NULL, startTime, 0.0f, blendAmount);
+				charState = IDLE;
 			}
-			break;
-		case IDLE_TALK:
+			logState("kick_idle \n");
+		}
+		else {
+			// punching
+			logState("kicking \n");
+		}
+		break;
+	case IDLE_TALK:
+		blendAmount += blendRate;
+		blendAmount = fmod(blendAmount, 1.0f);
+		animator.PlayAnimation(clips.idle, clips.talk, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+		if (blendAmount > 0.9f) {
+			blendAmount = 0.0f;
+			float startTime = animator.m_CurrentTime2;
+			animator.PlayAnimation(clips.talk, NULL, startTime, 0.0f, blendAmount);
+			charState = TALK_IDLE;
+		}
+		logState("idle_talk\n");
+		break;
+	case TALK_IDLE:
+		 if (animator.m_CurrentTime > 3.0f) { // Talk animation duration
 			blendAmount += blendRate;
 			blendAmount = fmod(blendAmount, 1.0f);
-			animator.PlayAnimation(&idleAnimation, &talkAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
+			animator.PlayAnimation(clips.talk, clips.idle, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
 			if (blendAmount > 0.9f) {
 				blendAmount = 0.0f;
 				float startTime = animator.m_CurrentTime2;
-				animator.PlayAnimation(&talkAnimation, NULL, startTime, 0.0f, blendAmount);
-				charState = TALK_IDLE;
-			}
-			printf("idle_talk\n");
-			break;
-		case TALK_IDLE:
-			 if (animator.m_CurrentTime > 3.0f) { // Talk animation duration
-				blendAmount += blendRate;
-				blendAmount = fmod(blendAmount, 1.0f);
-				animator.PlayAnimation(&talkAnimation, &idleAnimation, animator.m_CurrentTime, animator.m_CurrentTime2, blendAmount);
-				if (blendAmount > 0.9f) {
-					blendAmount = 0.0f;
-					float startTime = animator.m_CurrentTime2;
-					animator.PlayAnimation(&idleAnimation, NULL, startTime, 0.0f, blendAmount);
-					charState = IDLE;
-				}
-				printf("talk_idle \n");
-			}
-			else {
-				// talking
-				printf("talking \n");
+				animator.PlayAnimation(clips.idle, NULL, startTime, 0.0f, blendAmount);
+				charState = IDLE;
 			}
-			break;
+			logState("talk_idle \n");
 		}
+		else {
+			// talking
+			logState("talking \n");
+		}
+		break;
+	}
+}
 
+// Bit mask of the character keys held right now
+uint32_t sampleCharacterInput(GLFWwindow* window)
+{
+	static const int glfwKeys[] = { GLFW_KEY_UP, GLFW_KEY_DOWN, GLFW_KEY_LEFT, GLFW_KEY_RIGHT, GLFW_KEY_J, GLFW_KEY_K, GLFW_KEY_T,
+		GLFW_KEY_1, GLFW_KEY_2, GLFW_KEY_3, GLFW_KEY_4, GLFW_KEY_5 };
+	uint32_t keys = 0;
+	for (int i = 0; i < 12; ++i)
+		if (glfwGetKey(window, glfwKeys[i]) == GLFW_PRESS)
+			keys |= 1u << i;
+	return keys;
+}
 
+// Final state of a replay, hashed to check that it reproduced the recorded session
+uint64_t characterStateHash(const std::vector<glm::mat4>& bones)
+{
+	uint64_t hash = HASH_SEED;
+	hash = hashBytes(hash, &characterPosition, sizeof(characterPosition));
+	hash = hashBytes(hash, &characterRotation, sizeof(characterRotation));
+	hash = hashBytes(hash, &charState, sizeof(charState));
+	hash = hashBytes(hash, &blendAmount, sizeof(blendAmount));
+	if (!bones.empty())
+		hash = hashBytes(hash, bones.data(), bones.size() * sizeof(glm::mat4));
+	return hash;
+}
 
-		animator.UpdateAnimation(deltaTime);
-
-		// render
-		// ------
-		glClearColor(0.05f, 0.05f, 0.05f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void logState(const char* state)
+{
+	if (!quietStates)
+		printf("%s", state);
+}
 
-		// don't forget to enable shader before setting uniforms
-		ourShader.use();
+// Sampler uniform locations of every mesh texture of a model ("texture_diffuse1", ...)
+// in one program, looked up the first time the pair is drawn
+struct ModelSamplerLocations
+{
+	const Model* model;
+	GLuint program;
+	std::vector<std::vector<GLint>> meshes;
+};
 
-		// view/projection transformations
-		glm::mat4 projection = glm::perspective(glm::radians(camera.Zoom), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 100.0f);
-		glm::mat4 view = camera.GetViewMatrix();
-		ourShader.setMat4("projection", projection);
-		ourShader.setMat4("view", view);
+const ModelSamplerLocations& samplerLocations(const Model& model, GLuint program)
+{
+	static std::vector<ModelSamplerLocations> cache;
+	for (const ModelSamplerLocations& entry : cache)
+		if (entry.model == &model && entry.program == program)
+			return entry;
+	ModelSamplerLocations entry = { &model, program, {} };
+	for (const Mesh& mesh : model.meshes)
+	{
+		unsigned int diffuseNr = 1, specularNr = 1, normalNr = 1, heightNr = 1;
+		std::vector<GLint> locations;
+		for (const Texture& texture : mesh.textures)
+		{
+			const std::string& type = texture.type;
+			std::string number;
+			if (type == "texture_diffuse")
+				number = std::to_string(diffuseNr++);
+			else if (type == "texture_specular")
+				number = std::to_string(specularNr++);
+			else if (type == "texture_normal")
+				number = std::to_string(normalNr++);
+			else if (type == "texture_height")
+				number = std::to_string(heightNr++);
+			locations.push_back(glGetUniformLocation(program, (type + number).c_str()));
+		}
+		entry.meshes.push_back(locations);
+	}
+	cache.push_back(entry);
+	return cache.back();
+}
 
-		auto transforms = animator.GetFinalBoneMatrices();
-		for (int i = 0; i < transforms.size(); ++i)
-			ourShader.setMat4("finalBonesMatrices[" + std::to_string(i) + "]", transforms[i]);
+// Model::Draw takes learnopengl's Shader; this is the same per-mesh texture binding
+// and draw for a program from the cache, from the VAOs of a skeleton LOD if given
+void drawModel(Model& model, const CachedShader& shader, const SkeletonLod* lods, int lod)
+{
+	const ModelSamplerLocations& samplers = samplerLocations(model, shader.ID);
+	for (size_t m = 0; m < model.meshes.size(); ++m)
+	{
+		Mesh& mesh = model.meshes[m];
+		for (unsigned int i = 0; i < mesh.textures.size(); i++)
+		{
+			glActiveTexture(GL_TEXTURE0 + i);
+			glUniform1i(samplers.meshes[m][i], i);
+			glBindTexture(GL_TEXTURE_2D, mesh.textures[i].id);
+		}
+		glBindVertexArray(lods != NULL ? lods->vertexArray(lod, m, mesh.VAO) : mesh.VAO);
+		glDrawElements(GL_TRIANGLES, (GLsizei)mesh.indices.size(), GL_UNSIGNED_INT, 0);
+		glBindVertexArray(0);
+		glActiveTexture(GL_TEXTURE0);
+	}
+}
 
+// Draws crowds of 10, 1k and 10k characters both ways from the same camera: skeletal,
+// with an Animator per character updated on the CPU and its bones uploaded before each
+// draw, and baked, with one instanced draw per mesh. Reports CPU time per frame (update
+// and draw submission) and total time per frame with glFinish, over at least `seconds`.
+int runCrowdBenchmark(GLFWwindow* window, Model& model, const CharacterClips& clips, CachedShader& skeletalShader,
+	CachedShader& crowdShader, CrowdRenderer& crowd, const BoneAnimationTexture& poses, double seconds)
+{
+	Animation* clipList[] = { clips.idle, clips.walk, clips.run, clips.punch, clips.kick, clips.talk };
+	const float dt = 1.0f / 60.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 300.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 30.0f, 60.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(.5f, .5f, .5f));
+	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
-		// render the loaded model
-		glm::mat4 model = glm::mat4(1.0f);
-		model = glm::translate(model, characterPosition); // Use character position
-		model = glm::rotate(model, glm::radians(characterRotation), glm::vec3(0.0f, 1.0f, 0.0f)); // Apply character rotation
-		model = glm::translate(model, glm::vec3(0.0f, -0.4f, 0.0f)); // translate it down so it's at the center of the scene
-		model = glm::scale(model, glm::vec3(.5f, .5f, .5f));	// it's a bit too big for our scene, so scale it down
-		ourShader.setMat4("model", model);
-		ourModel.Draw(ourShader);
+	std::cout << "Crowd benchmark (" << seconds << " s per case)" << std::endl;
+	std::cout << "  characters  path       cpu ms/frame  gpu+cpu ms/frame" << std::endl;
+	for (int count : { 10, 1000, 10000 })
+	{
+		std::vector<CrowdInstance> instances = scatterCrowd(count, poses, glm::vec3(0.0f), 1.0f);
 
+		// skeletal: one Animator per character, started at the same clip and phase as its baked twin
+		std::vector<Animator> animators;
+		animators.reserve(count);
+		for (int i = 0; i < count; ++i)
+		{
+			int clip = 0;
+			while (clip < 5 && poses.clipTable()[clip].firstRow != (int)instances[i].clip.x)
+				++clip;
+			animators.emplace_back(clipList[clip]);
+			animators.back().UpdateAnimation(instances[i].clip.w);
+		}
+		crowd.setInstances(instances);
 
-		// glfw: swap buffers and poll IO events (keys pressed/released, mouse moved etc.)
-		// -------------------------------------------------------------------------------
-		glfwSwapBuffers(window);
-		glfwPollEvents();
+		for (int path = 0; path < 2; ++path)
+		{
+			bool baked = path == 1;
+			int frames = 0;
+			double cpuSeconds = 0.0;
+			auto start = std::chrono::steady_clock::now();
+			while (frames < 3 || std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)
+			{
+				auto frameStart = std::chrono::steady_clock::now();
+				glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+				if (baked)
+				{
+					crowdShader.use();
+					crowdShader.setMat4("projection", projection);
+					crowdShader.setMat4("view", view);
+					crowdShader.setMat4("model", scale);
+					crowd.draw(crowdShader, poses, frames * dt);
+				}
+				else
+				{
+					skeletalShader.use();
+					skeletalShader.setMat4("projection", projection);
+					skeletalShader.setMat4("view", view);
+					skeletalShader.setInt("boneInfluences", 4);
+					GLint bonesLocation = glGetUniformLocation(skeletalShader.ID, "finalBonesMatrices[0]");
+					for (int i = 0; i < count; ++i)
+					{
+						animators[i].UpdateAnimation(dt);
+						std::vector<glm::mat4> bones = animators[i].GetFinalBoneMatrices();
+						glUniformMatrix4fv(bonesLocation, (GLsizei)bones.size(), GL_FALSE, glm::value_ptr(bones[0]));
+						glm::vec4 placement = instances[i].placement;
+						glm::mat4 world = glm::translate(glm::mat4(1.0f), glm::vec3(placement));
+						world = glm::rotate(world, placement.w, glm::vec3(0.0f, 1.0f, 0.0f));
+						skeletalShader.setMat4("model", world * scale);
+						drawModel(model, skeletalShader);
+					}
+				}
+				cpuSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - frameStart).count();
+				glFinish();
+				glfwSwapBuffers(window);
+				frameArena().reset();
+				++frames;
+			}
+			double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+			printf("  %10d  %-9s  %12.3f  %16.3f\n", count, baked ? "baked" : "skeletal",
+				cpuSeconds * 1000.0 / frames, totalSeconds * 1000.0 / frames);
+		}
 	}
-
-	// glfw: terminate, clearing all previously allocated GLFW resources.
-	// ------------------------------------------------------------------
-	glfwTerminate();
+	crowd.setInstances({});
 	return 0;
 }
 
-// process all input: query GLFW whether relevant keys are pressed/released this frame and react accordingly
-// ---------------------------------------------------------------------------------------------------------
-void processInput(GLFWwindow* window)
+// 1k characters on the crowd benchmark's grid and camera, each playing one of the clips
+// at its own phase, drawn at every skeleton LOD in turn and then at the LOD its screen
+// size selects, each with the generic anim_model.vs and with the level's specialized
+// variant. The Animator row is learnopengl's full-rig path for reference. Animation is the
+// CPU pose evaluation; submit adds the palette uploads and draws; total waits for the GPU.
+int runSkeletonLodBenchmark(GLFWwindow* window, Model& model, const CharacterClips& clips, const std::vector<CompressedClip>& compressed,
+	CachedShader& shader, const std::vector<CachedShader>& variants, const SkeletonLod& lods, double seconds)
 {
-	if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
-		glfwSetWindowShouldClose(window, true);
+	const int count = 1000;
+	const int AUTO_LOD = SKELETON_LOD_COUNT, ANIMATOR = SKELETON_LOD_COUNT + 1;
+	Animation* clipList[] = { clips.idle, clips.walk, clips.run, clips.punch, clips.kick, clips.talk };
+	const float dt = 1.0f / 60.0f;
+	glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)SCR_WIDTH / (float)SCR_HEIGHT, 0.1f, 300.0f);
+	glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 4.0f, 20.0f), glm::vec3(0.0f, 0.0f, -5.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+	glm::mat4 scale = glm::scale(glm::mat4(1.0f), glm::vec3(.5f, .5f, .5f));
+	glViewport(0, 0, SCR_WIDTH, SCR_HEIGHT);
 
-	// Camera controls disabled to prevent interference with character movement
-	// Character movement controls (Arrow Keys):
-	// UP = Forward, DOWN = Backward, LEFT = Left, RIGHT = Right
-	// Movement automatically triggers walk animation with blending
+	// one pose evaluator per character at the level each run draws it at: a compressed
+	// clip is read front to back, so characters at different phases cannot share one
+	std::vector<SkeletonLodPose> poses;
+	poses.reserve(count);
+	std::vector<Animator> animators;
+	std::vector<glm::vec3> positions(count);
+	int side = (int)std::ceil(std::sqrt((float)count));
+	for (int i = 0; i < count; ++i)
+	{
+		positions[i] = glm::vec3((i % side - (side - 1) * 0.5f) * 1.5f, -0.4f, -(float)(i / side) * 1.5f);
+		animators.emplace_back(clipList[i % 6]);
+	}
+
+	std::cout << "Skeleton LOD benchmark (" << count << " characters, " << seconds << " s per case)" << std::endl;
+	std::cout << "  active uniform components: generic " << activeUniformComponents(shader.ID) << ", specialized";
+	for (int lod = 0; lod < SKELETON_LOD_COUNT; ++lod)
+		std::cout << (lod > 0 ? " / " : " ") << activeUniformComponents(variants[lod].ID);
+	std::cout << std::endl;
+	std::cout << "  lod       shader       bones  palette  influences  anim ms  submit ms  total ms/frame" << std::endl;
+	std::vector<glm::mat4> palette;
+	std::vector<CachedShader> programs = variants;
+	programs.push_back(shader);
+	for (const CachedShader& program : programs)
+	{
+		program.use();
+		program.setMat4("projection", projection);
+		program.setMat4("view", view);
+	}
+	for (int run = 0; run < 2 * ANIMATOR + 1; ++run)
+	{
+		// every LOD mode generic then specialized; the Animator row generic only
+		int mode = run / 2;
+		bool specialized = run % 2 == 1;
+		poses.clear();
+		for (int i = 0; mode < ANIMATOR && i < count; ++i)
+		{
+			int lod = mode < AUTO_LOD ? mode : lods.select(projection, view, positions[i], lods.boundingRadius() * 0.5f);
+			poses.emplace_back(compressed[i % 6], lods, lod);
+		}
+		GLuint boundProgram = 0;
+		int frames = 0, lodCounts[SKELETON_LOD_COUNT] = {};
+		double animSeconds = 0.0, submitSeconds = 0.0;
+		auto start = std::chrono::steady_clock::now();
+		while (frames < 3 || std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() < seconds)
+		{
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			for (int i = 0; i < count; ++i)
+			{
+				int lod = mode < AUTO_LOD ? mode : 0;
+				if (mode == AUTO_LOD)
+					lod = lods.select(projection, view, positions[i], lods.boundingRadius() * 0.5f);
+				auto animStart = std::chrono::steady_clock::now();
+				if (mode == ANIMATOR)
+				{
+					animators[i].UpdateAnimation(dt);
+					lods.gatherPalette(0, animators[i].GetFinalBoneMatrices(), palette);
+				}
+				else
+				{
+					Animation* clip = clipList[i % 6];
+					float ticks = std::fmod((frames * dt + i * 0.37f) * clip->GetTicksPerSecond(), clip->GetDuration());
+					poses[i].evaluate(ticks, palette);
+					++lodCounts[lod];
+				}
+				auto submitStart = std::chrono::steady_clock::now();
+				const CachedShader& drawShader = specialized ? variants[lod] : shader;
+				if (drawShader.ID != boundProgram)
+				{
+					drawShader.use();
+					boundProgram = drawShader.ID;
+				}
+				lods.apply(drawShader, lod, palette);
+				drawShader.setMat4("model", glm::translate(glm::mat4(1.0f), positions[i]) * scale);
+				drawModel(model, drawShader, &lods, lod);
+				auto submitEnd = std::chrono::steady_clock::now();
+				animSeconds += std::chrono::duration<double>(submitStart - animStart).count();
+				submitSeconds += std::chrono::duration<double>(submitEnd - submitStart).count();
+			}
+			glFinish();
+			glfwSwapBuffers(window);
+			frameArena().reset();
+			++frames;
+		}
+		double totalSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+		std::string name = mode == ANIMATOR ? "Animator" : mode == AUTO_LOD ? "auto" : std::to_string(mode);
+		const char* shaderName = specialized ? "specialized" : "generic";
+		if (mode < AUTO_LOD)
+			printf("  %-8s  %-11s  %5d  %7d  %10d", name.c_str(), shaderName, poses[0].bonesEvaluated(), lods.paletteSize(mode),
+				lods.influences(mode));
+		else if (mode == AUTO_LOD)
+			printf("  %-8s  %-11s  %5s  %7s  %10s", name.c_str(), shaderName, "mixed", "", "");
+		else
+			printf("  %-8s  %-11s  %5s  %7d  %10d", name.c_str(), shaderName, "all", lods.paletteSize(0), lods.influences(0));
+		printf("  %7.3f  %9.3f  %14.3f\n", animSeconds * 1000.0 / frames, submitSeconds * 1000.0 / frames, totalSeconds * 1000.0 / frames);
+		if (mode == AUTO_LOD)
+			printf("                         characters per lod: %d / %d / %d\n", lodCounts[0] / frames, lodCounts[1] / frames, lodCounts[2] / frames);
+	}
+	return 0;
 }
 
 // glfw: whenever the window size changed (by OS or user resize) this callback function executes
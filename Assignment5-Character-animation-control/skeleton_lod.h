@@ -0,0 +1,469 @@
+// skeleton_lod.h
+// Precomputed skeleton LODs for the character: each level merges the bones whose
+// subtree carries little skin weight (fingers, toes, end sites) into their nearest
+// kept ancestor and keeps only the strongest 4, 2 or 1 influences per vertex.
+//  - SkeletonLod: per level the compacted bone palette, the vertex bone ids remapped
+//    to it (one small id/weight buffer and VAO per mesh, sharing the packed
+//    position/frame/texcoord buffer), and the node list a pose walks
+//  - SkeletonLodPose: evaluates one compressed clip (clip_compression.h) for one level,
+//    touching only the kept nodes, and writes the level's palette directly
+//  - SkeletonLodAnimator: the player's animator, with Animator's two-clip blending
+//    controls, posing the character at whichever level it is asked for
+//  - shaderDefines: the anim_model.vs permutation specialized for a level
+// A level is selected per character from its projected size on screen.
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include <learnopengl/animation.h>
+#include <learnopengl/model_animation.h>
+
+#include "../common/clip_compression.h"
+#include "../common/model_optimizer.h"
+#include "../common/program_cache.h"
+#include "../common/skeleton_pose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <string>
+#include <vector>
+
+struct SkeletonLodLevel
+{
+    float minScreenFraction; // chosen while the character's bounding radius covers at least this much of half the screen height
+    float mergeWeight;       // bones whose subtree holds less than this share of all skin weight merge into their parent
+    int influences;
+};
+
+const SkeletonLodLevel SKELETON_LODS[] = {
+    { 0.25f, 0.0f, 4 },
+    { 0.08f, 0.01f, 2 },
+    { 0.0f, 0.04f, 1 },
+};
+const int SKELETON_LOD_COUNT = sizeof(SKELETON_LODS) / sizeof(SKELETON_LODS[0]);
+
+// per vertex bone ids and weights of a reduced level, beside the shared packed vertex buffer
+struct LodBoneWeights
+{
+    uint8_t boneIds[4]; // palette slots, PACKED_NO_BONE where unused
+    uint8_t weights[4]; // unorm8, summing to 255
+};
+
+class SkeletonLod
+{
+public:
+    // a node of the hierarchy kept at a level, parents before children
+    struct Node
+    {
+        std::string name;
+        int parent;              // index into the level's nodes, -1 for the root
+        glm::mat4 transform;     // bind transform, for nodes no clip animates
+        int slot;                // palette slot, -1 if not a bone
+        glm::mat4 offset;
+    };
+
+    // `rig` supplies the node hierarchy; every clip of the character shares it
+    SkeletonLod(Model& model, Animation& rig)
+    {
+        std::map<std::string, BoneInfo>& bones = model.GetBoneInfoMap();
+        int boneCount = model.GetBoneCount();
+
+        // skin weight per bone and the model's bounding radius
+        std::vector<double> boneWeight(boneCount, 0.0);
+        double totalWeight = 0.0;
+        for (Mesh& mesh : model.meshes)
+        {
+            for (const Vertex& vertex : mesh.vertices)
+            {
+                radius = std::max(radius, glm::length(vertex.Position));
+                for (int k = 0; k < MAX_BONE_INFLUENCE; ++k)
+                {
+                    if (vertex.m_BoneIDs[k] >= boneCount || vertex.m_BoneIDs[k] >= PACKED_NO_BONE)
+                        idsInPalette = false;
+                    if (vertex.m_BoneIDs[k] < 0 || vertex.m_BoneIDs[k] >= boneCount)
+                        continue;
+                    boneWeight[vertex.m_BoneIDs[k]] += vertex.m_Weights[k];
+                    totalWeight += vertex.m_Weights[k];
+                }
+            }
+        }
+        std::map<std::string, double> subtreeWeight;
+        accumulateWeight(rig.GetRootNode(), bones, boneWeight, subtreeWeight);
+
+        for (int lod = 0; lod < SKELETON_LOD_COUNT; ++lod)
+        {
+            Level level;
+            level.influences = SKELETON_LODS[lod].influences;
+            level.slotOf.assign(boneCount, -1);
+            addNodes(rig.GetRootNode(), -1, -1, false, lod == 0, SKELETON_LODS[lod].mergeWeight * totalWeight, bones, subtreeWeight, level);
+            // level 0 keeps the full rig in id order
+            if (lod == 0)
+                for (int id = 0; id < boneCount; ++id)
+                    level.paletteBones.push_back(id);
+            else
+                buildVertexArrays(model, level);
+            levels.push_back(level);
+        }
+    }
+
+    ~SkeletonLod()
+    {
+        for (Level& level : levels)
+        {
+            glDeleteVertexArrays((GLsizei)level.vaos.size(), level.vaos.data());
+            glDeleteBuffers((GLsizei)level.buffers.size(), level.buffers.data());
+        }
+    }
+    SkeletonLod(const SkeletonLod&) = delete;
+    SkeletonLod& operator=(const SkeletonLod&) = delete;
+
+    int paletteSize(int lod) const { return (int)levels[lod].paletteBones.size(); }
+    int influences(int lod) const { return levels[lod].influences; }
+    float boundingRadius() const { return radius; }
+    const std::vector<Node>& nodes(int lod) const { return levels[lod].nodes; }
+
+    // the first level whose minimum screen fraction the sphere still covers
+    int select(const glm::mat4& projection, const glm::mat4& view, glm::vec3 center, float worldRadius) const
+    {
+        float depth = -(view * glm::vec4(center, 1.0f)).z;
+        float fraction = depth > worldRadius ? worldRadius * projection[1][1] / depth : 1.0f;
+        for (int lod = 0; lod < SKELETON_LOD_COUNT; ++lod)
+            if (fraction >= SKELETON_LODS[lod].minScreenFraction)
+                return lod;
+        return SKELETON_LOD_COUNT - 1;
+    }
+
+    // the level's palette out of a full Animator palette
+    void gatherPalette(int lod, const std::vector<glm::mat4>& finalBones, std::vector<glm::mat4>& palette) const
+    {
+        const std::vector<int>& kept = levels[lod].paletteBones;
+        palette.resize(kept.size());
+        for (size_t slot = 0; slot < kept.size(); ++slot)
+            palette[slot] = finalBones[kept[slot]];
+    }
+
+    // Defines of the anim_model.vs variant for a level (program_cache.h): the palette
+    // array sized to the rig, the level's influence count as a constant, and no id range
+    // test when every vertex's ids were found to fit (the reduced levels' slots always do).
+    std::vector<ShaderDefine> shaderDefines(int lod) const
+    {
+        return { { "MAX_BONES", std::max(1, paletteSize(0)) }, { "BONE_INFLUENCES", levels[lod].influences },
+                 { "BONE_IDS_CHECKED", idsInPalette ? 1 : 0 } };
+    }
+
+    // uploads only the level's bones and, on the generic program, sets its influence count
+    void apply(const CachedShader& shader, int lod, const std::vector<glm::mat4>& palette) const
+    {
+        if (palette.empty())
+            return;
+        if (paletteLocation == -2 || shader.ID != paletteProgram)
+        {
+            paletteProgram = shader.ID;
+            paletteLocation = glGetUniformLocation(shader.ID, "finalBonesMatrices[0]");
+            influencesLocation = glGetUniformLocation(shader.ID, "boneInfluences"); // -1 on a specialized variant
+        }
+        glUniformMatrix4fv(paletteLocation, (GLsizei)palette.size(), GL_FALSE, glm::value_ptr(palette[0]));
+        if (influencesLocation >= 0)
+            glUniform1i(influencesLocation, levels[lod].influences);
+    }
+
+    // level 0 keeps every bone in its original slot, so it draws from the mesh's own VAO
+    GLuint vertexArray(int lod, size_t mesh, GLuint meshVao) const
+    {
+        return lod == 0 ? meshVao : levels[lod].vaos[mesh];
+    }
+
+private:
+    struct Level
+    {
+        std::vector<Node> nodes;
+        std::vector<int> paletteBones; // original bone id per slot
+        std::vector<int> slotOf;       // original bone id -> slot, merged bones -> their ancestor's
+        int influences = 4;
+        std::vector<GLuint> vaos, buffers;
+    };
+
+    static double accumulateWeight(const AssimpNodeData& node, const std::map<std::string, BoneInfo>& bones,
+                                   const std::vector<double>& boneWeight, std::map<std::string, double>& subtreeWeight)
+    {
+        double weight = 0.0;
+        auto bone = bones.find(node.name);
+        if (bone != bones.end() && bone->second.id < (int)boneWeight.size())
+            weight += boneWeight[bone->second.id];
+        for (const AssimpNodeData& child : node.children)
+            weight += accumulateWeight(child, bones, boneWeight, subtreeWeight);
+        subtreeWeight[node.name] = weight;
+        return weight;
+    }
+
+    // Keeps a node if it carries enough weight or has no bone above it; a dropped bone
+    // and everything under it map to `ancestorSlot`. Subtree weight only grows towards
+    // the root, so the kept nodes always form a connected tree.
+    static void addNodes(const AssimpNodeData& node, int parent, int ancestorSlot, bool underBone, bool identitySlots, double minWeight,
+                         const std::map<std::string, BoneInfo>& bones, const std::map<std::string, double>& subtreeWeight, Level& level)
+    {
+        auto bone = bones.find(node.name);
+        bool isBone = bone != bones.end() && bone->second.id < (int)level.slotOf.size();
+        bool keep = !underBone || subtreeWeight.at(node.name) >= minWeight;
+        int index = parent;
+        if (keep)
+        {
+            Node kept;
+            kept.name = node.name;
+            kept.parent = parent;
+            kept.transform = node.transformation;
+            kept.slot = -1;
+            kept.offset = glm::mat4(1.0f);
+            if (isBone)
+            {
+                kept.slot = identitySlots ? bone->second.id : (int)level.paletteBones.size();
+                kept.offset = bone->second.offset;
+                ancestorSlot = kept.slot;
+            }
+            index = (int)level.nodes.size();
+            level.nodes.push_back(kept);
+        }
+        if (isBone)
+            level.slotOf[bone->second.id] = ancestorSlot;
+        if (keep && isBone && !identitySlots)
+            level.paletteBones.push_back(bone->second.id);
+
+        for (const AssimpNodeData& child : node.children)
+            addNodes(child, keep ? index : parent, ancestorSlot, underBone || isBone, identitySlots, minWeight, bones, subtreeWeight,
+                     level);
+    }
+
+    // remaps every vertex's influences to the level's slots, sums the ones that merged,
+    // keeps the strongest and renormalizes
+    void buildVertexArrays(Model& model, Level& level)
+    {
+        for (Mesh& mesh : model.meshes)
+        {
+            std::vector<LodBoneWeights> weights(mesh.vertices.size());
+            for (size_t v = 0; v < mesh.vertices.size(); ++v)
+            {
+                const Vertex& vertex = mesh.vertices[v];
+                int slots[4];
+                float amounts[4];
+                int count = 0;
+                for (int k = 0; k < MAX_BONE_INFLUENCE; ++k)
+                {
+                    int id = vertex.m_BoneIDs[k];
+                    if (id < 0 || id >= (int)level.slotOf.size() || level.slotOf[id] < 0)
+                        continue;
+                    int slot = level.slotOf[id];
+                    int existing = 0;
+                    while (existing < count && slots[existing] != slot)
+                        ++existing;
+                    if (existing == count)
+                    {
+                        slots[count] = slot;
+                        amounts[count++] = 0.0f;
+                    }
+                    amounts[existing] += vertex.m_Weights[k];
+                }
+                for (int i = 1; i < count; ++i)
+                    for (int j = i; j > 0 && amounts[j] > amounts[j - 1]; --j)
+                    {
+                        std::swap(amounts[j], amounts[j - 1]);
+                        std::swap(slots[j], slots[j - 1]);
+                    }
+                count = std::min(count, level.influences);
+                float sum = 0.0f;
+                for (int i = 0; i < count; ++i)
+                    sum += amounts[i];
+
+                LodBoneWeights& out = weights[v];
+                int total = 0;
+                for (int k = 0; k < 4; ++k)
+                {
+                    bool used = k < count && sum > 0.0f;
+                    out.boneIds[k] = used ? (uint8_t)slots[k] : PACKED_NO_BONE;
+                    out.weights[k] = used ? (uint8_t)std::lround(amounts[k] / sum * 255.0f) : 0;
+                    total += out.weights[k];
+                }
+                // rounding residue to the strongest, as packSkinnedVertices does
+                if (total > 0)
+                    out.weights[0] = (uint8_t)std::min(255, std::max(0, out.weights[0] + 255 - total));
+            }
+
+            GLuint buffer, vao;
+            glGenBuffers(1, &buffer);
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glBufferData(GL_ARRAY_BUFFER, weights.size() * sizeof(LodBoneWeights), weights.data(), GL_STATIC_DRAW);
+
+            GLint vbo = 0, ebo = 0;
+            glBindVertexArray(mesh.VAO);
+            glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vbo);
+            glGetIntegerv(GL_ELEMENT_ARRAY_BUFFER_BINDING, &ebo);
+
+            glGenVertexArrays(1, &vao);
+            glBindVertexArray(vao);
+            glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vbo);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, (GLuint)ebo);
+            setPackedSkinnedAttributes();
+            glBindBuffer(GL_ARRAY_BUFFER, buffer);
+            glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, sizeof(LodBoneWeights), (void*)offsetof(LodBoneWeights, boneIds));
+            glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(LodBoneWeights), (void*)offsetof(LodBoneWeights, weights));
+            glBindVertexArray(0);
+
+            level.buffers.push_back(buffer);
+            level.vaos.push_back(vao);
+        }
+    }
+
+    std::vector<Level> levels;
+    float radius = 0.0f;
+    bool idsInPalette = true; // every vertex bone id below the bone count, so below MAX_BONES
+    mutable GLuint paletteProgram = 0;
+    mutable GLint paletteLocation = -2;
+    mutable GLint influencesLocation = -1;
+};
+
+// One compressed clip evaluated at one level. The node walk is Animator::CalculateBoneTransform's
+// flattened once (composeSkeleton): bones are looked up by name at construction rather
+// than every frame, and merged bones are never interpolated. The clip's sampler decodes
+// forward playback cheaply and rewinds when time goes back, so a pose is meant for one
+// playback; `clip` must outlive it.
+class SkeletonLodPose
+{
+public:
+    SkeletonLodPose(const CompressedClip& clip, const SkeletonLod& lod, int level) : sampler(clip), paletteSize(lod.paletteSize(level))
+    {
+        for (const SkeletonLod::Node& node : lod.nodes(level))
+        {
+            skeleton.push_back({ node.parent, node.slot, node.offset });
+            binds.push_back(node.transform);
+            auto bone = std::find(clip.boneNames.begin(), clip.boneNames.end(), node.name);
+            bones.push_back(bone != clip.boneNames.end() ? (int)(bone - clip.boneNames.begin()) : -1);
+            if (bones.back() >= 0)
+                ++animatedBones;
+        }
+        locals.resize(skeleton.size());
+        globals.resize(skeleton.size());
+    }
+
+    int bonesEvaluated() const { return animatedBones; }
+    const std::vector<SkeletonNode>& nodes() const { return skeleton; }
+
+    // the level's local transforms at `ticks`, the bind transform where the clip does not
+    // animate a node; `out` holds at least one matrix per node
+    void sample(float ticks, std::vector<glm::mat4>& out)
+    {
+        sampler.seek(ticks);
+        for (size_t i = 0; i < bones.size(); ++i)
+            out[i] = bones[i] >= 0 ? poseMatrix(sampler.pose(bones[i])) : binds[i];
+    }
+
+    // time in ticks, as Animator keeps it
+    void evaluate(float ticks, std::vector<glm::mat4>& palette)
+    {
+        palette.resize(paletteSize);
+        sample(ticks, locals);
+        composeSkeleton(skeleton, locals, globals, palette);
+    }
+
+private:
+    ClipSampler sampler;
+    std::vector<SkeletonNode> skeleton;
+    std::vector<glm::mat4> binds;  // for the nodes no clip animates
+    std::vector<int> bones;        // per node, its bone in the clip, -1 where not animated
+    std::vector<glm::mat4> locals, globals;
+    int paletteSize = 0;
+    int animatedBones = 0;
+};
+
+// Stands in for learnopengl's blending Animator on the player: the same PlayAnimation /
+// UpdateAnimation controls and clip times (in ticks, named as Animator names them, so
+// the state machine drives either), but the pose is evaluated per call at the level the
+// character is drawn at, from the compressed copy of each clip. A blend of two clips
+// mixes their local transforms node by node before the one walk. Nothing is allocated
+// after construction.
+class SkeletonLodAnimator
+{
+public:
+    float m_CurrentTime = 0.0f;
+    float m_CurrentTime2 = 0.0f;
+
+    // `compressed` holds the clips of `clipList` in the same order and must outlive the animator;
+    // the Animations stay the handles PlayAnimation takes
+    SkeletonLodAnimator(const SkeletonLod& lod, const std::vector<Animation*>& clipList, const std::vector<CompressedClip>& compressed,
+                        Animation* start)
+        : clips(clipList)
+    {
+        size_t maxNodes = 0;
+        for (int level = 0; level < SKELETON_LOD_COUNT; ++level)
+        {
+            poses.emplace_back();
+            for (const CompressedClip& clip : compressed)
+                poses.back().emplace_back(clip, lod, level);
+            paletteSizes.push_back(lod.paletteSize(level));
+            maxNodes = std::max(maxNodes, lod.nodes(level).size());
+        }
+        locals.resize(maxNodes);
+        blended.resize(maxNodes);
+        globals.resize(maxNodes);
+        PlayAnimation(start, nullptr, 0.0f, 0.0f, 0.0f);
+    }
+
+    // `second` blended over `first` by `blend`, each from the given time
+    void PlayAnimation(Animation* first, Animation* second, float time, float time2, float blend)
+    {
+        current = clipIndex(first);
+        current2 = second != nullptr ? clipIndex(second) : -1;
+        m_CurrentTime = time;
+        m_CurrentTime2 = time2;
+        blendAmount = blend;
+    }
+
+    void UpdateAnimation(float deltaTime)
+    {
+        advance(clips[current], m_CurrentTime, deltaTime);
+        if (current2 >= 0)
+            advance(clips[current2], m_CurrentTime2, deltaTime);
+    }
+
+    // the current pose as the level's palette
+    void evaluate(int level, std::vector<glm::mat4>& palette)
+    {
+        SkeletonLodPose& pose = poses[level][current];
+        palette.resize(paletteSizes[level]);
+        if (current2 < 0 || blendAmount <= 0.0f)
+        {
+            pose.evaluate(m_CurrentTime, palette);
+            return;
+        }
+        size_t count = pose.nodes().size();
+        pose.sample(m_CurrentTime, locals);
+        poses[level][current2].sample(m_CurrentTime2, blended);
+        for (size_t i = 0; i < count; ++i)
+            blended[i] = locals[i] * (1.0f - blendAmount) + blended[i] * blendAmount;
+        composeSkeleton(pose.nodes(), blended, globals, palette);
+    }
+
+private:
+    int clipIndex(Animation* clip) const
+    {
+        for (size_t i = 0; i < clips.size(); ++i)
+            if (clips[i] == clip)
+                return (int)i;
+        return 0;
+    }
+
+    static void advance(Animation* clip, float& time, float deltaTime)
+    {
+        time += clip->GetTicksPerSecond() * deltaTime;
+        time = std::fmod(time, clip->GetDuration());
+    }
+
+    std::vector<Animation*> clips;
+    std::vector<std::vector<SkeletonLodPose>> poses; // [level][clip]
+    std::vector<int> paletteSizes;
+    std::vector<glm::mat4> locals, blended, globals;
+    int current = 0;
+    int current2 = -1;
+    float blendAmount = 0.0f;
+};
@@ -0,0 +1,218 @@
+// bench_harness.h
+// Microbenchmark runner for the GL-free cores, built as the `bench` target:
+//  - Benchmark: a name, the work items one operation covers (rows, cars, bones...)
+//    and a prepare() that builds the inputs and returns the operation. prepare() only
+//    runs for the benchmarks the filter selects
+//  - runBenchmark: calibrates a batch size to the minimum time, then times `samples`
+//    batches and keeps the median and the fastest ns per operation
+//  - results go out as a table, CSV or JSON; either file format can be read back as
+//    a baseline, and compareWithBaseline fails on any benchmark slower than the
+//    baseline by more than the threshold
+// Anything the benchmarked code prints to std::cout (the game's status lines) is
+// dropped while it runs; the harness itself writes through stdio.
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <streambuf>
+#include <string>
+#include <vector>
+
+struct Benchmark
+{
+    std::string name;
+    double itemsPerOp;
+    std::function<std::function<void()>()> prepare;
+};
+
+struct BenchResult
+{
+    std::string name;
+    double nsPerOp = 0.0;    // median of the samples
+    double minNsPerOp = 0.0; // fastest sample
+    double itemsPerOp = 0.0;
+    long long iterations = 0; // per sample
+};
+
+struct BenchSettings
+{
+    double minSeconds = 0.2; // per sample
+    int samples = 5;
+};
+
+// Results that would otherwise be dead code are folded into this
+inline volatile double benchSink = 0.0;
+
+inline void keepResult(double value)
+{
+    benchSink = benchSink + value;
+}
+
+// Swallows std::cout for its lifetime
+class QuietCout
+{
+public:
+    QuietCout() : previous(std::cout.rdbuf(&discard)) {}
+    ~QuietCout() { std::cout.rdbuf(previous); }
+
+private:
+    struct Discard : std::streambuf
+    {
+        int overflow(int c) override { return c; }
+    };
+    Discard discard;
+    std::streambuf* previous;
+};
+
+inline BenchResult runBenchmark(const Benchmark& benchmark, const BenchSettings& settings)
+{
+    QuietCout quiet;
+    std::function<void()> op = benchmark.prepare();
+    auto timeBatch = [&op](long long iterations) {
+        auto start = std::chrono::steady_clock::now();
+        for (long long i = 0; i < iterations; ++i)
+            op();
+        return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    // grow the batch until it takes a tenth of the minimum time, then scale it up
+    op(); // warm up caches and pools
+    long long iterations = 1;
+    double seconds = timeBatch(iterations);
+    while (seconds < settings.minSeconds * 0.1 && iterations < (1LL << 40))
+    {
+        iterations *= 10;
+        seconds = timeBatch(iterations);
+    }
+    if (seconds < settings.minSeconds)
+        iterations = std::max(iterations, (long long)(iterations * settings.minSeconds / std::max(seconds, 1.0e-9)));
+
+    std::vector<double> nsPerOp;
+    for (int sample = 0; sample < settings.samples; ++sample)
+        nsPerOp.push_back(timeBatch(iterations) * 1.0e9 / iterations);
+    std::sort(nsPerOp.begin(), nsPerOp.end());
+
+    BenchResult result;
+    result.name = benchmark.name;
+    result.nsPerOp = nsPerOp[nsPerOp.size() / 2];
+    result.minNsPerOp = nsPerOp.front();
+    result.itemsPerOp = benchmark.itemsPerOp;
+    result.iterations = iterations;
+    return result;
+}
+
+inline double itemsPerSecond(const BenchResult& result)
+{
+    return result.nsPerOp > 0.0 ? result.itemsPerOp * 1.0e9 / result.nsPerOp : 0.0;
+}
+
+// ------------------------------------------------------------------------------------
+// output
+
+inline void printBenchTableHeader(FILE* out)
+{
+    std::fprintf(out, "%-32s %14s %14s %10s %14s %12s\n", "benchmark", "ns/op", "min ns/op", "items/op", "M items/s", "iterations");
+}
+
+inline void printBenchTableRow(FILE* out, const BenchResult& result)
+{
+    std::fprintf(out, "%-32s %14.1f %14.1f %10.0f %14.3f %12lld\n", result.name.c_str(), result.nsPerOp, result.minNsPerOp,
+                 result.itemsPerOp, itemsPerSecond(result) / 1.0e6, result.iterations);
+    std::fflush(out);
+}
+
+inline void writeBenchCsv(FILE* out, const std::vector<BenchResult>& results)
+{
+    std::fprintf(out, "name,ns_per_op,min_ns_per_op,items_per_op,items_per_second,iterations\n");
+    for (const BenchResult& result : results)
+        std::fprintf(out, "%s,%.3f,%.3f,%.0f,%.1f,%lld\n", result.name.c_str(), result.nsPerOp, result.minNsPerOp, result.itemsPerOp,
+                     itemsPerSecond(result), result.iterations);
+}
+
+// one object per line, so the baseline reader does not need a JSON parser
+inline void writeBenchJson(FILE* out, const std::vector<BenchResult>& results)
+{
+    std::fprintf(out, "[\n");
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const BenchResult& result = results[i];
+        std::fprintf(out,
+                     "  {\"name\": \"%s\", \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, \"items_per_op\": %.0f, "
+                     "\"items_per_second\": %.1f, \"iterations\": %lld}%s\n",
+                     result.name.c_str(), result.nsPerOp, result.minNsPerOp, result.itemsPerOp, itemsPerSecond(result), result.iterations,
+                     i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(out, "]\n");
+}
+
+// ------------------------------------------------------------------------------------
+// baselines
+
+// name -> ns per op, from a file written by writeBenchCsv or writeBenchJson
+inline bool loadBenchBaseline(const std::string& path, std::map<std::string, double>& baseline)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        std::fprintf(stderr, "Failed to open baseline %s\n", path.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        size_t key = line.find("\"name\": \"");
+        if (key != std::string::npos)
+        {
+            size_t begin = key + 9;
+            size_t end = line.find('"', begin);
+            size_t value = line.find("\"ns_per_op\": ");
+            if (end != std::string::npos && value != std::string::npos)
+                baseline[line.substr(begin, end - begin)] = std::atof(line.c_str() + value + 13);
+        }
+        else if (!line.empty() && line[0] != '[' && line[0] != ']' && line.compare(0, 5, "name,") != 0)
+        {
+            size_t comma = line.find(',');
+            if (comma != std::string::npos)
+                baseline[line.substr(0, comma)] = std::atof(line.c_str() + comma + 1);
+        }
+    }
+    return true;
+}
+
+// Prints every benchmark against its baseline; returns how many are slower than the
+// baseline by more than thresholdPercent. Benchmarks missing on either side are listed
+// but never fail the comparison.
+inline int compareWithBaseline(FILE* out, const std::vector<BenchResult>& results, const std::map<std::string, double>& baseline,
+                               double thresholdPercent)
+{
+    int regressions = 0;
+    std::fprintf(out, "\nAgainst the baseline (threshold +%.1f%%):\n", thresholdPercent);
+    std::fprintf(out, "%-32s %14s %14s %9s\n", "benchmark", "baseline ns", "ns/op", "change");
+    for (const BenchResult& result : results)
+    {
+        auto entry = baseline.find(result.name);
+        if (entry == baseline.end() || entry->second <= 0.0)
+        {
+            std::fprintf(out, "%-32s %14s %14.1f %9s\n", result.name.c_str(), "-", result.nsPerOp, "new");
+            continue;
+        }
+        double change = (result.nsPerOp / entry->second - 1.0) * 100.0;
+        bool regressed = change > thresholdPercent;
+        regressions += regressed ? 1 : 0;
+        std::fprintf(out, "%-32s %14.1f %14.1f %+8.1f%%%s\n", result.name.c_str(), entry->second, result.nsPerOp, change,
+                     regressed ? "  REGRESSION" : "");
+    }
+    for (const auto& entry : baseline)
+    {
+        bool ran = std::any_of(results.begin(), results.end(), [&entry](const BenchResult& result) { return result.name == entry.first; });
+        if (!ran)
+            std::fprintf(out, "%-32s %14.1f %14s %9s\n", entry.first.c_str(), entry.second, "-", "not run");
+    }
+    return regressions;
+}
@@ -0,0 +1,401 @@
+// bench: microbenchmarks of the hot paths of the three demos, without a window or a
+// GPU. Only the GL-free cores are linked (see CMakeLists.txt):
+//   crossy/*     the crossing game's world: row spawning, ticks, the render snapshot,
+//                impact prediction and world snapshots (Assignment4)
+//   traffic/*    IDM car following (Assignment4)
+//   kinetic/*    sphere LOD mesh generation, Barnes-Hut steps, mip chains and BC1
+//                encoding (Assignment3)
+//   animation/*  raw and compressed clip sampling, the skeleton walk, clip
+//                compression, on a synthetic clip (Assignment5)
+//   mesh/*       vertex cache optimization
+//
+// usage: bench [--filter <text>] [--quick] [--min-time <s>] [--samples <n>] [--list]
+//              [--csv | --json] [--output <file>] [--baseline <file>] [--threshold <percent>]
+//   --filter     run only the benchmarks whose name contains the text
+//   --quick      short samples, for smoke tests
+//   --csv/--json print the results in that format instead of a table
+//   --output     also write the results to a file, as JSON if it ends in .json, else CSV
+//   --baseline   compare with an earlier --output (CSV or JSON) and exit with 1 if any
+//                benchmark is slower by more than --threshold percent (default 10)
+
+#include "../common/clip_compression.h"
+#include "../common/mesh_optimizer.h"
+#include "../common/skeleton_pose.h"
+#include "bench_harness.h"
+
+#include "crossy_world.h"
+#include "game_pipeline.h"
+#include "nbody.h"
+#include "sphere_lod.h"
+#include "texture_cache.h"
+#include "traffic_model.h"
+#include "world_snapshot.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------------------
+// inputs
+
+// A crossing-game world with `rows` rows; the constructor's seed makes it the same world every run
+std::shared_ptr<CrossyWorld> makeWorld(int rows)
+{
+    std::shared_ptr<CrossyWorld> world = std::make_shared<CrossyWorld>();
+    world->spawnRows(rows - world->rowCount());
+    return world;
+}
+
+// A humanoid-sized skeleton: a spine of `chain` nodes with arms, legs and fingers
+// hanging off it, every node a bone, animated for `seconds` at 30 keys per second
+// with smooth rotations and a little translation
+RawClip makeSyntheticClip(int bones, float seconds, std::vector<SkeletonNode>& skeleton)
+{
+    RawClip clip;
+    clip.name = "synthetic";
+    clip.ticksPerSecond = 30.0f;
+    clip.duration = seconds * clip.ticksPerSecond;
+    int keys = (int)clip.duration + 1;
+    std::mt19937 random(7);
+    std::uniform_real_distribution<float> phase(0.0f, 6.2831853f);
+    skeleton.clear();
+    for (int bone = 0; bone < bones; ++bone)
+    {
+        // the first 8 nodes form the spine; each later node hangs off one 1 to 4 places before it
+        int parent = bone == 0 ? -1 : bone < 8 ? bone - 1 : bone - 1 - (int)(random() % std::min(4, bone));
+        skeleton.push_back({ parent, bone, glm::mat4(1.0f) });
+
+        RawTrack track;
+        track.name = "bone" + std::to_string(bone);
+        float a = phase(random), b = phase(random);
+        for (int key = 0; key < keys; ++key)
+        {
+            float time = (float)key;
+            float t = time / clip.ticksPerSecond;
+            track.positionTimes.push_back(time);
+            track.positions.push_back(glm::vec3(0.0f, 0.1f + 0.01f * std::sin(t * 2.0f + a), 0.0f));
+            track.rotationTimes.push_back(time);
+            glm::vec3 axis = glm::normalize(glm::vec3(std::sin(a), std::cos(b), 0.5f));
+            float angle = 0.6f * std::sin(t * 3.0f + b);
+            track.rotations.push_back(glm::quat(std::cos(angle * 0.5f), axis.x * std::sin(angle * 0.5f), axis.y * std::sin(angle * 0.5f),
+                                                axis.z * std::sin(angle * 0.5f)));
+        }
+        track.scaleTimes.push_back(0.0f);
+        track.scales.push_back(glm::vec3(1.0f));
+        clip.tracks.push_back(track);
+    }
+    return clip;
+}
+
+// An n x n grid of quads whose triangles are shuffled, as a mesh straight out of an exporter can be
+std::vector<unsigned int> makeShuffledGrid(int n)
+{
+    std::vector<unsigned int> indices;
+    auto vertex = [n](int x, int y) { return (unsigned int)(y * (n + 1) + x); };
+    for (int y = 0; y < n; ++y)
+        for (int x = 0; x < n; ++x)
+        {
+            unsigned int quad[6] = { vertex(x, y), vertex(x + 1, y), vertex(x + 1, y + 1), vertex(x, y), vertex(x + 1, y + 1), vertex(x, y + 1) };
+            indices.insert(indices.end(), quad, quad + 6);
+        }
+    std::mt19937 random(3);
+    for (size_t triangle = indices.size() / 3; triangle > 1; --triangle)
+    {
+        size_t other = random() % triangle;
+        for (int corner = 0; corner < 3; ++corner)
+            std::swap(indices[(triangle - 1) * 3 + corner], indices[other * 3 + corner]);
+    }
+    return indices;
+}
+
+// An RGB test image with gradients, edges and noise, so BC1 blocks are not trivial
+std::vector<unsigned char> makeTestImage(int width, int height)
+{
+    std::vector<unsigned char> pixels((size_t)width * height * 3);
+    std::mt19937 random(5);
+    for (int y = 0; y < height; ++y)
+        for (int x = 0; x < width; ++x)
+        {
+            unsigned char* p = &pixels[((size_t)y * width + x) * 3];
+            bool checker = ((x / 16) + (y / 16)) % 2 == 0;
+            p[0] = (unsigned char)(x * 255 / width);
+            p[1] = (unsigned char)(checker ? 200 : 40);
+            p[2] = (unsigned char)((y * 255 / height + random() % 32) & 0xff);
+        }
+    return pixels;
+}
+
+std::string snapshotBenchPath()
+{
+    return (std::filesystem::temp_directory_path() / "bench_world_snapshot.bin").string();
+}
+
+// ------------------------------------------------------------------------------------
+// benchmarks
+
+std::vector<Benchmark> allBenchmarks()
+{
+    std::vector<Benchmark> benchmarks;
+    const int spawnRows = 1000;
+    const int worldRows = 2048;
+
+    // reset() plus 1000 more rows: the row generator, as resetGame and an endless run use it
+    benchmarks.push_back({ "crossy/spawn_rows", (double)(spawnRows + VISIBLE_ROWS * 2), [] {
+        std::shared_ptr<CrossyWorld> world = std::make_shared<CrossyWorld>();
+        return std::function<void()>([world] {
+            world->reset();
+            world->spawnRows(spawnRows);
+        });
+    } });
+    // one fixed step of a standing player in a 2048-row world
+    benchmarks.push_back({ "crossy/tick", 1.0, [] {
+        std::shared_ptr<CrossyWorld> world = makeWorld(worldRows);
+        return std::function<void()>([world] { world->tick(1.0f / 60.0f); });
+    } });
+    // what the simulation thread copies out for the renderer after a tick, per visible car
+    {
+        std::shared_ptr<CrossyWorld> probe = makeWorld(worldRows);
+        std::shared_ptr<GameSnapshot> snapshot = std::make_shared<GameSnapshot>();
+        captureSnapshot(*probe, *snapshot);
+        double cars = (double)std::max<size_t>(1, snapshot->cars.size());
+        benchmarks.push_back({ "crossy/capture_snapshot", cars, [probe, snapshot] {
+            return std::function<void()>([probe, snapshot] {
+                captureSnapshot(*probe, *snapshot);
+                keepResult(snapshot->cars.size());
+            });
+        } });
+    }
+    // the collision sweep of checkCollisions(), at x = 0 for every lane of a 2048-row world
+    {
+        std::shared_ptr<CrossyWorld> probe = makeWorld(worldRows);
+        probe->lanes.step(1.0f / 60.0f);
+        benchmarks.push_back({ "crossy/collision_sweep", (double)probe->lanes.laneCount(), [probe] {
+            return std::function<void()>([probe] {
+                size_t hits = 0;
+                for (const TrafficLane& lane : probe->lanes.laneData())
+                    hits += lane.sweptWithin(ROAD_HALF_LENGTH, COLLISION_DISTANCE) ? 1 : 0;
+                keepResult(hits);
+            });
+        } });
+    }
+    // world snapshots of 10^4 rows, through the page cache
+    const int snapshotRows = 10000;
+    std::string snapshotPath = snapshotBenchPath();
+    benchmarks.push_back({ "crossy/snapshot_save", (double)snapshotRows, [snapshotPath] {
+        std::shared_ptr<CrossyWorld> world = makeWorld(snapshotRows);
+        return std::function<void()>([world, snapshotPath] { saveWorldSnapshot(*world, snapshotPath); });
+    } });
+    benchmarks.push_back({ "crossy/snapshot_load", (double)snapshotRows, [snapshotPath] {
+        saveWorldSnapshot(*makeWorld(snapshotRows), snapshotPath);
+        std::shared_ptr<CrossyWorld> world = std::make_shared<CrossyWorld>();
+        return std::function<void()>([world, snapshotPath] { loadWorldSnapshot(*world, snapshotPath); });
+    } });
+
+    // one IDM step of 10 lanes of 1000 cars, on the calling thread
+    benchmarks.push_back({ "traffic/step", 10000.0, [] {
+        std::shared_ptr<TrafficModel> model = std::make_shared<TrafficModel>(10, 1000, 1000 * 25.0f);
+        for (int i = 0; i < 60; ++i)
+            model->step(1.0f / 60.0f);
+        return std::function<void()>([model] { model->step(1.0f / 60.0f); });
+    } });
+
+    // the CPU half of createSphereVAO: every level from 8 to 128 sectors
+    {
+        size_t vertices = buildSphereLodChain(8, 128, false).vertices.size() / SPHERE_FLOATS_PER_VERTEX;
+        benchmarks.push_back({ "kinetic/sphere_lod_chain", (double)vertices, [] {
+            return std::function<void()>([] { keepResult(buildSphereLodChain(8, 128, false).indices.size()); });
+        } });
+    }
+    // one leapfrog step of a 10^4-body Plummer sphere, tree rebuilt, on the calling thread
+    benchmarks.push_back({ "kinetic/nbody_step", 10000.0, [] {
+        std::shared_ptr<NBodySystem> system = std::make_shared<NBodySystem>(makePlummerSphere(10000));
+        return std::function<void()>([system] { system->step(1.0 / 256.0); });
+    } });
+    // a full mip chain and its BC1 encoding, for a 512 x 512 image
+    benchmarks.push_back({ "kinetic/mip_chain", 512.0 * 512.0, [] {
+        std::shared_ptr<std::vector<unsigned char>> image = std::make_shared<std::vector<unsigned char>>(makeTestImage(512, 512));
+        return std::function<void()>([image] { keepResult(buildMipChain(image->data(), 512, 512, 3).size()); });
+    } });
+    benchmarks.push_back({ "kinetic/bc1_encode", 512.0 * 512.0, [] {
+        std::shared_ptr<std::vector<unsigned char>> image = std::make_shared<std::vector<unsigned char>>(makeTestImage(512, 512));
+        return std::function<void()>([image] { keepResult(encodeBC1(image->data(), 512, 512, 3).size()); });
+    } });
+
+    // a 64-bone clip played forward at 60 Hz; items are bones
+    const int bones = 64;
+    struct ClipBench
+    {
+        std::vector<SkeletonNode> skeleton;
+        RawClip raw;
+        CompressedClip compressed;
+        std::vector<BonePose> poses;
+        std::vector<glm::mat4> locals, globals, palette;
+        float time = 0.0f;
+
+        ClipBench() : raw(makeSyntheticClip(bones, 4.0f, skeleton)), compressed(compressClip(raw)), poses(bones), locals(bones),
+                      globals(bones), palette(bones) {}
+
+        void advance() { time = std::fmod(time + raw.ticksPerSecond / 60.0f, raw.duration); }
+    };
+    benchmarks.push_back({ "animation/sample_raw", (double)bones, [] {
+        std::shared_ptr<ClipBench> clip = std::make_shared<ClipBench>();
+        return std::function<void()>([clip] {
+            for (size_t bone = 0; bone < clip->raw.tracks.size(); ++bone)
+                clip->poses[bone] = sampleRawTrack(clip->raw.tracks[bone], clip->time);
+            keepResult(clip->poses[bones - 1].rotation.w);
+            clip->advance();
+        });
+    } });
+    benchmarks.push_back({ "animation/sample_compressed", (double)bones, [] {
+        std::shared_ptr<ClipBench> clip = std::make_shared<ClipBench>();
+        std::shared_ptr<ClipSampler> sampler = std::make_shared<ClipSampler>(clip->compressed);
+        return std::function<void()>([clip, sampler] {
+            sampler->sample(clip->time, clip->poses);
+            keepResult(clip->poses[bones - 1].rotation.w);
+            clip->advance();
+        });
+    } });
+    benchmarks.push_back({ "animation/compose_palette", (double)bones, [] {
+        std::shared_ptr<ClipBench> clip = std::make_shared<ClipBench>();
+        for (size_t bone = 0; bone < clip->raw.tracks.size(); ++bone)
+            clip->poses[bone] = sampleRawTrack(clip->raw.tracks[bone], 17.0f);
+        return std::function<void()>([clip] {
+            for (int bone = 0; bone < bones; ++bone)
+                clip->locals[bone] = poseMatrix(clip->poses[bone]);
+            composeSkeleton(clip->skeleton, clip->locals, clip->globals, clip->palette);
+            keepResult(clip->palette[bones - 1][3][1]);
+        });
+    } });
+    benchmarks.push_back({ "animation/compress_clip", (double)bones, [] {
+        std::shared_ptr<ClipBench> clip = std::make_shared<ClipBench>();
+        return std::function<void()>([clip] { keepResult(compressClip(clip->raw).bytes()); });
+    } });
+
+    // Forsyth-style vertex cache ordering of a shuffled 64 x 64 grid (the copy is included)
+    benchmarks.push_back({ "mesh/vertex_cache_optimize", 64.0 * 64.0 * 2.0, [] {
+        std::shared_ptr<std::vector<unsigned int>> source = std::make_shared<std::vector<unsigned int>>(makeShuffledGrid(64));
+        std::shared_ptr<std::vector<unsigned int>> indices = std::make_shared<std::vector<unsigned int>>();
+        return std::function<void()>([source, indices] {
+            *indices = *source;
+            optimizeVertexCache(*indices, 65 * 65);
+            keepResult((*indices)[0]);
+        });
+    } });
+    return benchmarks;
+}
+
+// ------------------------------------------------------------------------------------
+
+static bool endsWith(const std::string& text, const char* suffix)
+{
+    size_t length = std::strlen(suffix);
+    return text.size() >= length && text.compare(text.size() - length, length, suffix) == 0;
+}
+
+int main(int argc, char** argv)
+{
+    BenchSettings settings;
+    std::string filter, outputPath, baselinePath;
+    bool csv = false, json = false, list = false;
+    double threshold = 10.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc)
+            filter = argv[++i];
+        else if (strcmp(argv[i], "--quick") == 0)
+        {
+            settings.minSeconds = 0.01;
+            settings.samples = 3;
+        }
+        else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc)
+            settings.minSeconds = atof(argv[++i]);
+        else if (strcmp(argv[i], "--samples") == 0 && i + 1 < argc)
+            settings.samples = std::max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--csv") == 0)
+            csv = true;
+        else if (strcmp(argv[i], "--json") == 0)
+            json = true;
+        else if (strcmp(argv[i], "--list") == 0)
+            list = true;
+        else if (strcmp(argv[i], "--output") == 0 && i + 1 < argc)
+            outputPath = argv[++i];
+        else if (strcmp(argv[i], "--baseline") == 0 && i + 1 < argc)
+            baselinePath = argv[++i];
+        else if (strcmp(argv[i], "--threshold") == 0 && i + 1 < argc)
+            threshold = atof(argv[++i]);
+        else
+        {
+            std::fprintf(stderr, "Unknown argument %s (see the top of bench/main.cpp)\n", argv[i]);
+            return 2;
+        }
+    }
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !loadBenchBaseline(baselinePath, baseline))
+        return 2;
+
+    std::vector<Benchmark> benchmarks;
+    {
+        QuietCout quiet; // building the probe worlds prints the game's greeting
+        benchmarks = allBenchmarks();
+    }
+    bool table = !csv && !json && !list;
+    if (table)
+        printBenchTableHeader(stdout);
+    std::vector<BenchResult> results;
+    for (const Benchmark& benchmark : benchmarks)
+    {
+        if (!filter.empty() && benchmark.name.find(filter) == std::string::npos)
+            continue;
+        if (list)
+        {
+            std::printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+        results.push_back(runBenchmark(benchmark, settings));
+        if (table)
+            printBenchTableRow(stdout, results.back());
+    }
+    if (list)
+        return 0;
+    std::error_code error;
+    std::filesystem::remove(snapshotBenchPath(), error);
+    if (csv)
+        writeBenchCsv(stdout, results);
+    if (json)
+        writeBenchJson(stdout, results);
+
+    if (!outputPath.empty())
+    {
+        FILE* file = std::fopen(outputPath.c_str(), "w");
+        if (file == nullptr)
+        {
+            std::fprintf(stderr, "Failed to write %s\n", outputPath.c_str());
+            return 2;
+        }
+        if (endsWith(outputPath, ".json"))
+            writeBenchJson(file, results);
+        else
+            writeBenchCsv(file, results);
+        std::fclose(file);
+    }
+
+    if (!baselinePath.empty())
+    {
+        // the comparison goes to stderr when stdout carries CSV or JSON
+        int regressions = compareWithBaseline(table ? stdout : stderr, results, baseline, threshold);
+        if (regressions > 0)
+        {
+            std::fprintf(stderr, "%d benchmark(s) regressed by more than %.1f%%\n", regressions, threshold);
+            return 1;
+        }
+    }
+    return 0;
+}
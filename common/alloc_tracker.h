@@ -0,0 +1,154 @@
+// alloc_tracker.h
+// Counts heap allocations made through operator new, on every thread, by replacing
+// the global operator new / delete. Define ALLOC_TRACKER_IMPLEMENTATION before
+// including this in exactly one translation unit (each assignment's main.cpp).
+// Memory taken with malloc directly (stb_image, Assimp's C parts) is not seen.
+//  - heapAllocations(): running total
+//  - AllocationStats: allocations per frame; frames after a warm-up should show none
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+inline std::atomic<uint64_t> heapAllocationCount { 0 };
+inline std::atomic<uint64_t> heapAllocationBytes { 0 };
+
+inline uint64_t heapAllocations() { return heapAllocationCount.load(std::memory_order_relaxed); }
+inline uint64_t heapAllocatedBytes() { return heapAllocationBytes.load(std::memory_order_relaxed); }
+
+class AllocationStats
+{
+public:
+    // the first `warmupFrames` frames load, fill caches and grow buffers to their working size
+    explicit AllocationStats(long long warmupFrames = 120) : warmup(warmupFrames), last(heapAllocations()) {}
+
+    // call once per frame, after the swap
+    void endFrame()
+    {
+        uint64_t now = heapAllocations();
+        uint64_t allocations = now - last;
+        last = now;
+        lastCount = allocations;
+        if (++frames <= warmup)
+            return;
+        steadyAllocations += allocations;
+        if (allocations > 0)
+            ++framesWithAllocations;
+        maxPerFrame = std::max(maxPerFrame, allocations);
+    }
+
+    uint64_t lastFrame() const { return lastCount; }
+    uint64_t steadyStateAllocations() const { return steadyAllocations; }
+
+    void report(std::ostream& out, const char* label) const
+    {
+        if (frames <= warmup)
+            return;
+        out << label << ": " << steadyAllocations << " over " << frames - warmup << " frames after a " << warmup
+            << "-frame warm-up, " << framesWithAllocations << " frames allocated, max " << maxPerFrame << " per frame" << std::endl;
+    }
+
+private:
+    long long warmup;
+    long long frames = 0;
+    uint64_t last;
+    uint64_t lastCount = 0;
+    uint64_t steadyAllocations = 0;
+    uint64_t framesWithAllocations = 0;
+    uint64_t maxPerFrame = 0;
+};
+
+#ifdef ALLOC_TRACKER_IMPLEMENTATION
+
+// the replacements pair malloc / aligned_alloc with free; GCC sees a free inlined into
+// an operator delete and takes it for a mismatch
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+inline void* trackedAllocate(std::size_t size) noexcept
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    heapAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+    return std::malloc(size != 0 ? size : 1);
+}
+
+// over-aligned types (alignas above the default new alignment)
+inline void* trackedAllocate(std::size_t size, std::align_val_t alignment) noexcept
+{
+    heapAllocationCount.fetch_add(1, std::memory_order_relaxed);
+    heapAllocationBytes.fetch_add(size, std::memory_order_relaxed);
+    std::size_t align = (std::size_t)alignment;
+    std::size_t rounded = (std::max<std::size_t>(size, 1) + align - 1) / align * align; // aligned_alloc wants a multiple
+#ifdef _WIN32
+    return _aligned_malloc(rounded, align);
+#else
+    return std::aligned_alloc(align, rounded);
+#endif
+}
+
+inline void trackedFreeAligned(void* memory) noexcept
+{
+#ifdef _WIN32
+    _aligned_free(memory);
+#else
+    std::free(memory);
+#endif
+}
+
+void* operator new(std::size_t size)
+{
+    if (void* memory = trackedAllocate(size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size)
+{
+    if (void* memory = trackedAllocate(size))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept { return trackedAllocate(size); }
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete[](void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete[](void* memory, std::size_t) noexcept { std::free(memory); }
+void operator delete(void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+void operator delete[](void* memory, const std::nothrow_t&) noexcept { std::free(memory); }
+
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    if (void* memory = trackedAllocate(size, alignment))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    if (void* memory = trackedAllocate(size, alignment))
+        return memory;
+    throw std::bad_alloc();
+}
+
+void* operator new(std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedAllocate(size, alignment); }
+void* operator new[](std::size_t size, std::align_val_t alignment, const std::nothrow_t&) noexcept { return trackedAllocate(size, alignment); }
+void operator delete(void* memory, std::align_val_t) noexcept { trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t) noexcept { trackedFreeAligned(memory); }
+void operator delete(void* memory, std::size_t, std::align_val_t) noexcept { trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::size_t, std::align_val_t) noexcept { trackedFreeAligned(memory); }
+void operator delete(void* memory, std::align_val_t, const std::nothrow_t&) noexcept { trackedFreeAligned(memory); }
+void operator delete[](void* memory, std::align_val_t, const std::nothrow_t&) noexcept { trackedFreeAligned(memory); }
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+#endif
@@ -0,0 +1,527 @@
+// clip_compression.h
+// Keyframe compression for skeletal clips, no GL and no Assimp (clip_import.h loads
+// the clips from files):
+//  - RawClip: the keys of every channel exactly as learnopengl's Bone stores them,
+//    plus the Bone::Update sampling path
+//  - compressClip: per channel, constant channels are stored once; the rest are
+//    quantized (16-bit per component in the channel's range, rotations as
+//    smallest-three) and then every key that interpolation between its kept neighbours
+//    reproduces within the channel's tolerance is dropped
+//  - the kept keys of all channels go into one stream sorted by the time at which
+//    playback first needs them, so ClipSampler decodes a forward-playing clip by
+//    reading the stream front to back, each key once
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ------------------------------------------------------------------------------------
+// raw clips
+
+struct BonePose
+{
+    glm::vec3 position = glm::vec3(0.0f);
+    glm::quat rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+    glm::vec3 scale = glm::vec3(1.0f);
+};
+
+inline glm::mat4 poseMatrix(const BonePose& pose)
+{
+    return glm::translate(glm::mat4(1.0f), pose.position) * glm::mat4_cast(pose.rotation) * glm::scale(glm::mat4(1.0f), pose.scale);
+}
+
+struct RawTrack
+{
+    std::string name;
+    std::vector<float> positionTimes, rotationTimes, scaleTimes;
+    std::vector<glm::vec3> positions, scales;
+    std::vector<glm::quat> rotations;
+};
+
+struct RawClip
+{
+    std::string name;
+    float duration = 0.0f; // ticks
+    float ticksPerSecond = 0.0f;
+    std::vector<RawTrack> tracks;
+
+    size_t keyCount() const
+    {
+        size_t keys = 0;
+        for (const RawTrack& track : tracks)
+            keys += track.positions.size() + track.rotations.size() + track.scales.size();
+        return keys;
+    }
+
+    // as learnopengl's Bone holds them: KeyPosition / KeyScale are a vec3 and a float,
+    // KeyRotation a quat and a float
+    size_t bytes() const
+    {
+        size_t total = 0;
+        for (const RawTrack& track : tracks)
+            total += (track.positions.size() + track.scales.size()) * 16 + track.rotations.size() * 20;
+        return total;
+    }
+};
+
+// Bone::GetPositionIndex and friends: linear search from the first key
+inline size_t rawKeyIndex(const std::vector<float>& times, float time)
+{
+    for (size_t index = 0; index + 1 < times.size(); ++index)
+        if (time < times[index + 1])
+            return index;
+    return times.size() >= 2 ? times.size() - 2 : 0;
+}
+
+inline float rawKeyFactor(const std::vector<float>& times, size_t index, float time)
+{
+    float span = times[index + 1] - times[index];
+    return span > 0.0f ? std::min(1.0f, std::max(0.0f, (time - times[index]) / span)) : 0.0f;
+}
+
+// Bone::Update: lerp positions and scales, slerp rotations
+inline BonePose sampleRawTrack(const RawTrack& track, float time)
+{
+    BonePose pose;
+    if (track.positions.size() == 1)
+        pose.position = track.positions[0];
+    else if (!track.positions.empty())
+    {
+        size_t k = rawKeyIndex(track.positionTimes, time);
+        pose.position = glm::mix(track.positions[k], track.positions[k + 1], rawKeyFactor(track.positionTimes, k, time));
+    }
+    if (track.rotations.size() == 1)
+        pose.rotation = glm::normalize(track.rotations[0]);
+    else if (!track.rotations.empty())
+    {
+        size_t k = rawKeyIndex(track.rotationTimes, time);
+        pose.rotation = glm::normalize(glm::slerp(track.rotations[k], track.rotations[k + 1], rawKeyFactor(track.rotationTimes, k, time)));
+    }
+    if (track.scales.size() == 1)
+        pose.scale = track.scales[0];
+    else if (!track.scales.empty())
+    {
+        size_t k = rawKeyIndex(track.scaleTimes, time);
+        pose.scale = glm::mix(track.scales[k], track.scales[k + 1], rawKeyFactor(track.scaleTimes, k, time));
+    }
+    return pose;
+}
+
+// ------------------------------------------------------------------------------------
+// compressed clips
+
+struct ClipCompressionSettings
+{
+    float positionTolerance = 0.001f; // clip units
+    float rotationTolerance = 0.05f;  // degrees
+    float scaleTolerance = 0.0005f;
+};
+
+enum ChannelKind
+{
+    CHANNEL_POSITION = 0,
+    CHANNEL_ROTATION = 1,
+    CHANNEL_SCALE = 2
+};
+
+// One kept key of an animated channel. The top two bits of `channel` hold the index
+// of the component a smallest-three rotation dropped.
+struct StreamKey
+{
+    uint16_t channel;
+    uint16_t time;     // unorm16 over the clip's duration
+    uint16_t value[3]; // unorm16 in the channel's range, or smallest-three
+};
+
+const uint16_t STREAM_CHANNEL_MASK = 0x3fff;
+const uint8_t CHANNEL_ANIMATED = 0x4;
+
+struct CompressedClip
+{
+    std::string name;
+    float duration = 0.0f;
+    float ticksPerSecond = 0.0f;
+    std::vector<std::string> boneNames;
+    // per channel, three per bone in position, rotation, scale order: the kind in the
+    // low bits, CHANNEL_ANIMATED when it has stream keys
+    std::vector<uint8_t> channelFlags;
+    // per channel in order: a constant value (3 floats, 4 for rotations) or, for an
+    // animated position or scale, its quantization minimum and extent (6 floats)
+    std::vector<float> channelData;
+    std::vector<StreamKey> stream;
+    size_t keysBefore = 0;
+    int constantChannels = 0;
+
+    size_t bytes() const
+    {
+        return stream.size() * sizeof(StreamKey) + channelData.size() * sizeof(float) + channelFlags.size();
+    }
+};
+
+const float SMALLEST_THREE_RANGE = 0.70710678f; // components other than the largest are within +-1/sqrt(2)
+
+inline uint16_t quantizeUnit(float value)
+{
+    return (uint16_t)std::lround(std::min(1.0f, std::max(0.0f, value)) * 65535.0f);
+}
+
+inline void encodeSmallestThree(glm::quat q, uint16_t value[3], int& largest)
+{
+    float c[4] = { q.x, q.y, q.z, q.w };
+    largest = 0;
+    for (int i = 1; i < 4; ++i)
+        if (std::fabs(c[i]) > std::fabs(c[largest]))
+            largest = i;
+    float sign = c[largest] < 0.0f ? -1.0f : 1.0f;
+    for (int i = 0, j = 0; i < 4; ++i)
+        if (i != largest)
+            value[j++] = quantizeUnit((c[i] * sign / SMALLEST_THREE_RANGE) * 0.5f + 0.5f);
+}
+
+inline glm::quat decodeSmallestThree(const uint16_t value[3], int largest)
+{
+    float c[4];
+    float sum = 0.0f;
+    for (int i = 0, j = 0; i < 4; ++i)
+    {
+        if (i == largest)
+            continue;
+        c[i] = (value[j++] / 65535.0f * 2.0f - 1.0f) * SMALLEST_THREE_RANGE;
+        sum += c[i] * c[i];
+    }
+    c[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+    return glm::quat(c[3], c[0], c[1], c[2]);
+}
+
+// normalized lerp along the shorter arc; what ClipSampler interpolates rotations with
+inline glm::quat nlerpShortest(glm::quat a, glm::quat b, float t)
+{
+    if (glm::dot(a, b) < 0.0f)
+        b = -b;
+    return glm::normalize(a * (1.0f - t) + b * t);
+}
+
+// angle of the relative rotation; atan2 rather than acos of the dot product, which
+// loses small angles to float rounding
+inline float rotationDegrees(glm::quat a, glm::quat b)
+{
+    glm::quat d = glm::conjugate(glm::normalize(a)) * glm::normalize(b);
+    return glm::degrees(2.0f * std::atan2(glm::length(glm::vec3(d.x, d.y, d.z)), std::fabs(d.w)));
+}
+
+// Keeps the first and last key and, scanning forward, the last key from which the
+// anchor still interpolates every skipped source key, and the midpoints between source
+// keys, within `withinTolerance`. At a midpoint nlerp and the source's slerp agree, so
+// the source side can use `interpolate` too.
+template <typename Value, typename Interpolate, typename WithinTolerance>
+std::vector<size_t> reduceKeys(const std::vector<float>& times, const std::vector<Value>& decoded, const std::vector<Value>& source,
+                               Interpolate interpolate, WithinTolerance withinTolerance)
+{
+    std::vector<size_t> kept(1, 0);
+    size_t anchor = 0;
+    for (size_t end = 2; end < times.size(); ++end)
+    {
+        bool covered = true;
+        for (size_t i = anchor + 1; i <= end && covered; ++i)
+        {
+            float span = times[end] - times[anchor];
+            float t = (times[i] - times[anchor]) / span;
+            float middle = (0.5f * (times[i - 1] + times[i]) - times[anchor]) / span;
+            covered = (i == end || withinTolerance(interpolate(decoded[anchor], decoded[end], t), source[i])) &&
+                      withinTolerance(interpolate(decoded[anchor], decoded[end], middle), interpolate(source[i - 1], source[i], 0.5f));
+        }
+        if (!covered)
+        {
+            anchor = end - 1;
+            kept.push_back(anchor);
+        }
+    }
+    if (times.size() > 1)
+        kept.push_back(times.size() - 1);
+    return kept;
+}
+
+inline CompressedClip compressClip(const RawClip& raw, const ClipCompressionSettings& settings = ClipCompressionSettings())
+{
+    CompressedClip clip;
+    clip.name = raw.name;
+    clip.duration = raw.duration;
+    clip.ticksPerSecond = raw.ticksPerSecond;
+    clip.keysBefore = raw.keyCount();
+
+    // kept keys with the time at which playback first needs them: a channel's first key
+    // at once, every later one when the previous key is reached
+    struct PendingKey
+    {
+        int neededAt;
+        StreamKey key;
+    };
+    std::vector<PendingKey> pending;
+    auto quantizeTime = [&](float time) { return quantizeUnit(raw.duration > 0.0f ? time / raw.duration : 0.0f); };
+    auto emit = [&](const std::vector<float>& times, const std::vector<size_t>& kept, uint16_t channel, auto encode) {
+        for (size_t k = 0; k < kept.size(); ++k)
+        {
+            PendingKey entry;
+            entry.key.channel = channel;
+            entry.key.time = quantizeTime(times[kept[k]]);
+            entry.neededAt = k == 0 ? -1 : quantizeTime(times[kept[k - 1]]);
+            encode(kept[k], entry.key);
+            pending.push_back(entry);
+        }
+    };
+
+    // positions and scales share the vector path
+    auto addVectorChannel = [&](const std::vector<float>& times, const std::vector<glm::vec3>& values, float tolerance,
+                                ChannelKind kind, glm::vec3 identity) {
+        uint16_t channel = (uint16_t)clip.channelFlags.size();
+        bool constant = true;
+        for (const glm::vec3& value : values)
+            constant = constant && glm::length(value - values[0]) <= tolerance;
+        if (values.empty() || constant)
+        {
+            glm::vec3 value = values.empty() ? identity : values[0];
+            clip.channelFlags.push_back((uint8_t)kind);
+            clip.channelData.insert(clip.channelData.end(), { value.x, value.y, value.z });
+            ++clip.constantChannels;
+            return;
+        }
+        glm::vec3 minimum = values[0], maximum = values[0];
+        for (const glm::vec3& value : values)
+        {
+            minimum = glm::min(minimum, value);
+            maximum = glm::max(maximum, value);
+        }
+        glm::vec3 extent = maximum - minimum;
+        std::vector<uint16_t> quantized(values.size() * 3);
+        std::vector<glm::vec3> decoded(values.size());
+        for (size_t k = 0; k < values.size(); ++k)
+        {
+            for (int c = 0; c < 3; ++c)
+            {
+                quantized[k * 3 + c] = extent[c] > 0.0f ? quantizeUnit((values[k][c] - minimum[c]) / extent[c]) : 0;
+                decoded[k][c] = minimum[c] + quantized[k * 3 + c] / 65535.0f * extent[c];
+            }
+        }
+        std::vector<size_t> kept = reduceKeys(times, decoded, values,
+            [](glm::vec3 a, glm::vec3 b, float t) { return glm::mix(a, b, t); },
+            [tolerance](glm::vec3 a, glm::vec3 b) { return glm::length(a - b) <= tolerance; });
+        clip.channelFlags.push_back((uint8_t)kind | CHANNEL_ANIMATED);
+        clip.channelData.insert(clip.channelData.end(), { minimum.x, minimum.y, minimum.z, extent.x, extent.y, extent.z });
+        emit(times, kept, channel, [&](size_t k, StreamKey& key) {
+            for (int c = 0; c < 3; ++c)
+                key.value[c] = quantized[k * 3 + c];
+        });
+    };
+
+    auto addRotationChannel = [&](const std::vector<float>& times, const std::vector<glm::quat>& values) {
+        uint16_t channel = (uint16_t)clip.channelFlags.size();
+        bool constant = true;
+        for (const glm::quat& value : values)
+            constant = constant && rotationDegrees(value, values[0]) <= settings.rotationTolerance;
+        if (values.empty() || constant)
+        {
+            glm::quat value = values.empty() ? glm::quat(1.0f, 0.0f, 0.0f, 0.0f) : glm::normalize(values[0]);
+            clip.channelFlags.push_back((uint8_t)CHANNEL_ROTATION);
+            clip.channelData.insert(clip.channelData.end(), { value.x, value.y, value.z, value.w });
+            ++clip.constantChannels;
+            return;
+        }
+        std::vector<uint16_t> quantized(values.size() * 3);
+        std::vector<int> largest(values.size());
+        std::vector<glm::quat> decoded(values.size());
+        for (size_t k = 0; k < values.size(); ++k)
+        {
+            encodeSmallestThree(glm::normalize(values[k]), &quantized[k * 3], largest[k]);
+            decoded[k] = decodeSmallestThree(&quantized[k * 3], largest[k]);
+        }
+        float tolerance = settings.rotationTolerance;
+        std::vector<size_t> kept = reduceKeys(times, decoded, values,
+            [](glm::quat a, glm::quat b, float t) { return nlerpShortest(a, b, t); },
+            [tolerance](glm::quat a, glm::quat b) { return rotationDegrees(a, b) <= tolerance; });
+        clip.channelFlags.push_back((uint8_t)CHANNEL_ROTATION | CHANNEL_ANIMATED);
+        emit(times, kept, channel, [&](size_t k, StreamKey& key) {
+            key.channel |= (uint16_t)(largest[k] << 14);
+            for (int c = 0; c < 3; ++c)
+                key.value[c] = quantized[k * 3 + c];
+        });
+    };
+
+    for (const RawTrack& track : raw.tracks)
+    {
+        clip.boneNames.push_back(track.name);
+        addVectorChannel(track.positionTimes, track.positions, settings.positionTolerance, CHANNEL_POSITION, glm::vec3(0.0f));
+        addRotationChannel(track.rotationTimes, track.rotations);
+        addVectorChannel(track.scaleTimes, track.scales, settings.scaleTolerance, CHANNEL_SCALE, glm::vec3(1.0f));
+    }
+
+    // per channel the needed times rise with the key index, so a stable sort keeps each
+    // channel's keys in order
+    std::stable_sort(pending.begin(), pending.end(), [](const PendingKey& a, const PendingKey& b) { return a.neededAt < b.neededAt; });
+    for (const PendingKey& entry : pending)
+        clip.stream.push_back(entry.key);
+    return clip;
+}
+
+// Samples a CompressedClip. Keys are decoded as the stream cursor reaches them, into two
+// slots per channel; playing forward never reads a key twice, and sampling an earlier
+// time than the last one rewinds to the start of the stream.
+class ClipSampler
+{
+public:
+    explicit ClipSampler(const CompressedClip& clip) : clip(clip)
+    {
+        size_t offset = 0;
+        for (uint8_t flags : clip.channelFlags)
+        {
+            Channel channel;
+            channel.kind = flags & 0x3;
+            channel.animated = (flags & CHANNEL_ANIMATED) != 0;
+            channel.data = offset;
+            if (!channel.animated)
+            {
+                const float* data = &clip.channelData[offset];
+                channel.value[1] = glm::vec4(data[0], data[1], data[2], channel.kind == CHANNEL_ROTATION ? data[3] : 0.0f);
+                offset += channel.kind == CHANNEL_ROTATION ? 4 : 3;
+            }
+            else if (channel.kind != CHANNEL_ROTATION)
+                offset += 6;
+            channels.push_back(channel);
+        }
+        rewind();
+    }
+
+    size_t boneCount() const { return clip.boneNames.size(); }
+
+    // time in ticks, in [0, duration]
+    void sample(float time, std::vector<BonePose>& poses)
+    {
+        seek(time);
+        poses.resize(boneCount());
+        for (size_t bone = 0; bone < poses.size(); ++bone)
+            poses[bone] = pose(bone);
+    }
+
+    // sample() split for callers that need only some bones: seek decodes the keys up to
+    // `time`, pose then interpolates one bone at that time
+    void seek(float time)
+    {
+        float position = clip.duration > 0.0f ? std::min(1.0f, std::max(0.0f, time / clip.duration)) * 65535.0f : 0.0f;
+        if (position < lastPosition)
+            rewind();
+        lastPosition = position;
+
+        // consume every key whose predecessor has been reached
+        while (cursor < clip.stream.size())
+        {
+            const StreamKey& key = clip.stream[cursor];
+            Channel& channel = channels[key.channel & STREAM_CHANNEL_MASK];
+            if (channel.count > 0 && position < channel.time[1])
+                break;
+            channel.time[0] = channel.time[1];
+            channel.value[0] = channel.value[1];
+            channel.time[1] = key.time;
+            channel.value[1] = decode(channel, key);
+            ++channel.count;
+            ++cursor;
+        }
+    }
+
+    BonePose pose(size_t bone) const
+    {
+        glm::vec4 p = evaluate(channels[bone * 3], lastPosition);
+        glm::vec4 r = evaluate(channels[bone * 3 + 1], lastPosition);
+        glm::vec4 s = evaluate(channels[bone * 3 + 2], lastPosition);
+        BonePose result;
+        result.position = glm::vec3(p);
+        result.rotation = glm::quat(r.w, r.x, r.y, r.z);
+        result.scale = glm::vec3(s);
+        return result;
+    }
+
+private:
+    struct Channel
+    {
+        int kind = 0;
+        bool animated = false;
+        size_t data = 0;
+        int count = 0;
+        float time[2] = { 0.0f, 0.0f };
+        glm::vec4 value[2];
+    };
+
+    void rewind()
+    {
+        cursor = 0;
+        lastPosition = 0.0f;
+        for (Channel& channel : channels)
+            if (channel.animated)
+                channel.count = 0;
+    }
+
+    glm::vec4 decode(const Channel& channel, const StreamKey& key) const
+    {
+        if (channel.kind == CHANNEL_ROTATION)
+        {
+            glm::quat q = decodeSmallestThree(key.value, key.channel >> 14);
+            return glm::vec4(q.x, q.y, q.z, q.w);
+        }
+        const float* range = &clip.channelData[channel.data];
+        return glm::vec4(range[0] + key.value[0] / 65535.0f * range[3], range[1] + key.value[1] / 65535.0f * range[4],
+                         range[2] + key.value[2] / 65535.0f * range[5], 0.0f);
+    }
+
+    static glm::vec4 evaluate(const Channel& channel, float position)
+    {
+        if (!channel.animated || channel.count < 2 || position >= channel.time[1])
+            return channel.value[1];
+        float span = channel.time[1] - channel.time[0];
+        float t = span > 0.0f ? std::max(0.0f, (position - channel.time[0]) / span) : 1.0f;
+        if (channel.kind != CHANNEL_ROTATION)
+            return glm::mix(channel.value[0], channel.value[1], t);
+        glm::vec4 b = glm::dot(channel.value[0], channel.value[1]) < 0.0f ? -channel.value[1] : channel.value[1];
+        return glm::normalize(glm::mix(channel.value[0], b, t));
+    }
+
+    const CompressedClip& clip;
+    std::vector<Channel> channels;
+    size_t cursor = 0;
+    float lastPosition = 0.0f;
+};
+
+// ------------------------------------------------------------------------------------
+// benchmark
+
+struct ClipErrorReport
+{
+    float position = 0.0f; // max, clip units
+    float rotation = 0.0f; // max, degrees
+    float scale = 0.0f;
+};
+
+// both paths at `samples` evenly spaced times, every bone in its parent's space
+inline ClipErrorReport measureClipError(const RawClip& raw, const CompressedClip& compressed, int samples)
+{
+    ClipErrorReport error;
+    ClipSampler sampler(compressed);
+    std::vector<BonePose> poses;
+    for (int s = 0; s <= samples; ++s)
+    {
+        float time = raw.duration * s / samples;
+        sampler.sample(time, poses);
+        for (size_t bone = 0; bone < raw.tracks.size(); ++bone)
+        {
+            BonePose reference = sampleRawTrack(raw.tracks[bone], time);
+            error.position = std::max(error.position, glm::length(reference.position - poses[bone].position));
+            error.rotation = std::max(error.rotation, rotationDegrees(reference.rotation, poses[bone].rotation));
+            error.scale = std::max(error.scale, glm::length(reference.scale - poses[bone].scale));
+        }
+    }
+    return error;
+}
@@ -0,0 +1,134 @@
+// clip_import.h
+// The file side of clip_compression.h, through Assimp:
+//  - loadRawClip: the first animation of a file, keys as learnopengl's Bone stores them
+//  - runClipCompressionBenchmark: memory, worst bone-space error and sampling
+//    throughput against the raw path, per clip
+#pragma once
+
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include "clip_compression.h"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// first animation of the file, the one learnopengl's Animation loads
+inline bool loadRawClip(const std::string& path, RawClip& clip)
+{
+    Assimp::Importer importer;
+    const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate);
+    if (scene == nullptr || scene->mRootNode == nullptr || !scene->HasAnimations())
+    {
+        std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+        return false;
+    }
+    const aiAnimation* animation = scene->mAnimations[0];
+    clip.name = path.substr(path.find_last_of("/\\") + 1);
+    clip.duration = (float)animation->mDuration;
+    clip.ticksPerSecond = (float)animation->mTicksPerSecond;
+    clip.tracks.clear();
+    for (unsigned int c = 0; c < animation->mNumChannels; ++c)
+    {
+        const aiNodeAnim* channel = animation->mChannels[c];
+        RawTrack track;
+        track.name = channel->mNodeName.C_Str();
+        for (unsigned int k = 0; k < channel->mNumPositionKeys; ++k)
+        {
+            const aiVectorKey& key = channel->mPositionKeys[k];
+            track.positionTimes.push_back((float)key.mTime);
+            track.positions.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+        for (unsigned int k = 0; k < channel->mNumRotationKeys; ++k)
+        {
+            const aiQuatKey& key = channel->mRotationKeys[k];
+            track.rotationTimes.push_back((float)key.mTime);
+            track.rotations.push_back(glm::quat(key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+        for (unsigned int k = 0; k < channel->mNumScalingKeys; ++k)
+        {
+            const aiVectorKey& key = channel->mScalingKeys[k];
+            track.scaleTimes.push_back((float)key.mTime);
+            track.scales.push_back(glm::vec3(key.mValue.x, key.mValue.y, key.mValue.z));
+        }
+        clip.tracks.push_back(track);
+    }
+    return true;
+}
+
+// Headless: loads each clip, compresses it and prints key counts, bytes, the worst
+// error against the raw keys at 8 samples per source frame, and bone local matrices
+// per second for both paths playing the clip forward at 60 Hz for `seconds` each.
+inline int runClipCompressionBenchmark(const std::vector<std::string>& paths, double seconds,
+                                       const ClipCompressionSettings& settings = ClipCompressionSettings())
+{
+    printf("Clip compression (tolerance %.4f units, %.3f deg, scale %.4f)\n", settings.positionTolerance, settings.rotationTolerance,
+           settings.scaleTolerance);
+    printf("  %-16s %5s %7s %7s %9s %9s %6s %9s %8s %9s %9s %9s\n", "clip", "bones", "keys", "kept", "raw KB", "packed KB",
+           "ratio", "pos err", "rot deg", "scale err", "raw M/s", "packed M/s");
+    size_t rawTotal = 0, packedTotal = 0;
+    for (const std::string& path : paths)
+    {
+        RawClip raw;
+        if (!loadRawClip(path, raw))
+            continue;
+        auto start = std::chrono::steady_clock::now();
+        CompressedClip compressed = compressClip(raw, settings);
+        double compressMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+        size_t frames = 0;
+        for (const RawTrack& track : raw.tracks)
+            frames = std::max(frames, track.rotations.size());
+        ClipErrorReport error = measureClipError(raw, compressed, (int)std::max<size_t>(1, frames * 8));
+
+        // playback at 60 Hz, wrapping like Animator does
+        float step = raw.ticksPerSecond / 60.0f;
+        std::vector<BonePose> poses(raw.tracks.size());
+        float checksum = 0.0f;
+        double rawRate = 0.0, packedRate = 0.0;
+        for (int mode = 0; mode < 2; ++mode)
+        {
+            ClipSampler sampler(compressed);
+            size_t samples = 0;
+            float time = 0.0f;
+            auto begin = std::chrono::steady_clock::now();
+            double elapsed = 0.0;
+            while (elapsed < seconds)
+            {
+                for (int batch = 0; batch < 256; ++batch)
+                {
+                    if (mode == 0)
+                        for (size_t bone = 0; bone < raw.tracks.size(); ++bone)
+                            poses[bone] = sampleRawTrack(raw.tracks[bone], time);
+                    else
+                        sampler.sample(time, poses);
+                    for (const BonePose& pose : poses)
+                        checksum += poseMatrix(pose)[3][0];
+                    samples += poses.size();
+                    time = std::fmod(time + step, raw.duration > 0.0f ? raw.duration : 1.0f);
+                }
+                elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            }
+            (mode == 0 ? rawRate : packedRate) = samples / elapsed / 1.0e6;
+        }
+
+        size_t kept = compressed.stream.size() + compressed.constantChannels;
+        volatile float keep = checksum; // the sampled matrices must not be optimized away
+        (void)keep;
+        printf("  %-16.16s %5zu %7zu %7zu %9.1f %9.1f %5.1fx %9.5f %8.4f %9.6f %9.2f %9.2f\n", raw.name.c_str(), raw.tracks.size(),
+               raw.keyCount(), kept, raw.bytes() / 1024.0, compressed.bytes() / 1024.0,
+               compressed.bytes() > 0 ? (double)raw.bytes() / compressed.bytes() : 0.0, error.position, error.rotation, error.scale,
+               rawRate, packedRate);
+        printf("    %d constant channels of %zu, compressed in %.2f ms\n", compressed.constantChannels, compressed.channelFlags.size(), compressMs);
+        rawTotal += raw.bytes();
+        packedTotal += compressed.bytes();
+    }
+    if (packedTotal > 0)
+        printf("  total %.1f KB -> %.1f KB\n", rawTotal / 1024.0, packedTotal / 1024.0);
+    return 0;
+}
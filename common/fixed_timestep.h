@@ -0,0 +1,167 @@
+// fixed_timestep.h
+// Frame timing shared by the demos:
+//  - FixedTimestep: accumulator clock that turns variable frame times into a whole
+//    number of fixed simulation ticks, plus the blend factor for interpolation
+//  - FramePacer: optional sleep-then-spin limiter to a target frame time,
+//    independent of vsync
+//  - FrameTimeStats: mean/variance/percentiles of frame times for the exit report
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+class FixedTimestep
+{
+public:
+    // maxStepsPerFrame caps catch-up after a long hitch; the excess time is dropped
+    explicit FixedTimestep(double step = 1.0 / 60.0, int maxStepsPerFrame = 8)
+        : step(step), maxStepsPerFrame(maxStepsPerFrame)
+    {
+    }
+
+    // feed the wall-clock time of the new frame; returns the number of ticks to run
+    int advance(double now)
+    {
+        if (!started)
+        {
+            lastTime = now;
+            started = true;
+        }
+        accumulator += now - lastTime;
+        lastTime = now;
+
+        int steps = 0;
+        while (accumulator >= step && steps < maxStepsPerFrame)
+        {
+            accumulator -= step;
+            steps++;
+        }
+        if (accumulator >= step)
+        {
+            droppedTime += accumulator - std::fmod(accumulator, step);
+            accumulator = std::fmod(accumulator, step);
+        }
+        ticks += steps;
+        return steps;
+    }
+
+    float dt() const { return (float)step; }
+    // blend factor from the previous tick's state to the current one
+    float alpha() const { return (float)(accumulator / step); }
+    // simulated time of the current state
+    double time() const { return ticks * step; }
+    // time matching the interpolated render state (one tick behind time())
+    double interpolatedTime() const { return std::max(0.0, (ticks - 1 + accumulator / step) * step); }
+    long long tickCount() const { return ticks; }
+    double dropped() const { return droppedTime; }
+
+private:
+    double step;
+    int maxStepsPerFrame;
+    double accumulator = 0.0;
+    double lastTime = 0.0;
+    double droppedTime = 0.0;
+    long long ticks = 0;
+    bool started = false;
+};
+
+class FramePacer
+{
+public:
+    // targetFrameSeconds <= 0 disables pacing
+    explicit FramePacer(double targetFrameSeconds = 0.0)
+        : target(std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(targetFrameSeconds)))
+    {
+    }
+
+    bool enabled() const { return target.count() > 0; }
+
+    // call once per frame after presenting; returns once the target frame time has elapsed
+    void wait()
+    {
+        if (!enabled())
+            return;
+        Clock::time_point now = Clock::now();
+        if (!started)
+        {
+            deadline = now;
+            started = true;
+        }
+        deadline += target;
+        if (now >= deadline)
+        {
+            deadline = now; // missed it: start the next frame from here instead of building up debt
+            return;
+        }
+        // sleep coarsely, then spin the last couple of milliseconds for precision
+        const Clock::duration spinMargin = std::chrono::milliseconds(2);
+        if (deadline - now > spinMargin)
+            std::this_thread::sleep_for(deadline - now - spinMargin);
+        while (Clock::now() < deadline)
+            std::this_thread::yield();
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    Clock::duration target;
+    Clock::time_point deadline;
+    bool started = false;
+};
+
+class FrameTimeStats
+{
+public:
+    // keeps the last `window` samples for percentiles; mean and variance cover every sample
+    explicit FrameTimeStats(size_t window = 8192) : recent(window, 0.0) {}
+
+    void add(double seconds)
+    {
+        // Welford's running mean/variance
+        count++;
+        double delta = seconds - mean;
+        mean += delta / count;
+        m2 += delta * (seconds - mean);
+        minimum = std::min(minimum, seconds);
+        maximum = std::max(maximum, seconds);
+        recent[next] = seconds;
+        next = (next + 1) % recent.size();
+    }
+
+    long long frames() const { return count; }
+    double meanSeconds() const { return mean; }
+    double variance() const { return count > 1 ? m2 / (count - 1) : 0.0; }
+
+    // p in [0, 1], over the recent window
+    double percentile(double p) const
+    {
+        if (count == 0)
+            return 0.0;
+        std::vector<double> sorted(recent.begin(), recent.begin() + (size_t)std::min<long long>(count, (long long)recent.size()));
+        std::sort(sorted.begin(), sorted.end());
+        return sorted[(size_t)(p * (sorted.size() - 1))];
+    }
+
+    void report(std::ostream& out, const char* label) const
+    {
+        if (count == 0)
+            return;
+        out << label << ": " << count << " frames, mean " << mean * 1000.0 << " ms"
+            << ", stddev " << std::sqrt(variance()) * 1000.0 << " ms"
+            << ", variance " << variance() * 1.0e6 << " ms^2"
+            << ", min " << minimum * 1000.0 << " ms, p50 " << percentile(0.5) * 1000.0 << " ms"
+            << ", p99 " << percentile(0.99) * 1000.0 << " ms, max " << maximum * 1000.0 << " ms" << std::endl;
+    }
+
+private:
+    long long count = 0;
+    double mean = 0.0;
+    double m2 = 0.0;
+    double minimum = 1e30;
+    double maximum = 0.0;
+    std::vector<double> recent;
+    size_t next = 0;
+};
@@ -0,0 +1,571 @@
+// frame_capture.h
+// In-engine recording of the rendered frames, for the demo videos:
+//  - FrameCapture: after a frame is drawn, glReadPixels goes into the next of a small
+//    ring of pixel pack buffers with a fence behind it. A later frame maps the buffer
+//    once its fence has passed, so the render thread never waits on the GPU.
+//  - the pixels are copied into one of a fixed set of frame buffers and a worker
+//    encodes them: one PNG per frame (stored deflate blocks, so no compressor is
+//    needed and it stays fast, but every viewer opens it) or a raw 4:2:0 Y4M stream
+//    that ffmpeg and most players read directly (full range, marked XCOLORRANGE=FULL)
+//  - a frame is dropped and counted, rather than stalling the game, when every ring
+//    buffer is still in flight or every frame buffer still waits for its encoder
+// It reads GL_BACK of whatever framebuffer is bound, so it behaves the same on a hidden
+// window of a software context (LIBGL_ALWAYS_SOFTWARE=1). Once open, the only heap
+// traffic per frame is the worker queue's own; files are written with stdio, and
+// never while the render thread could be waiting on the capture's lock.
+#pragma once
+
+#include <glad/glad.h>
+
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+enum class CaptureFormat
+{
+    PngSequence, // <directory>/frame_000000.png, ...
+    Y4M,         // one .y4m file
+};
+
+struct FrameCaptureStats
+{
+    unsigned long long frames = 0;          // capture() calls
+    unsigned long long captured = 0;        // read back and handed to an encoder
+    unsigned long long encoded = 0;         // written out
+    unsigned long long droppedReadback = 0; // every ring buffer still waiting for the GPU
+    unsigned long long droppedEncoder = 0;  // every frame buffer still waiting for a worker
+    unsigned long long bytesWritten = 0;
+    double captureMs = 0.0;                 // render thread time in capture(): the frame time it adds
+    double maxCaptureMs = 0.0;
+    double encodeMs = 0.0;                  // worker time, summed over frames
+};
+
+// PNG needs CRC-32 per chunk and Adler-32 over the zlib stream
+inline uint32_t captureCrc32(uint32_t crc, const unsigned char* data, size_t size)
+{
+    static uint32_t table[256] = {};
+    static std::once_flag tableBuilt;
+    std::call_once(tableBuilt, [] {
+        for (uint32_t n = 0; n < 256; ++n)
+        {
+            uint32_t c = n;
+            for (int k = 0; k < 8; ++k)
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+    });
+    crc = ~crc;
+    for (size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+class FrameCapture
+{
+public:
+    // `path` is a directory for a PNG sequence, or a file for Y4M; `framesPerSecond` only
+    // goes into the Y4M header. A ring of 3 lets the GPU run two frames ahead of the reads.
+    FrameCapture(const std::string& path, CaptureFormat format, int width, int height, int framesPerSecond = 60,
+                 unsigned int encodeThreads = 0, int ringSize = 3, int frameBuffers = 8)
+        : path(path), format(format), width(width), height(height), framesPerSecond(framesPerSecond), workers(encodeThreads),
+          ring(ringSize), slots(frameBuffers)
+    {
+    }
+
+    ~FrameCapture() { finish(); }
+    FrameCapture(const FrameCapture&) = delete;
+    FrameCapture& operator=(const FrameCapture&) = delete;
+
+    // .y4m picks Y4M, anything else is a PNG directory
+    static CaptureFormat formatFor(const std::string& path)
+    {
+        return path.size() > 4 && path.compare(path.size() - 4, 4, ".y4m") == 0 ? CaptureFormat::Y4M : CaptureFormat::PngSequence;
+    }
+
+    // creates the directory or the Y4M file and the GL buffers; needs the context current
+    bool open()
+    {
+        if (format == CaptureFormat::Y4M)
+        {
+            file = std::fopen(path.c_str(), "wb");
+            if (file == nullptr)
+                return false;
+            int written = std::fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C420jpeg XCOLORRANGE=FULL\n", width, height, framesPerSecond);
+            stats_.bytesWritten += written > 0 ? written : 0;
+        }
+        else
+        {
+            std::error_code error;
+            std::filesystem::create_directories(path, error);
+            if (!std::filesystem::is_directory(path, error))
+                return false;
+        }
+
+        size_t pixelBytes = (size_t)width * height * 4;
+        for (Readback& readback : ring)
+        {
+            glGenBuffers(1, &readback.buffer);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            glBufferData(GL_PIXEL_PACK_BUFFER, (GLsizeiptr)pixelBytes, nullptr, GL_STREAM_READ);
+        }
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+        for (Slot& slot : slots)
+        {
+            slot.pixels.resize(pixelBytes);
+            slot.encoded.resize(encodedCapacity());
+            if (format == CaptureFormat::PngSequence)
+            {
+                slot.rows.resize((size_t)height * (1 + (size_t)width * 3));
+                slot.filePath.resize(path.size() + 32);
+            }
+        }
+        skippedFrames.reserve(ring.size() + slots.size());
+        dueSlots.reserve(slots.size());
+        opened = true;
+        return true;
+    }
+
+    bool isOpen() const { return opened; }
+
+    // Call once per frame after drawing and before the swap. Hands every finished
+    // readback to the encoders, then starts this frame's.
+    void capture()
+    {
+        if (!opened)
+            return;
+        auto start = Clock::now();
+        renderStats.frames++;
+        collect(false);
+        Readback& target = ring[next];
+        if (target.fence != 0)
+            renderStats.droppedReadback++;
+        else
+        {
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, target.buffer);
+            glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, (void*)0);
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            target.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+            target.frame = frameIndex++;
+            next = (next + 1) % ring.size();
+        }
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+        renderStats.captureMs += ms;
+        renderStats.maxCaptureMs = std::max(renderStats.maxCaptureMs, ms);
+    }
+
+    // capture() calls so far; render thread only, takes no lock
+    unsigned long long frames() const { return renderStats.frames; }
+
+    // Waits for the readbacks still in flight and for every encoder, then closes the
+    // file and frees the buffers. Needs the context current while the capture is open.
+    void finish()
+    {
+        if (!opened)
+            return;
+        collect(true);
+        workers.waitIdle();
+        for (Readback& readback : ring)
+            glDeleteBuffers(1, &readback.buffer);
+        if (file != nullptr)
+            std::fclose(file);
+        file = nullptr;
+        opened = false;
+    }
+
+    FrameCaptureStats stats() const
+    {
+        FrameCaptureStats s;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            s = stats_;
+        }
+        s.frames = renderStats.frames;
+        s.droppedReadback += renderStats.droppedReadback;
+        s.captureMs = renderStats.captureMs;
+        s.maxCaptureMs = renderStats.maxCaptureMs;
+        return s;
+    }
+
+    void report(std::ostream& out) const
+    {
+        FrameCaptureStats s = stats();
+        if (s.frames == 0)
+            return;
+        out << "Capture: " << s.frames << " frames to " << path << ", " << s.encoded << " written ("
+            << s.bytesWritten / (1024.0 * 1024.0) << " MB), " << s.droppedReadback + s.droppedEncoder << " dropped ("
+            << s.droppedReadback << " readback ring full, " << s.droppedEncoder << " encoders behind); adds " << std::fixed
+            << std::setprecision(3) << s.captureMs / s.frames << " ms/frame on the render thread (max " << s.maxCaptureMs << "), "
+            << (s.encoded > 0 ? s.encodeMs / s.encoded : 0.0) << " ms/frame encoding on " << workers.size() << " worker(s)"
+            << std::defaultfloat << std::setprecision(6) << std::endl;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Readback
+    {
+        GLuint buffer = 0;
+        GLsync fence = 0;
+        unsigned long long frame = 0;
+    };
+
+    enum class SlotState
+    {
+        Free,
+        Encoding,
+        Encoded, // Y4M only: waiting for the frames before it to be written
+        Writing, // Y4M only: claimed by the worker that writes the file
+    };
+
+    struct Slot
+    {
+        std::vector<unsigned char> pixels;  // RGBA, bottom row first as GL reads it
+        std::vector<unsigned char> rows;    // PNG only: the filtered scanlines, top row first
+        std::vector<unsigned char> encoded; // the PNG file, or the Y4M frame
+        std::vector<char> filePath;         // PNG only: room for <path>/frame_NNNNNN.png
+        size_t encodedSize = 0;
+        unsigned long long frame = 0;
+        SlotState state = SlotState::Free;
+    };
+
+    size_t encodedCapacity() const
+    {
+        if (format == CaptureFormat::Y4M)
+            return 6 + (size_t)width * height + 2 * (size_t)((width + 1) / 2) * ((height + 1) / 2);
+        size_t raw = (size_t)height * (1 + (size_t)width * 3);
+        size_t blocks = (raw + 65534) / 65535;
+        return 8 + 25 + 12 + 2 + blocks * 5 + raw + 4 + 12;
+    }
+
+    // Maps finished readbacks in frame order. Without `wait` it stops at the first
+    // fence that has not passed; with it, it blocks until every one has.
+    void collect(bool wait)
+    {
+        for (size_t n = 0; n < ring.size(); ++n)
+        {
+            size_t index = (next + n) % ring.size(); // oldest first
+            Readback& readback = ring[index];
+            if (readback.fence == 0)
+                continue;
+            GLenum status = glClientWaitSync(readback.fence, wait ? GL_SYNC_FLUSH_COMMANDS_BIT : 0, wait ? 1000000000ull : 0);
+            if (status == GL_TIMEOUT_EXPIRED || status == GL_WAIT_FAILED)
+            {
+                if (!wait)
+                    return;
+                // given up on: the Y4M frames after it must still get written
+                glDeleteSync(readback.fence);
+                readback.fence = 0;
+                std::lock_guard<std::mutex> lock(mutex);
+                stats_.droppedReadback++;
+                skipFrame(readback.frame);
+                continue;
+            }
+            glDeleteSync(readback.fence);
+            readback.fence = 0;
+
+            Slot* slot = acquireSlot(readback.frame);
+            if (slot == nullptr)
+                continue;
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, readback.buffer);
+            const void* pixels = glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, (GLsizeiptr)slot->pixels.size(), GL_MAP_READ_BIT);
+            if (pixels != nullptr)
+            {
+                std::memcpy(slot->pixels.data(), pixels, slot->pixels.size());
+                glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+            }
+            glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+            if (pixels == nullptr)
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                slot->state = SlotState::Free;
+                skipFrame(readback.frame);
+                continue;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stats_.captured++;
+            }
+            workers.enqueue([this, slot] { encode(*slot); });
+        }
+    }
+
+    Slot* acquireSlot(unsigned long long frame)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        for (Slot& slot : slots)
+        {
+            if (slot.state == SlotState::Free)
+            {
+                slot.state = SlotState::Encoding;
+                slot.frame = frame;
+                return &slot;
+            }
+        }
+        stats_.droppedEncoder++;
+        skipFrame(frame);
+        return nullptr;
+    }
+
+    // a frame dropped after its readback must not hold back the Y4M frames after it;
+    // called with the mutex held
+    void skipFrame(unsigned long long frame)
+    {
+        if (format != CaptureFormat::Y4M)
+            return; // PNG frames are written in any order, so nothing waits on a dropped one
+        if (frame == nextToWrite)
+            nextToWrite++;
+        else
+            skippedFrames.push_back(frame);
+    }
+
+    // on a worker
+    void encode(Slot& slot)
+    {
+        auto start = Clock::now();
+        if (format == CaptureFormat::Y4M)
+            encodeY4M(slot);
+        else
+            encodePng(slot);
+        double ms = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+
+        if (format == CaptureFormat::PngSequence)
+        {
+            std::snprintf(slot.filePath.data(), slot.filePath.size(), "%s/frame_%06llu.png", path.c_str(), slot.frame);
+            bool written = false;
+            if (FILE* out = std::fopen(slot.filePath.data(), "wb"))
+            {
+                written = std::fwrite(slot.encoded.data(), 1, slot.encodedSize, out) == slot.encodedSize;
+                std::fclose(out);
+            }
+            std::lock_guard<std::mutex> lock(mutex);
+            stats_.encodeMs += ms;
+            if (written)
+            {
+                stats_.encoded++;
+                stats_.bytesWritten += slot.encodedSize;
+            }
+            slot.state = SlotState::Free;
+            return;
+        }
+
+        // Y4M frames go into the one file in order. One worker at a time is the writer:
+        // under the lock it claims the frames that are due, then writes them without it,
+        // so neither the other workers nor the render thread wait on the disk
+        std::unique_lock<std::mutex> lock(mutex);
+        stats_.encodeMs += ms;
+        slot.state = SlotState::Encoded;
+        if (writing)
+            return; // the writer picks this frame up
+        writing = true;
+        for (;;)
+        {
+            dueSlots.clear();
+            for (;;)
+            {
+                auto skipped = std::find(skippedFrames.begin(), skippedFrames.end(), nextToWrite);
+                if (skipped != skippedFrames.end())
+                {
+                    skippedFrames.erase(skipped);
+                    nextToWrite++;
+                    continue;
+                }
+                Slot* due = nullptr;
+                for (Slot& candidate : slots)
+                    if (candidate.state == SlotState::Encoded && candidate.frame == nextToWrite)
+                        due = &candidate;
+                if (due == nullptr)
+                    break;
+                due->state = SlotState::Writing;
+                dueSlots.push_back(due);
+                nextToWrite++;
+            }
+            if (dueSlots.empty())
+            {
+                writing = false;
+                return;
+            }
+
+            lock.unlock();
+            unsigned long long written = 0, bytes = 0;
+            for (Slot* due : dueSlots)
+                if (std::fwrite(due->encoded.data(), 1, due->encodedSize, file) == due->encodedSize)
+                {
+                    written++;
+                    bytes += due->encodedSize;
+                }
+            lock.lock();
+            stats_.encoded += written;
+            stats_.bytesWritten += bytes;
+            for (Slot* due : dueSlots)
+                due->state = SlotState::Free;
+        }
+    }
+
+    // BT.601 full range ("C420jpeg"), chroma averaged over each 2x2 block; rows flipped to top first
+    void encodeY4M(Slot& slot) const
+    {
+        unsigned char* out = slot.encoded.data();
+        std::memcpy(out, "FRAME\n", 6);
+        unsigned char* yPlane = out + 6;
+        int chromaWidth = (width + 1) / 2, chromaHeight = (height + 1) / 2;
+        unsigned char* uPlane = yPlane + (size_t)width * height;
+        unsigned char* vPlane = uPlane + (size_t)chromaWidth * chromaHeight;
+        const unsigned char* pixels = slot.pixels.data();
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = pixels + (size_t)(height - 1 - y) * width * 4;
+            unsigned char* yRow = yPlane + (size_t)y * width;
+            for (int x = 0; x < width; ++x)
+            {
+                const unsigned char* p = row + x * 4;
+                yRow[x] = (unsigned char)((19595 * p[0] + 38470 * p[1] + 7471 * p[2] + 32768) >> 16);
+            }
+        }
+        for (int cy = 0; cy < chromaHeight; ++cy)
+        {
+            for (int cx = 0; cx < chromaWidth; ++cx)
+            {
+                int r = 0, g = 0, b = 0, count = 0;
+                for (int dy = 0; dy < 2; ++dy)
+                    for (int dx = 0; dx < 2; ++dx)
+                    {
+                        int x = cx * 2 + dx, y = cy * 2 + dy;
+                        if (x >= width || y >= height)
+                            continue;
+                        const unsigned char* p = pixels + ((size_t)(height - 1 - y) * width + x) * 4;
+                        r += p[0];
+                        g += p[1];
+                        b += p[2];
+                        count++;
+                    }
+                r /= count;
+                g /= count;
+                b /= count;
+                int u = (-11059 * r - 21709 * g + 32768 * b + 128 * 65536 + 32768) >> 16;
+                int v = (32768 * r - 27439 * g - 5329 * b + 128 * 65536 + 32768) >> 16;
+                uPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)std::min(255, std::max(0, u));
+                vPlane[(size_t)cy * chromaWidth + cx] = (unsigned char)std::min(255, std::max(0, v));
+            }
+        }
+        slot.encodedSize = slot.encoded.size();
+    }
+
+    // RGB, no filtering, the zlib stream made of stored deflate blocks
+    void encodePng(Slot& slot) const
+    {
+        unsigned char* out = slot.encoded.data();
+        size_t at = 0;
+        auto put32 = [&](uint32_t value) {
+            out[at++] = (unsigned char)(value >> 24);
+            out[at++] = (unsigned char)(value >> 16);
+            out[at++] = (unsigned char)(value >> 8);
+            out[at++] = (unsigned char)value;
+        };
+        auto endChunk = [&](size_t chunkStart) {
+            // the CRC covers the type and the data, not the length
+            put32(captureCrc32(0, out + chunkStart + 4, at - chunkStart - 4));
+        };
+        static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+        std::memcpy(out, signature, 8);
+        at = 8;
+
+        size_t chunk = at;
+        put32(13);
+        std::memcpy(out + at, "IHDR", 4);
+        at += 4;
+        put32((uint32_t)width);
+        put32((uint32_t)height);
+        out[at++] = 8; // bit depth
+        out[at++] = 2; // RGB
+        out[at++] = 0;
+        out[at++] = 0;
+        out[at++] = 0;
+        endChunk(chunk);
+
+        size_t raw = (size_t)height * (1 + (size_t)width * 3);
+        size_t blocks = (raw + 65534) / 65535;
+        chunk = at;
+        put32((uint32_t)(2 + blocks * 5 + raw + 4));
+        std::memcpy(out + at, "IDAT", 4);
+        at += 4;
+        out[at++] = 0x78; // deflate, 32K window
+        out[at++] = 0x01;
+        unsigned char* rows = slot.rows.data();
+        const unsigned char* pixels = slot.pixels.data();
+        for (int y = 0; y < height; ++y)
+        {
+            const unsigned char* row = pixels + (size_t)(height - 1 - y) * width * 4;
+            unsigned char* line = rows + (size_t)y * (1 + (size_t)width * 3);
+            *line++ = 0; // filter: none
+            for (int x = 0; x < width; ++x)
+            {
+                line[x * 3] = row[x * 4];
+                line[x * 3 + 1] = row[x * 4 + 1];
+                line[x * 3 + 2] = row[x * 4 + 2];
+            }
+        }
+        for (size_t offset = 0; offset < raw; offset += 65535)
+        {
+            size_t length = std::min<size_t>(raw - offset, 65535);
+            out[at++] = offset + length == raw ? 1 : 0; // BFINAL on the last block, BTYPE stored
+            out[at++] = (unsigned char)length;
+            out[at++] = (unsigned char)(length >> 8);
+            out[at++] = (unsigned char)~length;
+            out[at++] = (unsigned char)(~length >> 8);
+            std::memcpy(out + at, rows + offset, length);
+            at += length;
+        }
+        // Adler-32, reduced every 5552 bytes: the most that cannot overflow 32 bits
+        uint32_t adlerA = 1, adlerB = 0;
+        for (size_t offset = 0; offset < raw; offset += 5552)
+        {
+            size_t end = std::min<size_t>(raw, offset + 5552);
+            for (size_t i = offset; i < end; ++i)
+            {
+                adlerA += rows[i];
+                adlerB += adlerA;
+            }
+            adlerA %= 65521;
+            adlerB %= 65521;
+        }
+        put32((adlerB << 16) | adlerA);
+        endChunk(chunk);
+
+        chunk = at;
+        put32(0);
+        std::memcpy(out + at, "IEND", 4);
+        at += 4;
+        endChunk(chunk);
+        slot.encodedSize = at;
+    }
+
+    std::string path;
+    CaptureFormat format;
+    int width, height;
+    int framesPerSecond;
+    ThreadPool workers;
+    std::vector<Readback> ring;
+    size_t next = 0; // ring entry the next readback goes into; also the oldest in flight
+    unsigned long long frameIndex = 0;
+    std::vector<Slot> slots;
+    std::vector<unsigned long long> skippedFrames; // dropped after readback, for the Y4M ordering
+    unsigned long long nextToWrite = 0;              // first Y4M frame not yet claimed for writing
+    bool writing = false;                            // a worker is writing Y4M frames
+    std::vector<Slot*> dueSlots;                     // the writer's claimed frames; only it touches this
+    FILE* file = nullptr;
+    bool opened = false;
+    mutable std::mutex mutex; // slot states, stats_, the Y4M ordering
+    FrameCaptureStats stats_;
+    FrameCaptureStats renderStats; // frames, readback drops and capture time: render thread only
+};
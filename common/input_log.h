@@ -0,0 +1,282 @@
+// input_log.h
+// Recording and replay of per-tick input, so a session can be re-run exactly:
+//  - InputRecorder: writes the key state of each simulation tick to a compact binary log
+//  - InputReplay: loads a log and hands back the key state for any tick
+//  - runReplay(): drives a simulation from a log at max speed or at the recorded
+//    tick rate, timing every tick
+//  - baseline files: a few numbers from a previous replay to compare against
+//
+// Log format (little endian):
+//   "INPL"  uint16 version  uint16 reserved  double tick step
+//   then one record per key state change: varint ticks since the previous record,
+//   varint key state; the last record has key state INPUT_LOG_END and marks the
+//   tick count of the session.
+#pragma once
+
+#include "fixed_timestep.h"
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+const uint32_t INPUT_LOG_END = 0xffffffffu;
+const uint16_t INPUT_LOG_VERSION = 1;
+
+class InputRecorder
+{
+public:
+    bool open(const std::string& path, double tickStep)
+    {
+        file = std::fopen(path.c_str(), "wb");
+        if (file == nullptr)
+        {
+            std::cout << "Failed to open input log for writing: " << path << std::endl;
+            return false;
+        }
+        uint16_t version = INPUT_LOG_VERSION, reserved = 0;
+        std::fwrite("INPL", 1, 4, file);
+        std::fwrite(&version, sizeof(version), 1, file);
+        std::fwrite(&reserved, sizeof(reserved), 1, file);
+        std::fwrite(&tickStep, sizeof(tickStep), 1, file);
+        lastTick = 0;
+        lastKeys = 0;
+        return true;
+    }
+
+    ~InputRecorder() { close(lastTick); }
+
+    bool isOpen() const { return file != nullptr; }
+
+    // call for every tick, in order; only changes are written
+    void record(uint64_t tick, uint32_t keys)
+    {
+        if (file == nullptr || keys == lastKeys)
+            return;
+        writeRecord(tick, keys);
+        lastKeys = keys;
+    }
+
+    void close(uint64_t tickCount)
+    {
+        if (file == nullptr)
+            return;
+        writeRecord(tickCount, INPUT_LOG_END);
+        std::fclose(file);
+        file = nullptr;
+    }
+
+private:
+    void writeRecord(uint64_t tick, uint32_t keys)
+    {
+        writeVarint(tick - lastTick);
+        writeVarint(keys);
+        lastTick = tick;
+    }
+
+    void writeVarint(uint64_t value)
+    {
+        uint8_t bytes[10];
+        int n = 0;
+        do
+        {
+            uint8_t byte = value & 0x7f;
+            value >>= 7;
+            bytes[n++] = value != 0 ? (uint8_t)(byte | 0x80) : byte;
+        } while (value != 0);
+        std::fwrite(bytes, 1, n, file);
+    }
+
+    std::FILE* file = nullptr;
+    uint64_t lastTick = 0;
+    uint32_t lastKeys = 0;
+};
+
+class InputReplay
+{
+public:
+    bool load(const std::string& path)
+    {
+        std::ifstream in(path, std::ios::binary);
+        std::vector<uint8_t> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        uint16_t version = 0;
+        if (data.size() < 16 || std::string(data.begin(), data.begin() + 4) != "INPL")
+        {
+            std::cout << "Not an input log: " << path << std::endl;
+            return false;
+        }
+        std::memcpy(&version, &data[4], sizeof(version));
+        std::memcpy(&tickStep, &data[8], sizeof(tickStep));
+        if (version != INPUT_LOG_VERSION)
+        {
+            std::cout << "Unsupported input log version " << version << ": " << path << std::endl;
+            return false;
+        }
+
+        changes.clear();
+        size_t pos = 16;
+        uint64_t tick = 0, value = 0;
+        for (;;)
+        {
+            if (!readVarint(data, pos, value))
+                break;
+            tick += value;
+            if (!readVarint(data, pos, value))
+                break;
+            if ((uint32_t)value == INPUT_LOG_END)
+            {
+                tickCount = tick;
+                return true;
+            }
+            changes.push_back({ tick, (uint32_t)value });
+        }
+        std::cout << "Input log is truncated: " << path << std::endl;
+        tickCount = tick;
+        return true;
+    }
+
+    double step() const { return tickStep; }
+    uint64_t ticks() const { return tickCount; }
+    size_t records() const { return changes.size(); }
+
+    // key state at a tick; ticks must be asked for in increasing order
+    uint32_t keysAt(uint64_t tick)
+    {
+        while (cursor < changes.size() && changes[cursor].tick <= tick)
+            keys = changes[cursor++].keys;
+        return keys;
+    }
+
+    void rewind()
+    {
+        cursor = 0;
+        keys = 0;
+    }
+
+private:
+    struct Change
+    {
+        uint64_t tick;
+        uint32_t keys;
+    };
+
+    static bool readVarint(const std::vector<uint8_t>& data, size_t& pos, uint64_t& value)
+    {
+        value = 0;
+        for (int shift = 0; pos < data.size() && shift < 64; shift += 7)
+        {
+            uint8_t byte = data[pos++];
+            value |= (uint64_t)(byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    std::vector<Change> changes;
+    double tickStep = 1.0 / 60.0;
+    uint64_t tickCount = 0;
+    size_t cursor = 0;
+    uint32_t keys = 0;
+};
+
+struct ReplayResult
+{
+    uint64_t ticks = 0;
+    double seconds = 0.0;
+    FrameTimeStats tickTimes;
+    uint64_t stateHash = 0; // filled in by the caller from the final state
+};
+
+// FNV-1a, for hashing the final simulation state of a replay
+inline uint64_t hashBytes(uint64_t hash, const void* data, size_t size)
+{
+    const uint8_t* bytes = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+const uint64_t HASH_SEED = 14695981039346656037ull;
+
+// Runs tick(tickIndex, keys) for every tick of the log. At max speed ticks run back
+// to back; otherwise each tick waits for its slot at the recorded rate.
+template <typename TickFunction>
+ReplayResult runReplay(InputReplay& replay, bool maxSpeed, TickFunction tick)
+{
+    typedef std::chrono::steady_clock Clock;
+    ReplayResult result;
+    replay.rewind();
+    Clock::time_point start = Clock::now();
+    for (uint64_t i = 0; i < replay.ticks(); ++i)
+    {
+        if (!maxSpeed)
+            std::this_thread::sleep_until(start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(i * replay.step())));
+        Clock::time_point tickStart = Clock::now();
+        tick(i, replay.keysAt(i));
+        result.tickTimes.add(std::chrono::duration<double>(Clock::now() - tickStart).count());
+    }
+    result.ticks = replay.ticks();
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    return result;
+}
+
+inline void reportReplay(const ReplayResult& result, std::ostream& out)
+{
+    out << "Replay: " << result.ticks << " ticks in " << result.seconds * 1000.0 << " ms ("
+        << (result.seconds > 0.0 ? result.ticks / result.seconds : 0.0) << " ticks/s), state hash "
+        << std::hex << result.stateHash << std::dec << std::endl;
+    result.tickTimes.report(out, "Tick time");
+}
+
+// baseline file: "ticks <n>", "mean_us <x>", "p99_us <x>", "hash <hex>", one per line
+inline bool saveReplayBaseline(const ReplayResult& result, const std::string& path)
+{
+    std::ofstream out(path);
+    if (!out)
+        return false;
+    out << "ticks " << result.ticks << "\n"
+        << "mean_us " << result.tickTimes.meanSeconds() * 1.0e6 << "\n"
+        << "p99_us " << result.tickTimes.percentile(0.99) * 1.0e6 << "\n"
+        << "hash " << std::hex << result.stateHash << std::dec << "\n";
+    return true;
+}
+
+// Prints the comparison; false if the state diverged or the mean tick time grew by
+// more than `tolerance` (0.1 = 10%).
+inline bool compareReplayBaseline(const ReplayResult& result, const std::string& path, double tolerance = 0.1)
+{
+    std::ifstream in(path);
+    if (!in)
+    {
+        std::cout << "Failed to read baseline: " << path << std::endl;
+        return false;
+    }
+    uint64_t ticks = 0, hash = 0;
+    double mean = 0.0, p99 = 0.0;
+    std::string key;
+    while (in >> key)
+    {
+        if (key == "ticks") in >> ticks;
+        else if (key == "mean_us") in >> mean;
+        else if (key == "p99_us") in >> p99;
+        else if (key == "hash") in >> std::hex >> hash >> std::dec;
+    }
+
+    double currentMean = result.tickTimes.meanSeconds() * 1.0e6;
+    double currentP99 = result.tickTimes.percentile(0.99) * 1.0e6;
+    bool sameState = ticks == result.ticks && hash == result.stateHash;
+    bool regressed = mean > 0.0 && currentMean > mean * (1.0 + tolerance);
+    std::cout << "Baseline: mean " << mean << " us -> " << currentMean << " us (" << (mean > 0.0 ? (currentMean / mean - 1.0) * 100.0 : 0.0)
+              << "%), p99 " << p99 << " us -> " << currentP99 << " us, state "
+              << (sameState ? "matches" : "DIVERGED") << (regressed ? ", REGRESSION" : "") << std::endl;
+    return sameState && !regressed;
+}
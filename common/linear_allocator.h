@@ -0,0 +1,163 @@
+// linear_allocator.h
+// Bump allocator for data that lives exactly one frame: allocate freely, then
+// reset() throws everything away at once. Nothing is destructed, so only store
+// trivially destructible types in it, or containers that are gone before the reset.
+//  - ArenaAllocator: std allocator over a LinearAllocator, for FrameVector / FrameString
+//  - frameArena(): the render thread's per-frame arena, reset right after glfwSwapBuffers
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+class LinearAllocator
+{
+public:
+    explicit LinearAllocator(size_t capacity = 64 * 1024)
+    {
+        addBlock(capacity);
+    }
+
+    ~LinearAllocator()
+    {
+        for (Block& block : blocks)
+            std::free(block.data);
+    }
+
+    LinearAllocator(const LinearAllocator&) = delete;
+    LinearAllocator& operator=(const LinearAllocator&) = delete;
+
+    // never fails: when the current block is full a bigger one is chained on, and
+    // the next reset() replaces the chain with a single block large enough for it
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        Block* block = &blocks.back();
+        size_t offset = alignedOffset(*block, alignment);
+        if (offset + size > block->size)
+        {
+            addBlock(std::max(block->size * 2, size + alignment));
+            block = &blocks.back();
+            offset = alignedOffset(*block, alignment);
+        }
+        block->used = offset + size;
+        used += size;
+        peak = std::max(peak, used);
+        return block->data + offset;
+    }
+
+    template <typename T>
+    T* allocateArray(size_t count)
+    {
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    void reset()
+    {
+        if (blocks.size() > 1)
+        {
+            size_t total = 0;
+            for (Block& block : blocks)
+            {
+                total += block.size;
+                std::free(block.data);
+            }
+            blocks.clear();
+            addBlock(total);
+        }
+        blocks.back().used = 0;
+        used = 0;
+    }
+
+    size_t bytesUsed() const { return used; }
+    size_t peakBytes() const { return peak; }
+    size_t capacity() const
+    {
+        size_t total = 0;
+        for (const Block& block : blocks)
+            total += block.size;
+        return total;
+    }
+
+private:
+    struct Block
+    {
+        uint8_t* data;
+        size_t size;
+        size_t used;
+    };
+
+    // offset of the next free byte in the block that is aligned in memory
+    static size_t alignedOffset(const Block& block, size_t alignment)
+    {
+        uintptr_t next = (uintptr_t)(block.data + block.used);
+        return (size_t)(((next + alignment - 1) & ~(uintptr_t)(alignment - 1)) - (uintptr_t)block.data);
+    }
+
+    void addBlock(size_t size)
+    {
+        uint8_t* data = static_cast<uint8_t*>(std::malloc(size));
+        if (data == nullptr)
+            throw std::bad_alloc();
+        blocks.push_back({ data, size, 0 });
+    }
+
+    std::vector<Block> blocks;
+    size_t used = 0;
+    size_t peak = 0;
+};
+
+// Allocator adapter for std containers: allocation bumps the arena, deallocation is
+// a no-op, and growth abandons the old storage until the arena's next reset(). A
+// container using it must not outlive that reset.
+template <typename T>
+class ArenaAllocator
+{
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(LinearAllocator& arena) : arena(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U>& other) : arena(other.arena) {}
+
+    T* allocate(size_t count) { return arena->allocateArray<T>(count); }
+    void deallocate(T*, size_t) {}
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U>& other) const { return arena == other.arena; }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U>& other) const { return arena != other.arena; }
+
+private:
+    template <typename U>
+    friend class ArenaAllocator;
+    LinearAllocator* arena;
+};
+
+// Transient allocations of the frame being built. Render thread only; the main loop
+// calls frameArena().reset() after glfwSwapBuffers.
+inline LinearAllocator& frameArena()
+{
+    static LinearAllocator arena(256 * 1024);
+    return arena;
+}
+
+template <typename T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> FrameString;
+
+template <typename T>
+FrameVector<T> makeFrameVector(size_t reserve = 0)
+{
+    FrameVector<T> vector { ArenaAllocator<T>(frameArena()) };
+    vector.reserve(reserve);
+    return vector;
+}
+
+inline FrameString makeFrameString(const char* text)
+{
+    return FrameString(text, ArenaAllocator<char>(frameArena()));
+}
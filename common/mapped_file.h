@@ -0,0 +1,180 @@
+// mapped_file.h
+// Whole-file I/O for binary caches and snapshots that are used in place:
+//  - MappedFile: read-only memory mapping of a file
+//  - writeFileSections(): writes a list of memory ranges as a file's new contents with
+//    one gathering write (writev), so the ranges are not copied together first
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+// Read-only memory mapping of a whole file
+class MappedFile
+{
+public:
+    MappedFile() = default;
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    bool open(const std::string& path)
+    {
+        close();
+#ifdef _WIN32
+        file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+        LARGE_INTEGER fileSize;
+        GetFileSizeEx(file, &fileSize);
+        mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!mapping)
+        {
+            close();
+            return false;
+        }
+        bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        length = (size_t)fileSize.QuadPart;
+#else
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+        struct stat info;
+        if (fstat(fd, &info) != 0 || info.st_size == 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        void* address = mmap(nullptr, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (address == MAP_FAILED)
+            return false;
+        bytes = (const unsigned char*)address;
+        length = (size_t)info.st_size;
+#endif
+        return bytes != nullptr;
+    }
+
+    void close()
+    {
+#ifdef _WIN32
+        if (bytes) UnmapViewOfFile(bytes);
+        if (mapping) CloseHandle(mapping);
+        if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+        mapping = NULL;
+        file = INVALID_HANDLE_VALUE;
+#else
+        if (bytes) munmap((void*)bytes, length);
+#endif
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const unsigned char* data() const { return bytes; }
+    size_t size() const { return length; }
+
+private:
+    const unsigned char* bytes = nullptr;
+    size_t length = 0;
+#ifdef _WIN32
+    HANDLE file = INVALID_HANDLE_VALUE;
+    HANDLE mapping = NULL;
+#endif
+};
+
+struct FileSection
+{
+    const void* data;
+    size_t size;
+};
+
+// Writes the sections back to back to `path`, truncating it
+inline bool writeFileSectionsTo(const std::string& path, const FileSection* sections, size_t count)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    bool ok = true;
+    for (size_t i = 0; i < count && ok; ++i)
+    {
+        const char* data = (const char*)sections[i].data;
+        size_t left = sections[i].size;
+        while (left > 0 && ok)
+        {
+            DWORD written = 0;
+            DWORD chunk = left > 0x40000000 ? 0x40000000 : (DWORD)left;
+            ok = WriteFile(file, data, chunk, &written, NULL) && written > 0;
+            data += written;
+            left -= written;
+        }
+    }
+    CloseHandle(file);
+    return ok;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return false;
+    std::vector<iovec> parts;
+    for (size_t i = 0; i < count; ++i)
+        if (sections[i].size > 0)
+            parts.push_back({ const_cast<void*>(sections[i].data), sections[i].size });
+
+    // normally a single call; a short write (signals, very large files) resumes where it stopped
+    size_t first = 0;
+    bool ok = true;
+    while (first < parts.size())
+    {
+        int batch = (int)std::min(parts.size() - first, (size_t)IOV_MAX);
+        ssize_t written = ::writev(fd, &parts[first], batch);
+        if (written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ok = false;
+            break;
+        }
+        while (first < parts.size() && (size_t)written >= parts[first].iov_len)
+            written -= (ssize_t)parts[first++].iov_len;
+        if (first < parts.size())
+        {
+            parts[first].iov_base = (char*)parts[first].iov_base + written;
+            parts[first].iov_len -= (size_t)written;
+        }
+    }
+    ok = ::close(fd) == 0 && ok;
+    return ok;
+#endif
+}
+
+// Replaces the contents of `path` with the sections, back to back. They are written to
+// a temporary name first, so a crash never leaves a truncated file behind and `path`
+// can be the file the sections were mapped from.
+inline bool writeFileSections(const std::string& path, const FileSection* sections, size_t count)
+{
+    std::string temporary = path + ".tmp";
+    if (!writeFileSectionsTo(temporary, sections, count))
+    {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, path, error);
+    return !error;
+}
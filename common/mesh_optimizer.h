@@ -0,0 +1,399 @@
+// mesh_optimizer.h
+// Import-time mesh optimization, no GL:
+//  - deduplicateVertices: merges bit-identical vertices
+//  - optimizeVertexCache: reorders triangles for post-transform cache reuse
+//    (Forsyth's linear-speed algorithm)
+//  - optimizeOverdraw: reorders cache-friendly clusters of triangles so the ones
+//    facing outwards come first, as long as cache efficiency stays within a threshold
+//  - optimizeVertexFetch: renumbers vertices in first-use order
+//  - analyzeVertexCache: FIFO cache simulator for ACMR / ATVR
+// Vertices are handled as opaque structs; positions are pulled out through a
+// callback for the overdraw pass.
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+struct VertexCacheStats
+{
+    unsigned int misses = 0;
+    float acmr = 0.0f; // average cache miss ratio: transformed vertices per triangle (0.5 is ideal, 3 is worst)
+    float atvr = 0.0f; // average transformed vertex ratio: transformed vertices per unique vertex (1 is ideal)
+};
+
+// Simulates a FIFO post-transform cache of `cacheSize` entries
+inline VertexCacheStats analyzeVertexCache(const std::vector<unsigned int>& indices, size_t vertexCount, unsigned int cacheSize = 16)
+{
+    VertexCacheStats stats;
+    std::vector<unsigned int> timestamps(vertexCount, 0);
+    unsigned int time = cacheSize + 1;
+    for (unsigned int index : indices)
+    {
+        if (time - timestamps[index] > cacheSize)
+        {
+            timestamps[index] = time++;
+            stats.misses++;
+        }
+    }
+    size_t triangles = indices.size() / 3;
+    stats.acmr = triangles > 0 ? (float)stats.misses / triangles : 0.0f;
+    stats.atvr = vertexCount > 0 ? (float)stats.misses / vertexCount : 0.0f;
+    return stats;
+}
+
+// Merges vertices whose first `keyBytes` bytes are identical and rewrites the indices;
+// returns the new vertex count. Pass a shorter key when the tail of the struct is not
+// filled in by the loader (e.g. bone data on static meshes).
+template <typename Vertex>
+size_t deduplicateVertices(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, size_t keyBytes = sizeof(Vertex))
+{
+    struct Key
+    {
+        const Vertex* vertex;
+    };
+    auto equal = [keyBytes](const Key& a, const Key& b) { return std::memcmp(a.vertex, b.vertex, keyBytes) == 0; };
+    auto hash = [keyBytes](const Key& key) {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(key.vertex);
+        uint64_t value = 14695981039346656037ull; // FNV-1a
+        for (size_t i = 0; i < keyBytes; ++i)
+            value = (value ^ bytes[i]) * 1099511628211ull;
+        return (size_t)value;
+    };
+
+    std::unordered_map<Key, unsigned int, decltype(hash), decltype(equal)> unique(vertices.size(), hash, equal);
+    std::vector<unsigned int> remap(vertices.size());
+    std::vector<Vertex> merged;
+    merged.reserve(vertices.size());
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        auto found = unique.find(Key{ &vertices[i] });
+        if (found != unique.end())
+        {
+            remap[i] = found->second;
+            continue;
+        }
+        remap[i] = (unsigned int)merged.size();
+        merged.push_back(vertices[i]);
+        unique.emplace(Key{ &merged.back() }, remap[i]);
+    }
+    // merged never reallocates (reserved above), so the keys stay valid until here
+    for (unsigned int& index : indices)
+        index = remap[index];
+    vertices.swap(merged);
+    return vertices.size();
+}
+
+// Forsyth, "Linear-Speed Vertex Cache Optimisation" (2006), with a 32 entry LRU model
+inline void optimizeVertexCache(std::vector<unsigned int>& indices, size_t vertexCount)
+{
+    const int CACHE_SIZE = 32;
+    const float CACHE_DECAY_POWER = 1.5f;
+    const float LAST_TRIANGLE_SCORE = 0.75f;
+    const float VALENCE_BOOST_SCALE = 2.0f;
+    const float VALENCE_BOOST_POWER = 0.5f;
+
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount == 0)
+        return;
+
+    // vertex -> triangles adjacency
+    std::vector<unsigned int> adjacencyOffset(vertexCount + 1, 0);
+    for (unsigned int index : indices)
+        adjacencyOffset[index + 1]++;
+    for (size_t v = 0; v < vertexCount; ++v)
+        adjacencyOffset[v + 1] += adjacencyOffset[v];
+    std::vector<unsigned int> adjacency(indices.size());
+    std::vector<unsigned int> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+    for (size_t t = 0; t < triangleCount; ++t)
+        for (int k = 0; k < 3; ++k)
+            adjacency[fill[indices[t * 3 + k]]++] = (unsigned int)t;
+
+    std::vector<unsigned int> liveTriangles(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        liveTriangles[v] = adjacencyOffset[v + 1] - adjacencyOffset[v];
+    std::vector<int> cachePosition(vertexCount, -1);
+
+    auto vertexScore = [&](unsigned int v) -> float {
+        if (liveTriangles[v] == 0)
+            return -1.0f;
+        float score = 0.0f;
+        int position = cachePosition[v];
+        if (position >= 0)
+        {
+            if (position < 3)
+                score = LAST_TRIANGLE_SCORE;
+            else
+                score = std::pow(1.0f - (float)(position - 3) / (CACHE_SIZE - 3), CACHE_DECAY_POWER);
+        }
+        return score + VALENCE_BOOST_SCALE * std::pow((float)liveTriangles[v], -VALENCE_BOOST_POWER);
+    };
+
+    std::vector<float> vertexScores(vertexCount);
+    for (size_t v = 0; v < vertexCount; ++v)
+        vertexScores[v] = vertexScore((unsigned int)v);
+    std::vector<float> triangleScores(triangleCount);
+    std::vector<bool> emitted(triangleCount, false);
+    for (size_t t = 0; t < triangleCount; ++t)
+        triangleScores[t] = vertexScores[indices[t * 3]] + vertexScores[indices[t * 3 + 1]] + vertexScores[indices[t * 3 + 2]];
+
+    std::vector<unsigned int> output;
+    output.reserve(indices.size());
+    std::vector<unsigned int> cache, nextCache;
+    cache.reserve(CACHE_SIZE + 3);
+    nextCache.reserve(CACHE_SIZE + 3);
+    size_t scanCursor = 0;
+
+    long long best = -1;
+    for (size_t emittedCount = 0; emittedCount < triangleCount; ++emittedCount)
+    {
+        if (best < 0)
+        {
+            // nothing in the cache to continue from: take the best remaining triangle
+            // from a linear scan (triangles before scanCursor are all emitted)
+            float bestScore = -1.0f;
+            while (scanCursor < triangleCount && emitted[scanCursor])
+                scanCursor++;
+            for (size_t t = scanCursor; t < triangleCount; ++t)
+            {
+                if (!emitted[t] && triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = (long long)t;
+                }
+            }
+        }
+
+        unsigned int tri[3] = { indices[best * 3], indices[best * 3 + 1], indices[best * 3 + 2] };
+        output.insert(output.end(), tri, tri + 3);
+        emitted[best] = true;
+
+        // remove the triangle from its vertices' live lists
+        for (unsigned int v : tri)
+        {
+            unsigned int* begin = &adjacency[adjacencyOffset[v]];
+            unsigned int* end = begin + liveTriangles[v];
+            unsigned int* it = std::find(begin, end, (unsigned int)best);
+            if (it != end)
+            {
+                *it = *(end - 1);
+                liveTriangles[v]--;
+            }
+        }
+
+        // new cache: this triangle's vertices first, then the old contents
+        nextCache.assign(tri, tri + 3);
+        for (unsigned int v : cache)
+            if (v != tri[0] && v != tri[1] && v != tri[2])
+                nextCache.push_back(v);
+        for (size_t i = 0; i < nextCache.size(); ++i)
+            cachePosition[nextCache[i]] = i < (size_t)CACHE_SIZE ? (int)i : -1;
+
+        // rescore affected vertices and their triangles, and pick the best cached one
+        best = -1;
+        float bestScore = -1.0f;
+        for (size_t i = 0; i < nextCache.size(); ++i)
+        {
+            unsigned int v = nextCache[i];
+            float oldScore = vertexScores[v];
+            vertexScores[v] = vertexScore(v);
+            float delta = vertexScores[v] - oldScore;
+            for (unsigned int a = 0; a < liveTriangles[v]; ++a)
+            {
+                unsigned int t = adjacency[adjacencyOffset[v] + a];
+                triangleScores[t] += delta;
+                if (i < (size_t)CACHE_SIZE && triangleScores[t] > bestScore)
+                {
+                    bestScore = triangleScores[t];
+                    best = t;
+                }
+            }
+        }
+        if (nextCache.size() > (size_t)CACHE_SIZE)
+            nextCache.resize(CACHE_SIZE);
+        cache.swap(nextCache);
+    }
+    indices.swap(output);
+}
+
+// Overdraw pass in the spirit of Sander et al. "Fast Triangle Reordering for
+// Vertex Locality and Reduced Overdraw" (2007): split the cache-optimized order
+// into clusters where a triangle misses on all three vertices (hard boundaries),
+// split those again wherever the running ACMR since the last split is already within
+// `threshold` of the whole cluster's (soft boundaries), then draw clusters
+// whose average normal points away from the mesh centre first, since they are the
+// likeliest to occlude the rest. The result is kept only if ACMR grows by less than
+// `threshold` (1.05 = 5%). Returns the number of clusters.
+template <typename Vertex, typename PositionOf>
+size_t optimizeOverdraw(std::vector<unsigned int>& indices, const std::vector<Vertex>& vertices, PositionOf positionOf, float threshold = 1.05f)
+{
+    size_t triangleCount = indices.size() / 3;
+    if (triangleCount < 2)
+        return triangleCount;
+
+    // 16 entry FIFO; flushing is a jump in time past every stored stamp
+    std::vector<unsigned int> timestamps(vertices.size(), 0);
+    unsigned int time = 17;
+    auto triangleMisses = [&](size_t t) {
+        int misses = 0;
+        for (int k = 0; k < 3; ++k)
+        {
+            unsigned int v = indices[t * 3 + k];
+            if (time - timestamps[v] > 16)
+            {
+                timestamps[v] = time++;
+                misses++;
+            }
+        }
+        return misses;
+    };
+
+    // hard boundaries: triangles that hit nothing in the cache
+    std::vector<size_t> hardStart;
+    std::vector<int> missCount(triangleCount);
+    for (size_t t = 0; t < triangleCount; ++t)
+    {
+        missCount[t] = triangleMisses(t);
+        if (t == 0 || missCount[t] == 3)
+            hardStart.push_back(t);
+    }
+    hardStart.push_back(triangleCount);
+
+    // soft boundaries, simulating each soft cluster from a cold cache as it would be drawn
+    std::vector<size_t> clusterStart;
+    for (size_t h = 0; h + 1 < hardStart.size(); ++h)
+    {
+        size_t first = hardStart[h], last = hardStart[h + 1];
+        int hardMisses = 0;
+        for (size_t t = first; t < last; ++t)
+            hardMisses += missCount[t];
+        float target = (float)hardMisses / (last - first) * threshold;
+
+        clusterStart.push_back(first);
+        time += 17;
+        int misses = 0;
+        size_t start = first;
+        for (size_t t = first; t < last; ++t)
+        {
+            misses += triangleMisses(t);
+            if (t + 1 < last && (float)misses / (t + 1 - start) <= target)
+            {
+                clusterStart.push_back(t + 1);
+                time += 17;
+                misses = 0;
+                start = t + 1;
+            }
+        }
+    }
+    clusterStart.push_back(triangleCount);
+    size_t clusterCount = clusterStart.size() - 1;
+    if (clusterCount < 2)
+        return clusterCount;
+
+    glm::vec3 meshCentre(0.0f);
+    for (const Vertex& vertex : vertices)
+        meshCentre += positionOf(vertex);
+    meshCentre /= (float)vertices.size();
+
+    struct Cluster
+    {
+        size_t first, last;
+        float sortKey;
+    };
+    std::vector<Cluster> clusters(clusterCount);
+    for (size_t c = 0; c < clusterCount; ++c)
+    {
+        glm::vec3 centroid(0.0f), normal(0.0f);
+        float area = 0.0f;
+        for (size_t t = clusterStart[c]; t < clusterStart[c + 1]; ++t)
+        {
+            glm::vec3 a = positionOf(vertices[indices[t * 3]]);
+            glm::vec3 b = positionOf(vertices[indices[t * 3 + 1]]);
+            glm::vec3 d = positionOf(vertices[indices[t * 3 + 2]]);
+            glm::vec3 n = glm::cross(b - a, d - a); // length = twice the area
+            float weight = glm::length(n);
+            centroid += (a + b + d) / 3.0f * weight;
+            normal += n;
+            area += weight;
+        }
+        if (area > 0.0f)
+            centroid /= area;
+        float normalLength = glm::length(normal);
+        clusters[c] = { clusterStart[c], clusterStart[c + 1],
+                        normalLength > 0.0f ? glm::dot(centroid - meshCentre, normal / normalLength) : 0.0f };
+    }
+    std::stable_sort(clusters.begin(), clusters.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+
+    std::vector<unsigned int> reordered;
+    reordered.reserve(indices.size());
+    for (const Cluster& cluster : clusters)
+        reordered.insert(reordered.end(), indices.begin() + cluster.first * 3, indices.begin() + cluster.last * 3);
+
+    float before = analyzeVertexCache(indices, vertices.size()).acmr;
+    float after = analyzeVertexCache(reordered, vertices.size()).acmr;
+    if (after <= before * threshold)
+        indices.swap(reordered);
+    return clusterCount;
+}
+
+// Renumbers vertices in the order the index buffer first touches them, so vertex
+// fetch walks memory forwards; unreferenced vertices are dropped
+template <typename Vertex>
+void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+    const unsigned int UNUSED = ~0u;
+    std::vector<unsigned int> remap(vertices.size(), UNUSED);
+    std::vector<Vertex> ordered;
+    ordered.reserve(vertices.size());
+    for (unsigned int& index : indices)
+    {
+        if (remap[index] == UNUSED)
+        {
+            remap[index] = (unsigned int)ordered.size();
+            ordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices.swap(ordered);
+}
+
+struct MeshOptimizeReport
+{
+    size_t verticesBefore = 0;
+    size_t verticesAfter = 0;
+    size_t triangles = 0;
+    size_t clusters = 0;
+    VertexCacheStats cacheBefore; // 16 entry FIFO
+    VertexCacheStats cacheAfter;
+    bool indices16 = false;       // fits 16-bit indices after optimization
+    double milliseconds = 0.0;
+};
+
+// Full pass: dedup, vertex cache, overdraw, fetch order
+template <typename Vertex, typename PositionOf>
+MeshOptimizeReport optimizeMesh(std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, PositionOf positionOf,
+                                size_t keyBytes = sizeof(Vertex))
+{
+    auto start = std::chrono::steady_clock::now();
+    MeshOptimizeReport report;
+    report.verticesBefore = vertices.size();
+    report.triangles = indices.size() / 3;
+    report.cacheBefore = analyzeVertexCache(indices, vertices.size());
+
+    deduplicateVertices(vertices, indices, keyBytes);
+    optimizeVertexCache(indices, vertices.size());
+    report.clusters = optimizeOverdraw(indices, vertices, positionOf);
+    optimizeVertexFetch(vertices, indices);
+
+    report.verticesAfter = vertices.size();
+    report.cacheAfter = analyzeVertexCache(indices, vertices.size());
+    report.indices16 = vertices.size() <= 65536;
+    report.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
@@ -0,0 +1,205 @@
+// model_optimizer.h
+// Runs the mesh_optimizer.h passes over a loaded learnopengl Model and re-uploads
+// the result into the buffers the Mesh already owns, plus a headless benchmark that
+// loads model files through Assimp the same way Model does and reports the
+// vertex cache numbers before and after. packSkinnedModel() swaps a skinned model's
+// vertex buffers over to the packed_vertex.h format.
+#pragma once
+
+#include <glad/glad.h>
+#include <assimp/Importer.hpp>
+#include <assimp/scene.h>
+#include <assimp/postprocess.h>
+
+#include <learnopengl/mesh.h>
+
+#include "mesh_optimizer.h"
+#include "packed_vertex.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+inline void reportMeshOptimize(std::ostream& out, const std::string& name, const MeshOptimizeReport& report, GLenum indexType)
+{
+    out << "  " << name << ": " << report.triangles << " tris, verts " << report.verticesBefore << " -> " << report.verticesAfter
+        << ", ACMR " << std::fixed << std::setprecision(3) << report.cacheBefore.acmr << " -> " << report.cacheAfter.acmr
+        << ", ATVR " << report.cacheBefore.atvr << " -> " << report.cacheAfter.atvr << ", " << report.clusters << " clusters, "
+        << (indexType == GL_UNSIGNED_SHORT ? "16" : "32") << "-bit indices, " << std::setprecision(2) << report.milliseconds << " ms"
+        << std::defaultfloat << std::setprecision(6) << std::endl;
+}
+
+// Optimizes every mesh of `model` in place and re-uploads its vertex and index buffers.
+// Returns the index type of each mesh, which the caller must draw with: 16-bit where
+// the mesh fits and allow16BitIndices is set (Mesh::Draw itself assumes 32-bit, so only
+// callers that issue their own draws can allow it). mesh.indices keeps the 32-bit copy.
+// Static models leave the bone fields of Vertex unset, so they are kept out of the
+// dedup key unless `skinned`.
+template <typename ModelType>
+std::vector<GLenum> optimizeModel(ModelType& model, const std::string& name, bool allow16BitIndices, bool skinned)
+{
+    std::vector<GLenum> indexTypes;
+    std::cout << "Mesh optimizer: " << name << std::endl;
+    size_t keyBytes = skinned ? sizeof(Vertex) : offsetof(Vertex, m_BoneIDs);
+    std::vector<uint16_t> shortIndices;
+    for (size_t m = 0; m < model.meshes.size(); ++m)
+    {
+        auto& mesh = model.meshes[m];
+        MeshOptimizeReport report = optimizeMesh(mesh.vertices, mesh.indices, [](const Vertex& vertex) { return vertex.Position; }, keyBytes);
+        GLenum indexType = allow16BitIndices && report.indices16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+        indexTypes.push_back(indexType);
+
+        // binding the VAO binds its element buffer; the vertex buffer is found through attribute 0
+        GLint vbo = 0;
+        glBindVertexArray(mesh.VAO);
+        glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vbo);
+        glBufferData(GL_ARRAY_BUFFER, mesh.vertices.size() * sizeof(Vertex), mesh.vertices.data(), GL_STATIC_DRAW);
+        if (indexType == GL_UNSIGNED_SHORT)
+        {
+            shortIndices.assign(mesh.indices.begin(), mesh.indices.end());
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, shortIndices.size() * sizeof(uint16_t), shortIndices.data(), GL_STATIC_DRAW);
+        }
+        else
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.indices.size() * sizeof(unsigned int), mesh.indices.data(), GL_STATIC_DRAW);
+        glBindVertexArray(0);
+
+        reportMeshOptimize(std::cout, "mesh " + std::to_string(m), report, indexType);
+    }
+    return indexTypes;
+}
+
+// Points attributes 0-6 of the bound VAO at PackedSkinnedVertex data in the bound
+// GL_ARRAY_BUFFER, at the locations learnopengl's Mesh uses for the float layout
+inline void setPackedSkinnedAttributes()
+{
+    const GLsizei stride = sizeof(PackedSkinnedVertex);
+    // position: half
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 4, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedSkinnedVertex, position));
+    // tangent frame: snorm16 quaternion, in the normal's slot
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 4, GL_SHORT, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, tangentFrame));
+    // texcoords: half
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, stride, (void*)offsetof(PackedSkinnedVertex, texCoords));
+    // tangent and bitangent are folded into the frame
+    glDisableVertexAttribArray(3);
+    glDisableVertexAttribArray(4);
+    // bone ids: uint8; weights: unorm8
+    glEnableVertexAttribArray(5);
+    glVertexAttribIPointer(5, 4, GL_UNSIGNED_BYTE, stride, (void*)offsetof(PackedSkinnedVertex, boneIds));
+    glEnableVertexAttribArray(6);
+    glVertexAttribPointer(6, 4, GL_UNSIGNED_BYTE, GL_TRUE, stride, (void*)offsetof(PackedSkinnedVertex, weights));
+}
+
+// Re-uploads every mesh as PackedSkinnedVertex and re-points the attributes of its VAO,
+// so Mesh::Draw keeps working unchanged; the vertex shader must declare the packed
+// inputs (see anim_model.vs). The float vertices stay in mesh.vertices. A mesh whose
+// data does not fit the packed ranges is left on the float layout, so the shader and
+// the buffers would disagree; returns false in that case.
+template <typename ModelType>
+bool packSkinnedModel(ModelType& model, const std::string& name)
+{
+    bool allPacked = true;
+    std::cout << "Vertex format: " << name << std::endl;
+    for (size_t m = 0; m < model.meshes.size(); ++m)
+    {
+        auto& mesh = model.meshes[m];
+        VertexPackReport report;
+        std::vector<PackedSkinnedVertex> packed = packSkinnedVertices(mesh.vertices, report);
+        reportVertexPack(std::cout, "mesh " + std::to_string(m), report);
+        if (!report.fits)
+        {
+            allPacked = false;
+            continue;
+        }
+
+        GLint vbo = 0;
+        glBindVertexArray(mesh.VAO);
+        glGetVertexAttribiv(0, GL_VERTEX_ATTRIB_ARRAY_BUFFER_BINDING, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, (GLuint)vbo);
+        glBufferData(GL_ARRAY_BUFFER, packed.size() * sizeof(PackedSkinnedVertex), packed.data(), GL_STATIC_DRAW);
+        setPackedSkinnedAttributes();
+        glBindVertexArray(0);
+    }
+    return allPacked;
+}
+
+// Headless: loads each file with Model's import flags, runs the optimizer on position,
+// normal and texcoords, and prints ACMR / ATVR for 16 and 32 entry FIFO caches before
+// and after, plus the throughput of the cache simulator itself.
+inline int runMeshOptimizerBenchmark(const std::vector<std::string>& paths)
+{
+    struct BenchVertex
+    {
+        float position[3];
+        float normal[3];
+        float texCoords[2];
+    };
+    auto positionOf = [](const BenchVertex& vertex) { return glm::vec3(vertex.position[0], vertex.position[1], vertex.position[2]); };
+
+    double simulatedIndices = 0.0, simulatorSeconds = 0.0;
+    unsigned long long simulatedMisses = 0;
+    for (const std::string& path : paths)
+    {
+        Assimp::Importer importer;
+        const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
+        if (scene == nullptr || (scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE) || scene->mRootNode == nullptr)
+        {
+            std::cout << "ERROR::ASSIMP:: " << importer.GetErrorString() << std::endl;
+            continue;
+        }
+        std::cout << path << std::endl;
+        for (unsigned int m = 0; m < scene->mNumMeshes; ++m)
+        {
+            const aiMesh* source = scene->mMeshes[m];
+            std::vector<BenchVertex> vertices(source->mNumVertices);
+            for (unsigned int v = 0; v < source->mNumVertices; ++v)
+            {
+                BenchVertex& vertex = vertices[v];
+                vertex = BenchVertex();
+                vertex.position[0] = source->mVertices[v].x;
+                vertex.position[1] = source->mVertices[v].y;
+                vertex.position[2] = source->mVertices[v].z;
+                if (source->mNormals != nullptr)
+                {
+                    vertex.normal[0] = source->mNormals[v].x;
+                    vertex.normal[1] = source->mNormals[v].y;
+                    vertex.normal[2] = source->mNormals[v].z;
+                }
+                if (source->mTextureCoords[0] != nullptr)
+                {
+                    vertex.texCoords[0] = source->mTextureCoords[0][v].x;
+                    vertex.texCoords[1] = source->mTextureCoords[0][v].y;
+                }
+            }
+            std::vector<unsigned int> indices;
+            for (unsigned int f = 0; f < source->mNumFaces; ++f)
+                if (source->mFaces[f].mNumIndices == 3)
+                    indices.insert(indices.end(), source->mFaces[f].mIndices, source->mFaces[f].mIndices + 3);
+
+            VertexCacheStats before32 = analyzeVertexCache(indices, vertices.size(), 32);
+            MeshOptimizeReport report = optimizeMesh(vertices, indices, positionOf);
+            VertexCacheStats after32 = analyzeVertexCache(indices, vertices.size(), 32);
+            reportMeshOptimize(std::cout, "mesh " + std::to_string(m), report, report.indices16 ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT);
+            std::cout << "    32-entry cache: ACMR " << before32.acmr << " -> " << after32.acmr << ", ATVR " << before32.atvr
+                      << " -> " << after32.atvr << std::endl;
+
+            // time the simulator: enough passes for ~1M indices
+            int passes = indices.empty() ? 0 : (int)(1000000 / indices.size()) + 1;
+            auto start = std::chrono::steady_clock::now();
+            for (int pass = 0; pass < passes; ++pass)
+                simulatedMisses += analyzeVertexCache(indices, vertices.size()).misses;
+            simulatorSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            simulatedIndices += (double)passes * indices.size();
+        }
+    }
+    if (simulatorSeconds > 0.0)
+        std::cout << "Cache simulator: " << simulatedIndices / simulatorSeconds / 1.0e6 << " M indices/s (" << simulatedMisses << " misses)" << std::endl;
+    return 0;
+}
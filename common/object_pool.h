@@ -0,0 +1,89 @@
+// object_pool.h
+// Fixed-capacity pool for small value objects that are spawned and retired all the
+// time (the crossing game's cars and trees). Storage is reserved once; acquire()
+// takes the next free slot and release keeps the live objects dense by moving the
+// last one into the hole, so iteration stays a plain array walk and order is not
+// kept (releaseFront() is the order-keeping exception). Running past the capacity still works, but reallocates and is counted.
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+template <typename T>
+class ObjectPool
+{
+public:
+    explicit ObjectPool(size_t capacity)
+    {
+        items.reserve(capacity);
+    }
+
+    T& acquire()
+    {
+        if (items.size() == items.capacity())
+            ++overflows;
+        items.emplace_back();
+        return items.back();
+    }
+
+    void release(size_t index)
+    {
+        if (index + 1 != items.size())
+            items[index] = std::move(items.back());
+        items.pop_back();
+    }
+
+    // releases every object the predicate accepts; returns how many
+    template <typename Predicate>
+    size_t releaseIf(Predicate predicate)
+    {
+        size_t released = 0;
+        for (size_t i = 0; i < items.size();)
+        {
+            if (predicate(items[i]))
+            {
+                release(i);
+                ++released;
+            }
+            else
+                ++i;
+        }
+        return released;
+    }
+
+    // releases the first `count` objects and keeps the order of the rest, for pools that
+    // are filled in a sorted order and retired from the front
+    void releaseFront(size_t count)
+    {
+        items.erase(items.begin(), items.begin() + std::min(count, items.size()));
+    }
+
+    void clear() { items.clear(); }
+
+    // replaces the contents with count objects copied from `first` in one go (resuming a
+    // saved pool); counted as an overflow when they do not fit the reserved capacity
+    void assign(const T* first, size_t count)
+    {
+        if (count > items.capacity())
+            ++overflows;
+        items.assign(first, first + count);
+    }
+
+    size_t size() const { return items.size(); }
+    bool empty() const { return items.empty(); }
+    size_t capacity() const { return items.capacity(); }
+    size_t overflowCount() const { return overflows; }
+
+    T& operator[](size_t index) { return items[index]; }
+    const T& operator[](size_t index) const { return items[index]; }
+    T* begin() { return items.data(); }
+    T* end() { return items.data() + items.size(); }
+    const T* begin() const { return items.data(); }
+    const T* end() const { return items.data() + items.size(); }
+
+private:
+    std::vector<T> items;
+    size_t overflows = 0;
+};
@@ -0,0 +1,239 @@
+// packed_vertex.h
+// Compact vertex formats and their encoders, no GL:
+//  - PackedStaticVertex (16 bytes): snorm16 position inside a [-scale, scale] box,
+//    octahedral snorm16 normal, unorm16 texcoords
+//  - PackedSkinnedVertex (28 bytes): half position, tangent frame as an snorm16
+//    quaternion, half texcoords, uint8 bone ids, unorm8 weights
+//  - VertexPackReport: size before and after and the worst decode error against the
+//    float source, measured by decoding every vertex the way the GPU will
+// The matching GLSL decoders live next to the shaders that use them.
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+struct PackedStaticVertex
+{
+    int16_t position[4]; // snorm16, times the mesh's position scale; w unused
+    int16_t normal[2];   // snorm16 octahedral
+    uint16_t texCoords[2];
+};
+
+struct PackedSkinnedVertex
+{
+    uint16_t position[4];  // half; w = 1
+    int16_t tangentFrame[4]; // snorm16 quaternion (x, y, z, w); w < 0 marks a mirrored bitangent
+    uint16_t texCoords[2]; // half
+    uint8_t boneIds[4];    // PACKED_NO_BONE where unused
+    uint8_t weights[4];    // unorm8, summing to 255
+};
+
+const uint8_t PACKED_NO_BONE = 255;
+
+struct VertexPackReport
+{
+    size_t vertices = 0;
+    size_t floatStride = 0;
+    size_t packedStride = 0;
+    bool fits = true;            // false if a value could not be represented (e.g. a bone id over 254)
+    float positionError = 0.0f;  // max absolute, in model units
+    float normalDegrees = 0.0f;  // max angle between source and decoded normal
+    float tangentDegrees = 0.0f;
+    float texCoordError = 0.0f;
+    float weightError = 0.0f;
+};
+
+inline float angleDegrees(glm::vec3 a, glm::vec3 b)
+{
+    float c = glm::dot(glm::normalize(a), glm::normalize(b));
+    return glm::degrees(std::acos(std::min(1.0f, std::max(-1.0f, c))));
+}
+
+// octahedral mapping of a unit vector to [-1, 1]^2; the lower hemisphere folds onto the corners
+inline glm::vec2 octEncode(glm::vec3 n)
+{
+    n /= std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+    glm::vec2 p(n.x, n.y);
+    if (n.z < 0.0f)
+        p = glm::vec2((1.0f - std::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f));
+    return p;
+}
+
+// same arithmetic as octDecode() in the shaders
+inline glm::vec3 octDecode(glm::vec2 p)
+{
+    glm::vec3 n(p.x, p.y, 1.0f - std::abs(p.x) - std::abs(p.y));
+    float t = std::max(-n.z, 0.0f);
+    n.x += n.x >= 0.0f ? -t : t;
+    n.y += n.y >= 0.0f ? -t : t;
+    return glm::normalize(n);
+}
+
+// Tangent frame as one quaternion ("QTangent"). The rotation takes (x, y, z) to
+// (tangent, bitangent, normal); a mirrored UV layout is kept in the sign of w, which is
+// biased away from zero so the sign survives snorm16 quantization.
+inline glm::quat encodeTangentFrame(glm::vec3 normal, glm::vec3 tangent, glm::vec3 bitangent)
+{
+    glm::vec3 n = glm::normalize(normal);
+    glm::vec3 t = tangent - n * glm::dot(n, tangent);
+    if (glm::dot(t, t) < 1.0e-12f) // no usable tangent (mesh without UVs): any perpendicular will do
+        t = std::abs(n.x) < 0.9f ? glm::cross(n, glm::vec3(1.0f, 0.0f, 0.0f)) : glm::cross(n, glm::vec3(0.0f, 1.0f, 0.0f));
+    t = glm::normalize(t);
+    glm::vec3 b = glm::cross(n, t);
+    bool mirrored = glm::dot(b, bitangent) < 0.0f;
+
+    glm::mat3 frame(t, b, n);
+    glm::quat q = glm::normalize(glm::quat_cast(frame));
+    if (q.w < 0.0f)
+        q = -q;
+    const float bias = 1.0f / 32767.0f;
+    if (q.w < bias)
+    {
+        float scale = std::sqrt(1.0f - bias * bias) / std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z);
+        q = glm::quat(bias, q.x * scale, q.y * scale, q.z * scale);
+    }
+    return mirrored ? -q : q;
+}
+
+// normal, tangent and bitangent back out of an encoded frame, as the shaders do it
+inline void decodeTangentFrame(glm::quat q, glm::vec3& normal, glm::vec3& tangent, glm::vec3& bitangent)
+{
+    q = glm::normalize(q);
+    glm::mat3 frame = glm::mat3_cast(q);
+    tangent = frame[0];
+    normal = frame[2];
+    bitangent = glm::cross(normal, tangent) * (q.w < 0.0f ? -1.0f : 1.0f);
+}
+
+// Packs vertices laid out as position (3), normal (3), texcoord (2) floats. Positions
+// are divided by positionScale, so the draw must scale by it again (in the model
+// matrix); texcoords must be in [0, 1].
+inline std::vector<PackedStaticVertex> packStaticVertices(const float* vertices, size_t count, int floatsPerVertex,
+                                                          float positionScale, VertexPackReport& report)
+{
+    std::vector<PackedStaticVertex> packed(count);
+    report = VertexPackReport();
+    report.vertices = count;
+    report.floatStride = floatsPerVertex * sizeof(float);
+    report.packedStride = sizeof(PackedStaticVertex);
+    for (size_t i = 0; i < count; ++i)
+    {
+        const float* v = vertices + i * floatsPerVertex;
+        PackedStaticVertex& out = packed[i];
+        glm::vec3 position(v[0], v[1], v[2]);
+        glm::vec3 normal(v[3], v[4], v[5]);
+        glm::vec2 texCoords(v[6], v[7]);
+
+        for (int c = 0; c < 3; ++c)
+            out.position[c] = (int16_t)glm::packSnorm1x16(position[c] / positionScale);
+        out.position[3] = 0;
+        glm::vec2 oct = octEncode(normal);
+        out.normal[0] = (int16_t)glm::packSnorm1x16(oct.x);
+        out.normal[1] = (int16_t)glm::packSnorm1x16(oct.y);
+        out.texCoords[0] = glm::packUnorm1x16(texCoords.x);
+        out.texCoords[1] = glm::packUnorm1x16(texCoords.y);
+
+        for (int c = 0; c < 3; ++c)
+        {
+            float decoded = glm::unpackSnorm1x16((uint16_t)out.position[c]) * positionScale;
+            report.positionError = std::max(report.positionError, std::abs(decoded - position[c]));
+        }
+        glm::vec3 decodedNormal = octDecode(glm::vec2(glm::unpackSnorm1x16((uint16_t)out.normal[0]), glm::unpackSnorm1x16((uint16_t)out.normal[1])));
+        report.normalDegrees = std::max(report.normalDegrees, angleDegrees(normal, decodedNormal));
+        for (int c = 0; c < 2; ++c)
+            report.texCoordError = std::max(report.texCoordError, std::abs(glm::unpackUnorm1x16(out.texCoords[c]) - texCoords[c]));
+        if (std::abs(position.x) > positionScale || std::abs(position.y) > positionScale || std::abs(position.z) > positionScale ||
+            texCoords.x < 0.0f || texCoords.x > 1.0f || texCoords.y < 0.0f || texCoords.y > 1.0f)
+            report.fits = false;
+    }
+    return packed;
+}
+
+// Packs learnopengl-style skinned vertices (Position, Normal, TexCoords, Tangent,
+// Bitangent, m_BoneIDs, m_Weights with -1 for an unused slot).
+template <typename Vertex>
+std::vector<PackedSkinnedVertex> packSkinnedVertices(const std::vector<Vertex>& vertices, VertexPackReport& report)
+{
+    std::vector<PackedSkinnedVertex> packed(vertices.size());
+    report = VertexPackReport();
+    report.vertices = vertices.size();
+    report.floatStride = sizeof(Vertex);
+    report.packedStride = sizeof(PackedSkinnedVertex);
+    for (size_t i = 0; i < vertices.size(); ++i)
+    {
+        const Vertex& v = vertices[i];
+        PackedSkinnedVertex& out = packed[i];
+
+        for (int c = 0; c < 3; ++c)
+            out.position[c] = glm::packHalf1x16(v.Position[c]);
+        out.position[3] = glm::packHalf1x16(1.0f);
+        glm::quat frame = encodeTangentFrame(v.Normal, v.Tangent, v.Bitangent);
+        out.tangentFrame[0] = (int16_t)glm::packSnorm1x16(frame.x);
+        out.tangentFrame[1] = (int16_t)glm::packSnorm1x16(frame.y);
+        out.tangentFrame[2] = (int16_t)glm::packSnorm1x16(frame.z);
+        out.tangentFrame[3] = (int16_t)glm::packSnorm1x16(frame.w);
+        out.texCoords[0] = glm::packHalf1x16(v.TexCoords.x);
+        out.texCoords[1] = glm::packHalf1x16(v.TexCoords.y);
+
+        // weights: round each to 1/255, then hand the rounding residue to the largest
+        // so the decoded weights still sum to exactly one
+        int total = 0, largest = 0;
+        for (int k = 0; k < 4; ++k)
+        {
+            bool used = v.m_BoneIDs[k] >= 0;
+            if (v.m_BoneIDs[k] >= PACKED_NO_BONE)
+                report.fits = false;
+            out.boneIds[k] = used ? (uint8_t)std::min(v.m_BoneIDs[k], (int)PACKED_NO_BONE - 1) : PACKED_NO_BONE;
+            out.weights[k] = used ? glm::packUnorm1x8(v.m_Weights[k]) : 0;
+            total += out.weights[k];
+            if (out.weights[k] > out.weights[largest])
+                largest = k;
+        }
+        if (total > 0)
+            out.weights[largest] = (uint8_t)std::min(255, std::max(0, out.weights[largest] + 255 - total));
+
+        for (int c = 0; c < 3; ++c)
+            report.positionError = std::max(report.positionError, std::abs(glm::unpackHalf1x16(out.position[c]) - v.Position[c]));
+        glm::quat decoded(glm::unpackSnorm1x16((uint16_t)out.tangentFrame[3]), glm::unpackSnorm1x16((uint16_t)out.tangentFrame[0]),
+                          glm::unpackSnorm1x16((uint16_t)out.tangentFrame[1]), glm::unpackSnorm1x16((uint16_t)out.tangentFrame[2]));
+        glm::vec3 normal, tangent, bitangent;
+        decodeTangentFrame(decoded, normal, tangent, bitangent);
+        report.normalDegrees = std::max(report.normalDegrees, angleDegrees(v.Normal, normal));
+        if (glm::dot(v.Tangent, v.Tangent) > 1.0e-12f)
+            report.tangentDegrees = std::max(report.tangentDegrees, angleDegrees(v.Tangent - glm::normalize(v.Normal) * glm::dot(glm::normalize(v.Normal), v.Tangent), tangent));
+        for (int c = 0; c < 2; ++c)
+            report.texCoordError = std::max(report.texCoordError, std::abs(glm::unpackHalf1x16(out.texCoords[c]) - v.TexCoords[c]));
+        for (int k = 0; k < 4; ++k)
+            if (v.m_BoneIDs[k] >= 0)
+                report.weightError = std::max(report.weightError, std::abs(glm::unpackUnorm1x8(out.weights[k]) - v.m_Weights[k]));
+    }
+    return packed;
+}
+
+// e.g. "  sphere: 22k verts, 32 -> 16 B/vertex, 704 KB -> 352 KB per full fetch (-50%), max error ..."
+inline void reportVertexPack(std::ostream& out, const std::string& name, const VertexPackReport& report)
+{
+    double floatKB = report.vertices * report.floatStride / 1024.0;
+    double packedKB = report.vertices * report.packedStride / 1024.0;
+    out << "  " << name << ": " << report.vertices << " verts, " << report.floatStride << " -> " << report.packedStride
+        << " B/vertex, " << std::fixed << std::setprecision(1) << floatKB << " KB -> " << packedKB << " KB per full fetch ("
+        << (floatKB > 0.0 ? (packedKB / floatKB - 1.0) * 100.0 : 0.0) << "%)" << std::defaultfloat << std::setprecision(3)
+        << ", max error: position " << report.positionError << ", normal " << report.normalDegrees << " deg";
+    if (report.tangentDegrees > 0.0f)
+        out << ", tangent " << report.tangentDegrees << " deg";
+    out << ", texcoord " << report.texCoordError;
+    if (report.weightError > 0.0f)
+        out << ", weight " << report.weightError;
+    if (!report.fits)
+        out << " (OUT OF RANGE)";
+    out << std::setprecision(6) << std::endl;
+}
@@ -0,0 +1,567 @@
+// program_cache.h
+// Shader programs that skip compilation on later runs:
+//  - ProgramCache: builds programs from vertex/fragment files like learnopengl's Shader,
+//    but saves the linked program with glGetProgramBinary and restores it with
+//    glProgramBinary next time. The cache key is a hash of both sources and the
+//    GL vendor/renderer/version strings, so editing a shader or updating the driver
+//    misses cleanly; a binary the driver refuses falls back to compiling from source.
+//  - several programs can be built at once, optionally on worker threads that each
+//    own a context sharing objects with the main one
+//  - CachedShader: the Shader setter interface over a program id
+//  - permutations: a ProgramSource may carry #defines, inserted after the #version
+//    line of both stages, so one file yields specialized variants (a bone count, a
+//    light count, a material without a specular map); each variant is its own cache entry
+// Without GL_ARB_get_program_binary (or with zero binary formats, as some Mesa
+// configurations report) everything still works, it just always compiles.
+#pragma once
+
+#include <glad/glad.h>
+#include <GLFW/glfw3.h>
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// A uniform name from a literal or a std::string. Taking const std::string& would build
+// a temporary for every literal, which allocates once the name outgrows the small
+// string buffer ("pointLights[0].position").
+struct UniformName
+{
+    const char* text;
+    UniformName(const char* name) : text(name) {}
+    UniformName(const std::string& name) : text(name.c_str()) {}
+};
+
+class CachedShader
+{
+public:
+    unsigned int ID = 0;
+
+    CachedShader() {}
+    explicit CachedShader(unsigned int id) : ID(id) {}
+
+    void use() const { glUseProgram(ID); }
+    void setBool(UniformName name, bool value) const { glUniform1i(glGetUniformLocation(ID, name.text), (int)value); }
+    void setInt(UniformName name, int value) const { glUniform1i(glGetUniformLocation(ID, name.text), value); }
+    void setFloat(UniformName name, float value) const { glUniform1f(glGetUniformLocation(ID, name.text), value); }
+    void setVec2(UniformName name, const glm::vec2& value) const { glUniform2fv(glGetUniformLocation(ID, name.text), 1, &value[0]); }
+    void setVec2(UniformName name, float x, float y) const { glUniform2f(glGetUniformLocation(ID, name.text), x, y); }
+    void setVec3(UniformName name, const glm::vec3& value) const { glUniform3fv(glGetUniformLocation(ID, name.text), 1, &value[0]); }
+    void setVec3(UniformName name, float x, float y, float z) const { glUniform3f(glGetUniformLocation(ID, name.text), x, y, z); }
+    void setVec4(UniformName name, const glm::vec4& value) const { glUniform4fv(glGetUniformLocation(ID, name.text), 1, &value[0]); }
+    void setVec4(UniformName name, float x, float y, float z, float w) const { glUniform4f(glGetUniformLocation(ID, name.text), x, y, z, w); }
+    void setMat3(UniformName name, const glm::mat3& mat) const { glUniformMatrix3fv(glGetUniformLocation(ID, name.text), 1, GL_FALSE, &mat[0][0]); }
+    void setMat4(UniformName name, const glm::mat4& mat) const { glUniformMatrix4fv(glGetUniformLocation(ID, name.text), 1, GL_FALSE, &mat[0][0]); }
+};
+
+// one `#define name value` of a shader permutation
+struct ShaderDefine
+{
+    std::string name;
+    int value;
+};
+
+struct ProgramSource
+{
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::vector<ShaderDefine> defines = {}; // empty: the file as written, its generic path
+};
+
+// the defines as a block of #define lines, placed after `#version` (which must stay first)
+inline std::string applyDefines(const std::string& code, const std::vector<ShaderDefine>& defines)
+{
+    if (defines.empty())
+        return code;
+    std::string block;
+    for (const ShaderDefine& define : defines)
+        block += "#define " + define.name + " " + std::to_string(define.value) + "\n";
+    size_t version = code.find("#version");
+    size_t insert = version == std::string::npos ? 0 : code.find('\n', version);
+    insert = insert == std::string::npos ? code.size() : insert + 1;
+    return code.substr(0, insert) + block + code.substr(insert);
+}
+
+// Uniform storage a linked program actually uses, in float/int components: a mat4 is
+// 16, an array counts every element the compiler kept. Specialized variants that fold
+// a uniform into a constant, or size an array to the model, show up here.
+inline int activeUniformComponents(GLuint program)
+{
+    GLint uniforms = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &uniforms);
+    int components = 0;
+    for (GLint i = 0; i < uniforms; ++i)
+    {
+        GLint size = 0;
+        GLenum type = 0;
+        char name[128];
+        glGetActiveUniform(program, (GLuint)i, sizeof(name), NULL, &size, &type, name);
+        int perElement = 1;
+        switch (type)
+        {
+        case GL_FLOAT_VEC2: case GL_INT_VEC2: perElement = 2; break;
+        case GL_FLOAT_VEC3: case GL_INT_VEC3: perElement = 3; break;
+        case GL_FLOAT_VEC4: case GL_INT_VEC4: perElement = 4; break;
+        case GL_FLOAT_MAT3: perElement = 9; break;
+        case GL_FLOAT_MAT4: perElement = 16; break;
+        default: break;
+        }
+        components += perElement * size;
+    }
+    return components;
+}
+
+struct ProgramCacheStats
+{
+    unsigned int programs = 0;
+    unsigned int binaryHits = 0;
+    unsigned int binaryRejected = 0; // found on disk but refused by the driver or stale
+    unsigned int sourceBuilds = 0;
+    unsigned int binariesSaved = 0;
+    double readMs = 0.0;             // reading and hashing the sources
+    double binaryLoadMs = 0.0;       // reading cache files and glProgramBinary
+    double compileMs = 0.0;          // glCompileShader until status, summed over threads
+    double linkMs = 0.0;             // glLinkProgram until status, summed over threads
+    double saveMs = 0.0;             // glGetProgramBinary and writing the files
+    double totalMs = 0.0;            // wall clock of all loads
+};
+
+class ProgramCache
+{
+public:
+    // loader looks up the program binary entry points, which a 3.3 glad does not load
+    explicit ProgramCache(GLADloadproc loader, const std::string& directory = "shader_cache", bool enabled = true)
+        : directory(directory)
+    {
+        getProgramBinary = (GetProgramBinaryProc)loader("glGetProgramBinary");
+        programBinary = (ProgramBinaryProc)loader("glProgramBinary");
+        programParameteri = (ProgramParameteriProc)loader("glProgramParameteri");
+        GLint formats = 0;
+        if (getProgramBinary != nullptr && programBinary != nullptr && programParameteri != nullptr)
+            glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        binaryFormats = formats;
+        available = enabled && formats > 0;
+
+        const char* strings[3] = { (const char*)glGetString(GL_VENDOR), (const char*)glGetString(GL_RENDERER), (const char*)glGetString(GL_VERSION) };
+        for (const char* s : strings)
+        {
+            driver += s != nullptr ? s : "?";
+            driver += '|';
+        }
+    }
+
+    bool binariesAvailable() const { return available; }
+    const std::string& driverString() const { return driver; }
+
+    CachedShader load(const std::string& vertexPath, const std::string& fragmentPath)
+    {
+        return loadAll({ ProgramSource{ vertexPath, fragmentPath } })[0];
+    }
+
+    // Builds several programs. Cache hits are restored first; the misses are compiled
+    // either on this thread, with every compile and link issued before any status is
+    // queried so a driver with parallel compilation can overlap them, or spread over
+    // workerContexts: windows whose contexts share objects with the current one and are
+    // not current anywhere. Programs built on a worker are finished (glFinish) before
+    // they are handed back.
+    std::vector<CachedShader> loadAll(const std::vector<ProgramSource>& sources, const std::vector<GLFWwindow*>& workerContexts = {})
+    {
+        auto start = Clock::now();
+        std::vector<Build> builds(sources.size());
+        for (size_t i = 0; i < sources.size(); ++i)
+        {
+            Build& build = builds[i];
+            auto readStart = Clock::now();
+            build.vertexCode = applyDefines(readSource(sources[i].vertexPath), sources[i].defines);
+            build.fragmentCode = applyDefines(readSource(sources[i].fragmentPath), sources[i].defines);
+            build.key = hashString(hashString(hashString(14695981039346656037ull, build.vertexCode), build.fragmentCode), driver);
+            stats.readMs += millisecondsSince(readStart);
+            if (available)
+                build.program = loadBinary(build.key);
+        }
+
+        std::vector<Build*> misses;
+        for (Build& build : builds)
+            if (build.program == 0)
+                misses.push_back(&build);
+
+        if (workerContexts.empty() || misses.size() < 2)
+            buildFromSource(misses, stats.compileMs, stats.linkMs);
+        else
+        {
+            size_t threadCount = std::min(workerContexts.size(), misses.size());
+            std::vector<std::vector<Build*>> shares(threadCount);
+            for (size_t i = 0; i < misses.size(); ++i)
+                shares[i % threadCount].push_back(misses[i]);
+            std::vector<double> compileMs(threadCount, 0.0), linkMs(threadCount, 0.0);
+            std::vector<std::thread> threads;
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                threads.emplace_back([this, &shares, &workerContexts, &compileMs, &linkMs, t]() {
+                    glfwMakeContextCurrent(workerContexts[t]);
+                    for (Build* build : shares[t])
+                        buildFromSource({ build }, compileMs[t], linkMs[t]);
+                    glFinish();
+                    glfwMakeContextCurrent(nullptr);
+                });
+            }
+            for (size_t t = 0; t < threadCount; ++t)
+            {
+                threads[t].join();
+                stats.compileMs += compileMs[t];
+                stats.linkMs += linkMs[t];
+            }
+        }
+
+        if (available)
+            for (Build* build : misses)
+                if (build->linked)
+                    saveBinary(*build);
+
+        std::vector<CachedShader> shaders;
+        for (const Build& build : builds)
+            shaders.push_back(CachedShader(build.program));
+        stats.programs += (unsigned int)builds.size();
+        stats.sourceBuilds += (unsigned int)misses.size();
+        stats.totalMs += millisecondsSince(start);
+        return shaders;
+    }
+
+    // removes every cached binary, for measuring a cold start
+    void clear()
+    {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    const ProgramCacheStats& statistics() const { return stats; }
+    void resetStats() { stats = ProgramCacheStats(); }
+
+    void report(std::ostream& out) const
+    {
+        out << "Shader startup: " << std::fixed << std::setprecision(2) << stats.totalMs << " ms for " << stats.programs << " program(s) ("
+            << stats.binaryHits << " from cache, " << stats.sourceBuilds << " compiled";
+        if (stats.binaryRejected > 0)
+            out << ", " << stats.binaryRejected << " stale";
+        out << "): read " << stats.readMs << " ms, binary load " << stats.binaryLoadMs << " ms, compile " << stats.compileMs
+            << " ms, link " << stats.linkMs << " ms, save " << stats.saveMs << " ms" << std::defaultfloat << std::setprecision(6);
+        if (!available)
+            out << " [no program binary support: " << binaryFormats << " formats]";
+        out << std::endl;
+    }
+
+private:
+    typedef std::chrono::steady_clock Clock;
+    typedef void (APIENTRYP GetProgramBinaryProc)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+    typedef void (APIENTRYP ProgramBinaryProc)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+    typedef void (APIENTRYP ProgramParameteriProc)(GLuint program, GLenum pname, GLint value);
+
+    struct Build
+    {
+        std::string vertexCode;
+        std::string fragmentCode;
+        uint64_t key = 0;
+        GLuint program = 0;
+        bool linked = false;
+    };
+
+    static double millisecondsSince(Clock::time_point start)
+    {
+        return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    }
+
+    static uint64_t hashString(uint64_t hash, const std::string& text)
+    {
+        for (unsigned char c : text)
+            hash = (hash ^ c) * 1099511628211ull;
+        return (hash ^ 0xff) * 1099511628211ull; // separator, so "ab"+"c" and "a"+"bc" differ
+    }
+
+    static std::string readSource(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file)
+        {
+            std::cout << "ERROR::SHADER::FILE_NOT_SUCCESFULLY_READ: " << path << std::endl;
+            return std::string();
+        }
+        std::stringstream stream;
+        stream << file.rdbuf();
+        return stream.str();
+    }
+
+    std::string cachePath(uint64_t key) const
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.bin", (unsigned long long)key);
+        return directory + "/" + name;
+    }
+
+    // File: "PRGB", uint32 version, uint64 key, uint32 driver length, driver string,
+    // uint32 binary format, uint32 binary length, binary
+    GLuint loadBinary(uint64_t key)
+    {
+        auto start = Clock::now();
+        std::ifstream file(cachePath(key), std::ios::binary);
+        if (!file)
+            return 0;
+        char magic[4] = {};
+        uint32_t version = 0, driverLength = 0, format = 0, length = 0;
+        uint64_t storedKey = 0;
+        file.read(magic, 4);
+        file.read((char*)&version, sizeof(version));
+        file.read((char*)&storedKey, sizeof(storedKey));
+        file.read((char*)&driverLength, sizeof(driverLength));
+        std::string storedDriver(driverLength < 4096 ? driverLength : 0, '\0');
+        file.read(&storedDriver[0], storedDriver.size());
+        file.read((char*)&format, sizeof(format));
+        file.read((char*)&length, sizeof(length));
+        std::vector<char> binary(file ? length : 0);
+        file.read(binary.data(), binary.size());
+        if (!file || std::string(magic, 4) != "PRGB" || version != FILE_VERSION || storedKey != key || storedDriver != driver)
+        {
+            stats.binaryRejected++;
+            stats.binaryLoadMs += millisecondsSince(start);
+            return 0;
+        }
+
+        GLuint program = glCreateProgram();
+        programBinary(program, (GLenum)format, binary.data(), (GLsizei)binary.size());
+        GLint linked = 0;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked)
+        {
+            // driver changed its mind (e.g. same version string, different build): rebuild
+            glDeleteProgram(program);
+            program = 0;
+            stats.binaryRejected++;
+        }
+        else
+            stats.binaryHits++;
+        stats.binaryLoadMs += millisecondsSince(start);
+        return program;
+    }
+
+    void saveBinary(const Build& build)
+    {
+        auto start = Clock::now();
+        GLint length = 0;
+        glGetProgramiv(build.program, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (length <= 0)
+            return;
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        GLsizei written = 0;
+        getProgramBinary(build.program, length, &written, &format, binary.data());
+
+        std::error_code error;
+        std::filesystem::create_directories(directory, error);
+        std::string path = cachePath(build.key);
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary);
+            if (!file)
+                return;
+            uint32_t version = FILE_VERSION, driverLength = (uint32_t)driver.size(), storedFormat = format, storedLength = (uint32_t)written;
+            file.write("PRGB", 4);
+            file.write((const char*)&version, sizeof(version));
+            file.write((const char*)&build.key, sizeof(build.key));
+            file.write((const char*)&driverLength, sizeof(driverLength));
+            file.write(driver.data(), driver.size());
+            file.write((const char*)&storedFormat, sizeof(storedFormat));
+            file.write((const char*)&storedLength, sizeof(storedLength));
+            file.write(binary.data(), written);
+        }
+        std::filesystem::rename(temporary, path, error); // a concurrent reader never sees half a file
+        stats.binariesSaved++;
+        stats.saveMs += millisecondsSince(start);
+    }
+
+    // Compiles and links every build from source on the current context. All commands
+    // are issued first and the statuses read afterwards.
+    void buildFromSource(const std::vector<Build*>& builds, double& compileMs, double& linkMs)
+    {
+        struct Stages
+        {
+            GLuint vertex, fragment;
+        };
+        std::vector<Stages> stages(builds.size());
+        auto compileStart = Clock::now();
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            stages[i].vertex = compileStage(GL_VERTEX_SHADER, builds[i]->vertexCode);
+            stages[i].fragment = compileStage(GL_FRAGMENT_SHADER, builds[i]->fragmentCode);
+        }
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            checkCompileErrors(stages[i].vertex, "VERTEX");
+            checkCompileErrors(stages[i].fragment, "FRAGMENT");
+        }
+        compileMs += millisecondsSince(compileStart);
+
+        auto linkStart = Clock::now();
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            GLuint program = glCreateProgram();
+            if (available)
+                programParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+            glAttachShader(program, stages[i].vertex);
+            glAttachShader(program, stages[i].fragment);
+            glLinkProgram(program);
+            builds[i]->program = program;
+        }
+        for (size_t i = 0; i < builds.size(); ++i)
+        {
+            builds[i]->linked = checkCompileErrors(builds[i]->program, "PROGRAM");
+            glDeleteShader(stages[i].vertex);
+            glDeleteShader(stages[i].fragment);
+        }
+        linkMs += millisecondsSince(linkStart);
+    }
+
+    static GLuint compileStage(GLenum type, const std::string& code)
+    {
+        GLuint shader = glCreateShader(type);
+        const char* text = code.c_str();
+        glShaderSource(shader, 1, &text, NULL);
+        glCompileShader(shader);
+        return shader;
+    }
+
+    // same messages as learnopengl's Shader::checkCompileErrors; true on success
+    static bool checkCompileErrors(GLuint object, const std::string& type)
+    {
+        GLint success = 0;
+        GLchar infoLog[1024];
+        if (type != "PROGRAM")
+        {
+            glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+            if (!success)
+            {
+                glGetShaderInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::SHADER_COMPILATION_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        else
+        {
+            glGetProgramiv(object, GL_LINK_STATUS, &success);
+            if (!success)
+            {
+                glGetProgramInfoLog(object, 1024, NULL, infoLog);
+                std::cout << "ERROR::PROGRAM_LINKING_ERROR of type: " << type << "\n" << infoLog << "\n -- --------------------------------------------------- -- " << std::endl;
+            }
+        }
+        return success != 0;
+    }
+
+    static const uint32_t FILE_VERSION = 1;
+
+    std::string directory;
+    std::string driver;
+    GLint binaryFormats = 0;
+    bool available = false;
+    GetProgramBinaryProc getProgramBinary = nullptr;
+    ProgramBinaryProc programBinary = nullptr;
+    ProgramParameteriProc programParameteri = nullptr;
+    ProgramCacheStats stats;
+};
+
+// Headless: builds `sources` cold on one thread, cold on `threads` shared worker
+// contexts, then warm from the cache, and reports each. Creates its own hidden 3.3
+// core window, so it runs wherever GLFW can make a context, including Mesa's
+// llvmpipe (LIBGL_ALWAYS_SOFTWARE=1). Mesa only offers program binaries while its own
+// shader disk cache is on, which also speeds up the second cold pass; point
+// MESA_SHADER_CACHE_DIR at an empty directory for a true cold start, or set
+// MESA_SHADER_CACHE_DISABLE=true to exercise the no-binary fallback. Returns non-zero
+// if a program failed to build, or if binaries are supported but the warm pass did
+// not hit the cache.
+inline int runProgramCacheBenchmark(const std::vector<ProgramSource>& sources, int threads, const std::string& directory = "shader_cache_bench")
+{
+    glfwInit();
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+#ifdef __APPLE__
+    glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE);
+#endif
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* window = glfwCreateWindow(64, 64, "shader cache", NULL, NULL);
+    if (window == NULL)
+    {
+        std::cout << "Failed to create GLFW window" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    glfwMakeContextCurrent(window);
+    if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress))
+    {
+        std::cout << "Failed to initialize GLAD" << std::endl;
+        glfwTerminate();
+        return -1;
+    }
+    std::vector<GLFWwindow*> workers;
+    for (int i = 0; i < threads; ++i)
+    {
+        GLFWwindow* worker = glfwCreateWindow(1, 1, "shader worker", NULL, window);
+        if (worker != NULL)
+            workers.push_back(worker);
+    }
+
+    ProgramCache cache((GLADloadproc)glfwGetProcAddress, directory);
+    std::cout << "Driver: " << cache.driverString() << " (" << (cache.binariesAvailable() ? "program binaries supported" : "no program binaries")
+              << "), " << workers.size() << " worker context(s)" << std::endl;
+
+    int failures = 0;
+    auto pass = [&](const char* name, bool cold, const std::vector<GLFWwindow*>& contexts) {
+        if (cold)
+            cache.clear();
+        cache.resetStats();
+        std::vector<CachedShader> shaders = cache.loadAll(sources, contexts);
+        std::cout << name << ": ";
+        cache.report(std::cout);
+        for (const CachedShader& shader : shaders)
+        {
+            GLint linked = 0;
+            glGetProgramiv(shader.ID, GL_LINK_STATUS, &linked);
+            if (!linked)
+                failures++;
+            glDeleteProgram(shader.ID);
+        }
+    };
+    pass("Cold, 1 thread", true, {});
+    if (!workers.empty())
+        pass("Cold, worker contexts", true, workers);
+    pass("Warm", false, {});
+    bool warmHit = cache.statistics().binaryHits == sources.size();
+    if (cache.binariesAvailable() && !warmHit)
+    {
+        std::cout << "Warm pass missed the cache" << std::endl;
+        failures++;
+    }
+    cache.clear();
+
+    for (GLFWwindow* worker : workers)
+        glfwDestroyWindow(worker);
+    glfwTerminate();
+    return failures == 0 ? 0 : 1;
+}
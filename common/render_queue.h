@@ -0,0 +1,253 @@
+// render_queue.h
+// Renderer front-end: the frame's draws are recorded as DrawPackets into a
+// linear-allocated command buffer, radix-sorted by a 64-bit state key and then
+// submitted with only the program / VAO / texture binds that actually change.
+//
+// Key layout, most significant first:
+//   program slot (8) | texture unit 0 (16) | texture unit 1 (16) | VAO (16) | depth (8)
+// GL names are truncated to 16 bits; a collision only costs sort quality, since
+// every packet still carries its full state.
+//
+// A program that declares `uniform mat3 normalMatrix` (a NORMAL_MATRIX shader
+// permutation) gets it computed here from the packet's model matrix, once per draw
+// rather than once per vertex.
+#pragma once
+
+#include <glad/glad.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_inverse.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "linear_allocator.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+const int RENDER_QUEUE_TEXTURE_UNITS = 2;
+
+struct DrawPacket
+{
+    GLuint program;
+    GLuint vao;
+    GLuint textures[RENDER_QUEUE_TEXTURE_UNITS]; // GL_TEXTURE_2D on units 0 and 1, 0 = leave as is
+    GLenum indexType;                             // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+    GLsizei indexCount;
+    size_t firstIndexOffset;                      // byte offset into the element buffer
+    GLint baseVertex;
+    float depth;                                  // 0 = near, 1 = far; orders packets with equal state front to back
+    glm::mat4 model;
+};
+
+struct RenderQueueStats
+{
+    unsigned int packets = 0;
+    unsigned int programBinds = 0;
+    unsigned int vaoBinds = 0;
+    unsigned int textureBinds = 0;
+    unsigned int modelUploads = 0;
+    unsigned int normalMatrixUploads = 0;
+    unsigned int avoidedChanges = 0; // binds an unsorted, unfiltered submit would have made on top of these
+    double sortMicroseconds = 0.0;
+};
+
+class RenderQueue
+{
+public:
+    explicit RenderQueue(size_t initialPackets = 256)
+        : arena(initialPackets * (sizeof(DrawPacket) + 2 * sizeof(SortEntry)) + 4096), initialCapacity(initialPackets)
+    {
+        begin();
+    }
+
+    // starts recording a new frame; everything recorded before is dropped
+    void begin()
+    {
+        arena.reset();
+        capacity = initialCapacity;
+        packets = arena.allocateArray<DrawPacket>(capacity);
+        count = 0;
+    }
+
+    void submit(const DrawPacket& packet)
+    {
+        if (count == capacity)
+        {
+            // grow inside the arena; the old array is simply abandoned until begin()
+            DrawPacket* grown = arena.allocateArray<DrawPacket>(capacity * 2);
+            std::memcpy(grown, packets, sizeof(DrawPacket) * count);
+            packets = grown;
+            capacity *= 2;
+        }
+        packets[count++] = packet;
+    }
+
+    // sorts and issues every recorded packet, then starts a new frame
+    void flush()
+    {
+        frameStats = RenderQueueStats();
+        frameStats.packets = (unsigned int)count;
+        if (count == 0)
+            return;
+
+        auto sortStart = std::chrono::steady_clock::now();
+        SortEntry* entries = arena.allocateArray<SortEntry>(count);
+        SortEntry* scratch = arena.allocateArray<SortEntry>(count);
+        for (size_t i = 0; i < count; ++i)
+            entries[i] = { makeKey(packets[i]), (uint32_t)i };
+        SortEntry* sorted = radixSort(entries, scratch, count);
+        frameStats.sortMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - sortStart).count();
+
+        // bound state is unknown at the start of each flush
+        GLuint boundProgram = 0, boundVAO = 0;
+        GLuint boundTextures[RENDER_QUEUE_TEXTURE_UNITS] = {};
+        GLint modelLocation = -1, normalLocation = -1;
+        bool first = true;
+        unsigned int naiveTextureBinds = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const DrawPacket& packet = packets[sorted[i].index];
+            if (first || packet.program != boundProgram)
+            {
+                glUseProgram(packet.program);
+                boundProgram = packet.program;
+                const ProgramInfo& info = programInfo(packet.program);
+                modelLocation = info.modelLocation;
+                normalLocation = info.normalLocation;
+                frameStats.programBinds++;
+            }
+            if (first || packet.vao != boundVAO)
+            {
+                glBindVertexArray(packet.vao);
+                boundVAO = packet.vao;
+                frameStats.vaoBinds++;
+            }
+            for (int unit = 0; unit < RENDER_QUEUE_TEXTURE_UNITS; ++unit)
+            {
+                if (packet.textures[unit] == 0)
+                    continue;
+                naiveTextureBinds++;
+                if (first || packet.textures[unit] != boundTextures[unit])
+                {
+                    glActiveTexture(GL_TEXTURE0 + unit);
+                    glBindTexture(GL_TEXTURE_2D, packet.textures[unit]);
+                    boundTextures[unit] = packet.textures[unit];
+                    frameStats.textureBinds++;
+                }
+            }
+            first = false;
+
+            glUniformMatrix4fv(modelLocation, 1, GL_FALSE, glm::value_ptr(packet.model));
+            frameStats.modelUploads++;
+            if (normalLocation >= 0)
+            {
+                glm::mat3 normalMatrix = glm::inverseTranspose(glm::mat3(packet.model));
+                glUniformMatrix3fv(normalLocation, 1, GL_FALSE, glm::value_ptr(normalMatrix));
+                frameStats.normalMatrixUploads++;
+            }
+            glDrawElementsBaseVertex(GL_TRIANGLES, packet.indexCount, packet.indexType,
+                                     (void*)packet.firstIndexOffset, packet.baseVertex);
+        }
+        unsigned int naive = frameStats.packets * 2 + naiveTextureBinds;
+        frameStats.avoidedChanges = naive - (frameStats.programBinds + frameStats.vaoBinds + frameStats.textureBinds);
+
+        totals.packets += frameStats.packets;
+        totals.programBinds += frameStats.programBinds;
+        totals.vaoBinds += frameStats.vaoBinds;
+        totals.textureBinds += frameStats.textureBinds;
+        totals.modelUploads += frameStats.modelUploads;
+        totals.normalMatrixUploads += frameStats.normalMatrixUploads;
+        totals.avoidedChanges += frameStats.avoidedChanges;
+        totals.sortMicroseconds += frameStats.sortMicroseconds;
+        begin();
+    }
+
+    // counters of the last flush, and their sum since the last resetTotals()
+    const RenderQueueStats& lastFrame() const { return frameStats; }
+    const RenderQueueStats& accumulated() const { return totals; }
+    void resetTotals() { totals = RenderQueueStats(); }
+    size_t arenaPeakBytes() const { return arena.peakBytes(); }
+
+private:
+    struct SortEntry
+    {
+        uint64_t key;
+        uint32_t index;
+    };
+
+    uint64_t makeKey(const DrawPacket& packet)
+    {
+        uint64_t depthBits = (uint64_t)(std::min(std::max(packet.depth, 0.0f), 1.0f) * 255.0f);
+        return ((uint64_t)programSlot(packet.program) << 56)
+             | ((uint64_t)(packet.textures[0] & 0xffff) << 40)
+             | ((uint64_t)(packet.textures[1] & 0xffff) << 24)
+             | ((uint64_t)(packet.vao & 0xffff) << 8)
+             | depthBits;
+    }
+
+    // LSD radix sort, one byte per pass. All eight histograms are built in one read
+    // of the keys, and a pass is skipped when every key has the same byte there
+    // (program and texture bytes usually are). Returns whichever buffer holds the result.
+    static SortEntry* radixSort(SortEntry* entries, SortEntry* scratch, size_t n)
+    {
+        uint32_t histograms[8][256] = {};
+        for (size_t i = 0; i < n; ++i)
+            for (int pass = 0; pass < 8; ++pass)
+                histograms[pass][(entries[i].key >> (pass * 8)) & 0xff]++;
+
+        for (int pass = 0; pass < 8; ++pass)
+        {
+            uint32_t* histogram = histograms[pass];
+            if (histogram[(entries[0].key >> (pass * 8)) & 0xff] == n)
+                continue;
+            uint32_t offset = 0;
+            for (int bucket = 0; bucket < 256; ++bucket)
+            {
+                uint32_t bucketCount = histogram[bucket];
+                histogram[bucket] = offset;
+                offset += bucketCount;
+            }
+            for (size_t i = 0; i < n; ++i)
+                scratch[histogram[(entries[i].key >> (pass * 8)) & 0xff]++] = entries[i];
+            std::swap(entries, scratch);
+        }
+        return entries;
+    }
+
+    // programs get a compact slot in first-seen order so they fit the top byte
+    uint32_t programSlot(GLuint program)
+    {
+        for (size_t i = 0; i < programs.size(); ++i)
+            if (programs[i].program == program)
+                return (uint32_t)std::min<size_t>(i, 255);
+        programs.push_back({ program, glGetUniformLocation(program, "model"), glGetUniformLocation(program, "normalMatrix") });
+        return (uint32_t)std::min<size_t>(programs.size() - 1, 255);
+    }
+
+    struct ProgramInfo
+    {
+        GLuint program;
+        GLint modelLocation;
+        GLint normalLocation; // -1 unless the program takes its normal matrix from the CPU
+    };
+
+    // every packet's program got a slot in makeKey before the submit loop runs
+    const ProgramInfo& programInfo(GLuint program) const
+    {
+        for (const ProgramInfo& info : programs)
+            if (info.program == program)
+                return info;
+        return programs.front();
+    }
+
+    LinearAllocator arena;
+    size_t initialCapacity;
+    DrawPacket* packets = nullptr;
+    size_t capacity = 0;
+    size_t count = 0;
+    std::vector<ProgramInfo> programs;
+    RenderQueueStats frameStats;
+    RenderQueueStats totals;
+};
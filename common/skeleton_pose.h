@@ -0,0 +1,32 @@
+// skeleton_pose.h
+// The node walk of learnopengl's Animator::CalculateBoneTransform over a flattened
+// hierarchy, no GL and no Assimp: local transforms in, skinning palette out. The
+// nodes are stored parents first, so one forward pass sees every parent's global
+// transform before its children need it. SkeletonLodPose (Assignment5) feeds it from
+// the clip's Bone tracks; the bench feeds it from ClipSampler.
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <vector>
+
+struct SkeletonNode
+{
+    int parent;       // index of the parent node, -1 for the root
+    int slot;         // palette slot, -1 if not a bone
+    glm::mat4 offset; // mesh space to bone space, for bones
+};
+
+// globals must hold one matrix per node and palette one per slot
+inline void composeSkeleton(const std::vector<SkeletonNode>& nodes, const std::vector<glm::mat4>& locals,
+                            std::vector<glm::mat4>& globals, std::vector<glm::mat4>& palette)
+{
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        const SkeletonNode& node = nodes[i];
+        globals[i] = node.parent < 0 ? locals[i] : globals[node.parent] * locals[i];
+        if (node.slot >= 0)
+            palette[node.slot] = globals[i] * node.offset;
+    }
+}
@@ -0,0 +1,50 @@
+// triple_buffer.h
+// Single-producer / single-consumer hand-off of the latest value, lock-free.
+// The writer fills writeBuffer() and publish()es it; the reader calls update()
+// and then reads readBuffer(), which stays untouched until its next update().
+// Neither side ever waits: the writer may publish many times between reads
+// (older values are skipped) and the reader keeps the last value if nothing new
+// arrived. Slots are reused, so a T holding vectors stops allocating once warm.
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+template <typename T>
+class TripleBuffer
+{
+public:
+    TripleBuffer() = default;
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    // writer side
+    T& writeBuffer() { return slots[back]; }
+
+    void publish()
+    {
+        uint8_t previous = middle.exchange((uint8_t)(back | FRESH), std::memory_order_acq_rel);
+        back = previous & INDEX_MASK;
+    }
+
+    // reader side: true if a newer value was published since the last update()
+    bool update()
+    {
+        if ((middle.load(std::memory_order_relaxed) & FRESH) == 0)
+            return false;
+        uint8_t previous = middle.exchange(front, std::memory_order_acq_rel);
+        front = previous & INDEX_MASK;
+        return true;
+    }
+
+    const T& readBuffer() const { return slots[front]; }
+
+private:
+    static const uint8_t INDEX_MASK = 0x3;
+    static const uint8_t FRESH = 0x4;
+
+    T slots[3];
+    uint8_t back = 0;                  // owned by the writer
+    std::atomic<uint8_t> middle { 1 }; // slot index plus the FRESH flag
+    uint8_t front = 2;                 // owned by the reader
+};